@@ -147,7 +147,7 @@ public:
         }
         else
         {
-            std::sort(First, Last);
+            std::sort(Data.begin(), Data.end());
         }
     }
 
@@ -217,14 +217,14 @@ public:
         return *this;
     }
 
-    inline _Vty& operator[](_Kty Key) { return Data[Key]; }
-    inline const _Vty& operator[](_Kty Key) const { return Data[Key]; }
+    inline _Vty& operator[](const _Kty& Key) { return Data[Key]; }
+    inline const _Vty& operator[](const _Kty& Key) const { return Data[Key]; }
 
     inline void Clear() { Data.clear(); }
 
-    inline TPair<_Iterator, bool> Add(_Kty Key, _Vty Val) { return Data.emplace(Key, Val); }
+    inline TPair<_Iterator, bool> Add(const _Kty& Key, _Vty Val) { return Data.emplace(Key, Val); }
 
-    inline _Vty* Remove(_Kty Key)
+    inline _Vty* Remove(const _Kty& Key)
     {
         _Vty* Val = Find(Key);
         if (Val)
@@ -234,7 +234,7 @@ public:
         return Val;
     }
 
-    inline _Vty* Find(_Kty Key)
+    inline _Vty* Find(const _Kty& Key)
     {
         _Iterator Iter = Data.find(Key);
         if (Iter != Data.end())
@@ -244,7 +244,7 @@ public:
         return nullptr;
     }
 
-    inline const _Vty* Find(_Kty Key) const
+    inline const _Vty* Find(const _Kty& Key) const
     {
         _ConstIterator Iter = Data.find(Key);
         if (Iter != Data.end())
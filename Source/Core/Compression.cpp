@@ -0,0 +1,553 @@
+#include "Compression.h"
+
+namespace
+{
+    constexpr size_t MinMatch = 4;
+    // The block format requires the last 5 bytes to be literals and the last match to start 12 bytes before the end.
+    constexpr size_t LastLiterals = 5;
+    constexpr size_t MatchFindLimit = 12;
+    constexpr size_t MaxOffset = 65535;
+    constexpr uint32_t HashBits = 12;
+
+    inline uint32_t Read32(const uint8_t* Ptr)
+    {
+        uint32_t Value;
+        std::memcpy(&Value, Ptr, sizeof(Value));
+        return Value;
+    }
+
+    inline uint32_t HashSequence(uint32_t Sequence) { return (Sequence * 2654435761u) >> (32 - HashBits); }
+
+    inline uint8_t* WriteLength(uint8_t* Out, size_t Length)
+    {
+        for (; Length >= 255; Length -= 255)
+        {
+            *Out++ = 255;
+        }
+        *Out++ = static_cast<uint8_t>(Length);
+        return Out;
+    }
+
+    inline uint8_t* WriteSequence(uint8_t* Out, const uint8_t* Literals, size_t NumLiterals, size_t Offset, size_t MatchLength)
+    {
+        uint8_t* Token = Out++;
+        *Token = static_cast<uint8_t>(std::min<size_t>(NumLiterals, 15) << 4);
+        if (NumLiterals >= 15)
+        {
+            Out = WriteLength(Out, NumLiterals - 15);
+        }
+        std::memcpy(Out, Literals, NumLiterals);
+        Out += NumLiterals;
+
+        // The last sequence has literals only.
+        if (MatchLength != 0)
+        {
+            *Out++ = static_cast<uint8_t>(Offset & 0xFF);
+            *Out++ = static_cast<uint8_t>(Offset >> 8);
+
+            *Token |= static_cast<uint8_t>(std::min<size_t>(MatchLength - MinMatch, 15));
+            if (MatchLength - MinMatch >= 15)
+            {
+                Out = WriteLength(Out, MatchLength - MinMatch - 15);
+            }
+        }
+        return Out;
+    }
+} // namespace
+
+bool ACompression::CompressLZ4(const void* Src, size_t SrcSize, TArray<uint8_t>& OutData)
+{
+    const uint8_t* In = static_cast<const uint8_t*>(Src);
+
+    OutData.Resize(static_cast<int32_t>(SrcSize + SrcSize / 255 + 16));
+    uint8_t* Out = OutData.GetData();
+
+    size_t Anchor = 0;
+    if (SrcSize > MatchFindLimit)
+    {
+        uint32_t HashTable[1 << HashBits];
+        std::fill(std::begin(HashTable), std::end(HashTable), UINT32_MAX);
+
+        const size_t MatchStartLimit = SrcSize - MatchFindLimit;
+        const size_t MatchEndLimit = SrcSize - LastLiterals;
+        for (size_t Pos = 0; Pos < MatchStartLimit;)
+        {
+            const uint32_t Sequence = Read32(In + Pos);
+            const uint32_t Hash = HashSequence(Sequence);
+            const uint32_t Candidate = HashTable[Hash];
+            HashTable[Hash] = static_cast<uint32_t>(Pos);
+
+            if (Candidate == UINT32_MAX || Pos - Candidate > MaxOffset || Read32(In + Candidate) != Sequence)
+            {
+                ++Pos;
+                continue;
+            }
+
+            size_t MatchLength = MinMatch;
+            while (Pos + MatchLength < MatchEndLimit && In[Candidate + MatchLength] == In[Pos + MatchLength])
+            {
+                ++MatchLength;
+            }
+
+            Out = WriteSequence(Out, In + Anchor, Pos - Anchor, Pos - Candidate, MatchLength);
+            Pos += MatchLength;
+            Anchor = Pos;
+        }
+    }
+    Out = WriteSequence(Out, In + Anchor, SrcSize - Anchor, 0, 0);
+
+    const size_t CompressedSize = static_cast<size_t>(Out - OutData.GetData());
+    OutData.Resize(static_cast<int32_t>(CompressedSize));
+    return CompressedSize < SrcSize;
+}
+
+bool ACompression::DecompressLZ4(const void* Src, size_t SrcSize, void* Dst, size_t DstSize)
+{
+    const uint8_t* In = static_cast<const uint8_t*>(Src);
+    const uint8_t* InEnd = In + SrcSize;
+    uint8_t* Out = static_cast<uint8_t*>(Dst);
+    uint8_t* OutEnd = Out + DstSize;
+
+    auto ReadLength = [&In, InEnd](size_t& Length)
+    {
+        uint8_t Byte;
+        do
+        {
+            if (In >= InEnd)
+            {
+                return false;
+            }
+            Byte = *In++;
+            Length += Byte;
+        } while (Byte == 255);
+        return true;
+    };
+
+    while (In < InEnd)
+    {
+        const uint8_t Token = *In++;
+
+        size_t NumLiterals = Token >> 4;
+        if (NumLiterals == 15 && !ReadLength(NumLiterals))
+        {
+            return false;
+        }
+        if (NumLiterals > static_cast<size_t>(InEnd - In) || NumLiterals > static_cast<size_t>(OutEnd - Out))
+        {
+            return false;
+        }
+        std::memcpy(Out, In, NumLiterals);
+        In += NumLiterals;
+        Out += NumLiterals;
+
+        if (In == InEnd)
+        {
+            break;
+        }
+
+        if (InEnd - In < 2)
+        {
+            return false;
+        }
+        const size_t Offset = In[0] | (static_cast<size_t>(In[1]) << 8);
+        In += 2;
+        if (Offset == 0 || Offset > static_cast<size_t>(Out - static_cast<uint8_t*>(Dst)))
+        {
+            return false;
+        }
+
+        size_t MatchLength = Token & 15;
+        if (MatchLength == 15 && !ReadLength(MatchLength))
+        {
+            return false;
+        }
+        MatchLength += MinMatch;
+        if (MatchLength > static_cast<size_t>(OutEnd - Out))
+        {
+            return false;
+        }
+
+        // Matches may overlap the bytes they produce, copy forward byte by byte.
+        const uint8_t* Match = Out - Offset;
+        for (size_t Index = 0; Index < MatchLength; ++Index)
+        {
+            Out[Index] = Match[Index];
+        }
+        Out += MatchLength;
+    }
+
+    return Out == OutEnd;
+}
+
+namespace
+{
+    constexpr uint32_t MaxCodeLength = 15;
+    constexpr uint32_t NumLiteralLengthCodes = 288;
+    constexpr uint32_t NumDistanceCodes = 30;
+
+    constexpr uint16_t LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr uint8_t LengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    constexpr uint16_t DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577 };
+    constexpr uint8_t DistanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    // Order the code length code lengths of a dynamic block are stored in.
+    constexpr uint8_t CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Canonical Huffman code, the symbols sorted by code length and then by value.
+    struct AHuffmanCode
+    {
+        uint16_t Counts[MaxCodeLength + 1];
+        uint16_t Symbols[NumLiteralLengthCodes];
+    };
+
+    struct AInflateStream
+    {
+        const uint8_t* In;
+        const uint8_t* InEnd;
+        uint8_t* OutStart;
+        uint8_t* Out;
+        uint8_t* OutEnd;
+        uint32_t BitBuffer;
+        uint32_t NumBits;
+        // Set when the input ran out, reads return zeros from then on.
+        bool bOverrun;
+
+        // Deflate packs bits starting at the least significant bit of each byte.
+        uint32_t GetBits(uint32_t Count)
+        {
+            uint32_t Value = BitBuffer;
+            while (NumBits < Count)
+            {
+                if (In == InEnd)
+                {
+                    bOverrun = true;
+                    return 0;
+                }
+                Value |= static_cast<uint32_t>(*In++) << NumBits;
+                NumBits += 8;
+            }
+            BitBuffer = Value >> Count;
+            NumBits -= Count;
+            return Value & ((1u << Count) - 1);
+        }
+    };
+
+    // Incomplete codes are allowed, a single distance code is, over-subscribed ones are not.
+    bool BuildHuffmanCode(AHuffmanCode& Code, const uint8_t* Lengths, uint32_t NumSymbols)
+    {
+        AMemory::Memzero(Code.Counts);
+        for (uint32_t Symbol = 0; Symbol < NumSymbols; ++Symbol)
+        {
+            ++Code.Counts[Lengths[Symbol]];
+        }
+
+        int32_t Left = 1;
+        for (uint32_t Length = 1; Length <= MaxCodeLength; ++Length)
+        {
+            Left = (Left << 1) - Code.Counts[Length];
+            if (Left < 0)
+            {
+                return false;
+            }
+        }
+
+        uint16_t Offsets[MaxCodeLength + 1];
+        Offsets[1] = 0;
+        for (uint32_t Length = 1; Length < MaxCodeLength; ++Length)
+        {
+            Offsets[Length + 1] = Offsets[Length] + Code.Counts[Length];
+        }
+        for (uint32_t Symbol = 0; Symbol < NumSymbols; ++Symbol)
+        {
+            if (Lengths[Symbol] != 0)
+            {
+                Code.Symbols[Offsets[Lengths[Symbol]]++] = static_cast<uint16_t>(Symbol);
+            }
+        }
+        return true;
+    }
+
+    // Returns -1 for an invalid code. Bit by bit, textures are decoded once at load time.
+    int32_t DecodeSymbol(AInflateStream& Stream, const AHuffmanCode& Code)
+    {
+        int32_t Bits = 0;
+        int32_t First = 0;
+        int32_t Index = 0;
+        for (uint32_t Length = 1; Length <= MaxCodeLength; ++Length)
+        {
+            Bits |= static_cast<int32_t>(Stream.GetBits(1));
+            const int32_t Count = Code.Counts[Length];
+            if (Bits - First < Count)
+            {
+                return Code.Symbols[Index + Bits - First];
+            }
+            Index += Count;
+            First = (First + Count) << 1;
+            Bits <<= 1;
+        }
+        return -1;
+    }
+
+    bool InflateStored(AInflateStream& Stream)
+    {
+        // Stored blocks start at a byte boundary.
+        Stream.BitBuffer = 0;
+        Stream.NumBits = 0;
+        if (Stream.InEnd - Stream.In < 4)
+        {
+            return false;
+        }
+        const size_t Length = Stream.In[0] | (static_cast<size_t>(Stream.In[1]) << 8);
+        const size_t InvLength = Stream.In[2] | (static_cast<size_t>(Stream.In[3]) << 8);
+        Stream.In += 4;
+        if (Length != (~InvLength & 0xFFFF) || Length > static_cast<size_t>(Stream.InEnd - Stream.In) ||
+            Length > static_cast<size_t>(Stream.OutEnd - Stream.Out))
+        {
+            return false;
+        }
+        std::memcpy(Stream.Out, Stream.In, Length);
+        Stream.In += Length;
+        Stream.Out += Length;
+        return true;
+    }
+
+    bool InflateCodes(AInflateStream& Stream, const AHuffmanCode& LiteralLengthCode, const AHuffmanCode& DistanceCode)
+    {
+        for (;;)
+        {
+            const int32_t Symbol = DecodeSymbol(Stream, LiteralLengthCode);
+            if (Symbol < 0 || Stream.bOverrun)
+            {
+                return false;
+            }
+            if (Symbol < 256)
+            {
+                if (Stream.Out == Stream.OutEnd)
+                {
+                    return false;
+                }
+                *Stream.Out++ = static_cast<uint8_t>(Symbol);
+                continue;
+            }
+            if (Symbol == 256)
+            {
+                return true;
+            }
+
+            const int32_t LengthSymbol = Symbol - 257;
+            if (LengthSymbol >= 29)
+            {
+                return false;
+            }
+            const size_t Length = LengthBase[LengthSymbol] + Stream.GetBits(LengthExtraBits[LengthSymbol]);
+
+            const int32_t DistanceSymbol = DecodeSymbol(Stream, DistanceCode);
+            if (DistanceSymbol < 0 || DistanceSymbol >= static_cast<int32_t>(NumDistanceCodes))
+            {
+                return false;
+            }
+            const size_t Distance = DistanceBase[DistanceSymbol] + Stream.GetBits(DistanceExtraBits[DistanceSymbol]);
+            if (Stream.bOverrun || Distance > static_cast<size_t>(Stream.Out - Stream.OutStart) || Length > static_cast<size_t>(Stream.OutEnd - Stream.Out))
+            {
+                return false;
+            }
+
+            // Matches may overlap the bytes they produce, copy forward byte by byte.
+            const uint8_t* Match = Stream.Out - Distance;
+            for (size_t Index = 0; Index < Length; ++Index)
+            {
+                Stream.Out[Index] = Match[Index];
+            }
+            Stream.Out += Length;
+        }
+    }
+
+    bool InflateFixed(AInflateStream& Stream)
+    {
+        static AHuffmanCode LiteralLengthCode;
+        static AHuffmanCode DistanceCode;
+        static const bool bBuilt = []()
+        {
+            uint8_t Lengths[NumLiteralLengthCodes];
+            std::fill(Lengths, Lengths + 144, 8);
+            std::fill(Lengths + 144, Lengths + 256, 9);
+            std::fill(Lengths + 256, Lengths + 280, 7);
+            std::fill(Lengths + 280, Lengths + NumLiteralLengthCodes, 8);
+            BuildHuffmanCode(LiteralLengthCode, Lengths, NumLiteralLengthCodes);
+
+            std::fill(Lengths, Lengths + NumDistanceCodes, 5);
+            BuildHuffmanCode(DistanceCode, Lengths, NumDistanceCodes);
+            return true;
+        }();
+        (void)bBuilt;
+
+        return InflateCodes(Stream, LiteralLengthCode, DistanceCode);
+    }
+
+    bool InflateDynamic(AInflateStream& Stream)
+    {
+        const uint32_t NumLiteralLengths = Stream.GetBits(5) + 257;
+        const uint32_t NumDistances = Stream.GetBits(5) + 1;
+        const uint32_t NumCodeLengths = Stream.GetBits(4) + 4;
+        if (NumLiteralLengths > 286 || NumDistances > NumDistanceCodes)
+        {
+            return false;
+        }
+
+        uint8_t Lengths[NumLiteralLengthCodes + NumDistanceCodes] = {};
+        for (uint32_t Index = 0; Index < NumCodeLengths; ++Index)
+        {
+            Lengths[CodeLengthOrder[Index]] = static_cast<uint8_t>(Stream.GetBits(3));
+        }
+
+        AHuffmanCode CodeLengthCode;
+        if (!BuildHuffmanCode(CodeLengthCode, Lengths, 19))
+        {
+            return false;
+        }
+
+        // Literal/length and distance code lengths form one sequence, repeats may cross from one to the other.
+        const uint32_t NumLengths = NumLiteralLengths + NumDistances;
+        for (uint32_t Index = 0; Index < NumLengths;)
+        {
+            const int32_t Symbol = DecodeSymbol(Stream, CodeLengthCode);
+            if (Symbol < 0 || Stream.bOverrun)
+            {
+                return false;
+            }
+            if (Symbol < 16)
+            {
+                Lengths[Index++] = static_cast<uint8_t>(Symbol);
+                continue;
+            }
+
+            uint8_t Length = 0;
+            uint32_t Repeat;
+            if (Symbol == 16)
+            {
+                if (Index == 0)
+                {
+                    return false;
+                }
+                Length = Lengths[Index - 1];
+                Repeat = 3 + Stream.GetBits(2);
+            }
+            else if (Symbol == 17)
+            {
+                Repeat = 3 + Stream.GetBits(3);
+            }
+            else
+            {
+                Repeat = 11 + Stream.GetBits(7);
+            }
+            if (Index + Repeat > NumLengths)
+            {
+                return false;
+            }
+            std::fill(Lengths + Index, Lengths + Index + Repeat, Length);
+            Index += Repeat;
+        }
+
+        // Without an end of block code the block can't end.
+        if (Lengths[256] == 0)
+        {
+            return false;
+        }
+
+        AHuffmanCode LiteralLengthCode;
+        AHuffmanCode DistanceCode;
+        if (!BuildHuffmanCode(LiteralLengthCode, Lengths, NumLiteralLengths) || !BuildHuffmanCode(DistanceCode, Lengths + NumLiteralLengths, NumDistances))
+        {
+            return false;
+        }
+        return InflateCodes(Stream, LiteralLengthCode, DistanceCode);
+    }
+
+    uint32_t Adler32(const uint8_t* Data, size_t Size)
+    {
+        constexpr uint32_t Modulus = 65521;
+        // Largest run whose sums can't overflow 32 bits before the modulo.
+        constexpr size_t MaxRun = 5552;
+
+        uint32_t A = 1;
+        uint32_t B = 0;
+        while (Size != 0)
+        {
+            const size_t Run = std::min(Size, MaxRun);
+            for (size_t Index = 0; Index < Run; ++Index)
+            {
+                A += Data[Index];
+                B += A;
+            }
+            A %= Modulus;
+            B %= Modulus;
+            Data += Run;
+            Size -= Run;
+        }
+        return (B << 16) | A;
+    }
+} // namespace
+
+bool ACompression::DecompressZlib(const void* Src, size_t SrcSize, void* Dst, size_t DstSize)
+{
+    const uint8_t* In = static_cast<const uint8_t*>(Src);
+    // Two header bytes and the checksum.
+    if (SrcSize < 6)
+    {
+        return false;
+    }
+
+    // Deflate with at most a 32K window, no preset dictionary.
+    const uint8_t Method = In[0];
+    const uint8_t Flags = In[1];
+    if ((Method & 0x0F) != 8 || (Method >> 4) > 7 || ((Method << 8) | Flags) % 31 != 0 || (Flags & 0x20))
+    {
+        return false;
+    }
+
+    AInflateStream Stream;
+    Stream.In = In + 2;
+    Stream.InEnd = In + SrcSize - 4;
+    Stream.OutStart = static_cast<uint8_t*>(Dst);
+    Stream.Out = Stream.OutStart;
+    Stream.OutEnd = Stream.OutStart + DstSize;
+    Stream.BitBuffer = 0;
+    Stream.NumBits = 0;
+    Stream.bOverrun = false;
+
+    bool bLastBlock;
+    do
+    {
+        bLastBlock = Stream.GetBits(1) != 0;
+        const uint32_t BlockType = Stream.GetBits(2);
+
+        bool bDecoded = false;
+        switch (BlockType)
+        {
+        case 0:
+            bDecoded = InflateStored(Stream);
+            break;
+        case 1:
+            bDecoded = InflateFixed(Stream);
+            break;
+        case 2:
+            bDecoded = InflateDynamic(Stream);
+            break;
+        default:
+            break;
+        }
+        if (!bDecoded || Stream.bOverrun)
+        {
+            return false;
+        }
+    } while (!bLastBlock);
+
+    if (Stream.Out != Stream.OutEnd)
+    {
+        return false;
+    }
+
+    const uint8_t* Checksum = In + SrcSize - 4;
+    const uint32_t ExpectedAdler = (static_cast<uint32_t>(Checksum[0]) << 24) | (Checksum[1] << 16) | (Checksum[2] << 8) | Checksum[3];
+    return Adler32(Stream.OutStart, DstSize) == ExpectedAdler;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Core/BasicCore.h"
+
+// LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), cheap enough to
+// decode at load time. Zlib streams (RFC 1950/1951) are decoded only, for assets written by other tools.
+struct ACompression
+{
+    // Returns false if the data does not get smaller.
+    static bool CompressLZ4(const void* Src, size_t SrcSize, TArray<uint8_t>& OutData);
+    // DstSize must be the exact uncompressed size.
+    static bool DecompressLZ4(const void* Src, size_t SrcSize, void* Dst, size_t DstSize);
+    // DstSize must be the exact uncompressed size, the Adler-32 checksum is verified.
+    static bool DecompressZlib(const void* Src, size_t SrcSize, void* Dst, size_t DstSize);
+};
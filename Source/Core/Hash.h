@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Fast non-cryptographic hashing, XXH64 (https://github.com/Cyan4973/xxHash).
+struct AHash
+{
+    static inline uint64_t XXH64(const void* Data, size_t Size, uint64_t Seed = 0)
+    {
+        const uint8_t* Ptr = static_cast<const uint8_t*>(Data);
+        const uint8_t* End = Ptr + Size;
+        uint64_t Hash;
+
+        if (Size >= 32)
+        {
+            uint64_t V1 = Seed + Prime1 + Prime2;
+            uint64_t V2 = Seed + Prime2;
+            uint64_t V3 = Seed;
+            uint64_t V4 = Seed - Prime1;
+
+            for (const uint8_t* Limit = End - 32; Ptr <= Limit; Ptr += 32)
+            {
+                V1 = Round(V1, Read64(Ptr));
+                V2 = Round(V2, Read64(Ptr + 8));
+                V3 = Round(V3, Read64(Ptr + 16));
+                V4 = Round(V4, Read64(Ptr + 24));
+            }
+
+            Hash = Rotl(V1, 1) + Rotl(V2, 7) + Rotl(V3, 12) + Rotl(V4, 18);
+            Hash = MergeRound(Hash, V1);
+            Hash = MergeRound(Hash, V2);
+            Hash = MergeRound(Hash, V3);
+            Hash = MergeRound(Hash, V4);
+        }
+        else
+        {
+            Hash = Seed + Prime5;
+        }
+
+        Hash += static_cast<uint64_t>(Size);
+
+        for (; Ptr + 8 <= End; Ptr += 8)
+        {
+            Hash ^= Round(0, Read64(Ptr));
+            Hash = Rotl(Hash, 27) * Prime1 + Prime4;
+        }
+        if (Ptr + 4 <= End)
+        {
+            Hash ^= static_cast<uint64_t>(Read32(Ptr)) * Prime1;
+            Hash = Rotl(Hash, 23) * Prime2 + Prime3;
+            Ptr += 4;
+        }
+        for (; Ptr < End; ++Ptr)
+        {
+            Hash ^= (*Ptr) * Prime5;
+            Hash = Rotl(Hash, 11) * Prime1;
+        }
+
+        Hash ^= Hash >> 33;
+        Hash *= Prime2;
+        Hash ^= Hash >> 29;
+        Hash *= Prime3;
+        Hash ^= Hash >> 32;
+        return Hash;
+    }
+
+    static inline uint64_t XXH64(std::string_view String, uint64_t Seed = 0) { return XXH64(String.data(), String.size(), Seed); }
+
+    // Hashes the object representation, T must not contain padding.
+    template <typename T>
+    static inline uint64_t Memory(const T& Value, uint64_t Seed = 0)
+    {
+        return XXH64(&Value, sizeof(T), Seed);
+    }
+
+    static inline uint64_t Combine(uint64_t Hash, uint64_t Other) { return Hash ^ (Other + 0x9e3779b97f4a7c15ull + (Hash << 6) + (Hash >> 2)); }
+
+private:
+    static constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+    static constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+    static constexpr uint64_t Prime3 = 0x165667B19E3779F9ull;
+    static constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ull;
+    static constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ull;
+
+    static inline uint64_t Rotl(uint64_t Value, int32_t Bits) { return (Value << Bits) | (Value >> (64 - Bits)); }
+
+    static inline uint64_t Read64(const uint8_t* Ptr)
+    {
+        uint64_t Value;
+        std::memcpy(&Value, Ptr, sizeof(Value));
+        return Value;
+    }
+
+    static inline uint32_t Read32(const uint8_t* Ptr)
+    {
+        uint32_t Value;
+        std::memcpy(&Value, Ptr, sizeof(Value));
+        return Value;
+    }
+
+    static inline uint64_t Round(uint64_t Acc, uint64_t Input)
+    {
+        Acc += Input * Prime2;
+        Acc = Rotl(Acc, 31);
+        return Acc * Prime1;
+    }
+
+    static inline uint64_t MergeRound(uint64_t Acc, uint64_t Value)
+    {
+        Acc ^= Round(0, Value);
+        return Acc * Prime1 + Prime4;
+    }
+};
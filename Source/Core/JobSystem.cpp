@@ -0,0 +1,149 @@
+#include "JobSystem.h"
+
+AJobSystem& AJobSystem::Get()
+{
+    static AJobSystem Instance;
+    return Instance;
+}
+
+AJobSystem::~AJobSystem()
+{
+    Shutdown();
+}
+
+void AJobSystem::Initialize(uint32_t NumWorkers)
+{
+    check(Workers.IsEmpty(), "Job system is already initialized.");
+
+    if (NumWorkers == 0)
+    {
+        // Leave one core to the render thread, hardware_concurrency() is 0 when it can't tell.
+        const uint32_t NumHardwareThreads = std::thread::hardware_concurrency();
+        NumWorkers = std::max(1u, NumHardwareThreads > 1 ? NumHardwareThreads - 1 : 1u);
+    }
+
+    RenderThreadId = std::this_thread::get_id();
+    bStopping = false;
+
+    for (uint32_t Index = 0; Index < NumWorkers; ++Index)
+    {
+        Workers.Add(std::thread(&AJobSystem::WorkerMain, this));
+    }
+
+    std::cout << "[INFO] Job system started with " << NumWorkers << " workers.\n";
+}
+
+void AJobSystem::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> Lock(JobsMutex);
+        bStopping = true;
+    }
+    JobsCondition.notify_all();
+
+    for (std::thread& Worker : Workers)
+    {
+        if (Worker.joinable())
+        {
+            Worker.join();
+        }
+    }
+    Workers.Clear();
+
+    // Jobs that never ran, the coroutines among them are never resumed so their frames go with the queue.
+    DestroyCoroutines(Jobs);
+    std::lock_guard<std::mutex> Lock(RenderThreadMutex);
+    DestroyCoroutines(RenderThreadJobs);
+}
+
+void AJobSystem::DestroyCoroutines(std::deque<AJob>& Queue)
+{
+    for (AJob& Job : Queue)
+    {
+        if (Job.Coroutine)
+        {
+            Job.Coroutine.destroy();
+        }
+    }
+    Queue.clear();
+}
+
+void AJobSystem::Enqueue(TFunction<void()>&& Job)
+{
+    Enqueue(AJob{ std::move(Job), nullptr });
+}
+
+void AJobSystem::EnqueueResume(std::coroutine_handle<> Coroutine)
+{
+    Enqueue(AJob{ nullptr, Coroutine });
+}
+
+void AJobSystem::EnqueueRenderThread(TFunction<void()>&& Job)
+{
+    EnqueueRenderThread(AJob{ std::move(Job), nullptr });
+}
+
+void AJobSystem::EnqueueRenderThreadResume(std::coroutine_handle<> Coroutine)
+{
+    EnqueueRenderThread(AJob{ nullptr, Coroutine });
+}
+
+void AJobSystem::Enqueue(AJob&& Job)
+{
+    if (Workers.IsEmpty())
+    {
+        // Not initialized (or already shut down), run inline.
+        Job.Run();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> Lock(JobsMutex);
+        Jobs.push_back(std::move(Job));
+    }
+    JobsCondition.notify_one();
+}
+
+void AJobSystem::EnqueueRenderThread(AJob&& Job)
+{
+    std::lock_guard<std::mutex> Lock(RenderThreadMutex);
+    RenderThreadJobs.push_back(std::move(Job));
+}
+
+uint32_t AJobSystem::PumpRenderThread()
+{
+    check(IsRenderThread(), "PumpRenderThread must be called from the render thread.");
+
+    std::deque<AJob> PendingJobs;
+    {
+        std::lock_guard<std::mutex> Lock(RenderThreadMutex);
+        PendingJobs.swap(RenderThreadJobs);
+    }
+
+    for (AJob& Job : PendingJobs)
+    {
+        Job.Run();
+    }
+    return static_cast<uint32_t>(PendingJobs.size());
+}
+
+void AJobSystem::WorkerMain()
+{
+    while (true)
+    {
+        AJob Job;
+        {
+            std::unique_lock<std::mutex> Lock(JobsMutex);
+            JobsCondition.wait(Lock, [this]() { return bStopping || !Jobs.empty(); });
+            if (bStopping && Jobs.empty())
+            {
+                return;
+            }
+
+            Job = std::move(Jobs.front());
+            Jobs.pop_front();
+        }
+
+        Job.Run();
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Core/BasicCore.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class AJobSystem
+{
+public:
+    static AJobSystem& Get();
+
+    // Spawns the worker threads and marks the calling thread as the render thread.
+    void Initialize(uint32_t NumWorkers = 0);
+    void Shutdown();
+
+    // Runs the job on any worker thread.
+    void Enqueue(TFunction<void()>&& Job);
+    // Runs the job on the render thread during the next PumpRenderThread().
+    void EnqueueRenderThread(TFunction<void()>&& Job);
+    // Same as above for a suspended coroutine, whose frame Shutdown() destroys if it is still queued.
+    void EnqueueResume(std::coroutine_handle<> Coroutine);
+    void EnqueueRenderThreadResume(std::coroutine_handle<> Coroutine);
+
+    // Executes the jobs queued for the render thread, must be called once per frame.
+    uint32_t PumpRenderThread();
+
+    bool IsRenderThread() const { return std::this_thread::get_id() == RenderThreadId; }
+    uint32_t GetNumWorkers() const { return static_cast<uint32_t>(Workers.Num()); }
+
+    // co_await AJobSystem::Get().ResumeOnWorker(): continues the coroutine on a worker thread.
+    struct AWorkerAwaiter
+    {
+        AJobSystem* Owner;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> Handle) { Owner->EnqueueResume(Handle); }
+        void await_resume() const noexcept { }
+    };
+
+    // co_await AJobSystem::Get().ResumeOnRenderThread(): continues the coroutine on the render thread.
+    struct ARenderThreadAwaiter
+    {
+        AJobSystem* Owner;
+
+        bool await_ready() const noexcept { return Owner->IsRenderThread(); }
+        void await_suspend(std::coroutine_handle<> Handle) { Owner->EnqueueRenderThreadResume(Handle); }
+        void await_resume() const noexcept { }
+    };
+
+    AWorkerAwaiter ResumeOnWorker() { return AWorkerAwaiter{ this }; }
+    ARenderThreadAwaiter ResumeOnRenderThread() { return ARenderThreadAwaiter{ this }; }
+
+private:
+    // A plain function, or a coroutine to resume when Coroutine is set.
+    struct AJob
+    {
+        TFunction<void()> Function;
+        std::coroutine_handle<> Coroutine;
+
+        void Run()
+        {
+            if (Coroutine)
+            {
+                Coroutine.resume();
+            }
+            else
+            {
+                Function();
+            }
+        }
+    };
+
+    AJobSystem() = default;
+    ~AJobSystem();
+
+    void Enqueue(AJob&& Job);
+    void EnqueueRenderThread(AJob&& Job);
+    static void DestroyCoroutines(std::deque<AJob>& Queue);
+
+    void WorkerMain();
+
+private:
+    TArray<std::thread> Workers;
+
+    std::mutex JobsMutex;
+    std::condition_variable JobsCondition;
+    std::deque<AJob> Jobs;
+    bool bStopping = false;
+
+    std::mutex RenderThreadMutex;
+    std::deque<AJob> RenderThreadJobs;
+    std::thread::id RenderThreadId;
+};
@@ -0,0 +1,114 @@
+#include "MappedFile.h"
+
+#if WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+AMappedFile::AMappedFile()
+    : Data(nullptr), Size(0),
+#if WIN32
+      FileHandle(INVALID_HANDLE_VALUE), MappingHandle(nullptr)
+#else
+      FileHandle(-1)
+#endif
+{
+}
+
+AMappedFile::~AMappedFile()
+{
+    Close();
+}
+
+bool AMappedFile::Open(const AnsiChar* Filename)
+{
+    Close();
+
+#if WIN32
+    FileHandle = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER FileSize;
+    if (!GetFileSizeEx(FileHandle, &FileSize) || FileSize.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (MappingHandle == nullptr)
+    {
+        Close();
+        return false;
+    }
+
+    Data = static_cast<const uint8_t*>(MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0));
+    Size = static_cast<size_t>(FileSize.QuadPart);
+#else
+    FileHandle = open(Filename, O_RDONLY);
+    if (FileHandle < 0)
+    {
+        return false;
+    }
+
+    struct stat FileStat;
+    if (fstat(FileHandle, &FileStat) != 0 || FileStat.st_size == 0)
+    {
+        Close();
+        return false;
+    }
+
+    void* View = mmap(nullptr, static_cast<size_t>(FileStat.st_size), PROT_READ, MAP_PRIVATE, FileHandle, 0);
+    Data = View != MAP_FAILED ? static_cast<const uint8_t*>(View) : nullptr;
+    Size = static_cast<size_t>(FileStat.st_size);
+#endif
+
+    if (Data == nullptr)
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void AMappedFile::Close()
+{
+#if WIN32
+    if (Data)
+    {
+        UnmapViewOfFile(Data);
+    }
+    if (MappingHandle)
+    {
+        CloseHandle(MappingHandle);
+        MappingHandle = nullptr;
+    }
+    if (FileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(FileHandle);
+        FileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (Data)
+    {
+        munmap(const_cast<uint8_t*>(Data), Size);
+    }
+    if (FileHandle >= 0)
+    {
+        close(FileHandle);
+        FileHandle = -1;
+    }
+#endif
+
+    Data = nullptr;
+    Size = 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Core/BasicCore.h"
+
+// Read-only memory mapping of a whole file. The view is page aligned and stays valid until Close().
+class AMappedFile
+{
+public:
+    AMappedFile();
+    ~AMappedFile();
+
+    AMappedFile(const AMappedFile&) = delete;
+    AMappedFile& operator=(const AMappedFile&) = delete;
+
+    bool Open(const AnsiChar* Filename);
+    void Close();
+
+    inline bool IsOpen() const { return Data != nullptr; }
+    inline const uint8_t* GetData() const { return Data; }
+    inline size_t GetSize() const { return Size; }
+
+private:
+    const uint8_t* Data;
+    size_t Size;
+
+#if WIN32
+    void* FileHandle;
+    void* MappingHandle;
+#else
+    int32_t FileHandle;
+#endif
+};
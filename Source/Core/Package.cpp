@@ -0,0 +1,178 @@
+#include "Package.h"
+
+#include "Core/Compression.h"
+#include "Core/Hash.h"
+
+uint64_t APackageFormat::HashName(std::string_view Name)
+{
+    return AHash::XXH64(Name);
+}
+
+bool APackage::Mount(const AnsiChar* Filename)
+{
+    Unmount();
+
+    if (!MappedFile.Open(Filename))
+    {
+        return false;
+    }
+
+    const uint8_t* Data = MappedFile.GetData();
+    const size_t Size = MappedFile.GetSize();
+
+    APackageFormat::AHeader Header;
+    if (Size < sizeof(Header))
+    {
+        std::cerr << "[WARNING] " << Filename << " is not a package.\n";
+        Unmount();
+        return false;
+    }
+    AMemory::Memcpy(&Header, Data, sizeof(Header));
+
+    const uint64_t TocSize = static_cast<uint64_t>(Header.NumEntries) * sizeof(AEntry);
+    if (Header.Magic != APackageFormat::Magic || Header.Version != APackageFormat::Version || Header.TocOffset % alignof(AEntry) != 0 ||
+        Header.TocOffset > Size || TocSize > Size - Header.TocOffset)
+    {
+        std::cerr << "[WARNING] " << Filename << " is not a package or has an outdated version.\n";
+        Unmount();
+        return false;
+    }
+
+    if (AHash::XXH64(Data + Header.TocOffset, static_cast<size_t>(TocSize)) != Header.TocHash)
+    {
+        std::cerr << "[WARNING] " << Filename << " has a corrupted table of contents.\n";
+        Unmount();
+        return false;
+    }
+
+    Entries = reinterpret_cast<const AEntry*>(Data + Header.TocOffset);
+    NumEntries = Header.NumEntries;
+
+    for (uint32_t Index = 0; Index < NumEntries; ++Index)
+    {
+        const AEntry& Entry = Entries[Index];
+        if (Entry.Offset % APackageFormat::BlobAlignment != 0 || Entry.Offset > Header.TocOffset || Entry.Size > Header.TocOffset - Entry.Offset)
+        {
+            std::cerr << "[WARNING] " << Filename << " has an entry outside of the package.\n";
+            Unmount();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void APackage::Unmount()
+{
+    Entries = nullptr;
+    NumEntries = 0;
+    MappedFile.Close();
+}
+
+const APackage::AEntry* APackage::FindEntry(std::string_view Name) const
+{
+    return FindEntry(APackageFormat::HashName(Name));
+}
+
+const APackage::AEntry* APackage::FindEntry(uint64_t NameHash) const
+{
+    const AEntry* End = Entries + NumEntries;
+    const AEntry* Found = std::lower_bound(Entries, End, NameHash, [](const AEntry& Entry, uint64_t Hash) { return Entry.NameHash < Hash; });
+    return Found != End && Found->NameHash == NameHash ? Found : nullptr;
+}
+
+bool APackage::Read(const AEntry& Entry, void* OutData) const
+{
+    switch (Entry.Compression)
+    {
+    case APackageFormat::ECompression::None:
+        if (Entry.Size != Entry.UncompressedSize)
+        {
+            return false;
+        }
+        AMemory::Memcpy(OutData, GetData(Entry), Entry.Size);
+        return true;
+    case APackageFormat::ECompression::LZ4:
+        return ACompression::DecompressLZ4(GetData(Entry), Entry.Size, OutData, Entry.UncompressedSize);
+    default:
+        return false;
+    }
+}
+
+void APackageWriter::Add(const AString& Name, const void* Data, size_t Size, bool bCompress)
+{
+    APackageFormat::AEntry Entry;
+    AMemory::Memzero(Entry);
+    Entry.NameHash = APackageFormat::HashName(Name);
+    Entry.ContentHash = AHash::XXH64(Data, Size);
+    Entry.UncompressedSize = static_cast<uint32_t>(Size);
+
+    for (const APackageFormat::AEntry& Other : Entries)
+    {
+        check(Other.NameHash != Entry.NameHash, "Duplicated name in package.");
+    }
+
+    // Identical files share one blob.
+    for (const APackageFormat::AEntry& Other : Entries)
+    {
+        if (Other.ContentHash == Entry.ContentHash && Other.UncompressedSize == Entry.UncompressedSize)
+        {
+            Entry.Offset = Other.Offset;
+            Entry.Size = Other.Size;
+            Entry.Compression = Other.Compression;
+            Entries.Add(Entry);
+            return;
+        }
+    }
+
+    TArray<uint8_t> Compressed;
+    if (bCompress && ACompression::CompressLZ4(Data, Size, Compressed))
+    {
+        Data = Compressed.GetData();
+        Size = Compressed.Num();
+        Entry.Compression = APackageFormat::ECompression::LZ4;
+    }
+
+    // Offsets are relative to the blob section until Save().
+    const size_t Offset = (Blobs.Num() + APackageFormat::BlobAlignment - 1) & ~size_t(APackageFormat::BlobAlignment - 1);
+    Blobs.Resize(static_cast<int32_t>(Offset + Size));
+    AMemory::Memcpy(Blobs.GetData() + Offset, Data, Size);
+
+    Entry.Offset = Offset;
+    Entry.Size = static_cast<uint32_t>(Size);
+    Entries.Add(Entry);
+}
+
+bool APackageWriter::Save(const AString& Filename) const
+{
+    TArray<APackageFormat::AEntry> SortedEntries = Entries;
+    std::sort(SortedEntries.begin(), SortedEntries.end(),
+        [](const APackageFormat::AEntry& A, const APackageFormat::AEntry& B) { return A.NameHash < B.NameHash; });
+
+    const uint64_t BlobsOffset = sizeof(APackageFormat::AHeader);
+    for (APackageFormat::AEntry& Entry : SortedEntries)
+    {
+        Entry.Offset += BlobsOffset;
+    }
+
+    APackageFormat::AHeader Header;
+    AMemory::Memzero(Header);
+    Header.Magic = APackageFormat::Magic;
+    Header.Version = APackageFormat::Version;
+    Header.NumEntries = static_cast<uint32_t>(SortedEntries.Num());
+    Header.TocOffset = (BlobsOffset + Blobs.Num() + alignof(APackageFormat::AEntry) - 1) & ~uint64_t(alignof(APackageFormat::AEntry) - 1);
+    Header.TocHash = AHash::XXH64(SortedEntries.GetData(), SortedEntries.Num() * sizeof(APackageFormat::AEntry));
+
+    std::ofstream File(Filename, std::ios::binary | std::ios::trunc);
+    if (!File.is_open())
+    {
+        return false;
+    }
+
+    const AnsiChar Padding[alignof(APackageFormat::AEntry)] = {};
+    File.write(reinterpret_cast<const AnsiChar*>(&Header), sizeof(Header));
+    File.write(reinterpret_cast<const AnsiChar*>(Blobs.GetData()), Blobs.Num());
+    File.write(Padding, Header.TocOffset - BlobsOffset - Blobs.Num());
+    File.write(reinterpret_cast<const AnsiChar*>(SortedEntries.GetData()), SortedEntries.Num() * sizeof(APackageFormat::AEntry));
+    return static_cast<bool>(File);
+}
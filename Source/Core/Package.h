@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Core/BasicCore.h"
+#include "Core/MappedFile.h"
+
+// Read-only archive of many small files, mapped once and read straight from the mapping.
+//
+// Layout: APackageHeader | blobs (each aligned to BlobAlignment) | APackageEntry[NumEntries].
+// Entries are sorted by NameHash, names are '/' separated paths relative to the packed directory.
+struct APackageFormat
+{
+    static constexpr uint32_t Magic = 0x4B41504F; // "OPAK"
+    static constexpr uint32_t Version = 1;
+    static constexpr uint32_t BlobAlignment = 4;
+
+    enum class ECompression : uint32_t
+    {
+        None,
+        LZ4,
+    };
+
+    struct AHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t NumEntries;
+        uint32_t Padding;
+        uint64_t TocOffset;
+        // XXH64 of the entry table.
+        uint64_t TocHash;
+    };
+
+    struct AEntry
+    {
+        uint64_t NameHash;
+        // XXH64 of the uncompressed data.
+        uint64_t ContentHash;
+        uint64_t Offset;
+        uint32_t Size;
+        uint32_t UncompressedSize;
+        ECompression Compression;
+        uint32_t Padding;
+    };
+
+    static uint64_t HashName(std::string_view Name);
+};
+
+class APackage
+{
+public:
+    using AEntry = APackageFormat::AEntry;
+
+    bool Mount(const AnsiChar* Filename);
+    void Unmount();
+
+    inline bool IsMounted() const { return Entries != nullptr; }
+    inline uint32_t GetNumEntries() const { return NumEntries; }
+
+    const AEntry* FindEntry(std::string_view Name) const;
+    const AEntry* FindEntry(uint64_t NameHash) const;
+
+    // Pointer into the mapping, only valid for uncompressed entries.
+    inline const uint8_t* GetData(const AEntry& Entry) const { return MappedFile.GetData() + Entry.Offset; }
+    // Copies or decompresses the entry into OutData, which must hold Entry.UncompressedSize bytes.
+    bool Read(const AEntry& Entry, void* OutData) const;
+
+private:
+    AMappedFile MappedFile;
+    const AEntry* Entries = nullptr;
+    uint32_t NumEntries = 0;
+};
+
+class APackageWriter
+{
+public:
+    void Add(const AString& Name, const void* Data, size_t Size, bool bCompress);
+    bool Save(const AString& Filename) const;
+
+    inline uint32_t GetNumEntries() const { return static_cast<uint32_t>(Entries.Num()); }
+
+private:
+    TArray<APackageFormat::AEntry> Entries;
+    TArray<uint8_t> Blobs;
+};
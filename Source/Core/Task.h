@@ -0,0 +1,213 @@
+#pragma once
+
+#include "Core/JobSystem.h"
+
+#include <exception>
+
+template <typename T>
+class TTask;
+
+namespace TaskPrivate
+{
+    // Promise state shared by the task and its (single) awaiter. Holds nullptr while nobody waits,
+    // the awaiting coroutine address once someone does, and CompletedTag once the task finished.
+    struct APromiseBase
+    {
+        static inline void* const CompletedTag = reinterpret_cast<void*>(~uintptr_t(0));
+
+        std::atomic<void*> State{ nullptr };
+        std::exception_ptr Exception;
+
+        struct AFinalAwaiter
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename PromiseType>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<PromiseType> Handle) noexcept
+            {
+                void* Continuation = Handle.promise().State.exchange(CompletedTag, std::memory_order_acq_rel);
+                if (Continuation != nullptr && Continuation != CompletedTag)
+                {
+                    return std::coroutine_handle<>::from_address(Continuation);
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept { }
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        AFinalAwaiter final_suspend() const noexcept { return {}; }
+        void unhandled_exception() { Exception = std::current_exception(); }
+
+        bool IsCompleted() const { return State.load(std::memory_order_acquire) == CompletedTag; }
+    };
+
+    template <typename T>
+    struct TPromise : APromiseBase
+    {
+        TOptional<T> Value;
+
+        TTask<T> get_return_object();
+
+        template <typename ValueType>
+        void return_value(ValueType&& InValue)
+        {
+            Value.emplace(std::forward<ValueType>(InValue));
+        }
+
+        T& GetResult()
+        {
+            if (Exception)
+            {
+                std::rethrow_exception(Exception);
+            }
+            return *Value;
+        }
+    };
+
+    template <>
+    struct TPromise<void> : APromiseBase
+    {
+        TTask<void> get_return_object();
+
+        void return_void() { }
+
+        void GetResult()
+        {
+            if (Exception)
+            {
+                std::rethrow_exception(Exception);
+            }
+        }
+    };
+} // namespace TaskPrivate
+
+// Lazily started coroutine task. The body runs when the task is co_awaited or Launch()ed, and
+// resumes its awaiter on whichever thread it finishes on. Use AJobSystem::ResumeOnWorker() /
+// ResumeOnRenderThread() inside the body to hop threads.
+template <typename T = void>
+class TTask
+{
+public:
+    using promise_type = TaskPrivate::TPromise<T>;
+    using HandleType = std::coroutine_handle<promise_type>;
+
+    TTask() : Handle(nullptr), bStarted(false) { }
+    explicit TTask(HandleType InHandle) : Handle(InHandle), bStarted(false) { }
+
+    TTask(const TTask&) = delete;
+    TTask& operator=(const TTask&) = delete;
+
+    TTask(TTask&& Other) noexcept : Handle(Other.Handle), bStarted(Other.bStarted) { Other.Handle = nullptr; }
+    TTask& operator=(TTask&& Other) noexcept
+    {
+        if (this != &Other)
+        {
+            Release();
+            Handle = Other.Handle;
+            bStarted = Other.bStarted;
+            Other.Handle = nullptr;
+        }
+        return *this;
+    }
+
+    ~TTask() { Release(); }
+
+    inline bool IsValid() const { return Handle != nullptr; }
+    inline bool IsStarted() const { return bStarted; }
+    inline bool IsReady() const { return Handle && Handle.promise().IsCompleted(); }
+
+    // Starts the task without awaiting it, poll IsReady() / Get() afterwards.
+    void Launch()
+    {
+        check(Handle && !bStarted, "Task is invalid or already started.");
+        bStarted = true;
+        Handle.resume();
+    }
+
+    // Blocks until the task finished. Keeps pumping the render thread queue so that tasks which
+    // hop back to the render thread can not dead lock against the caller.
+    void Wait()
+    {
+        if (!bStarted)
+        {
+            Launch();
+        }
+        while (!IsReady())
+        {
+            if (AJobSystem::Get().IsRenderThread())
+            {
+                AJobSystem::Get().PumpRenderThread();
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    decltype(auto) Get()
+    {
+        check(IsReady(), "Task is not completed.");
+        return Handle.promise().GetResult();
+    }
+
+    struct AAwaiter
+    {
+        TTask* Task;
+
+        bool await_ready() const noexcept { return Task->IsReady(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> Awaiting)
+        {
+            promise_type& Promise = Task->Handle.promise();
+            if (!Task->bStarted)
+            {
+                // Start the body right away, it resumes us from its final suspend point.
+                Task->bStarted = true;
+                Promise.State.store(Awaiting.address(), std::memory_order_release);
+                return Task->Handle;
+            }
+
+            void* Expected = nullptr;
+            if (Promise.State.compare_exchange_strong(Expected, Awaiting.address(), std::memory_order_acq_rel))
+            {
+                return std::noop_coroutine();
+            }
+            // Finished in the meantime.
+            return Awaiting;
+        }
+
+        decltype(auto) await_resume() { return Task->Handle.promise().GetResult(); }
+    };
+
+    AAwaiter operator co_await() & { return AAwaiter{ this }; }
+    AAwaiter operator co_await() && { return AAwaiter{ this }; }
+
+private:
+    void Release()
+    {
+        if (Handle)
+        {
+            check(!bStarted || Handle.promise().IsCompleted(), "Task destroyed while still running.");
+            Handle.destroy();
+            Handle = nullptr;
+        }
+    }
+
+private:
+    HandleType Handle;
+    bool bStarted;
+};
+
+namespace TaskPrivate
+{
+    template <typename T>
+    inline TTask<T> TPromise<T>::get_return_object()
+    {
+        return TTask<T>(std::coroutine_handle<TPromise<T>>::from_promise(*this));
+    }
+
+    inline TTask<void> TPromise<void>::get_return_object()
+    {
+        return TTask<void>(std::coroutine_handle<TPromise<void>>::from_promise(*this));
+    }
+} // namespace TaskPrivate
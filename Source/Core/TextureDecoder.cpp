@@ -0,0 +1,442 @@
+#include "TextureDecoder.h"
+
+namespace
+{
+    constexpr uint32_t BlockDim = 4;
+    constexpr uint32_t NumBlockTexels = BlockDim * BlockDim;
+    // Largest decoded texel, RGBA8 and R16G16.
+    constexpr uint32_t MaxDecodedTexelSize = 4;
+
+    // ETC1 modifiers, by table and texel index.
+    constexpr int32_t ETCModifiers[8][4] = {
+        { 2, 8, -2, -8 },
+        { 5, 17, -5, -17 },
+        { 9, 29, -9, -29 },
+        { 13, 42, -13, -42 },
+        { 18, 60, -18, -60 },
+        { 24, 80, -24, -80 },
+        { 33, 106, -33, -106 },
+        { 47, 183, -47, -183 },
+    };
+
+    // Distances of the ETC2 T and H modes.
+    constexpr int32_t ETCDistances[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+    // EAC modifiers, by table and texel index.
+    constexpr int32_t EACModifiers[16][8] = {
+        { -3, -6, -9, -15, 2, 5, 8, 14 },
+        { -3, -7, -10, -13, 2, 6, 9, 12 },
+        { -2, -5, -8, -13, 1, 4, 7, 12 },
+        { -2, -4, -6, -13, 1, 3, 5, 12 },
+        { -3, -6, -8, -12, 2, 5, 7, 11 },
+        { -3, -7, -9, -11, 2, 6, 8, 10 },
+        { -4, -7, -8, -11, 3, 6, 7, 10 },
+        { -3, -5, -8, -11, 2, 4, 7, 10 },
+        { -2, -6, -8, -10, 1, 5, 7, 9 },
+        { -2, -5, -8, -10, 1, 4, 7, 9 },
+        { -2, -4, -8, -10, 1, 3, 7, 9 },
+        { -2, -5, -7, -10, 1, 4, 6, 9 },
+        { -3, -4, -7, -10, 2, 3, 6, 9 },
+        { -1, -2, -3, -10, 0, 1, 2, 9 },
+        { -4, -6, -8, -9, 3, 5, 7, 8 },
+        { -3, -5, -7, -9, 2, 4, 6, 8 },
+    };
+
+    inline uint8_t ClampByte(int32_t Value) { return static_cast<uint8_t>(std::clamp(Value, 0, 255)); }
+    inline int32_t Extend4(int32_t Value) { return (Value << 4) | Value; }
+    inline int32_t Extend5(int32_t Value) { return (Value << 3) | (Value >> 2); }
+    inline int32_t Extend6(int32_t Value) { return (Value << 2) | (Value >> 4); }
+    inline int32_t Extend7(int32_t Value) { return (Value << 1) | (Value >> 6); }
+    inline int32_t SignExtend3(int32_t Value) { return (Value & 4) ? Value - 8 : Value; }
+
+    inline void SetTexel(uint8_t* Texels, uint32_t X, uint32_t Y, int32_t R, int32_t G, int32_t B, int32_t A)
+    {
+        uint8_t* Texel = Texels + (Y * BlockDim + X) * 4;
+        Texel[0] = ClampByte(R);
+        Texel[1] = ClampByte(G);
+        Texel[2] = ClampByte(B);
+        Texel[3] = ClampByte(A);
+    }
+
+    // BC1 color block into RGBA texels. BC2 and BC3 always use four colors, BC1 uses three and black when the
+    // first endpoint is not the larger one.
+    void DecodeBC1Color(const uint8_t* Block, uint8_t* Texels, bool bFourColorsOnly, bool bTransparentBlack)
+    {
+        const uint16_t Colors[2] = { static_cast<uint16_t>(Block[0] | (Block[1] << 8)), static_cast<uint16_t>(Block[2] | (Block[3] << 8)) };
+
+        int32_t Palette[4][4];
+        for (uint32_t Index = 0; Index < 2; ++Index)
+        {
+            Palette[Index][0] = Extend5(Colors[Index] >> 11);
+            Palette[Index][1] = Extend6((Colors[Index] >> 5) & 0x3F);
+            Palette[Index][2] = Extend5(Colors[Index] & 0x1F);
+            Palette[Index][3] = 255;
+        }
+
+        const bool bFourColors = bFourColorsOnly || Colors[0] > Colors[1];
+        for (uint32_t Channel = 0; Channel < 3; ++Channel)
+        {
+            const int32_t Color0 = Palette[0][Channel];
+            const int32_t Color1 = Palette[1][Channel];
+            Palette[2][Channel] = bFourColors ? (2 * Color0 + Color1 + 1) / 3 : (Color0 + Color1 + 1) / 2;
+            Palette[3][Channel] = bFourColors ? (Color0 + 2 * Color1 + 1) / 3 : 0;
+        }
+        Palette[2][3] = 255;
+        Palette[3][3] = bFourColors || !bTransparentBlack ? 255 : 0;
+
+        const uint32_t Indices = Block[4] | (Block[5] << 8) | (Block[6] << 16) | (static_cast<uint32_t>(Block[7]) << 24);
+        for (uint32_t Texel = 0; Texel < NumBlockTexels; ++Texel)
+        {
+            const int32_t* Color = Palette[(Indices >> (Texel * 2)) & 3];
+            SetTexel(Texels, Texel % BlockDim, Texel / BlockDim, Color[0], Color[1], Color[2], Color[3]);
+        }
+    }
+
+    // BC3 alpha and BC4 block, one byte every Stride bytes.
+    void DecodeBCChannel(const uint8_t* Block, uint8_t* Texels, uint32_t Stride)
+    {
+        int32_t Values[8];
+        Values[0] = Block[0];
+        Values[1] = Block[1];
+        if (Values[0] > Values[1])
+        {
+            for (int32_t Index = 2; Index < 8; ++Index)
+            {
+                Values[Index] = ((8 - Index) * Values[0] + (Index - 1) * Values[1] + 3) / 7;
+            }
+        }
+        else
+        {
+            for (int32_t Index = 2; Index < 6; ++Index)
+            {
+                Values[Index] = ((6 - Index) * Values[0] + (Index - 1) * Values[1] + 2) / 5;
+            }
+            Values[6] = 0;
+            Values[7] = 255;
+        }
+
+        uint64_t Indices = 0;
+        for (uint32_t Byte = 0; Byte < 6; ++Byte)
+        {
+            Indices |= static_cast<uint64_t>(Block[2 + Byte]) << (Byte * 8);
+        }
+        for (uint32_t Texel = 0; Texel < NumBlockTexels; ++Texel)
+        {
+            Texels[Texel * Stride] = static_cast<uint8_t>(Values[(Indices >> (Texel * 3)) & 7]);
+        }
+    }
+
+    // ETC1 and ETC2 RGB block into RGBA texels. With bPunchthrough the differential bit tells whether the block is
+    // opaque, transparent blocks have no individual mode and use texel index 2 for transparent black.
+    void DecodeETC2Color(const uint8_t* Block, uint8_t* Texels, bool bPunchthrough)
+    {
+        const uint32_t IndexBits = (static_cast<uint32_t>(Block[4]) << 24) | (Block[5] << 16) | (Block[6] << 8) | Block[7];
+        const bool bDifferential = (Block[3] & 2) != 0;
+        const bool bOpaque = !bPunchthrough || bDifferential;
+
+        // Texels are stored column by column, the most significant index bits in the upper half.
+        auto GetIndex = [IndexBits](uint32_t X, uint32_t Y)
+        {
+            const uint32_t Bit = X * BlockDim + Y;
+            return (((IndexBits >> (Bit + 16)) & 1) << 1) | ((IndexBits >> Bit) & 1);
+        };
+
+        int32_t Base[2][3];
+        if (!bPunchthrough && !bDifferential)
+        {
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                Base[0][Channel] = Extend4(Block[Channel] >> 4);
+                Base[1][Channel] = Extend4(Block[Channel] & 0x0F);
+            }
+        }
+        else
+        {
+            int32_t Color1[3];
+            int32_t Color2[3];
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                Color1[Channel] = Block[Channel] >> 3;
+                Color2[Channel] = Color1[Channel] + SignExtend3(Block[Channel] & 7);
+            }
+
+            // A second color out of range selects one of the modes ETC2 added.
+            const bool bTMode = Color2[0] < 0 || Color2[0] > 31;
+            const bool bHMode = !bTMode && (Color2[1] < 0 || Color2[1] > 31);
+            const bool bPlanarMode = !bTMode && !bHMode && (Color2[2] < 0 || Color2[2] > 31);
+            if (bTMode || bHMode)
+            {
+                int32_t Paint[4][3];
+                if (bTMode)
+                {
+                    const int32_t C1[3] = { Extend4(((Block[0] >> 1) & 0x0C) | (Block[0] & 3)), Extend4(Block[1] >> 4), Extend4(Block[1] & 0x0F) };
+                    const int32_t C2[3] = { Extend4(Block[2] >> 4), Extend4(Block[2] & 0x0F), Extend4(Block[3] >> 4) };
+                    const int32_t Distance = ETCDistances[((Block[3] >> 1) & 6) | (Block[3] & 1)];
+                    for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                    {
+                        Paint[0][Channel] = C1[Channel];
+                        Paint[1][Channel] = C2[Channel] + Distance;
+                        Paint[2][Channel] = C2[Channel];
+                        Paint[3][Channel] = C2[Channel] - Distance;
+                    }
+                }
+                else
+                {
+                    const int32_t R1 = (Block[0] >> 3) & 0x0F;
+                    const int32_t G1 = ((Block[0] & 7) << 1) | ((Block[1] >> 4) & 1);
+                    const int32_t B1 = (Block[1] & 8) | ((Block[1] & 3) << 1) | (Block[2] >> 7);
+                    const int32_t R2 = (Block[2] >> 3) & 0x0F;
+                    const int32_t G2 = ((Block[2] & 7) << 1) | (Block[3] >> 7);
+                    const int32_t B2 = (Block[3] >> 3) & 0x0F;
+                    // The lowest distance bit is the order of the two colors.
+                    const int32_t Order = ((R1 << 8) | (G1 << 4) | B1) >= ((R2 << 8) | (G2 << 4) | B2) ? 1 : 0;
+                    const int32_t Distance = ETCDistances[(Block[3] & 4) | ((Block[3] & 1) << 1) | Order];
+                    const int32_t C1[3] = { Extend4(R1), Extend4(G1), Extend4(B1) };
+                    const int32_t C2[3] = { Extend4(R2), Extend4(G2), Extend4(B2) };
+                    for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                    {
+                        Paint[0][Channel] = C1[Channel] + Distance;
+                        Paint[1][Channel] = C1[Channel] - Distance;
+                        Paint[2][Channel] = C2[Channel] + Distance;
+                        Paint[3][Channel] = C2[Channel] - Distance;
+                    }
+                }
+
+                for (uint32_t Y = 0; Y < BlockDim; ++Y)
+                {
+                    for (uint32_t X = 0; X < BlockDim; ++X)
+                    {
+                        const uint32_t Index = GetIndex(X, Y);
+                        if (!bOpaque && Index == 2)
+                        {
+                            SetTexel(Texels, X, Y, 0, 0, 0, 0);
+                            continue;
+                        }
+                        SetTexel(Texels, X, Y, Paint[Index][0], Paint[Index][1], Paint[Index][2], 255);
+                    }
+                }
+                return;
+            }
+
+            if (bPlanarMode)
+            {
+                // Colors at the origin, the right and the bottom of the block, always opaque.
+                const int32_t Origin[3] = {
+                    Extend6((Block[0] >> 1) & 0x3F),
+                    Extend7(((Block[0] & 1) << 6) | ((Block[1] >> 1) & 0x3F)),
+                    Extend6(((Block[1] & 1) << 5) | (Block[2] & 0x18) | ((Block[2] & 3) << 1) | (Block[3] >> 7)),
+                };
+                const int32_t Horizontal[3] = {
+                    Extend6((((Block[3] >> 2) & 0x1F) << 1) | (Block[3] & 1)),
+                    Extend7(Block[4] >> 1),
+                    Extend6(((Block[4] & 1) << 5) | (Block[5] >> 3)),
+                };
+                const int32_t Vertical[3] = {
+                    Extend6(((Block[5] & 7) << 3) | (Block[6] >> 5)),
+                    Extend7(((Block[6] & 0x1F) << 2) | (Block[7] >> 6)),
+                    Extend6(Block[7] & 0x3F),
+                };
+
+                for (uint32_t Y = 0; Y < BlockDim; ++Y)
+                {
+                    for (uint32_t X = 0; X < BlockDim; ++X)
+                    {
+                        int32_t Color[3];
+                        for (uint32_t Channel = 0; Channel < 3; ++Channel)
+                        {
+                            Color[Channel] = (static_cast<int32_t>(X) * (Horizontal[Channel] - Origin[Channel]) +
+                                static_cast<int32_t>(Y) * (Vertical[Channel] - Origin[Channel]) + 4 * Origin[Channel] + 2) >> 2;
+                        }
+                        SetTexel(Texels, X, Y, Color[0], Color[1], Color[2], 255);
+                    }
+                }
+                return;
+            }
+
+            for (uint32_t Channel = 0; Channel < 3; ++Channel)
+            {
+                Base[0][Channel] = Extend5(Color1[Channel]);
+                Base[1][Channel] = Extend5(Color2[Channel]);
+            }
+        }
+
+        // Two 2x4 or, flipped, 4x2 sub blocks with a base color and a modifier table each.
+        const uint32_t Tables[2] = { static_cast<uint32_t>(Block[3] >> 5), static_cast<uint32_t>((Block[3] >> 2) & 7) };
+        const bool bFlip = (Block[3] & 1) != 0;
+        for (uint32_t Y = 0; Y < BlockDim; ++Y)
+        {
+            for (uint32_t X = 0; X < BlockDim; ++X)
+            {
+                const uint32_t SubBlock = bFlip ? Y / 2 : X / 2;
+                const uint32_t Index = GetIndex(X, Y);
+                if (!bOpaque && Index == 2)
+                {
+                    SetTexel(Texels, X, Y, 0, 0, 0, 0);
+                    continue;
+                }
+
+                // Transparent blocks keep the base color where opaque ones add the small modifier.
+                const int32_t Modifier = !bOpaque && Index == 0 ? 0 : ETCModifiers[Tables[SubBlock]][Index];
+                const int32_t* Color = Base[SubBlock];
+                SetTexel(Texels, X, Y, Color[0] + Modifier, Color[1] + Modifier, Color[2] + Modifier, 255);
+            }
+        }
+    }
+
+    inline uint64_t ReadEACIndices(const uint8_t* Block)
+    {
+        uint64_t Indices = 0;
+        for (uint32_t Byte = 2; Byte < 8; ++Byte)
+        {
+            Indices = (Indices << 8) | Block[Byte];
+        }
+        return Indices;
+    }
+
+    // EAC alpha of ETC2 RGBA8, one byte every Stride bytes.
+    void DecodeEACAlpha(const uint8_t* Block, uint8_t* Texels, uint32_t Stride)
+    {
+        const int32_t Base = Block[0];
+        const int32_t Multiplier = Block[1] >> 4;
+        const int32_t* Modifiers = EACModifiers[Block[1] & 0x0F];
+        const uint64_t Indices = ReadEACIndices(Block);
+
+        for (uint32_t Y = 0; Y < BlockDim; ++Y)
+        {
+            for (uint32_t X = 0; X < BlockDim; ++X)
+            {
+                const uint32_t Index = static_cast<uint32_t>(Indices >> (45 - (X * BlockDim + Y) * 3)) & 7;
+                Texels[(Y * BlockDim + X) * Stride] = ClampByte(Base + Modifiers[Index] * Multiplier);
+            }
+        }
+    }
+
+    // 11 bit EAC channel, widened to 16 bits and written every Stride bytes.
+    void DecodeEAC11(const uint8_t* Block, uint8_t* Texels, uint32_t Stride)
+    {
+        const int32_t Base = Block[0] * 8 + 4;
+        const int32_t Multiplier = Block[1] >> 4;
+        const int32_t* Modifiers = EACModifiers[Block[1] & 0x0F];
+        const uint64_t Indices = ReadEACIndices(Block);
+
+        for (uint32_t Y = 0; Y < BlockDim; ++Y)
+        {
+            for (uint32_t X = 0; X < BlockDim; ++X)
+            {
+                const uint32_t Index = static_cast<uint32_t>(Indices >> (45 - (X * BlockDim + Y) * 3)) & 7;
+                const int32_t Modifier = Multiplier != 0 ? Modifiers[Index] * Multiplier * 8 : Modifiers[Index];
+                const uint32_t Value = static_cast<uint32_t>(std::clamp(Base + Modifier, 0, 2047));
+                const uint16_t Widened = static_cast<uint16_t>((Value << 5) | (Value >> 6));
+                std::memcpy(Texels + (Y * BlockDim + X) * Stride, &Widened, sizeof(Widened));
+            }
+        }
+    }
+
+    void DecodeBlock(ETextureBlockFormat Format, const uint8_t* Block, uint8_t* Texels)
+    {
+        switch (Format)
+        {
+        case ETextureBlockFormat::BC1:
+            DecodeBC1Color(Block, Texels, false, false);
+            break;
+        case ETextureBlockFormat::BC1A:
+            DecodeBC1Color(Block, Texels, false, true);
+            break;
+        case ETextureBlockFormat::BC2:
+            DecodeBC1Color(Block + 8, Texels, true, false);
+            for (uint32_t Texel = 0; Texel < NumBlockTexels; ++Texel)
+            {
+                const uint32_t Alpha = (Block[Texel / 2] >> ((Texel & 1) * 4)) & 0x0F;
+                Texels[Texel * 4 + 3] = static_cast<uint8_t>(Alpha * 17);
+            }
+            break;
+        case ETextureBlockFormat::BC3:
+            DecodeBC1Color(Block + 8, Texels, true, false);
+            DecodeBCChannel(Block, Texels + 3, 4);
+            break;
+        case ETextureBlockFormat::BC4:
+            DecodeBCChannel(Block, Texels, 1);
+            break;
+        case ETextureBlockFormat::BC5:
+            DecodeBCChannel(Block, Texels, 2);
+            DecodeBCChannel(Block + 8, Texels + 1, 2);
+            break;
+        case ETextureBlockFormat::ETC2_RGB8:
+            DecodeETC2Color(Block, Texels, false);
+            break;
+        case ETextureBlockFormat::ETC2_RGB8A1:
+            DecodeETC2Color(Block, Texels, true);
+            break;
+        case ETextureBlockFormat::ETC2_RGBA8:
+            DecodeETC2Color(Block + 8, Texels, false);
+            DecodeEACAlpha(Block, Texels + 3, 4);
+            break;
+        case ETextureBlockFormat::EAC_R11:
+            DecodeEAC11(Block, Texels, 2);
+            break;
+        case ETextureBlockFormat::EAC_RG11:
+            DecodeEAC11(Block, Texels, 4);
+            DecodeEAC11(Block + 8, Texels + 2, 4);
+            break;
+        }
+    }
+} // namespace
+
+uint32_t ATextureDecoder::GetBlockSize(ETextureBlockFormat Format)
+{
+    switch (Format)
+    {
+    case ETextureBlockFormat::BC1:
+    case ETextureBlockFormat::BC1A:
+    case ETextureBlockFormat::BC4:
+    case ETextureBlockFormat::ETC2_RGB8:
+    case ETextureBlockFormat::ETC2_RGB8A1:
+    case ETextureBlockFormat::EAC_R11:
+        return 8;
+    default:
+        return 16;
+    }
+}
+
+uint32_t ATextureDecoder::GetDecodedTexelSize(ETextureBlockFormat Format)
+{
+    switch (Format)
+    {
+    case ETextureBlockFormat::BC4:
+        return 1;
+    case ETextureBlockFormat::BC5:
+    case ETextureBlockFormat::EAC_R11:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+void ATextureDecoder::Decode(ETextureBlockFormat Format, const void* Src, uint32_t Width, uint32_t Height, void* Dst)
+{
+    const uint32_t BlockSize = GetBlockSize(Format);
+    const uint32_t TexelSize = GetDecodedTexelSize(Format);
+    const uint32_t NumBlocksX = (Width + BlockDim - 1) / BlockDim;
+    const uint32_t NumBlocksY = (Height + BlockDim - 1) / BlockDim;
+
+    const uint8_t* Block = static_cast<const uint8_t*>(Src);
+    uint8_t* Out = static_cast<uint8_t*>(Dst);
+    uint8_t Texels[NumBlockTexels * MaxDecodedTexelSize];
+    for (uint32_t BlockY = 0; BlockY < NumBlocksY; ++BlockY)
+    {
+        for (uint32_t BlockX = 0; BlockX < NumBlocksX; ++BlockX)
+        {
+            DecodeBlock(Format, Block, Texels);
+            Block += BlockSize;
+
+            // Blocks on the right and bottom edges may cover texels outside of the image.
+            const uint32_t NumColumns = std::min(BlockDim, Width - BlockX * BlockDim);
+            const uint32_t NumRows = std::min(BlockDim, Height - BlockY * BlockDim);
+            for (uint32_t Row = 0; Row < NumRows; ++Row)
+            {
+                const size_t DstOffset = (static_cast<size_t>(BlockY * BlockDim + Row) * Width + BlockX * BlockDim) * TexelSize;
+                std::memcpy(Out + DstOffset, Texels + Row * BlockDim * TexelSize, NumColumns * TexelSize);
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Core/BasicCore.h"
+
+// Block compressed formats with a CPU decoder, for devices that can't sample them. All of them use 4x4 blocks.
+enum class ETextureBlockFormat : uint8_t
+{
+    // Opaque, the fourth color of three color blocks is black.
+    BC1,
+    // The fourth color of three color blocks is transparent black.
+    BC1A,
+    BC2,
+    BC3,
+    BC4,
+    BC5,
+    ETC2_RGB8,
+    ETC2_RGB8A1,
+    ETC2_RGBA8,
+    EAC_R11,
+    EAC_RG11,
+};
+
+// Decodes block compressed images to plain texels: RGBA8 for the color formats, R8 and R8G8 for BC4 and BC5,
+// R16 and R16G16 for the 11 bit EAC formats. Unsigned normalized formats only, sRGB data stays sRGB encoded.
+struct ATextureDecoder
+{
+    static uint32_t GetBlockSize(ETextureBlockFormat Format);
+    static uint32_t GetDecodedTexelSize(ETextureBlockFormat Format);
+
+    // Src holds the blocks of a Width x Height image row by row, Dst receives tightly packed rows of texels.
+    static void Decode(ETextureBlockFormat Format, const void* Src, uint32_t Width, uint32_t Height, void* Dst);
+};
@@ -39,7 +39,10 @@ int main(int argc, char** argv)
     //}
     //std::cout << Ta->P << std::endl;
 
-     ARenderer Renderer = ARenderer();
+     ARendererOptions Options;
+     Options.ParseCommandLine(argc, argv);
+
+     ARenderer Renderer = ARenderer(1280, 720, Options);
      Renderer.MainTick();
 
     return 0;
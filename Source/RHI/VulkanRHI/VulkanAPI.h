@@ -153,7 +153,16 @@
 	EnumMacro(PFN_vkDestroySwapchainKHR, vkDestroySwapchainKHR) \
 	EnumMacro(PFN_vkGetSwapchainImagesKHR, vkGetSwapchainImagesKHR) \
 	EnumMacro(PFN_vkAcquireNextImageKHR, vkAcquireNextImageKHR) \
-	EnumMacro(PFN_vkQueuePresentKHR, vkQueuePresentKHR)
+	EnumMacro(PFN_vkQueuePresentKHR, vkQueuePresentKHR) \
+	EnumMacro(PFN_vkGetPhysicalDeviceFeatures2, vkGetPhysicalDeviceFeatures2) \
+	EnumMacro(PFN_vkGetPhysicalDeviceProperties2, vkGetPhysicalDeviceProperties2) \
+	EnumMacro(PFN_vkGetSemaphoreCounterValue, vkGetSemaphoreCounterValue) \
+	EnumMacro(PFN_vkWaitSemaphores, vkWaitSemaphores) \
+	EnumMacro(PFN_vkSignalSemaphore, vkSignalSemaphore) \
+	EnumMacro(PFN_vkCmdBeginRendering, vkCmdBeginRendering) \
+	EnumMacro(PFN_vkCmdEndRendering, vkCmdEndRendering) \
+	EnumMacro(PFN_vkCmdPipelineBarrier2, vkCmdPipelineBarrier2) \
+	EnumMacro(PFN_vkCreateRenderPass2, vkCreateRenderPass2)
 
 // List all surface Vulkan entry points used by Unreal that need to be loaded manually
 #define ENUM_VK_ENTRYPOINTS_SURFACE_INSTANCE(EnumMacro) \
@@ -249,6 +258,16 @@ enum
     MaxSimultaneousRenderTargets = 8
 };
 
+// Depth is reversed, the near plane maps to 1 and the far plane to 0. With a float depth buffer that spreads the precision
+// evenly over the view distance. Depth clears to the far plane and nearer fragments pass.
+static constexpr float VulkanFarDepth = 0.0f;
+static constexpr VkCompareOp VulkanDepthCompareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+
+// Accesses that write, the only ones a barrier has to make available.
+static constexpr VkAccessFlags2 VulkanWriteAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+                                                        VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                                        VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
 #define VK_CHECK_RESULT(VkFunction)                                                                                                        \
     {                                                                                                                                      \
         const VkResult ScopedResult = VkFunction;                                                                                          \
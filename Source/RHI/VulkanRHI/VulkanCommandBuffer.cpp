@@ -5,9 +5,17 @@
 #include "VulkanQueue.h"
 #include "VulkanResources.h"
 #include "VulkanRHI.h"
+#include "VulkanTextureUpload.h"
+
+static bool IsIntegerFormat(VkFormat Format)
+{
+    const EVulkanFormatNumericType NumericType = GetFormatNumericType(Format);
+    return NumericType == EVulkanFormatNumericType::UInt || NumericType == EVulkanFormatNumericType::SInt;
+}
 
 AVulkanCommandBuffer::AVulkanCommandBuffer(AVulkanDevice* InDevice, AVulkanCommandBufferPool* InCommandBufferPool)
-    : Device(InDevice), CmdBufferPool(InCommandBufferPool), Handle(VK_NULL_HANDLE), bHasPipeline(false), bHasViewport(false), bHasScissor(false)
+    : Device(InDevice), CmdBufferPool(InCommandBufferPool), Handle(VK_NULL_HANDLE), CurrentRenderPass(nullptr), CurrentSubpass(0), bHasPipeline(false),
+      bHasViewport(false), bHasScissor(false)
 {
     AMemory::Memzero(CurrentViewport);
     AMemory::Memzero(CurrentScissor);
@@ -70,13 +78,270 @@ void AVulkanCommandBuffer::BeginRenderPass(AVulkanRenderPass* RenderPass, AVulka
     VulkanApi::vkCmdBeginRenderPass(Handle, &Info, VK_SUBPASS_CONTENTS_INLINE);
 
     State = EState::IsInsideRenderPass;
+    CurrentRenderPass = RenderPass;
+    CurrentSubpass = 0;
+}
+
+void AVulkanCommandBuffer::NextSubpass()
+{
+    check(CurrentRenderPass && CurrentSubpass + 1 < CurrentRenderPass->GetNumSubpasses(), "The render pass has no further subpass.");
+    VulkanApi::vkCmdNextSubpass(Handle, VK_SUBPASS_CONTENTS_INLINE);
+    ++CurrentSubpass;
 }
 
 void AVulkanCommandBuffer::EndRenderPass()
 {
     check(IsInsideRenderPass(), "Can't EndRP as we're NOT inside one! CmdBuffer 0x%p State=%d");
+    check(CurrentSubpass + 1 == CurrentRenderPass->GetNumSubpasses(), "Render pass ended before its last subpass.");
     VulkanApi::vkCmdEndRenderPass(Handle);
     State = EState::IsInsideBegin;
+    CurrentRenderPass = nullptr;
+    CurrentSubpass = 0;
+}
+
+void AVulkanCommandBuffer::BeginRendering(const AVulkanRenderTargetsInfo& RTInfo, const VkClearValue* ClearValues)
+{
+    check(IsOutsideRenderPass(), "Can't BeginRendering as already inside a render pass!");
+
+    VkRenderingAttachmentInfo ColorAttachments[MaxSimultaneousRenderTargets];
+    VkRenderingAttachmentInfo DepthAttachment;
+    VkRenderingAttachmentInfo StencilAttachment;
+    VkExtent2D Extent = { 0, 0 };
+
+    auto AddAttachment = [&](VkRenderingAttachmentInfo& Attachment, AVulkanTexture* Texture, VkImageLayout Layout, VkAttachmentLoadOp LoadOp,
+                             VkAttachmentStoreOp StoreOp, uint32_t ClearIndex) {
+        check(Texture->Layout == Layout, "Attachments are transitioned before rendering begins.");
+        ZeroVulkanStruct(Attachment, VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO);
+        Attachment.imageView = Texture->View;
+        Attachment.imageLayout = Layout;
+        Attachment.loadOp = LoadOp;
+        Attachment.storeOp = StoreOp;
+        if (ClearValues && LoadOp == VK_ATTACHMENT_LOAD_OP_CLEAR)
+        {
+            Attachment.clearValue = ClearValues[ClearIndex];
+        }
+
+        Extent.width = Texture->Width;
+        Extent.height = Texture->Height;
+    };
+
+    auto AddResolve = [](VkRenderingAttachmentInfo& Attachment, const AVulkanTexture* Texture, const AVulkanTexture* ResolveTexture, VkImageLayout Layout) {
+        if (!ResolveTexture)
+        {
+            return;
+        }
+        check(Texture->NumSamples > 1 && ResolveTexture->NumSamples == 1, "Resolving a multisampled attachment into a single sampled one.");
+        check(ResolveTexture->Layout == Layout, "Resolve targets are transitioned before rendering begins.");
+        // Integer formats can't be averaged, sample zero is valid for everything.
+        const bool bAverage = (Texture->AspectMask == VK_IMAGE_ASPECT_COLOR_BIT) && !IsIntegerFormat(Texture->PixelFormat);
+        Attachment.resolveMode = bAverage ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+        Attachment.resolveImageView = ResolveTexture->View;
+        Attachment.resolveImageLayout = Layout;
+    };
+
+    for (int32_t Index = 0; Index < RTInfo.NumColorRenderTargets; ++Index)
+    {
+        const AVulkanRenderTargetView& View = RTInfo.ColorRenderTarget[Index];
+        AddAttachment(ColorAttachments[Index], View.Texture, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, View.LoadAction, View.StoreAction, Index);
+        AddResolve(ColorAttachments[Index], View.Texture, RTInfo.ResolveRenderTarget[Index].Texture, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+
+    const ADepthRenderTargetView& DepthView = RTInfo.DepthStencilRenderTarget;
+    const bool bHasDepth = DepthView.Texture && (DepthView.Texture->AspectMask & VK_IMAGE_ASPECT_DEPTH_BIT);
+    const bool bHasStencil = DepthView.Texture && (DepthView.Texture->AspectMask & VK_IMAGE_ASPECT_STENCIL_BIT);
+    if (bHasDepth)
+    {
+        AddAttachment(DepthAttachment, DepthView.Texture, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DepthView.DepthLoadAction,
+            DepthView.DepthStoreAction, RTInfo.NumColorRenderTargets);
+        AddResolve(DepthAttachment, DepthView.Texture, RTInfo.DepthStencilResolveTexture, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+    if (bHasStencil)
+    {
+        AddAttachment(StencilAttachment, DepthView.Texture, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DepthView.StencilLoadAction,
+            DepthView.StencilStoreAction, RTInfo.NumColorRenderTargets);
+        AddResolve(StencilAttachment, DepthView.Texture, RTInfo.DepthStencilResolveTexture, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+    check(Extent.width != 0 && Extent.height != 0, "Rendering without attachments.");
+
+    VkRenderingInfo Info;
+    ZeroVulkanStruct(Info, VK_STRUCTURE_TYPE_RENDERING_INFO);
+    Info.renderArea.extent = Extent;
+    Info.layerCount = 1;
+    Info.colorAttachmentCount = RTInfo.NumColorRenderTargets;
+    Info.pColorAttachments = ColorAttachments;
+    Info.pDepthAttachment = bHasDepth ? &DepthAttachment : nullptr;
+    Info.pStencilAttachment = bHasStencil ? &StencilAttachment : nullptr;
+    VulkanApi::vkCmdBeginRendering(Handle, &Info);
+
+    State = EState::IsInsideRenderPass;
+}
+
+void AVulkanCommandBuffer::EndRendering()
+{
+    check(IsInsideRenderPass(), "Can't EndRendering as we're NOT inside a render pass!");
+    VulkanApi::vkCmdEndRendering(Handle);
+    State = EState::IsInsideBegin;
+}
+
+void AVulkanCommandBuffer::TransitionRenderTargets(const AVulkanRenderTargetsInfo& RTInfo)
+{
+    AVulkanTexture* Textures[MaxSimultaneousRenderTargets * 2 + 2];
+    VkImageLayout NewLayouts[MaxSimultaneousRenderTargets * 2 + 2];
+    bool bDiscardContents[MaxSimultaneousRenderTargets * 2 + 2];
+    uint32_t NumTextures = 0;
+
+    // Resolves overwrite the whole target, what it held before is discarded.
+    auto AddResolveTarget = [&](AVulkanTexture* Texture, VkImageLayout Layout) {
+        if (Texture)
+        {
+            Textures[NumTextures] = Texture;
+            bDiscardContents[NumTextures] = true;
+            NewLayouts[NumTextures++] = Layout;
+        }
+    };
+
+    for (int32_t Index = 0; Index < RTInfo.NumColorRenderTargets; ++Index)
+    {
+        const AVulkanRenderTargetView& View = RTInfo.ColorRenderTarget[Index];
+        // Contents that are not loaded need not survive the transition.
+        Textures[NumTextures] = View.Texture;
+        bDiscardContents[NumTextures] = View.LoadAction != VK_ATTACHMENT_LOAD_OP_LOAD;
+        NewLayouts[NumTextures++] = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        AddResolveTarget(RTInfo.ResolveRenderTarget[Index].Texture, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    }
+
+    const ADepthRenderTargetView& DepthView = RTInfo.DepthStencilRenderTarget;
+    if (DepthView.Texture)
+    {
+        const bool bHasStencil = (DepthView.Texture->AspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+        Textures[NumTextures] = DepthView.Texture;
+        bDiscardContents[NumTextures] =
+            DepthView.DepthLoadAction != VK_ATTACHMENT_LOAD_OP_LOAD && (!bHasStencil || DepthView.StencilLoadAction != VK_ATTACHMENT_LOAD_OP_LOAD);
+        NewLayouts[NumTextures++] = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        AddResolveTarget(RTInfo.DepthStencilResolveTexture, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    }
+
+    TransitionLayouts(Textures, NewLayouts, NumTextures, bDiscardContents);
+}
+
+void AVulkanCommandBuffer::GetImageLayoutSync(VkImageLayout Layout, VkPipelineStageFlags2& OutStages, VkAccessFlags2& OutAccess)
+{
+    switch (Layout)
+    {
+    case VK_IMAGE_LAYOUT_UNDEFINED:
+        // No earlier contents to protect.
+        OutStages = VK_PIPELINE_STAGE_2_NONE;
+        OutAccess = VK_ACCESS_2_NONE;
+        break;
+    case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+        // Swapchain images are acquired by a semaphore waited on at the color output stage, chain to it.
+        OutStages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        OutAccess = VK_ACCESS_2_NONE;
+        break;
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+        OutStages = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+        OutAccess = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+        OutStages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+        OutAccess = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+        OutStages = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        OutAccess = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+        OutStages = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        OutAccess = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+        OutStages = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+        OutAccess = VK_ACCESS_2_TRANSFER_READ_BIT;
+        break;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+        OutStages = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+        OutAccess = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        break;
+    default:
+        OutStages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        OutAccess = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+        break;
+    }
+}
+
+void AVulkanCommandBuffer::GetTextureSync(const AVulkanTexture* Texture, VkPipelineStageFlags2& OutStages, VkAccessFlags2& OutAccess)
+{
+    GetImageLayoutSync(Texture->Layout, OutStages, OutAccess);
+    if (!Texture->bOwnsImage && Texture->Layout == VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+        // Swapchain images that were never presented still come from the acquire semaphore, chain to its wait stage.
+        GetImageLayoutSync(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, OutStages, OutAccess);
+    }
+}
+
+void AVulkanCommandBuffer::TransitionLayouts(
+    AVulkanTexture* const* Textures, const VkImageLayout* NewLayouts, uint32_t NumTextures, const bool* bDiscardContents)
+{
+    VkImageMemoryBarrier2 Barriers[MaxSimultaneousRenderTargets + 1];
+    uint32_t NumBarriers = 0;
+
+    for (uint32_t Index = 0; Index < NumTextures; ++Index)
+    {
+        AVulkanTexture* Texture = Textures[Index];
+        if (Texture->Layout == NewLayouts[Index] && NewLayouts[Index] != VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL &&
+            NewLayouts[Index] != VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+        {
+            // Read only layouts need no barrier, attachments still order writes after earlier ones.
+            continue;
+        }
+
+        if (NumBarriers == MaxSimultaneousRenderTargets + 1)
+        {
+            PipelineBarrier(Barriers, NumBarriers);
+            NumBarriers = 0;
+        }
+
+        VkImageMemoryBarrier2& Barrier = Barriers[NumBarriers++];
+        ZeroVulkanStruct(Barrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2);
+        GetTextureSync(Texture, Barrier.srcStageMask, Barrier.srcAccessMask);
+        GetImageLayoutSync(NewLayouts[Index], Barrier.dstStageMask, Barrier.dstAccessMask);
+        // Only writes need to be made available.
+        Barrier.srcAccessMask &= VulkanWriteAccessMask;
+        if (NewLayouts[Index] == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+        {
+            // Presentation is ordered by the semaphore signaled at the end of the submit.
+            Barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+            Barrier.dstAccessMask = VK_ACCESS_2_NONE;
+        }
+        // The previous accesses still finish first, only their contents need not be preserved.
+        Barrier.oldLayout = bDiscardContents && bDiscardContents[Index] ? VK_IMAGE_LAYOUT_UNDEFINED : Texture->Layout;
+        Barrier.newLayout = NewLayouts[Index];
+        Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        Barrier.image = Texture->Image;
+        Barrier.subresourceRange.aspectMask = Texture->AspectMask;
+        Barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        Barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+
+        Texture->Layout = NewLayouts[Index];
+    }
+
+    PipelineBarrier(Barriers, NumBarriers);
+}
+
+void AVulkanCommandBuffer::PipelineBarrier(const VkImageMemoryBarrier2* Barriers, uint32_t NumBarriers)
+{
+    if (NumBarriers == 0)
+    {
+        return;
+    }
+    check(IsOutsideRenderPass(), "Barriers are recorded outside of render passes.");
+
+    VkDependencyInfo DependencyInfo;
+    ZeroVulkanStruct(DependencyInfo, VK_STRUCTURE_TYPE_DEPENDENCY_INFO);
+    DependencyInfo.imageMemoryBarrierCount = NumBarriers;
+    DependencyInfo.pImageMemoryBarriers = Barriers;
+    VulkanApi::vkCmdPipelineBarrier2(Handle, &DependencyInfo);
 }
 
 void AVulkanCommandBuffer::Reset()
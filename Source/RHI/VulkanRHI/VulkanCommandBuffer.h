@@ -7,6 +7,8 @@ class AVulkanRHI;
 class AVulkanRenderPass;
 class AVulkanFramebuffer;
 class AVulkanCommandBufferPool;
+struct AVulkanRenderTargetsInfo;
+struct AVulkanTexture;
 
 class AVulkanCommandBuffer
 {
@@ -20,9 +22,27 @@ public:
     void Begin();
     void End();
     void BeginRenderPass(AVulkanRenderPass* RenderPass, AVulkanFramebuffer* Framebuffer, const VkClearValue* ClearValues);
+    // Every subpass of the render pass is entered before it ends.
+    void NextSubpass();
     void EndRenderPass();
+    // Dynamic rendering straight from the views, the attachments must already be in their attachment layouts.
+    void BeginRendering(const AVulkanRenderTargetsInfo& RTInfo, const VkClearValue* ClearValues);
+    void EndRendering();
     void Reset();
 
+    // One batched barrier moving each texture from its tracked layout to NewLayouts[Index]. Textures with
+    // bDiscardContents[Index] set transition from UNDEFINED, still ordered after the accesses of the tracked layout.
+    void TransitionLayouts(AVulkanTexture* const* Textures, const VkImageLayout* NewLayouts, uint32_t NumTextures, const bool* bDiscardContents = nullptr);
+    // Moves the attachments to their attachment layouts, discarding the contents of those that are not loaded.
+    void TransitionRenderTargets(const AVulkanRenderTargetsInfo& RTInfo);
+    // Barriers prepared by the caller, which is also responsible for updating AVulkanTexture::Layout.
+    void PipelineBarrier(const VkImageMemoryBarrier2* Barriers, uint32_t NumBarriers);
+
+    // Stages and accesses that use an image in the given layout.
+    static void GetImageLayoutSync(VkImageLayout Layout, VkPipelineStageFlags2& OutStages, VkAccessFlags2& OutAccess);
+    // Stages and accesses that last used the texture, GetImageLayoutSync() of its layout except for swapchain images.
+    static void GetTextureSync(const AVulkanTexture* Texture, VkPipelineStageFlags2& OutStages, VkAccessFlags2& OutAccess);
+
 public:
     enum class EState : uint8_t
     {
@@ -39,6 +59,9 @@ public:
     inline bool HasBegun() const { return State == EState::IsInsideBegin || State == EState::IsInsideRenderPass; }
     inline bool HasEnded() const { return State == EState::HasEnded; }
     inline bool IsSubmitted() const { return State == EState::Submitted; }
+    // nullptr outside of render passes and inside dynamic rendering.
+    inline AVulkanRenderPass* GetCurrentRenderPass() const { return CurrentRenderPass; }
+    inline uint32_t GetCurrentSubpass() const { return CurrentSubpass; }
 
     VkViewport CurrentViewport;
     VkRect2D CurrentScissor;
@@ -50,6 +73,9 @@ public:
 private:
     VkCommandBuffer Handle;
 
+    AVulkanRenderPass* CurrentRenderPass;
+    uint32_t CurrentSubpass;
+
     AVulkanCommandBufferPool* CmdBufferPool;
     AVulkanDevice* Device;
 
@@ -0,0 +1,454 @@
+#include "VulkanDescriptorSets.h"
+
+#include "VulkanDevice.h"
+
+#include "Core/Hash.h"
+
+// Sized for a frame worth of material and pass sets, another pool is added when one runs out.
+static constexpr uint32_t MaxSetsPerPool = 1024;
+static const VkDescriptorPoolSize PoolSizes[] = {
+    { VK_DESCRIPTOR_TYPE_SAMPLER, 256 },
+    { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2048 },
+    { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2048 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 256 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1024 },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 256 },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1024 },
+    { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 64 },
+};
+
+static constexpr uint32_t MaxBindlessSampledImages = 16384;
+static constexpr uint32_t MaxBindlessStorageBuffers = 8192;
+static constexpr uint32_t MaxBindlessSamplers = 256;
+static constexpr uint64_t NumFramesToRetireBindlessHandle = 3;
+
+void AVulkanDescriptorSetBindings::SetImage(uint32_t Binding, VkDescriptorType Type, VkImageView ImageView, VkImageLayout ImageLayout, VkSampler Sampler,
+    uint32_t ArrayElement)
+{
+    AEntry& Entry = FindOrAddEntry(Binding, ArrayElement);
+    Entry.Type = Type;
+    Entry.ImageView = ImageView;
+    Entry.ImageLayout = ImageLayout;
+    Entry.Sampler = Sampler;
+}
+
+void AVulkanDescriptorSetBindings::SetSampler(uint32_t Binding, VkSampler Sampler, uint32_t ArrayElement)
+{
+    AEntry& Entry = FindOrAddEntry(Binding, ArrayElement);
+    Entry.Type = VK_DESCRIPTOR_TYPE_SAMPLER;
+    Entry.Sampler = Sampler;
+}
+
+void AVulkanDescriptorSetBindings::SetBuffer(uint32_t Binding, VkDescriptorType Type, VkBuffer Buffer, VkDeviceSize Offset, VkDeviceSize Range,
+    uint32_t ArrayElement)
+{
+    AEntry& Entry = FindOrAddEntry(Binding, ArrayElement);
+    Entry.Type = Type;
+    Entry.Buffer = Buffer;
+    Entry.Offset = Offset;
+    Entry.Range = Range;
+}
+
+uint64_t AVulkanDescriptorSetBindings::GetHash() const
+{
+    return AHash::XXH64(Entries.GetData(), sizeof(AEntry) * Entries.Num());
+}
+
+bool AVulkanDescriptorSetBindings::Equals(const AVulkanDescriptorSetBindings& Other) const
+{
+    return Entries.Num() == Other.Entries.Num() && AMemory::Memcmp(Entries.GetData(), Other.Entries.GetData(), sizeof(AEntry) * Entries.Num()) == 0;
+}
+
+AVulkanDescriptorSetBindings::AEntry& AVulkanDescriptorSetBindings::FindOrAddEntry(uint32_t Binding, uint32_t ArrayElement)
+{
+    auto Less = [](const AEntry& Entry, const TPair<uint32_t, uint32_t>& Key) {
+        return Entry.Binding != Key.first ? Entry.Binding < Key.first : Entry.ArrayElement < Key.second;
+    };
+
+    const TPair<uint32_t, uint32_t> Key(Binding, ArrayElement);
+    auto Found = std::lower_bound(Entries.begin(), Entries.end(), Key, Less);
+    if (Found == Entries.end() || Found->Binding != Binding || Found->ArrayElement != ArrayElement)
+    {
+        // Zeroed so the unused members of the entry hash and compare equal.
+        AEntry Entry;
+        AMemory::Memzero(Entry);
+        Entry.Binding = Binding;
+        Entry.ArrayElement = ArrayElement;
+        Entries.Add(Entry);
+
+        std::sort(Entries.begin(), Entries.end(), [](const AEntry& A, const AEntry& B) {
+            return A.Binding != B.Binding ? A.Binding < B.Binding : A.ArrayElement < B.ArrayElement;
+        });
+        Found = std::lower_bound(Entries.begin(), Entries.end(), Key, Less);
+    }
+    else
+    {
+        AMemory::Memzero(*Found);
+        Found->Binding = Binding;
+        Found->ArrayElement = ArrayElement;
+    }
+    return *Found;
+}
+
+AVulkanDescriptorAllocator::AVulkanDescriptorAllocator(AVulkanDevice* InDevice)
+    : FrameNumber(0), NumPersistentSets(0), Device(InDevice)
+{
+}
+
+AVulkanDescriptorAllocator::~AVulkanDescriptorAllocator()
+{
+    for (APoolList& PoolList : FramePools)
+    {
+        for (VkDescriptorPool Pool : PoolList.Pools)
+        {
+            VulkanApi::vkDestroyDescriptorPool(Device->GetHandle(), Pool, VK_CPU_ALLOCATOR);
+        }
+    }
+
+    for (VkDescriptorPool Pool : PersistentPools.Pools)
+    {
+        VulkanApi::vkDestroyDescriptorPool(Device->GetHandle(), Pool, VK_CPU_ALLOCATOR);
+    }
+}
+
+VkDescriptorSet AVulkanDescriptorAllocator::AllocateTransient(VkDescriptorSetLayout Layout, const AVulkanDescriptorSetBindings& Bindings)
+{
+    VkDescriptorSet Set = Allocate(FramePools[FrameNumber % NumFramePools], Layout);
+    WriteSet(Set, Bindings);
+    return Set;
+}
+
+VkDescriptorSet AVulkanDescriptorAllocator::GetOrCreatePersistent(VkDescriptorSetLayout Layout, const AVulkanDescriptorSetBindings& Bindings)
+{
+    const uint64_t Hash = AHash::Combine(AHash::Memory(Layout), Bindings.GetHash());
+
+    // Sets with the same hash are compared in full, a collision must not bind the wrong resources.
+    TArray<APersistentSet>& Sets = PersistentSets[Hash];
+    for (const APersistentSet& PersistentSet : Sets)
+    {
+        if (PersistentSet.Layout == Layout && PersistentSet.Bindings.Equals(Bindings))
+        {
+            return PersistentSet.Handle;
+        }
+    }
+
+    APersistentSet PersistentSet;
+    PersistentSet.Layout = Layout;
+    PersistentSet.Bindings = Bindings;
+    PersistentSet.Handle = Allocate(PersistentPools, Layout);
+    WriteSet(PersistentSet.Handle, Bindings);
+    Sets.Add(PersistentSet);
+    ++NumPersistentSets;
+
+    return PersistentSet.Handle;
+}
+
+void AVulkanDescriptorAllocator::EndFrame()
+{
+    ++FrameNumber;
+
+    // The frame that used these pools NumFramePools frames ago has finished on the GPU.
+    APoolList& PoolList = FramePools[FrameNumber % NumFramePools];
+    for (int32_t Index = 0; Index <= PoolList.CurrentPool && Index < PoolList.Pools.Num(); ++Index)
+    {
+        VK_CHECK_RESULT(VulkanApi::vkResetDescriptorPool(Device->GetHandle(), PoolList.Pools[Index], 0));
+    }
+    PoolList.CurrentPool = 0;
+}
+
+VkDescriptorSet AVulkanDescriptorAllocator::Allocate(APoolList& PoolList, VkDescriptorSetLayout Layout)
+{
+    VkDescriptorSetAllocateInfo AllocateInfo;
+    ZeroVulkanStruct(AllocateInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO);
+    AllocateInfo.descriptorSetCount = 1;
+    AllocateInfo.pSetLayouts = &Layout;
+
+    VkDescriptorSet Set;
+    for (;;)
+    {
+        const bool bNewPool = PoolList.CurrentPool == PoolList.Pools.Num();
+        if (bNewPool)
+        {
+            PoolList.Pools.Add(CreatePool());
+        }
+
+        AllocateInfo.descriptorPool = PoolList.Pools[PoolList.CurrentPool];
+        const VkResult Result = VulkanApi::vkAllocateDescriptorSets(Device->GetHandle(), &AllocateInfo, &Set);
+        if (Result == VK_SUCCESS)
+        {
+            return Set;
+        }
+
+        check(Result == VK_ERROR_OUT_OF_POOL_MEMORY || Result == VK_ERROR_FRAGMENTED_POOL, "Failed to allocate descriptor set.");
+        // A fresh pool failing means the layout can never fit.
+        check(!bNewPool, "Descriptor set layout does not fit an empty pool.");
+        ++PoolList.CurrentPool;
+    }
+}
+
+VkDescriptorPool AVulkanDescriptorAllocator::CreatePool()
+{
+    VkDescriptorPoolCreateInfo PoolInfo;
+    ZeroVulkanStruct(PoolInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO);
+    PoolInfo.maxSets = MaxSetsPerPool;
+    PoolInfo.poolSizeCount = static_cast<uint32_t>(sizeof(PoolSizes) / sizeof(PoolSizes[0]));
+    PoolInfo.pPoolSizes = PoolSizes;
+
+    VkDescriptorPool Pool;
+    VK_CHECK_RESULT(VulkanApi::vkCreateDescriptorPool(Device->GetHandle(), &PoolInfo, VK_CPU_ALLOCATOR, &Pool));
+    return Pool;
+}
+
+void AVulkanDescriptorAllocator::WriteSet(VkDescriptorSet Set, const AVulkanDescriptorSetBindings& Bindings)
+{
+    const TArray<AVulkanDescriptorSetBindings::AEntry>& Entries = Bindings.GetEntries();
+    if (Entries.IsEmpty())
+    {
+        return;
+    }
+
+    // Sized up front, the writes point into these arrays.
+    Writes.Resize(Entries.Num());
+    ImageInfos.Resize(Entries.Num());
+    BufferInfos.Resize(Entries.Num());
+
+    for (int32_t Index = 0; Index < Entries.Num(); ++Index)
+    {
+        const AVulkanDescriptorSetBindings::AEntry& Entry = Entries[Index];
+
+        VkWriteDescriptorSet& Write = Writes[Index];
+        ZeroVulkanStruct(Write, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
+        Write.dstSet = Set;
+        Write.dstBinding = Entry.Binding;
+        Write.dstArrayElement = Entry.ArrayElement;
+        Write.descriptorCount = 1;
+        Write.descriptorType = Entry.Type;
+
+        switch (Entry.Type)
+        {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            ImageInfos[Index].sampler = Entry.Sampler;
+            ImageInfos[Index].imageView = Entry.ImageView;
+            ImageInfos[Index].imageLayout = Entry.ImageLayout;
+            Write.pImageInfo = &ImageInfos[Index];
+            break;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            BufferInfos[Index].buffer = Entry.Buffer;
+            BufferInfos[Index].offset = Entry.Offset;
+            BufferInfos[Index].range = Entry.Range;
+            Write.pBufferInfo = &BufferInfos[Index];
+            break;
+        default:
+            check(false, "Unsupported descriptor type.");
+            break;
+        }
+    }
+
+    VulkanApi::vkUpdateDescriptorSets(Device->GetHandle(), static_cast<uint32_t>(Writes.Num()), Writes.GetData(), 0, nullptr);
+}
+
+AVulkanBindlessHeap::AVulkanBindlessHeap(AVulkanDevice* InDevice)
+    : Pool(VK_NULL_HANDLE), Layout(VK_NULL_HANDLE), Set(VK_NULL_HANDLE), FrameNumber(0), Device(InDevice)
+{
+    // Capped by the non update-after-bind limits, which the update-after-bind ones are never below.
+    const VkPhysicalDeviceLimits& Limits = Device->GetPhysicalDeviceProperties().limits;
+    Slots[SampledImages].Capacity =
+        std::min(MaxBindlessSampledImages, std::min(Limits.maxDescriptorSetSampledImages, Limits.maxPerStageDescriptorSampledImages));
+    Slots[StorageBuffers].Capacity =
+        std::min(MaxBindlessStorageBuffers, std::min(Limits.maxDescriptorSetStorageBuffers, Limits.maxPerStageDescriptorStorageBuffers));
+    Slots[Samplers].Capacity = std::min(MaxBindlessSamplers, std::min(Limits.maxDescriptorSetSamplers, Limits.maxPerStageDescriptorSamplers));
+
+    static const VkDescriptorType BindingTypes[NumBindings] = {
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        VK_DESCRIPTOR_TYPE_SAMPLER,
+    };
+
+    VkDescriptorSetLayoutBinding LayoutBindings[NumBindings];
+    VkDescriptorBindingFlags BindingFlags[NumBindings];
+    VkDescriptorPoolSize PoolSizes[NumBindings];
+    for (uint32_t Binding = 0; Binding < NumBindings; ++Binding)
+    {
+        Slots[Binding].NumUsed = 0;
+
+        AMemory::Memzero(LayoutBindings[Binding]);
+        LayoutBindings[Binding].binding = Binding;
+        LayoutBindings[Binding].descriptorType = BindingTypes[Binding];
+        LayoutBindings[Binding].descriptorCount = Slots[Binding].Capacity;
+        LayoutBindings[Binding].stageFlags = VK_SHADER_STAGE_ALL;
+
+        // Slots are written while the set is bound and unwritten slots are never indexed.
+        BindingFlags[Binding] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+                                VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+
+        PoolSizes[Binding].type = BindingTypes[Binding];
+        PoolSizes[Binding].descriptorCount = Slots[Binding].Capacity;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo BindingFlagsInfo;
+    ZeroVulkanStruct(BindingFlagsInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO);
+    BindingFlagsInfo.bindingCount = NumBindings;
+    BindingFlagsInfo.pBindingFlags = BindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo SetLayoutInfo;
+    ZeroVulkanStruct(SetLayoutInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO);
+    SetLayoutInfo.pNext = &BindingFlagsInfo;
+    SetLayoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+    SetLayoutInfo.bindingCount = NumBindings;
+    SetLayoutInfo.pBindings = LayoutBindings;
+    VK_CHECK_RESULT(VulkanApi::vkCreateDescriptorSetLayout(Device->GetHandle(), &SetLayoutInfo, VK_CPU_ALLOCATOR, &Layout));
+
+    VkDescriptorPoolCreateInfo PoolInfo;
+    ZeroVulkanStruct(PoolInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO);
+    PoolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+    PoolInfo.maxSets = 1;
+    PoolInfo.poolSizeCount = NumBindings;
+    PoolInfo.pPoolSizes = PoolSizes;
+    VK_CHECK_RESULT(VulkanApi::vkCreateDescriptorPool(Device->GetHandle(), &PoolInfo, VK_CPU_ALLOCATOR, &Pool));
+
+    VkDescriptorSetAllocateInfo AllocateInfo;
+    ZeroVulkanStruct(AllocateInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO);
+    AllocateInfo.descriptorPool = Pool;
+    AllocateInfo.descriptorSetCount = 1;
+    AllocateInfo.pSetLayouts = &Layout;
+    VK_CHECK_RESULT(VulkanApi::vkAllocateDescriptorSets(Device->GetHandle(), &AllocateInfo, &Set));
+
+    std::cout << "[INFO] Bindless heap: " << Slots[SampledImages].Capacity << " images, " << Slots[StorageBuffers].Capacity << " storage buffers, "
+              << Slots[Samplers].Capacity << " samplers.\n";
+}
+
+AVulkanBindlessHeap::~AVulkanBindlessHeap()
+{
+    VulkanApi::vkDestroyDescriptorPool(Device->GetHandle(), Pool, VK_CPU_ALLOCATOR);
+    VulkanApi::vkDestroyDescriptorSetLayout(Device->GetHandle(), Layout, VK_CPU_ALLOCATOR);
+}
+
+bool AVulkanBindlessHeap::IsSupported(const AVulkanDevice* Device)
+{
+    const VkPhysicalDeviceVulkan12Features& Features12 = Device->GetPhysicalDeviceFeatures12();
+    return Features12.descriptorIndexing && Features12.runtimeDescriptorArray && Features12.descriptorBindingPartiallyBound &&
+           Features12.descriptorBindingUpdateUnusedWhilePending && Features12.descriptorBindingSampledImageUpdateAfterBind &&
+           Features12.descriptorBindingStorageBufferUpdateAfterBind && Features12.shaderSampledImageArrayNonUniformIndexing &&
+           Features12.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+uint32_t AVulkanBindlessHeap::AddSampledImage(VkImageView ImageView, VkImageLayout ImageLayout)
+{
+    VkDescriptorImageInfo ImageInfo;
+    AMemory::Memzero(ImageInfo);
+    ImageInfo.imageView = ImageView;
+    ImageInfo.imageLayout = ImageLayout;
+
+    VkWriteDescriptorSet Write;
+    ZeroVulkanStruct(Write, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
+    Write.dstSet = Set;
+    Write.dstBinding = SampledImages;
+    Write.descriptorCount = 1;
+    Write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    Write.pImageInfo = &ImageInfo;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Write.dstArrayElement = AllocateHandle(SampledImages);
+    if (Write.dstArrayElement != InvalidHandle)
+    {
+        VulkanApi::vkUpdateDescriptorSets(Device->GetHandle(), 1, &Write, 0, nullptr);
+    }
+    return Write.dstArrayElement;
+}
+
+uint32_t AVulkanBindlessHeap::AddStorageBuffer(VkBuffer Buffer, VkDeviceSize Offset, VkDeviceSize Range)
+{
+    VkDescriptorBufferInfo BufferInfo;
+    BufferInfo.buffer = Buffer;
+    BufferInfo.offset = Offset;
+    BufferInfo.range = Range;
+
+    VkWriteDescriptorSet Write;
+    ZeroVulkanStruct(Write, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
+    Write.dstSet = Set;
+    Write.dstBinding = StorageBuffers;
+    Write.descriptorCount = 1;
+    Write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    Write.pBufferInfo = &BufferInfo;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Write.dstArrayElement = AllocateHandle(StorageBuffers);
+    if (Write.dstArrayElement != InvalidHandle)
+    {
+        VulkanApi::vkUpdateDescriptorSets(Device->GetHandle(), 1, &Write, 0, nullptr);
+    }
+    return Write.dstArrayElement;
+}
+
+uint32_t AVulkanBindlessHeap::AddSampler(VkSampler Sampler)
+{
+    VkDescriptorImageInfo ImageInfo;
+    AMemory::Memzero(ImageInfo);
+    ImageInfo.sampler = Sampler;
+
+    VkWriteDescriptorSet Write;
+    ZeroVulkanStruct(Write, VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET);
+    Write.dstSet = Set;
+    Write.dstBinding = Samplers;
+    Write.descriptorCount = 1;
+    Write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+    Write.pImageInfo = &ImageInfo;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Write.dstArrayElement = AllocateHandle(Samplers);
+    if (Write.dstArrayElement != InvalidHandle)
+    {
+        VulkanApi::vkUpdateDescriptorSets(Device->GetHandle(), 1, &Write, 0, nullptr);
+    }
+    return Write.dstArrayElement;
+}
+
+void AVulkanBindlessHeap::Remove(EBinding Binding, uint32_t Handle)
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    check(Handle < Slots[Binding].NumUsed, "Invalid bindless handle.");
+    Slots[Binding].RetiredHandles.Add(TPair<uint64_t, uint32_t>(FrameNumber, Handle));
+}
+
+void AVulkanBindlessHeap::EndFrame()
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    ++FrameNumber;
+
+    for (ASlots& BindingSlots : Slots)
+    {
+        for (int32_t Index = BindingSlots.RetiredHandles.Num() - 1; Index >= 0; --Index)
+        {
+            if (BindingSlots.RetiredHandles[Index].first + NumFramesToRetireBindlessHandle <= FrameNumber)
+            {
+                BindingSlots.FreeHandles.Add(BindingSlots.RetiredHandles[Index].second);
+                BindingSlots.RetiredHandles.RemoveAt(Index);
+            }
+        }
+    }
+}
+
+uint32_t AVulkanBindlessHeap::AllocateHandle(EBinding Binding)
+{
+    ASlots& BindingSlots = Slots[Binding];
+    if (!BindingSlots.FreeHandles.IsEmpty())
+    {
+        const uint32_t Handle = BindingSlots.FreeHandles[BindingSlots.FreeHandles.Num() - 1];
+        BindingSlots.FreeHandles.RemoveAt(BindingSlots.FreeHandles.Num() - 1);
+        return Handle;
+    }
+
+    if (BindingSlots.NumUsed == BindingSlots.Capacity)
+    {
+        std::cerr << "[WARNING] Bindless heap is full.\n";
+        return InvalidHandle;
+    }
+    return BindingSlots.NumUsed++;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "VulkanApi.h"
+#include "VulkanShaderReflection.h"
+
+#include <mutex>
+
+class AVulkanDevice;
+
+// Contents of one descriptor set, one entry per written array element. Sets with equal contents and layout
+// are interchangeable, which is what the persistent set cache keys on.
+class AVulkanDescriptorSetBindings
+{
+public:
+    struct AEntry
+    {
+        uint32_t Binding;
+        uint32_t ArrayElement;
+        VkDescriptorType Type;
+        VkImageLayout ImageLayout;
+        VkSampler Sampler;
+        VkImageView ImageView;
+        VkBuffer Buffer;
+        VkDeviceSize Offset;
+        VkDeviceSize Range;
+    };
+
+    void SetImage(uint32_t Binding, VkDescriptorType Type, VkImageView ImageView, VkImageLayout ImageLayout, VkSampler Sampler = VK_NULL_HANDLE,
+        uint32_t ArrayElement = 0);
+    void SetSampler(uint32_t Binding, VkSampler Sampler, uint32_t ArrayElement = 0);
+    void SetBuffer(uint32_t Binding, VkDescriptorType Type, VkBuffer Buffer, VkDeviceSize Offset, VkDeviceSize Range, uint32_t ArrayElement = 0);
+
+    inline void Reset() { Entries.Clear(); }
+    inline bool IsEmpty() const { return Entries.IsEmpty(); }
+    inline const TArray<AEntry>& GetEntries() const { return Entries; }
+
+    uint64_t GetHash() const;
+    bool Equals(const AVulkanDescriptorSetBindings& Other) const;
+
+private:
+    AEntry& FindOrAddEntry(uint32_t Binding, uint32_t ArrayElement);
+
+private:
+    // Sorted by binding and array element, so equal contents hash equal regardless of the write order.
+    TArray<AEntry> Entries;
+};
+
+// Descriptor sets for the render thread.
+//
+// Transient sets come from per-frame pools that are reset as a whole once the GPU is done with the frame,
+// allocation is a pointer bump in the driver and nothing is ever freed one by one. Persistent sets live
+// until the allocator is destroyed and are shared by every request with the same layout and contents.
+class AVulkanDescriptorAllocator
+{
+public:
+    AVulkanDescriptorAllocator(AVulkanDevice* Device);
+    ~AVulkanDescriptorAllocator();
+
+    // Valid until the end of the frame.
+    VkDescriptorSet AllocateTransient(VkDescriptorSetLayout Layout, const AVulkanDescriptorSetBindings& Bindings);
+    VkDescriptorSet GetOrCreatePersistent(VkDescriptorSetLayout Layout, const AVulkanDescriptorSetBindings& Bindings);
+
+    // Recycles the pools of the oldest frame.
+    void EndFrame();
+
+    inline uint32_t GetNumPersistentSets() const { return NumPersistentSets; }
+
+private:
+    struct APoolList
+    {
+        TArray<VkDescriptorPool> Pools;
+        // Pools before this one are full.
+        int32_t CurrentPool = 0;
+    };
+
+    struct APersistentSet
+    {
+        VkDescriptorSetLayout Layout;
+        AVulkanDescriptorSetBindings Bindings;
+        VkDescriptorSet Handle;
+    };
+
+    VkDescriptorSet Allocate(APoolList& PoolList, VkDescriptorSetLayout Layout);
+    VkDescriptorPool CreatePool();
+    void WriteSet(VkDescriptorSet Set, const AVulkanDescriptorSetBindings& Bindings);
+
+private:
+    enum
+    {
+        // Frames the GPU may still be reading descriptors of.
+        NumFramePools = 3
+    };
+
+    APoolList FramePools[NumFramePools];
+    APoolList PersistentPools;
+    uint64_t FrameNumber;
+
+    TMap<uint64_t, TArray<APersistentSet>> PersistentSets;
+    uint32_t NumPersistentSets;
+
+    // Scratch for WriteSet(), reused to avoid allocating per set.
+    TArray<VkWriteDescriptorSet> Writes;
+    TArray<VkDescriptorImageInfo> ImageInfos;
+    TArray<VkDescriptorBufferInfo> BufferInfos;
+
+    AVulkanDevice* Device;
+};
+
+// One descriptor set holding every sampled image, storage buffer and sampler registered with it, so shaders
+// index resources by the integer handle returned from Add*() instead of binding a set per draw.
+//
+// Bound at BindlessSetIndex, shaders declare it as
+//     layout(set = 3, binding = 0) uniform texture2D BindlessTextures[];
+//     layout(set = 3, binding = 1) buffer ABindlessBuffer { uint Data[]; } BindlessBuffers[];
+//     layout(set = 3, binding = 2) uniform sampler BindlessSamplers[];
+// Requires descriptor indexing with update-after-bind, see IsSupported().
+class AVulkanBindlessHeap
+{
+public:
+    enum EBinding : uint32_t
+    {
+        SampledImages,
+        StorageBuffers,
+        Samplers,
+        NumBindings
+    };
+
+    static constexpr uint32_t BindlessSetIndex = MaxDescriptorSets - 1;
+    static constexpr uint32_t InvalidHandle = ~0u;
+
+    AVulkanBindlessHeap(AVulkanDevice* Device);
+    ~AVulkanBindlessHeap();
+
+    static bool IsSupported(const AVulkanDevice* Device);
+
+    // Thread safe, returns InvalidHandle when the heap is full.
+    uint32_t AddSampledImage(VkImageView ImageView, VkImageLayout ImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    uint32_t AddStorageBuffer(VkBuffer Buffer, VkDeviceSize Offset, VkDeviceSize Range);
+    uint32_t AddSampler(VkSampler Sampler);
+    // The handle is reused once frames in flight can no longer read it.
+    void Remove(EBinding Binding, uint32_t Handle);
+
+    void EndFrame();
+
+    inline VkDescriptorSetLayout GetLayout() const { return Layout; }
+    inline VkDescriptorSet GetSet() const { return Set; }
+    inline uint32_t GetCapacity(EBinding Binding) const { return Slots[Binding].Capacity; }
+
+private:
+    struct ASlots
+    {
+        uint32_t Capacity;
+        // Handles below this were handed out at least once.
+        uint32_t NumUsed;
+        TArray<uint32_t> FreeHandles;
+        // Removed handles and the frame they were removed in.
+        TArray<TPair<uint64_t, uint32_t>> RetiredHandles;
+    };
+
+    uint32_t AllocateHandle(EBinding Binding);
+
+private:
+    VkDescriptorPool Pool;
+    VkDescriptorSetLayout Layout;
+    VkDescriptorSet Set;
+
+    std::mutex Mutex;
+    ASlots Slots[NumBindings];
+    uint64_t FrameNumber;
+
+    AVulkanDevice* Device;
+};
@@ -2,20 +2,34 @@
 
 #include "VulkanRHI.h"
 #include "VulkanQueue.h"
+#include "VulkanDescriptorSets.h"
 #include "VulkanMemory.h"
 #include "VulkanPipeline.h"
 
+#define PIPELINE_CACHE_PATH (AString(SAVED_DIR) + "PipelineCache.bin")
+#define SHADER_PACKAGE_PATH (AString(SHADER_DIR) + "Shaders.pak")
+
 AVulkanDevice::AVulkanDevice(AVulkanRHI* InRHI, VkPhysicalDevice InGpu)
     : RHI(InRHI), Device(VK_NULL_HANDLE), Gpu(InGpu), GraphicsQueue(nullptr), ComputeQueue(nullptr), TransferQueue(nullptr), PresentQueue(nullptr),
-      /*FenceManager(nullptr),*/ ShaderManager(nullptr)
+      bSupportsGraphicsPipelineLibrary(false), /*FenceManager(nullptr),*/ ShaderManager(nullptr), PipelineCache(nullptr), BindlessHeap(nullptr)
 {
     AMemory::Memzero(GpuProps);
+    ZeroVulkanStruct(GpuIdProps, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES);
     AMemory::Memzero(PhysicalFeatures);
+    ZeroVulkanStruct(PhysicalFeatures12, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES);
+    ZeroVulkanStruct(PhysicalFeatures13, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES);
+    ZeroVulkanStruct(GraphicsPipelineLibraryFeatures, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT);
+    ZeroVulkanStruct(GraphicsPipelineLibraryProps, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT);
     AMemory::Memzero(FormatProperties);
 
-    VulkanApi::vkGetPhysicalDeviceProperties(Gpu, &GpuProps);
+    VkPhysicalDeviceProperties2 GpuProps2;
+    ZeroVulkanStruct(GpuProps2, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2);
+    GpuProps2.pNext = &GpuIdProps;
+    VulkanApi::vkGetPhysicalDeviceProperties2(Gpu, &GpuProps2);
+    GpuProps = GpuProps2.properties;
+    GpuIdProps.pNext = nullptr;
+
     VendorId = static_cast<EGpuVendorId>(GpuProps.vendorID);
-    //VulkanApi::vkGetPhysicalDeviceProperties2KHR
     check(VendorId != EGpuVendorId::Unknown, "Unknown GPU Vendor.");
 }
 
@@ -29,19 +43,133 @@ AVulkanDevice::~AVulkanDevice()
 
 void AVulkanDevice::Initizlize()
 {
-    VulkanApi::vkGetPhysicalDeviceFeatures(Gpu, &PhysicalFeatures);
+    uint32_t ExtensionCount = 0;
+    VK_CHECK_RESULT(VulkanApi::vkEnumerateDeviceExtensionProperties(Gpu, nullptr, &ExtensionCount, nullptr));
+    SupportedExtensions.Resize(ExtensionCount);
+    VK_CHECK_RESULT(VulkanApi::vkEnumerateDeviceExtensionProperties(Gpu, nullptr, &ExtensionCount, SupportedExtensions.GetData()));
+
+    const bool bHasGraphicsPipelineLibrary =
+        IsExtensionSupported(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) && IsExtensionSupported(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+    VkPhysicalDeviceFeatures2 PhysicalFeatures2;
+    ZeroVulkanStruct(PhysicalFeatures2, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2);
+    PhysicalFeatures2.pNext = &PhysicalFeatures12;
+    PhysicalFeatures12.pNext = &PhysicalFeatures13;
+    PhysicalFeatures13.pNext = bHasGraphicsPipelineLibrary ? &GraphicsPipelineLibraryFeatures : nullptr;
+    VulkanApi::vkGetPhysicalDeviceFeatures2(Gpu, &PhysicalFeatures2);
+    PhysicalFeatures = PhysicalFeatures2.features;
+
+    check(PhysicalFeatures12.timelineSemaphore == VK_TRUE, "Timeline semaphores are not supported.");
+
+    if (bHasGraphicsPipelineLibrary && GraphicsPipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE)
+    {
+        VkPhysicalDeviceProperties2 GpuProps2;
+        ZeroVulkanStruct(GpuProps2, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2);
+        GpuProps2.pNext = &GraphicsPipelineLibraryProps;
+        VulkanApi::vkGetPhysicalDeviceProperties2(Gpu, &GpuProps2);
+        GraphicsPipelineLibraryProps.pNext = nullptr;
+
+        bSupportsGraphicsPipelineLibrary = true;
+        std::cout << "[INFO] Graphics pipeline libraries enabled, fast linking "
+                  << (GraphicsPipelineLibraryProps.graphicsPipelineLibraryFastLinking ? "supported" : "not supported") << ".\n";
+    }
 
     QueryGpu();
     CreateDevice();
     SetupFormats();
 
     //FenceManager = new AVulkanFenceManager(this);
+    if (AVulkanBindlessHeap::IsSupported(this))
+    {
+        BindlessHeap = new AVulkanBindlessHeap(this);
+    }
+
     ShaderManager = new AVulkanShaderManager(this);
+    ShaderManager->MountPackage(SHADER_PACKAGE_PATH, SHADER_DIR);
+
+    PipelineCache = new AVulkanPipelineCache(this);
+    PipelineCache->Load(PIPELINE_CACHE_PATH);
+}
+
+uint32_t AVulkanDevice::FindMemoryTypeIndex(uint32_t TypeBits, VkMemoryPropertyFlags Properties) const
+{
+    uint32_t Index = 0;
+    const bool bFound = TryFindMemoryTypeIndex(TypeBits, Properties, Index);
+    check(bFound, "No memory type with the requested properties.");
+    return Index;
+}
+
+bool AVulkanDevice::TryFindMemoryTypeIndex(uint32_t TypeBits, VkMemoryPropertyFlags Properties, uint32_t& OutIndex) const
+{
+    for (uint32_t Index = 0; Index < MemoryProperties.memoryTypeCount; ++Index)
+    {
+        if ((TypeBits & (1u << Index)) != 0 && (MemoryProperties.memoryTypes[Index].propertyFlags & Properties) == Properties)
+        {
+            OutIndex = Index;
+            return true;
+        }
+    }
+    return false;
+}
+
+VkFormat AVulkanDevice::GetDepthStencilFormat(bool bStencil) const
+{
+    // Without stencil 32 bit float first, which reversed-Z needs for its precision. With stencil D24S8, which packs into
+    // 32 bits where D32S8 usually takes 64. The spec guarantees one of each list.
+    static constexpr VkFormat Formats[2][3] = {
+        { VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32, VK_FORMAT_D16_UNORM },
+        { VK_FORMAT_D24_UNORM_S8_UINT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D16_UNORM_S8_UINT },
+    };
+
+    for (VkFormat Format : Formats[bStencil ? 1 : 0])
+    {
+        if (FormatProperties[Format].optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)
+        {
+            return Format;
+        }
+    }
+
+    check(false, "No depth stencil format can be rendered to.");
+    return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t AVulkanDevice::GetSupportedSampleCount(uint32_t NumSamples, bool bDepthStencil) const
+{
+    VkSampleCountFlags SampleCounts = GpuProps.limits.framebufferColorSampleCounts;
+    if (bDepthStencil)
+    {
+        SampleCounts &= GpuProps.limits.framebufferDepthSampleCounts & GpuProps.limits.framebufferStencilSampleCounts;
+    }
+
+    // Sample counts are powers of two and the flag bits equal them, 1 is always supported.
+    uint32_t SampleCount = 1;
+    for (uint32_t Candidate = 2; Candidate <= NumSamples && Candidate <= VK_SAMPLE_COUNT_64_BIT; Candidate <<= 1)
+    {
+        SampleCount = (SampleCounts & Candidate) ? Candidate : SampleCount;
+    }
+    return SampleCount;
+}
+
+bool AVulkanDevice::IsExtensionSupported(const AnsiChar* ExtensionName) const
+{
+    for (const VkExtensionProperties& Extension : SupportedExtensions)
+    {
+        if (std::strcmp(Extension.extensionName, ExtensionName) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 void AVulkanDevice::QueryGpu()
 {
     DeviceExtensions.Add(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    if (bSupportsGraphicsPipelineLibrary)
+    {
+        DeviceExtensions.Add(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+        DeviceExtensions.Add(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+    }
     ValidationLayers.Add(VK_KHRONOS_VALIDATION_LAYER_NAME);
 
     uint32_t QueueCount = 0;
@@ -50,6 +178,8 @@ void AVulkanDevice::QueryGpu()
 
     QueueFamilyProps.Resize(QueueCount);
     VulkanApi::vkGetPhysicalDeviceQueueFamilyProperties(Gpu, &QueueCount, QueueFamilyProps.GetData());
+
+    VulkanApi::vkGetPhysicalDeviceMemoryProperties(Gpu, &MemoryProperties);
 }
 
 void AVulkanDevice::CreateDevice()
@@ -133,7 +263,17 @@ void AVulkanDevice::CreateDevice()
     DeviceInfo.queueCreateInfoCount = QueueFamilyInfos.Num();
     DeviceInfo.pQueueCreateInfos = QueueFamilyInfos.GetData();
 
-    DeviceInfo.pEnabledFeatures = &PhysicalFeatures; // Unsupport.
+    // Enable everything the device supports, chained through VkPhysicalDeviceFeatures2.
+    VkPhysicalDeviceFeatures2 PhysicalFeatures2;
+    ZeroVulkanStruct(PhysicalFeatures2, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2);
+    PhysicalFeatures2.features = PhysicalFeatures;
+    PhysicalFeatures2.pNext = &PhysicalFeatures12;
+    PhysicalFeatures12.pNext = &PhysicalFeatures13;
+    PhysicalFeatures13.pNext = bSupportsGraphicsPipelineLibrary ? &GraphicsPipelineLibraryFeatures : nullptr;
+    GraphicsPipelineLibraryFeatures.pNext = nullptr;
+
+    DeviceInfo.pNext = &PhysicalFeatures2;
+    DeviceInfo.pEnabledFeatures = nullptr;
 
     VK_CHECK_RESULT(VulkanApi::vkCreateDevice(Gpu, &DeviceInfo, VK_CPU_ALLOCATOR, &Device));
 
@@ -184,8 +324,18 @@ void AVulkanDevice::SetupPresentQueue(VkSurfaceKHR Surface)
 
 void AVulkanDevice::Destory()
 {
+    if (PipelineCache)
+    {
+        PipelineCache->Save(PIPELINE_CACHE_PATH);
+    }
+    delete PipelineCache;
+    PipelineCache = nullptr;
+
     delete ShaderManager;
     ShaderManager = nullptr;
+    // Pipeline layouts of the shader manager reference its set layout.
+    delete BindlessHeap;
+    BindlessHeap = nullptr;
     //delete FenceManager;
     //FenceManager = nullptr;
 
@@ -200,6 +350,18 @@ void AVulkanDevice::Destory()
     Device = VK_NULL_HANDLE;
 }
 
+void AVulkanDevice::NotifyDeletedImage(VkImage Image)
+{
+    RHI->NotifyDeletedImage(Image);
+}
+
+void AVulkanDevice::ProcessTimelineWaiters()
+{
+    GraphicsQueue->GetTimeline()->ProcessWaiters();
+    ComputeQueue->GetTimeline()->ProcessWaiters();
+    TransferQueue->GetTimeline()->ProcessWaiters();
+}
+
 void AVulkanDevice::WaitUntilIdle()
 {
     VK_CHECK_RESULT(VulkanApi::vkDeviceWaitIdle(Device));
@@ -2,7 +2,9 @@
 
 #include "VulkanApi.h"
 
+class AVulkanBindlessHeap;
 class AVulkanFenceManager;
+class AVulkanPipelineCache;
 class AVulkanPipelineStateManager;
 class AVulkanQueue;
 class AVulkanRHI;
@@ -21,11 +23,35 @@ public:
 
     void WaitUntilIdle();
 
+    // Resumes coroutines waiting on queue timeline values that the GPU has reached.
+    void ProcessTimelineWaiters();
+
+    // Drops everything that references the image, such as cached framebuffers, before it is destroyed.
+    void NotifyDeletedImage(VkImage Image);
+
     inline VkDevice GetHandle() const { return Device; }
     inline VkPhysicalDevice GetPhysicalDeviceHandle() const { return Gpu; }
 
     inline VkPhysicalDeviceProperties GetPhysicalDeviceProperties() const { return GpuProps; }
+    inline const VkPhysicalDeviceIDProperties& GetPhysicalDeviceIDProperties() const { return GpuIdProps; }
+    inline const VkPhysicalDeviceFeatures& GetPhysicalDeviceFeatures() const { return PhysicalFeatures; }
+    inline const VkPhysicalDeviceVulkan12Features& GetPhysicalDeviceFeatures12() const { return PhysicalFeatures12; }
+    inline const VkPhysicalDeviceVulkan13Features& GetPhysicalDeviceFeatures13() const { return PhysicalFeatures13; }
+    inline const VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT& GetGraphicsPipelineLibraryProperties() const { return GraphicsPipelineLibraryProps; }
+    inline bool SupportsGraphicsPipelineLibrary() const { return bSupportsGraphicsPipelineLibrary; }
+    // Core in 1.3, pipelines are then created without render passes and drawn between vkCmdBeginRendering/vkCmdEndRendering.
+    inline bool SupportsDynamicRendering() const { return PhysicalFeatures13.dynamicRendering && PhysicalFeatures13.synchronization2; }
+    bool IsExtensionSupported(const AnsiChar* ExtensionName) const;
+    inline const VkPhysicalDeviceMemoryProperties& GetPhysicalDeviceMemoryProperties() const { return MemoryProperties; }
+    // First memory type allowed by TypeBits that has all of Properties, check()s that one exists.
+    uint32_t FindMemoryTypeIndex(uint32_t TypeBits, VkMemoryPropertyFlags Properties) const;
+    // Same, for optional properties such as lazily allocated memory.
+    bool TryFindMemoryTypeIndex(uint32_t TypeBits, VkMemoryPropertyFlags Properties, uint32_t& OutIndex) const;
     inline const VkFormatProperties* GetFormatProperties() const { return FormatProperties; }
+    // Best depth format the device can render to, with stencil only when bStencil.
+    VkFormat GetDepthStencilFormat(bool bStencil) const;
+    // Highest sample count up to NumSamples render targets can have, depth stencil ones as well with bDepthStencil.
+    uint32_t GetSupportedSampleCount(uint32_t NumSamples, bool bDepthStencil = false) const;
 
     inline AVulkanQueue* GetGraphicsQueue() const { return GraphicsQueue; }
     inline AVulkanQueue* GetComputeQueue() const { return ComputeQueue; }
@@ -34,6 +60,9 @@ public:
 
     //inline AVulkanFenceManager* GetFenceManager() const { return FenceManager; }
     inline AVulkanShaderManager* GetShaderManager() const { return ShaderManager; }
+    inline AVulkanPipelineCache* GetPipelineCache() const { return PipelineCache; }
+    // nullptr without descriptor indexing.
+    inline AVulkanBindlessHeap* GetBindlessHeap() const { return BindlessHeap; }
 
 private:
     void QueryGpu();
@@ -46,8 +75,16 @@ private:
     EGpuVendorId VendorId;
     VkPhysicalDevice Gpu;
     VkPhysicalDeviceProperties GpuProps;
+    VkPhysicalDeviceIDProperties GpuIdProps;
     VkPhysicalDeviceFeatures PhysicalFeatures;
-
+    VkPhysicalDeviceVulkan12Features PhysicalFeatures12;
+    VkPhysicalDeviceVulkan13Features PhysicalFeatures13;
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT GraphicsPipelineLibraryFeatures;
+    VkPhysicalDeviceGraphicsPipelineLibraryPropertiesEXT GraphicsPipelineLibraryProps;
+    bool bSupportsGraphicsPipelineLibrary;
+    VkPhysicalDeviceMemoryProperties MemoryProperties;
+
+    TArray<VkExtensionProperties> SupportedExtensions;
     TArray<VkQueueFamilyProperties> QueueFamilyProps;
     VkFormatProperties FormatProperties[VK_FORMAT_RANGE_SIZE];
 
@@ -61,6 +98,8 @@ private:
 
     //AVulkanFenceManager* FenceManager;
     AVulkanShaderManager* ShaderManager;
+    AVulkanPipelineCache* PipelineCache;
+    AVulkanBindlessHeap* BindlessHeap;
 
     AVulkanRHI* RHI;
     friend AVulkanRHI;
@@ -1,6 +1,7 @@
 #include "VulkanMemory.h"
 
 #include "VulkanDevice.h"
+#include "VulkanResources.h"
 
 ////////////////////////////////////////
 //          Vulkan Semaphore          //
@@ -19,6 +20,105 @@ AVulkanSemaphore::~AVulkanSemaphore()
     Handle = VK_NULL_HANDLE;
 }
 
+////////////////////////////////////////
+//     Vulkan Timeline Semaphore      //
+////////////////////////////////////////
+
+AVulkanTimelineSemaphore::AVulkanTimelineSemaphore(AVulkanDevice* InDevice, uint64_t InitialValue) : Device(InDevice), Handle(VK_NULL_HANDLE)
+{
+    VkSemaphoreTypeCreateInfo TypeInfo;
+    ZeroVulkanStruct(TypeInfo, VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO);
+    TypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    TypeInfo.initialValue = InitialValue;
+
+    VkSemaphoreCreateInfo CreateInfo;
+    ZeroVulkanStruct(CreateInfo, VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO);
+    CreateInfo.pNext = &TypeInfo;
+    VK_CHECK_RESULT(VulkanApi::vkCreateSemaphore(Device->GetHandle(), &CreateInfo, VK_CPU_ALLOCATOR, &Handle));
+}
+
+AVulkanTimelineSemaphore::~AVulkanTimelineSemaphore()
+{
+    check(Waiters.IsEmpty(), "Timeline semaphore destroyed with pending waiters.");
+
+    VulkanApi::vkDestroySemaphore(Device->GetHandle(), Handle, VK_CPU_ALLOCATOR);
+    Handle = VK_NULL_HANDLE;
+}
+
+uint64_t AVulkanTimelineSemaphore::GetCompletedValue() const
+{
+    uint64_t Value = 0;
+    VK_CHECK_RESULT(VulkanApi::vkGetSemaphoreCounterValue(Device->GetHandle(), Handle, &Value));
+    return Value;
+}
+
+void AVulkanTimelineSemaphore::Signal(uint64_t Value)
+{
+    VkSemaphoreSignalInfo SignalInfo;
+    ZeroVulkanStruct(SignalInfo, VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO);
+    SignalInfo.semaphore = Handle;
+    SignalInfo.value = Value;
+    VK_CHECK_RESULT(VulkanApi::vkSignalSemaphore(Device->GetHandle(), &SignalInfo));
+}
+
+bool AVulkanTimelineSemaphore::WaitFor(uint64_t Value, uint64_t TimeInNanoseconds)
+{
+    VkSemaphoreWaitInfo WaitInfo;
+    ZeroVulkanStruct(WaitInfo, VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO);
+    WaitInfo.semaphoreCount = 1;
+    WaitInfo.pSemaphores = &Handle;
+    WaitInfo.pValues = &Value;
+
+    VkResult Result = VulkanApi::vkWaitSemaphores(Device->GetHandle(), &WaitInfo, TimeInNanoseconds);
+    switch (Result)
+    {
+    case VK_SUCCESS:
+        return true;
+    case VK_TIMEOUT:
+        break;
+    default:
+        VK_CHECK_RESULT(Result);
+        break;
+    }
+
+    return false;
+}
+
+void AVulkanTimelineSemaphore::AddWaiter(uint64_t Value, std::coroutine_handle<> Handle)
+{
+    std::lock_guard<std::mutex> Lock(WaitersMutex);
+    Waiters.Add(TPair<uint64_t, std::coroutine_handle<>>(Value, Handle));
+}
+
+uint32_t AVulkanTimelineSemaphore::ProcessWaiters()
+{
+    TArray<std::coroutine_handle<>> ReadyHandles;
+    {
+        std::lock_guard<std::mutex> Lock(WaitersMutex);
+        if (Waiters.IsEmpty())
+        {
+            return 0;
+        }
+
+        const uint64_t CompletedValue = GetCompletedValue();
+        for (int32_t Index = Waiters.Num() - 1; Index >= 0; --Index)
+        {
+            if (Waiters[Index].first <= CompletedValue)
+            {
+                ReadyHandles.Add(Waiters[Index].second);
+                Waiters.RemoveAt(Index);
+            }
+        }
+    }
+
+    // Resume outside the lock, the continuation may wait on this timeline again.
+    for (std::coroutine_handle<> Handle : ReadyHandles)
+    {
+        Handle.resume();
+    }
+    return static_cast<uint32_t>(ReadyHandles.Num());
+}
+
 ////////////////////////////////////////
 //            Vulkan Fence            //
 ////////////////////////////////////////
@@ -86,3 +186,82 @@ void AVulkanFence::Reset()
         State = AVulkanFence::EState::NotReady;
     }
 }
+
+////////////////////////////////////////
+//         Vulkan Memory Heap         //
+////////////////////////////////////////
+
+AVulkanMemoryHeap::AVulkanMemoryHeap(AVulkanDevice* InDevice, VkDeviceSize InSize, uint32_t InMemoryTypeIndex)
+    : Handle(VK_NULL_HANDLE), Size(InSize), MemoryTypeIndex(InMemoryTypeIndex), Device(InDevice)
+{
+    VkMemoryAllocateInfo AllocateInfo;
+    ZeroVulkanStruct(AllocateInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
+    AllocateInfo.allocationSize = Size;
+    AllocateInfo.memoryTypeIndex = MemoryTypeIndex;
+    VK_CHECK_RESULT(VulkanApi::vkAllocateMemory(Device->GetHandle(), &AllocateInfo, VK_CPU_ALLOCATOR, &Handle));
+}
+
+AVulkanMemoryHeap::~AVulkanMemoryHeap()
+{
+    VulkanApi::vkFreeMemory(Device->GetHandle(), Handle, VK_CPU_ALLOCATOR);
+}
+
+////////////////////////////////////////
+//         Vulkan Ring Buffer         //
+////////////////////////////////////////
+
+static constexpr uint64_t NumFramesToRetireRingBuffer = 3;
+
+AVulkanRingBuffer::AVulkanRingBuffer(AVulkanDevice* Device, VkDeviceSize Size, VkBufferUsageFlags Usage, VkDeviceSize InAlignment)
+    : Buffer(nullptr), Alignment(InAlignment), Head(0), TotalAllocated(0), TotalFreed(0), FrameNumber(0)
+{
+    check(Alignment != 0 && (Alignment & (Alignment - 1)) == 0, "Ring buffer alignment must be a power of two.");
+    Buffer = new AVulkanBuffer(Device, Size, Usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+AVulkanRingBuffer::~AVulkanRingBuffer()
+{
+    delete Buffer;
+    Buffer = nullptr;
+}
+
+VkDeviceSize AVulkanRingBuffer::Allocate(const void* Data, VkDeviceSize Size)
+{
+    const VkDeviceSize AlignedSize = (Size + Alignment - 1) & ~(Alignment - 1);
+
+    // An allocation never straddles the end, the tail is skipped instead.
+    VkDeviceSize Offset = Head;
+    VkDeviceSize Wasted = 0;
+    if (Offset + AlignedSize > Buffer->Size)
+    {
+        Wasted = Buffer->Size - Offset;
+        Offset = 0;
+    }
+
+    check(TotalAllocated + Wasted + AlignedSize - TotalFreed <= Buffer->Size, "Ring buffer overflow, too much data in flight.");
+    TotalAllocated += Wasted + AlignedSize;
+    Head = Offset + AlignedSize;
+
+    AMemory::Memcpy(Buffer->MappedData + Offset, Data, static_cast<size_t>(Size));
+    return Offset;
+}
+
+void AVulkanRingBuffer::EndFrame()
+{
+    FrameEnds.Add(TPair<uint64_t, uint64_t>(FrameNumber, TotalAllocated));
+    ++FrameNumber;
+
+    for (int32_t Index = FrameEnds.Num() - 1; Index >= 0; --Index)
+    {
+        if (FrameEnds[Index].first + NumFramesToRetireRingBuffer <= FrameNumber)
+        {
+            TotalFreed = std::max(TotalFreed, FrameEnds[Index].second);
+            FrameEnds.RemoveAt(Index);
+        }
+    }
+}
+
+VkBuffer AVulkanRingBuffer::GetHandle() const
+{
+    return Buffer->Buffer;
+}
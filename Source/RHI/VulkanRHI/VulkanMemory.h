@@ -2,8 +2,12 @@
 
 #include "VulkanApi.h"
 
+#include <coroutine>
+#include <mutex>
+
 class AVulkanDevice;
 class AVulkanFenceManager;
+struct AVulkanBuffer;
 
 class AVulkanSemaphore
 {
@@ -18,6 +22,48 @@ private:
     AVulkanDevice* Device;
 };
 
+class AVulkanTimelineSemaphore
+{
+public:
+    AVulkanTimelineSemaphore(AVulkanDevice* Device, uint64_t InitialValue = 0);
+    ~AVulkanTimelineSemaphore();
+
+    uint64_t GetCompletedValue() const;
+    bool IsCompleted(uint64_t Value) const { return GetCompletedValue() >= Value; }
+
+    void Signal(uint64_t Value);
+    bool WaitFor(uint64_t Value, uint64_t TimeInNanoseconds);
+
+    // Resumes the coroutines whose value has been reached, call once per frame from the render thread.
+    uint32_t ProcessWaiters();
+
+    // co_await Timeline->Wait(Value): suspends until the GPU reached Value, resumed by ProcessWaiters().
+    struct AAwaiter
+    {
+        AVulkanTimelineSemaphore* Owner;
+        uint64_t Value;
+
+        bool await_ready() const { return Owner->IsCompleted(Value); }
+        void await_suspend(std::coroutine_handle<> Handle) { Owner->AddWaiter(Value, Handle); }
+        void await_resume() const noexcept { }
+    };
+
+    AAwaiter Wait(uint64_t Value) { return AAwaiter{ this, Value }; }
+
+    inline VkSemaphore GetHandle() const { return Handle; }
+
+private:
+    void AddWaiter(uint64_t Value, std::coroutine_handle<> Handle);
+
+private:
+    VkSemaphore Handle;
+
+    std::mutex WaitersMutex;
+    TArray<TPair<uint64_t, std::coroutine_handle<>>> Waiters;
+
+    AVulkanDevice* Device;
+};
+
 class AVulkanFence
 {
 public:
@@ -46,3 +92,51 @@ private:
 
     friend AVulkanFenceManager;
 };
+
+// Device memory that images are placed in at explicit offsets, see AVulkanTexture::BindMemory(). Lets
+// resources that are never alive at the same time share the same range.
+class AVulkanMemoryHeap
+{
+public:
+    AVulkanMemoryHeap(AVulkanDevice* Device, VkDeviceSize Size, uint32_t MemoryTypeIndex);
+    ~AVulkanMemoryHeap();
+
+    inline VkDeviceMemory GetHandle() const { return Handle; }
+    inline VkDeviceSize GetSize() const { return Size; }
+    inline uint32_t GetMemoryTypeIndex() const { return MemoryTypeIndex; }
+
+private:
+    VkDeviceMemory Handle;
+    VkDeviceSize Size;
+    uint32_t MemoryTypeIndex;
+
+    AVulkanDevice* Device;
+};
+
+// Host visible buffer for data written once by the CPU and read by the GPU in the same frame. Allocations are
+// carved linearly and wrap around, space is reclaimed once the frame that wrote it can no longer be in flight.
+class AVulkanRingBuffer
+{
+public:
+    AVulkanRingBuffer(AVulkanDevice* Device, VkDeviceSize Size, VkBufferUsageFlags Usage, VkDeviceSize Alignment);
+    ~AVulkanRingBuffer();
+
+    // Copies Size bytes into the ring and returns their offset, valid until the end of the frame.
+    VkDeviceSize Allocate(const void* Data, VkDeviceSize Size);
+
+    void EndFrame();
+
+    VkBuffer GetHandle() const;
+
+private:
+    AVulkanBuffer* Buffer;
+    VkDeviceSize Alignment;
+    VkDeviceSize Head;
+
+    // Monotonic byte counts, wasted space at the end of a wrap included.
+    uint64_t TotalAllocated;
+    uint64_t TotalFreed;
+    // TotalAllocated at the end of each frame still in flight, oldest first.
+    TArray<TPair<uint64_t, uint64_t>> FrameEnds;
+    uint64_t FrameNumber;
+};
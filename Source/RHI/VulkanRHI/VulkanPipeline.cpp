@@ -1,292 +1,1978 @@
 #include "VulkanPipeline.h"
 
 #include "VulkanDevice.h"
+#include "VulkanDescriptorSets.h"
 #include "VulkanCommandBuffer.h"
 #include "VulkanResources.h"
 
-#define SHADER_PATH(NAME) ((std::string(SHADER_DIR) + std::string(NAME)).data())
+#include <chrono>
+#include <filesystem>
 
-AVulkanShaderManager::AVulkanShaderManager(AVulkanDevice* InDevice) : Device(InDevice) { }
+static constexpr uint32_t PipelineCacheFileMagic = 0x43505256; // "VRPC"
+static constexpr uint32_t PipelineCacheFileVersion = 1;
+
+static constexpr uint32_t PipelineManifestFileMagic = 0x4d4f5350; // "PSOM"
+// 2: shaders keyed by content hash, full stencil, depth bounds and blend constant state.
+static constexpr uint32_t PipelineManifestFileVersion = 2;
+
+static constexpr uint64_t NumFramesToRetirePipeline = 3;
+
+AVulkanShaderManager::AVulkanShaderManager(AVulkanDevice* InDevice)
+    : NumRequests(0), NumPathHits(0), NumContentHits(0), NumModulesCreated(0), NumBytesRead(0), Device(InDevice)
+{
+}
 
 AVulkanShaderManager::~AVulkanShaderManager()
 {
+    LogStats();
+
     for (auto& [Hash, Module] : ShaderModules)
     {
-        VulkanApi::vkDestroyShaderModule(Device->GetHandle(), Module, VK_CPU_ALLOCATOR);
-        Module = VK_NULL_HANDLE;
+        VulkanApi::vkDestroyShaderModule(Device->GetHandle(), Module.Handle, VK_CPU_ALLOCATOR);
+        Module.Handle = VK_NULL_HANDLE;
+        delete Module.Reflection;
+        Module.Reflection = nullptr;
+    }
+
+    for (auto& [Hash, Layouts] : PipelineLayouts)
+    {
+        for (AVulkanPipelineLayout* Layout : Layouts)
+        {
+            VulkanApi::vkDestroyPipelineLayout(Device->GetHandle(), Layout->Handle, VK_CPU_ALLOCATOR);
+            delete Layout;
+        }
+    }
+    for (auto& [Hash, SetLayouts] : DescriptorSetLayouts)
+    {
+        for (ADescriptorSetLayout& SetLayout : SetLayouts)
+        {
+            VulkanApi::vkDestroyDescriptorSetLayout(Device->GetHandle(), SetLayout.Handle, VK_CPU_ALLOCATOR);
+        }
+    }
+}
+
+bool AVulkanShaderManager::MountPackage(const AString& Filename, const AString& Root)
+{
+    if (!Package.Mount(Filename.c_str()))
+    {
+        std::cout << "[INFO] No shader package at " << Filename << ", loading loose shader files.\n";
+        return false;
     }
+
+    PackageRoot = Root;
+    std::cout << "[INFO] Mounted shader package " << Filename << " with " << Package.GetNumEntries() << " shaders.\n";
+    return true;
 }
 
-TArray<uint32_t> AVulkanShaderManager::ReadSpirv(const AnsiChar* Spirv)
+bool AVulkanShaderManager::ReadSpirv(const AnsiChar* Spirv, TArray<uint32_t>& OutCode)
 {
     std::ifstream ShaderFile(Spirv, std::ios::ate | std::ios::binary);
-    if (ShaderFile.is_open())
+    if (!ShaderFile.is_open())
+    {
+        return false;
+    }
+
+    // Read straight into the word array handed to vkCreateShaderModule.
+    const size_t FileSize = static_cast<size_t>(ShaderFile.tellg());
+    if (FileSize == 0 || FileSize % sizeof(uint32_t) != 0)
+    {
+        std::cerr << "[WARNING] " << Spirv << " is not a valid SPIR-V file.\n";
+        return false;
+    }
+
+    OutCode.Resize(static_cast<int32_t>(FileSize / sizeof(uint32_t)));
+    ShaderFile.seekg(0);
+    ShaderFile.read(reinterpret_cast<AnsiChar*>(OutCode.GetData()), FileSize);
+    return static_cast<bool>(ShaderFile);
+}
+
+const APackage::AEntry* AVulkanShaderManager::FindPackageEntry(const AString& Spirv) const
+{
+    if (!Package.IsMounted() || Spirv.compare(0, PackageRoot.size(), PackageRoot) != 0)
     {
-        int32_t FileSize = static_cast<int32_t>(ShaderFile.tellg());
-        TArray<AnsiChar> Buffer(FileSize);
+        return nullptr;
+    }
+    return Package.FindEntry(std::string_view(Spirv).substr(PackageRoot.size()));
+}
 
-        ShaderFile.seekg(0);
-        ShaderFile.read(Buffer.GetData(), FileSize);
-        ShaderFile.close();
+VkShaderModule AVulkanShaderManager::FindShader(uint64_t PathHash)
+{
+    std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+    ++NumRequests;
 
-        return TArray<uint32_t>(reinterpret_cast<uint32_t*>(Buffer.GetData()), FileSize / sizeof(uint32_t));
+    const uint64_t* ContentHash = ContentHashes.Find(PathHash);
+    AShaderModule* FoundShaderModule = ContentHash ? ShaderModules.Find(*ContentHash) : nullptr;
+    if (!FoundShaderModule)
+    {
+        return VK_NULL_HANDLE;
     }
-    return TArray<uint32_t>();
+
+    ++NumPathHits;
+    ++FoundShaderModule->RefCount;
+    return FoundShaderModule->Handle;
 }
 
-VkShaderModule AVulkanShaderManager::GetOrCreateShader(const AnsiChar* Spirv)
+VkShaderModule AVulkanShaderManager::FindShaderByContent(uint64_t PathHash, uint64_t ContentHash)
 {
-    uint64_t SpirvHash = static_cast<uint64_t>(std::hash<const AnsiChar*>()(Spirv));
-    VkShaderModule* FoundShaderModule = ShaderModules.Find(SpirvHash);
-    if (FoundShaderModule)
+    std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+    ContentHashes[PathHash] = ContentHash;
+
+    AShaderModule* FoundShaderModule = ShaderModules.Find(ContentHash);
+    if (!FoundShaderModule)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    // Same code under another path, or loaded by another thread in the meantime.
+    ++NumContentHits;
+    ++FoundShaderModule->RefCount;
+    return FoundShaderModule->Handle;
+}
+
+VkShaderModule AVulkanShaderManager::LoadShader(uint64_t PathHash, const AString& Spirv)
+{
+    if (const APackage::AEntry* Entry = FindPackageEntry(Spirv))
+    {
+        // The table of contents already holds the content hash, shared code is not even decompressed.
+        if (VkShaderModule FoundShaderModule = FindShaderByContent(PathHash, Entry->ContentHash))
+        {
+            return FoundShaderModule;
+        }
+
+        if (Entry->Compression == APackageFormat::ECompression::None)
+        {
+            const uint32_t* MappedCode = reinterpret_cast<const uint32_t*>(Package.GetData(*Entry));
+            return CreateShader(Entry->ContentHash, MappedCode, Entry->UncompressedSize);
+        }
+
+        TArray<uint32_t> SpirvCode(static_cast<int32_t>((Entry->UncompressedSize + sizeof(uint32_t) - 1) / sizeof(uint32_t)));
+        if (!Package.Read(*Entry, SpirvCode.GetData()))
+        {
+            std::cerr << "[WARNING] Failed to decompress shader " << Spirv << " from the package.\n";
+            return VK_NULL_HANDLE;
+        }
+        return CreateShader(Entry->ContentHash, SpirvCode.GetData(), Entry->UncompressedSize);
+    }
+
+    TArray<uint32_t> SpirvCode;
+    if (!ReadSpirv(Spirv.c_str(), SpirvCode) || SpirvCode.IsEmpty())
+    {
+        std::cerr << "[WARNING] Failed to read shader " << Spirv << ".\n";
+        return VK_NULL_HANDLE;
+    }
+
+    const size_t CodeSize = SpirvCode.Num() * sizeof(uint32_t);
+    const uint64_t ContentHash = AHash::XXH64(SpirvCode.GetData(), CodeSize);
+    if (VkShaderModule FoundShaderModule = FindShaderByContent(PathHash, ContentHash))
     {
-        return *FoundShaderModule;
+        return FoundShaderModule;
     }
+    return CreateShader(ContentHash, SpirvCode.GetData(), CodeSize);
+}
 
-    TArray<uint32_t>& SpirvCode = ReadSpirv(Spirv);
+VkShaderModule AVulkanShaderManager::CreateShader(uint64_t ContentHash, const uint32_t* SpirvCode, size_t CodeSize)
+{
+    AVulkanShaderReflection* Reflection = new AVulkanShaderReflection();
+    if (!AVulkanShaderReflection::Parse(SpirvCode, CodeSize, *Reflection))
+    {
+        std::cerr << "[WARNING] Failed to reflect shader " << std::hex << ContentHash << std::dec << ", assuming it uses no resources.\n";
+    }
 
     VkShaderModuleCreateInfo ShaderModuleInfo;
     ZeroVulkanStruct(ShaderModuleInfo, VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO);
-    ShaderModuleInfo.codeSize = SpirvCode.Num() * sizeof(uint32_t);
-    ShaderModuleInfo.pCode = SpirvCode.GetData();
+    ShaderModuleInfo.codeSize = CodeSize;
+    ShaderModuleInfo.pCode = SpirvCode;
 
     VkShaderModule ShaderModule;
     VK_CHECK_RESULT(VulkanApi::vkCreateShaderModule(Device->GetHandle(), &ShaderModuleInfo, VK_CPU_ALLOCATOR, &ShaderModule));
 
-    ShaderModules.Add(SpirvHash, ShaderModule);
+    std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+    if (AShaderModule* FoundShaderModule = ShaderModules.Find(ContentHash))
+    {
+        // Another thread created the same module in the meantime.
+        VulkanApi::vkDestroyShaderModule(Device->GetHandle(), ShaderModule, VK_CPU_ALLOCATOR);
+        delete Reflection;
+        ++NumContentHits;
+        ++FoundShaderModule->RefCount;
+        return FoundShaderModule->Handle;
+    }
+
+    ShaderModules.Add(ContentHash, AShaderModule{ ShaderModule, 1, static_cast<uint32_t>(CodeSize), Reflection });
+    ModuleContentHashes.Add(ShaderModule, ContentHash);
+    ++NumModulesCreated;
+    NumBytesRead += CodeSize;
     return ShaderModule;
 }
 
-AVulkanGraphicsPipelineState::AVulkanGraphicsPipelineState(AVulkanDevice* InDevice, const AVulkanGraphicsPipelineDesc& InDesc)
-    : Device(InDevice), Desc(InDesc), Pipeline(VK_NULL_HANDLE), Layout(VK_NULL_HANDLE), RenderPass(nullptr)
+uint64_t AVulkanShaderManager::GetContentHash(const AString& Spirv)
+{
+    const uint64_t PathHash = AHash::XXH64(Spirv);
+    {
+        std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+        if (const uint64_t* ContentHash = ContentHashes.Find(PathHash))
+        {
+            return *ContentHash;
+        }
+    }
+
+    // Same hash LoadShader() computes, packaged shaders already store it.
+    uint64_t ContentHash = 0;
+    if (const APackage::AEntry* Entry = FindPackageEntry(Spirv))
+    {
+        ContentHash = Entry->ContentHash;
+    }
+    else
+    {
+        TArray<uint32_t> SpirvCode;
+        if (ReadSpirv(Spirv.c_str(), SpirvCode) && !SpirvCode.IsEmpty())
+        {
+            ContentHash = AHash::XXH64(SpirvCode.GetData(), SpirvCode.Num() * sizeof(uint32_t));
+        }
+    }
+
+    if (ContentHash != 0)
+    {
+        std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+        ContentHashes[PathHash] = ContentHash;
+    }
+    return ContentHash;
+}
+
+VkShaderModule AVulkanShaderManager::GetOrCreateShader(const AnsiChar* Spirv)
 {
-    ShaderModules[ShaderStage::Vertex] = VK_NULL_HANDLE;
-    ShaderModules[ShaderStage::Pixel] = VK_NULL_HANDLE;
+    const uint64_t PathHash = AHash::XXH64(Spirv);
+    if (VkShaderModule FoundShaderModule = FindShader(PathHash))
+    {
+        return FoundShaderModule;
+    }
+    return LoadShader(PathHash, Spirv);
 }
 
-AVulkanGraphicsPipelineState::~AVulkanGraphicsPipelineState()
+TTask<VkShaderModule> AVulkanShaderManager::GetOrCreateShaderAsync(AString Spirv)
 {
-    VulkanApi::vkDestroyPipeline(Device->GetHandle(), Pipeline, nullptr);
-    Pipeline = VK_NULL_HANDLE;
+    const uint64_t PathHash = AHash::XXH64(Spirv);
+    if (VkShaderModule FoundShaderModule = FindShader(PathHash))
+    {
+        co_return FoundShaderModule;
+    }
 
-    VulkanApi::vkDestroyPipelineLayout(Device->GetHandle(), Layout, nullptr);
-    Layout = VK_NULL_HANDLE;
+    co_await AJobSystem::Get().ResumeOnWorker();
+    co_return LoadShader(PathHash, Spirv);
 }
 
-void AVulkanGraphicsPipelineState::FindOrCreateShaderModules()
+void AVulkanShaderManager::ReleaseShader(VkShaderModule ShaderModule)
 {
-    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+    const uint64_t* ContentHash = ModuleContentHashes.Find(ShaderModule);
+    check(ContentHash, "Releasing an unknown shader module.");
+
+    AShaderModule* FoundShaderModule = ShaderModules.Find(*ContentHash);
+    check(FoundShaderModule && FoundShaderModule->RefCount > 0, "Shader module released too often.");
+    --FoundShaderModule->RefCount;
+}
+
+uint32_t AVulkanShaderManager::ReleaseUnusedShaders()
+{
+    std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+
+    TArray<uint64_t> UnusedHashes;
+    for (auto& [ContentHash, Module] : ShaderModules)
     {
-        if (const AnsiChar* Spirv = Desc.Spirvs[Index]; Spirv)
+        if (Module.RefCount == 0)
         {
-            AVulkanShaderManager* ShaderMgr = Device->GetShaderManager();
-            ShaderModules[Index] = ShaderMgr->GetOrCreateShader(Spirv);
+            UnusedHashes.Add(ContentHash);
         }
     }
+
+    for (uint64_t ContentHash : UnusedHashes)
+    {
+        AShaderModule Module = *ShaderModules.Find(ContentHash);
+        VulkanApi::vkDestroyShaderModule(Device->GetHandle(), Module.Handle, VK_CPU_ALLOCATOR);
+        delete Module.Reflection;
+        ModuleContentHashes.Remove(Module.Handle);
+        ShaderModules.Remove(ContentHash);
+    }
+
+    return static_cast<uint32_t>(UnusedHashes.Num());
 }
 
-void AVulkanGraphicsPipelineState::Bind(AVulkanCommandBuffer* CmdBuffer)
+const AVulkanShaderReflection* AVulkanShaderManager::FindReflection(VkShaderModule ShaderModule)
 {
-    VulkanApi::vkCmdBindPipeline(CmdBuffer->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+    std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+    const uint64_t* ContentHash = ModuleContentHashes.Find(ShaderModule);
+    const AShaderModule* FoundShaderModule = ContentHash ? ShaderModules.Find(*ContentHash) : nullptr;
+    return FoundShaderModule ? FoundShaderModule->Reflection : nullptr;
 }
 
-AVulkanPipelineStateManager::AVulkanPipelineStateManager(AVulkanDevice* InDevice) : Device(InDevice) { }
-
-AVulkanPipelineStateManager::~AVulkanPipelineStateManager()
+const AVulkanPipelineLayout* AVulkanShaderManager::GetOrCreatePipelineLayout(const VkShaderModule* InShaderModules, uint32_t NumShaderModules)
 {
-    for (auto& [Hash, PSO] : GraphicsPSOMap)
+    AVulkanPipelineLayout Merged;
+    Merged.Handle = VK_NULL_HANDLE;
+    Merged.NumSetLayouts = 0;
+    AMemory::Memzero(Merged.SetLayouts);
+    AMemory::Memzero(Merged.PushConstantRange);
+    Merged.bBindless = false;
+    Merged.bDynamicDrawData = false;
+
+    uint32_t PushConstantEnd = 0;
+    bool bDeclaresDrawData = false;
+    for (uint32_t Index = 0; Index < NumShaderModules; ++Index)
     {
-        delete PSO;
-        PSO = nullptr;
+        const AVulkanShaderReflection* Reflection = InShaderModules[Index] != VK_NULL_HANDLE ? FindReflection(InShaderModules[Index]) : nullptr;
+        if (!Reflection)
+        {
+            continue;
+        }
+
+        for (const AVulkanShaderReflection::ABinding& Binding : Reflection->Bindings)
+        {
+            check(Binding.Set < MaxDescriptorSets, "Shader uses too many descriptor sets.");
+            bDeclaresDrawData = bDeclaresDrawData || (Binding.bDrawData && Binding.Set == AVulkanPipelineLayout::DrawDataSetIndex && Binding.Binding == 0);
+            Merged.NumSetLayouts = std::max(Merged.NumSetLayouts, Binding.Set + 1);
+
+            TArray<AVulkanPipelineLayout::ABinding>& SetBindings = Merged.SetBindings[Binding.Set];
+            auto Found = std::find_if(SetBindings.begin(), SetBindings.end(),
+                [&Binding](const AVulkanPipelineLayout::ABinding& Other) { return Other.Binding == Binding.Binding; });
+            if (Found != SetBindings.end())
+            {
+                check(Found->Type == Binding.Type, "Stages declare the same binding with different descriptor types.");
+                Found->Count = std::max(Found->Count, Binding.Count);
+                Found->StageFlags |= Reflection->Stage;
+            }
+            else
+            {
+                SetBindings.Add(
+                    AVulkanPipelineLayout::ABinding{ Binding.Binding, Binding.Type, Binding.Count, static_cast<VkShaderStageFlags>(Reflection->Stage) });
+            }
+        }
+
+        // One range visible to every stage using push constants keeps binding them a single call.
+        if (Reflection->PushConstantSize != 0)
+        {
+            const uint32_t Offset = Merged.PushConstantRange.size ? std::min(Merged.PushConstantRange.offset, Reflection->PushConstantOffset)
+                                                                 : Reflection->PushConstantOffset;
+            PushConstantEnd = std::max(PushConstantEnd, Reflection->PushConstantOffset + Reflection->PushConstantSize);
+            Merged.PushConstantRange.offset = Offset;
+            Merged.PushConstantRange.size = PushConstantEnd - Offset;
+            Merged.PushConstantRange.stageFlags |= Reflection->Stage;
+        }
+    }
+
+    std::lock_guard<std::mutex> Lock(LayoutsMutex);
+
+    // Unused sets below the highest one get an empty layout.
+    for (uint32_t Set = 0; Set < Merged.NumSetLayouts; ++Set)
+    {
+        std::sort(Merged.SetBindings[Set].begin(), Merged.SetBindings[Set].end(),
+            [](const AVulkanPipelineLayout::ABinding& A, const AVulkanPipelineLayout::ABinding& B) { return A.Binding < B.Binding; });
+
+        // Shaders declare the heap bindings they read, every pipeline shares the heap's full layout.
+        AVulkanBindlessHeap* BindlessHeap = Device->GetBindlessHeap();
+        if (Set == AVulkanBindlessHeap::BindlessSetIndex && BindlessHeap && !Merged.SetBindings[Set].IsEmpty())
+        {
+            static const VkDescriptorType HeapTypes[AVulkanBindlessHeap::NumBindings] = {
+                VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                VK_DESCRIPTOR_TYPE_SAMPLER,
+            };
+            for (const AVulkanPipelineLayout::ABinding& Binding : Merged.SetBindings[Set])
+            {
+                check(Binding.Binding < AVulkanBindlessHeap::NumBindings && Binding.Type == HeapTypes[Binding.Binding],
+                    "Shader binding does not match the bindless heap layout.");
+            }
+
+            Merged.SetLayouts[Set] = BindlessHeap->GetLayout();
+            Merged.bBindless = true;
+            continue;
+        }
+
+        TArray<AVulkanPipelineLayout::ABinding>& SetBindings = Merged.SetBindings[Set];
+        if (bDeclaresDrawData && Set == AVulkanPipelineLayout::DrawDataSetIndex && SetBindings.Num() == 1 && SetBindings[0].Binding == 0 &&
+            SetBindings[0].Type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER)
+        {
+            SetBindings[0].Type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            Merged.bDynamicDrawData = true;
+        }
+
+        Merged.SetLayouts[Set] = GetOrCreateDescriptorSetLayout(SetBindings);
+    }
+
+    // Set layouts are unique per binding list, so the handles identify the layout.
+    uint64_t Hash = AHash::XXH64(Merged.SetLayouts, sizeof(Merged.SetLayouts[0]) * Merged.NumSetLayouts);
+    Hash = AHash::Combine(Hash, AHash::Memory(Merged.PushConstantRange));
+
+    TArray<AVulkanPipelineLayout*>& Layouts = PipelineLayouts[Hash];
+    for (AVulkanPipelineLayout* Layout : Layouts)
+    {
+        if (Layout->NumSetLayouts == Merged.NumSetLayouts &&
+            AMemory::Memcmp(Layout->SetLayouts, Merged.SetLayouts, sizeof(Merged.SetLayouts[0]) * Merged.NumSetLayouts) == 0 &&
+            AMemory::Memcmp(&Layout->PushConstantRange, &Merged.PushConstantRange, sizeof(Merged.PushConstantRange)) == 0)
+        {
+            return Layout;
+        }
     }
+
+    VkPipelineLayoutCreateInfo PipelineLayoutInfo;
+    ZeroVulkanStruct(PipelineLayoutInfo, VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO);
+    PipelineLayoutInfo.setLayoutCount = Merged.NumSetLayouts;
+    PipelineLayoutInfo.pSetLayouts = Merged.SetLayouts;
+    PipelineLayoutInfo.pushConstantRangeCount = Merged.PushConstantRange.size ? 1 : 0;
+    PipelineLayoutInfo.pPushConstantRanges = &Merged.PushConstantRange;
+    VK_CHECK_RESULT(VulkanApi::vkCreatePipelineLayout(Device->GetHandle(), &PipelineLayoutInfo, VK_CPU_ALLOCATOR, &Merged.Handle));
+
+    AVulkanPipelineLayout* Layout = new AVulkanPipelineLayout(std::move(Merged));
+    Layouts.Add(Layout);
+    return Layout;
 }
 
-AVulkanGraphicsPipelineState* AVulkanPipelineStateManager::CreateGraphicsPipelineState(AVulkanRenderPass* RenderPass)
+VkDescriptorSetLayout AVulkanShaderManager::GetOrCreateDescriptorSetLayout(const TArray<AVulkanPipelineLayout::ABinding>& Bindings)
 {
-    if (AVulkanGraphicsPipelineState** FoundPSO = GraphicsPSOMap.Find(0))
+    const size_t BindingsSize = sizeof(AVulkanPipelineLayout::ABinding) * Bindings.Num();
+    const uint64_t Hash = AHash::XXH64(Bindings.GetData(), BindingsSize);
+
+    TArray<ADescriptorSetLayout>& SetLayouts = DescriptorSetLayouts[Hash];
+    for (const ADescriptorSetLayout& SetLayout : SetLayouts)
     {
-        return *FoundPSO;
+        if (SetLayout.Bindings.Num() == Bindings.Num() && AMemory::Memcmp(SetLayout.Bindings.GetData(), Bindings.GetData(), BindingsSize) == 0)
+        {
+            return SetLayout.Handle;
+        }
     }
 
-    AVulkanGraphicsPipelineDesc Desc;
-    AMemory::Memzero(Desc);
-    Desc.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    Desc.SubpassIndex = 0;
-    Desc.Spirvs[ShaderStage::Vertex] = "E:/_Project/Git_Project/Renderer/Shaders/Compiled/VertShaderBase_vert.spv";
-    Desc.Spirvs[ShaderStage::Pixel] = "E:/_Project/Git_Project/Renderer/Shaders/Compiled/FragShaderBase_frag.spv";
+    TArray<VkDescriptorSetLayoutBinding> LayoutBindings(Bindings.Num());
+    for (int32_t Index = 0; Index < Bindings.Num(); ++Index)
+    {
+        AMemory::Memzero(LayoutBindings[Index]);
+        LayoutBindings[Index].binding = Bindings[Index].Binding;
+        LayoutBindings[Index].descriptorType = Bindings[Index].Type;
+        LayoutBindings[Index].descriptorCount = Bindings[Index].Count;
+        LayoutBindings[Index].stageFlags = Bindings[Index].StageFlags;
+    }
 
-    AVulkanGraphicsPipelineState* PSO = new AVulkanGraphicsPipelineState(Device, Desc);
-    PSO->RenderPass = RenderPass;
+    VkDescriptorSetLayoutCreateInfo SetLayoutInfo;
+    ZeroVulkanStruct(SetLayoutInfo, VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO);
+    SetLayoutInfo.bindingCount = static_cast<uint32_t>(LayoutBindings.Num());
+    SetLayoutInfo.pBindings = LayoutBindings.GetData();
 
-    VkPipelineLayoutCreateInfo PipelineLayoutInfo = {};
-    ZeroVulkanStruct(PipelineLayoutInfo, VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO);
-    PipelineLayoutInfo.setLayoutCount = 0;
-    PipelineLayoutInfo.pushConstantRangeCount = 0;
-    VK_CHECK_RESULT(VulkanApi::vkCreatePipelineLayout(Device->GetHandle(), &PipelineLayoutInfo, VK_CPU_ALLOCATOR, &PSO->Layout));
+    ADescriptorSetLayout SetLayout;
+    SetLayout.Bindings = Bindings;
+    VK_CHECK_RESULT(VulkanApi::vkCreateDescriptorSetLayout(Device->GetHandle(), &SetLayoutInfo, VK_CPU_ALLOCATOR, &SetLayout.Handle));
+    SetLayouts.Add(SetLayout);
 
-    CreateGraphicsPipeline(PSO);
-    GraphicsPSOMap.Add(0, PSO);
+    return SetLayout.Handle;
+}
 
-    return PSO;
+void AVulkanShaderManager::LogStats()
+{
+    std::lock_guard<std::mutex> Lock(ShaderModulesMutex);
+    std::cout << "[INFO] Shader modules: " << NumRequests << " requests, " << NumPathHits << " path hits, " << NumContentHits
+              << " deduplicated by content, " << NumModulesCreated << " created, " << NumBytesRead << " bytes of SPIR-V loaded.\n";
 }
 
-bool AVulkanPipelineStateManager::CreateGraphicsPipeline(AVulkanGraphicsPipelineState* PSO)
+AVulkanPipelineCache::AVulkanPipelineCache(AVulkanDevice* InDevice)
+    : Handle(VK_NULL_HANDLE), NumPipelines(0), NumCacheHits(0), TotalCompileTimeUs(0), Device(InDevice)
 {
-    const AVulkanGraphicsPipelineDesc& GraphicsDesc = PSO->Desc;
+}
 
-    PSO->FindOrCreateShaderModules();
+AVulkanPipelineCache::~AVulkanPipelineCache()
+{
+    LogStats();
 
-    // Color blend
-    // VkPipelineColorBlendAttachmentState BlendStates[MaxSimultaneousRenderTargets];
-    // AMemory::Memzero(BlendStates);
-    // uint32_t ColorWriteMask = 0xffffffff;
-    // if (Shaders[EShaderStage::Pixel])
-    // {
-    //  ColorWriteMask = Shaders[EShaderStage::Pixel]->CodeHeader.InOutMask;
-    // }
-    // for (int32_t Index = 0; Index < GraphicsDesc.ColorAttachmentStates.Num(); ++Index)
-    // {
-    //    GraphicsDesc.ColorAttachmentStates[Index].WriteInto(BlendStates[Index]);
-    //
-    //    if (0 == (ColorWriteMask & 1)) // clear write mask of rendertargets not written by pixelshader.
-    //    {
-    //        BlendStates[Index].colorWriteMask = 0;
-    //    }
-    //    ColorWriteMask >>= 1;
-    // }
-    //
-    // VkPipelineColorBlendStateCreateInfo ColorBlendingInfo;
-    // ZeroVulkanStruct(ColorBlendingInfo, VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO);
-    // ColorBlendingInfo.attachmentCount = GraphicsDesc.ColorAttachmentStates.Num();
-    // ColorBlendingInfo.pAttachments = BlendStates;
-    // ColorBlendingInfo.blendConstants[0] = 1.0f;
-    // ColorBlendingInfo.blendConstants[1] = 1.0f;
-    // ColorBlendingInfo.blendConstants[2] = 1.0f;
-    // ColorBlendingInfo.blendConstants[3] = 1.0f;
-
-    VkPipelineColorBlendAttachmentState ColorBlendAttachment;
-    AMemory::Memzero(ColorBlendAttachment);
-    ColorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    ColorBlendAttachment.blendEnable = VK_FALSE;
+    VulkanApi::vkDestroyPipelineCache(Device->GetHandle(), Handle, VK_CPU_ALLOCATOR);
+    Handle = VK_NULL_HANDLE;
+}
 
-    VkPipelineColorBlendStateCreateInfo ColorBlendingInfo;
-    ZeroVulkanStruct(ColorBlendingInfo, VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO);
-    ColorBlendingInfo.logicOpEnable = VK_FALSE;
-    ColorBlendingInfo.logicOp = VK_LOGIC_OP_COPY;
-    ColorBlendingInfo.attachmentCount = 1;
-    ColorBlendingInfo.pAttachments = &ColorBlendAttachment;
-    ColorBlendingInfo.blendConstants[0] = 0.0f;
-    ColorBlendingInfo.blendConstants[1] = 0.0f;
-    ColorBlendingInfo.blendConstants[2] = 0.0f;
-    ColorBlendingInfo.blendConstants[3] = 0.0f;
-
-    // Viewport
-    VkPipelineViewportStateCreateInfo ViewportInfo;
-    ZeroVulkanStruct(ViewportInfo, VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO);
-    ViewportInfo.viewportCount = 1;
-    ViewportInfo.scissorCount = 1;
+void AVulkanPipelineCache::FillFileHeader(AFileHeader& OutHeader) const
+{
+    const VkPhysicalDeviceProperties GpuProps = Device->GetPhysicalDeviceProperties();
+    const VkPhysicalDeviceIDProperties& GpuIdProps = Device->GetPhysicalDeviceIDProperties();
 
-    // Multisample
-    VkPipelineMultisampleStateCreateInfo MultisamplingInfo;
-    ZeroVulkanStruct(MultisamplingInfo, VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO);
-    MultisamplingInfo.sampleShadingEnable = VK_FALSE;
-    MultisamplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    // MultisamplingInfo.rasterizationSamples = (VkSampleCountFlagBits)std::max<uint16>(1u, GraphicsDesc.RasterizationSamples);
-    // MultisamplingInfo.alphaToCoverageEnable = GraphicsDesc.UseAlphaToCoverage;
+    AMemory::Memzero(OutHeader);
+    OutHeader.Magic = PipelineCacheFileMagic;
+    OutHeader.Version = PipelineCacheFileVersion;
+    OutHeader.VendorID = GpuProps.vendorID;
+    OutHeader.DeviceID = GpuProps.deviceID;
+    OutHeader.DriverVersion = GpuProps.driverVersion;
+    AMemory::Memcpy(OutHeader.DriverUUID, GpuIdProps.driverUUID, VK_UUID_SIZE);
+    AMemory::Memcpy(OutHeader.PipelineCacheUUID, GpuProps.pipelineCacheUUID, VK_UUID_SIZE);
+}
 
-    // Shader stages.
-    uint32_t ShaderStageCount = 0;
-    VkPipelineShaderStageCreateInfo ShaderStagesInfo[ShaderStage::NumStages];
-    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+bool AVulkanPipelineCache::ValidateCacheData(const AFileHeader& Header, const TArray<uint8_t>& Data) const
+{
+    AFileHeader Expected;
+    FillFileHeader(Expected);
+
+    if (Header.Magic != Expected.Magic || Header.Version != Expected.Version)
+    {
+        std::cerr << "[WARNING] Pipeline cache: unknown file format.\n";
+        return false;
+    }
+    if (Header.VendorID != Expected.VendorID || Header.DeviceID != Expected.DeviceID)
+    {
+        std::cout << "[INFO] Pipeline cache: written by another GPU, discarded.\n";
+        return false;
+    }
+    if (Header.DriverVersion != Expected.DriverVersion || AMemory::Memcmp(Header.DriverUUID, Expected.DriverUUID, VK_UUID_SIZE) != 0)
+    {
+        std::cout << "[INFO] Pipeline cache: written by another driver, discarded.\n";
+        return false;
+    }
+    if (Header.DataSize != (uint64_t)Data.Num() || Header.DataHash != AHash::XXH64(Data.GetData(), Data.Num()))
+    {
+        std::cerr << "[WARNING] Pipeline cache: file is truncated or corrupted.\n";
+        return false;
+    }
+
+    // The driver validates its own header as well, but rejecting early avoids handing it foreign blobs.
+    VkPipelineCacheHeaderVersionOne CacheHeader;
+    if (Data.Num() < (int32_t)sizeof(CacheHeader))
+    {
+        return false;
+    }
+    AMemory::Memcpy(&CacheHeader, Data.GetData(), sizeof(CacheHeader));
+    if (CacheHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || CacheHeader.vendorID != Expected.VendorID ||
+        CacheHeader.deviceID != Expected.DeviceID || AMemory::Memcmp(CacheHeader.pipelineCacheUUID, Expected.PipelineCacheUUID, VK_UUID_SIZE) != 0)
+    {
+        std::cout << "[INFO] Pipeline cache: pipeline cache UUID mismatch, discarded.\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool AVulkanPipelineCache::Load(const AString& Filename)
+{
+    using Clock = std::chrono::steady_clock;
+    auto LoadStart = Clock::now();
+
+    TArray<uint8_t> Data;
+    std::ifstream CacheFile(Filename, std::ios::ate | std::ios::binary);
+    if (CacheFile.is_open())
     {
-        VkPipelineShaderStageCreateInfo& StageInfo = ShaderStagesInfo[Index];
-        ZeroVulkanStruct(StageInfo, VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO);
-        if (PSO->ShaderModules[Index] == VK_NULL_HANDLE)
+        const int64_t FileSize = static_cast<int64_t>(CacheFile.tellg());
+        AFileHeader Header;
+        if (FileSize >= (int64_t)sizeof(Header))
         {
-            continue;
+            CacheFile.seekg(0);
+            CacheFile.read(reinterpret_cast<AnsiChar*>(&Header), sizeof(Header));
+            Data.Resize(static_cast<int32_t>(FileSize - sizeof(Header)));
+            CacheFile.read(reinterpret_cast<AnsiChar*>(Data.GetData()), Data.Num());
+
+            if (!ValidateCacheData(Header, Data))
+            {
+                Data.Clear();
+            }
         }
+        CacheFile.close();
+    }
 
-        StageInfo.stage = ShaderStage::ConvertToVKStageFlagBit((ShaderStage::EStage)Index);
-        StageInfo.module = PSO->ShaderModules[Index];
-        StageInfo.pName = "main";
+    VkPipelineCacheCreateInfo CacheInfo;
+    ZeroVulkanStruct(CacheInfo, VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO);
+    CacheInfo.initialDataSize = Data.Num();
+    CacheInfo.pInitialData = Data.IsEmpty() ? nullptr : Data.GetData();
+    VK_CHECK_RESULT(VulkanApi::vkCreatePipelineCache(Device->GetHandle(), &CacheInfo, VK_CPU_ALLOCATOR, &Handle));
 
-        ++ShaderStageCount;
-    }
-    check(ShaderStageCount != 0);
+    auto LoadTimeMs = std::chrono::duration<double, std::milli>(Clock::now() - LoadStart).count();
+    std::cout << "[INFO] Pipeline cache: loaded " << Data.Num() << " bytes from " << Filename << " in " << LoadTimeMs << " ms.\n";
 
-    // Vertex Input. The structure is mandatory even without vertex attributes.
-    // VkPipelineVertexInputStateCreateInfo VertexInputInfo;
-    // ZeroVulkanStruct(VertexInputInfo, VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO);
-    //
-    // TArray<VkVertexInputBindingDescription> VBBindings;
-    // for (const AGraphicsPipelineDesc::AVertexBinding& SourceBinding : GraphicsDesc.VertexBindings)
-    // {
-    //     VkVertexInputBindingDescription* Binding = new (VBBindings) VkVertexInputBindingDescription;
-    //     SourceBinding.WriteInto(*Binding);
-    // }
-    // VertexInputInfo.vertexBindingDescriptionCount = VBBindings.Num();
-    // VertexInputInfo.pVertexBindingDescriptions = VBBindings.GetData();
-    //
-    // TArray<VkVertexInputAttributeDescription> VBAttributes;
-    // for (const AGraphicsPipelineDesc::AVertexAttribute& SourceAttr : GraphicsDesc.VertexAttributes)
-    // {
-    //     VkVertexInputAttributeDescription* Attr = new (VBAttributes) VkVertexInputAttributeDescription;
-    //     SourceAttr.WriteInto(*Attr);
-    // }
-    // VertexInputInfo.vertexAttributeDescriptionCount = VBAttributes.Num();
-    // VertexInputInfo.pVertexAttributeDescriptions = VBAttributes.GetData();
+    return !Data.IsEmpty();
+}
 
-    VkPipelineVertexInputStateCreateInfo VertexInputInfo;
-    ZeroVulkanStruct(VertexInputInfo, VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO);
-    VertexInputInfo.vertexBindingDescriptionCount = 0;
-    VertexInputInfo.vertexAttributeDescriptionCount = 0;
+bool AVulkanPipelineCache::Save(const AString& Filename) const
+{
+    size_t DataSize = 0;
+    VK_CHECK_RESULT(VulkanApi::vkGetPipelineCacheData(Device->GetHandle(), Handle, &DataSize, nullptr));
+    if (DataSize == 0)
+    {
+        return false;
+    }
 
-    // Input assembly.
-    VkPipelineInputAssemblyStateCreateInfo InputAssemblyInfo;
-    ZeroVulkanStruct(InputAssemblyInfo, VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO);
-    InputAssemblyInfo.topology = (VkPrimitiveTopology)GraphicsDesc.Topology;
+    TArray<uint8_t> Data(static_cast<int32_t>(DataSize));
+    VK_CHECK_RESULT(VulkanApi::vkGetPipelineCacheData(Device->GetHandle(), Handle, &DataSize, Data.GetData()));
+    Data.Resize(static_cast<int32_t>(DataSize));
 
-    // Rasterization state.
-    VkPipelineRasterizationStateCreateInfo RasterizerInfo;
-    ZeroVulkanStruct(RasterizerInfo, VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO);
-    RasterizerInfo.depthClampEnable = VK_FALSE;
-    RasterizerInfo.rasterizerDiscardEnable = VK_FALSE;
-    RasterizerInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    RasterizerInfo.lineWidth = 1.0f;
-    RasterizerInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    RasterizerInfo.frontFace = VK_FRONT_FACE_CLOCKWISE;
-    RasterizerInfo.depthBiasEnable = VK_FALSE;
-
-    // Dynamic state.
-    VkPipelineDynamicStateCreateInfo DynamicInfo;
-    ZeroVulkanStruct(DynamicInfo, VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO);
-    VkDynamicState DynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
-    DynamicInfo.dynamicStateCount = 2;
-    DynamicInfo.pDynamicStates = DynamicStates;
+    AFileHeader Header;
+    FillFileHeader(Header);
+    Header.DataSize = DataSize;
+    Header.DataHash = AHash::XXH64(Data.GetData(), DataSize);
 
-    // Pipeline
-    VkGraphicsPipelineCreateInfo PipelineInfo;
-    ZeroVulkanStruct(PipelineInfo, VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
-    PipelineInfo.stageCount = ShaderStageCount;
-    PipelineInfo.pStages = ShaderStagesInfo;
-    PipelineInfo.pVertexInputState = &VertexInputInfo;
-    PipelineInfo.pInputAssemblyState = &InputAssemblyInfo;
-    PipelineInfo.pViewportState = &ViewportInfo;
-    PipelineInfo.pRasterizationState = &RasterizerInfo;
-    PipelineInfo.pMultisampleState = &MultisamplingInfo;
-    PipelineInfo.pColorBlendState = &ColorBlendingInfo;
-    PipelineInfo.pDynamicState = &DynamicInfo;
-    PipelineInfo.layout = PSO->Layout;
-    PipelineInfo.renderPass = PSO->RenderPass->GetHandle();
-    PipelineInfo.subpass = GraphicsDesc.SubpassIndex;
-    PipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    std::error_code ErrorCode;
+    std::filesystem::create_directories(std::filesystem::path(Filename).parent_path(), ErrorCode);
 
-    VkResult Result = VulkanApi::vkCreateGraphicsPipelines(Device->GetHandle(), VK_NULL_HANDLE, 1, &PipelineInfo, VK_CPU_ALLOCATOR, &PSO->Pipeline);
-    if (Result != VK_SUCCESS)
+    std::ofstream CacheFile(Filename, std::ios::binary | std::ios::trunc);
+    if (!CacheFile.is_open())
     {
-        // Log.
+        std::cerr << "[WARNING] Pipeline cache: failed to open " << Filename << " for writing.\n";
         return false;
     }
+    CacheFile.write(reinterpret_cast<const AnsiChar*>(&Header), sizeof(Header));
+    CacheFile.write(reinterpret_cast<const AnsiChar*>(Data.GetData()), DataSize);
+    CacheFile.close();
 
+    std::cout << "[INFO] Pipeline cache: saved " << DataSize << " bytes to " << Filename << ".\n";
     return true;
-}
\ No newline at end of file
+}
+
+void AVulkanPipelineCache::AddPipelineStats(double CompileTimeMs, bool bCacheHit)
+{
+    NumPipelines.fetch_add(1, std::memory_order_relaxed);
+    NumCacheHits.fetch_add(bCacheHit ? 1 : 0, std::memory_order_relaxed);
+    TotalCompileTimeUs.fetch_add(static_cast<uint64_t>(CompileTimeMs * 1000.0), std::memory_order_relaxed);
+}
+
+void AVulkanPipelineCache::LogStats() const
+{
+    const uint32_t Count = NumPipelines.load(std::memory_order_relaxed);
+    if (Count == 0)
+    {
+        return;
+    }
+
+    const double TotalMs = TotalCompileTimeUs.load(std::memory_order_relaxed) / 1000.0;
+    std::cout << "[INFO] Pipeline cache: " << Count << " pipelines, " << NumCacheHits.load(std::memory_order_relaxed) << " cache hits, "
+              << TotalMs << " ms total, " << TotalMs / Count << " ms average.\n";
+}
+
+AShaderPermutation& AShaderPermutation::Set(uint32_t ConstantId, uint32_t Value)
+{
+    uint32_t Index = 0;
+    while (Index < NumConstants && ConstantIds[Index] < ConstantId)
+    {
+        ++Index;
+    }
+
+    if (Index == NumConstants || ConstantIds[Index] != ConstantId)
+    {
+        check(NumConstants < MaxSpecializationConstants, "Too many specialization constants.");
+        for (uint32_t Move = NumConstants; Move > Index; --Move)
+        {
+            ConstantIds[Move] = ConstantIds[Move - 1];
+            Values[Move] = Values[Move - 1];
+        }
+        ConstantIds[Index] = ConstantId;
+        ++NumConstants;
+    }
+
+    Values[Index] = Value;
+    return *this;
+}
+
+AShaderPermutation& AShaderPermutation::Set(uint32_t ConstantId, float Value)
+{
+    uint32_t Bits;
+    AMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+    return Set(ConstantId, Bits);
+}
+
+// Descs are hashed and compared as raw memory. The floats rule out has_unique_object_representations for the
+// whole desc, so its integer parts are checked on their own and the desc size against the sum of its members.
+static_assert(std::has_unique_object_representations_v<AShaderPermutation>, "AShaderPermutation must not contain padding.");
+static_assert(std::has_unique_object_representations_v<AVulkanGraphicsPipelineDesc::AVertexBinding> &&
+                  std::has_unique_object_representations_v<AVulkanGraphicsPipelineDesc::AVertexAttribute> &&
+                  std::has_unique_object_representations_v<AVulkanGraphicsPipelineDesc::ABlendAttachment> &&
+                  std::has_unique_object_representations_v<AVulkanGraphicsPipelineDesc::AStencilOp> &&
+                  std::has_unique_object_representations_v<AVulkanGraphicsPipelineDesc::ARenderPass>,
+    "AVulkanGraphicsPipelineDesc members must not contain padding.");
+static_assert(sizeof(AVulkanGraphicsPipelineDesc::ARasterizer) == 8 + 2 * sizeof(float) &&
+                  sizeof(AVulkanGraphicsPipelineDesc::ADepthStencil) == 4 + 2 * sizeof(AVulkanGraphicsPipelineDesc::AStencilOp) + 4 + 2 * sizeof(float),
+    "AVulkanGraphicsPipelineDesc members must not contain padding.");
+static_assert(sizeof(AVulkanGraphicsPipelineDesc) == sizeof(AVulkanGraphicsPipelineDesc::ShaderHashes) +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::VertexBindings) +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::VertexAttributes) +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::BlendAttachments) +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::BlendConstants) +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::ARasterizer) +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::ADepthStencil) +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::ARenderPass) + sizeof(AShaderPermutation) + 4 +
+                                                         sizeof(AVulkanGraphicsPipelineDesc::Padding),
+    "AVulkanGraphicsPipelineDesc must not contain padding.");
+static_assert(sizeof(AVulkanGraphicsPipelineDesc) == 672, "AVulkanGraphicsPipelineDesc changed size, bump PipelineManifestFileVersion.");
+
+void AVulkanGraphicsPipelineDesc::AVertexBinding::ReadFrom(const VkVertexInputBindingDescription& InState)
+{
+    Stride = InState.stride;
+    Binding = static_cast<uint16_t>(InState.binding);
+    InputRate = static_cast<uint16_t>(InState.inputRate);
+}
+
+void AVulkanGraphicsPipelineDesc::AVertexBinding::WriteInto(VkVertexInputBindingDescription& OutState) const
+{
+    OutState.binding = Binding;
+    OutState.stride = Stride;
+    OutState.inputRate = (VkVertexInputRate)InputRate;
+}
+
+void AVulkanGraphicsPipelineDesc::AVertexAttribute::ReadFrom(const VkVertexInputAttributeDescription& InState)
+{
+    Location = InState.location;
+    Binding = InState.binding;
+    Format = InState.format;
+    Offset = InState.offset;
+}
+
+void AVulkanGraphicsPipelineDesc::AVertexAttribute::WriteInto(VkVertexInputAttributeDescription& OutState) const
+{
+    OutState.location = Location;
+    OutState.binding = Binding;
+    OutState.format = (VkFormat)Format;
+    OutState.offset = Offset;
+}
+
+void AVulkanGraphicsPipelineDesc::ABlendAttachment::ReadFrom(const VkPipelineColorBlendAttachmentState& InState)
+{
+    bBlend = InState.blendEnable != VK_FALSE;
+    ColorBlendOp = static_cast<uint8_t>(InState.colorBlendOp);
+    SrcColorBlendFactor = static_cast<uint8_t>(InState.srcColorBlendFactor);
+    DstColorBlendFactor = static_cast<uint8_t>(InState.dstColorBlendFactor);
+    AlphaBlendOp = static_cast<uint8_t>(InState.alphaBlendOp);
+    SrcAlphaBlendFactor = static_cast<uint8_t>(InState.srcAlphaBlendFactor);
+    DstAlphaBlendFactor = static_cast<uint8_t>(InState.dstAlphaBlendFactor);
+    ColorWriteMask = static_cast<uint8_t>(InState.colorWriteMask);
+}
+
+void AVulkanGraphicsPipelineDesc::ABlendAttachment::WriteInto(VkPipelineColorBlendAttachmentState& OutState) const
+{
+    OutState.blendEnable = bBlend ? VK_TRUE : VK_FALSE;
+    OutState.colorBlendOp = (VkBlendOp)ColorBlendOp;
+    OutState.srcColorBlendFactor = (VkBlendFactor)SrcColorBlendFactor;
+    OutState.dstColorBlendFactor = (VkBlendFactor)DstColorBlendFactor;
+    OutState.alphaBlendOp = (VkBlendOp)AlphaBlendOp;
+    OutState.srcAlphaBlendFactor = (VkBlendFactor)SrcAlphaBlendFactor;
+    OutState.dstAlphaBlendFactor = (VkBlendFactor)DstAlphaBlendFactor;
+    OutState.colorWriteMask = ColorWriteMask;
+}
+
+void AVulkanGraphicsPipelineDesc::ARasterizer::WriteInto(VkPipelineRasterizationStateCreateInfo& OutState) const
+{
+    OutState.depthClampEnable = bDepthClamp ? VK_TRUE : VK_FALSE;
+    OutState.rasterizerDiscardEnable = VK_FALSE;
+    OutState.polygonMode = (VkPolygonMode)PolygonMode;
+    OutState.cullMode = CullMode;
+    OutState.frontFace = (VkFrontFace)FrontFace;
+    OutState.depthBiasEnable = bDepthBias ? VK_TRUE : VK_FALSE;
+    OutState.depthBiasConstantFactor = DepthBiasConstantFactor;
+    OutState.depthBiasSlopeFactor = DepthBiasSlopeFactor;
+    OutState.lineWidth = 1.0f;
+}
+
+void AVulkanGraphicsPipelineDesc::AStencilOp::ReadFrom(const VkStencilOpState& InState)
+{
+    FailOp = static_cast<uint8_t>(InState.failOp);
+    PassOp = static_cast<uint8_t>(InState.passOp);
+    DepthFailOp = static_cast<uint8_t>(InState.depthFailOp);
+    CompareOp = static_cast<uint8_t>(InState.compareOp);
+    CompareMask = InState.compareMask;
+    WriteMask = InState.writeMask;
+    Reference = InState.reference;
+}
+
+void AVulkanGraphicsPipelineDesc::AStencilOp::WriteInto(VkStencilOpState& OutState) const
+{
+    OutState.failOp = (VkStencilOp)FailOp;
+    OutState.passOp = (VkStencilOp)PassOp;
+    OutState.depthFailOp = (VkStencilOp)DepthFailOp;
+    OutState.compareOp = (VkCompareOp)CompareOp;
+    OutState.compareMask = CompareMask;
+    OutState.writeMask = WriteMask;
+    OutState.reference = Reference;
+}
+
+void AVulkanGraphicsPipelineDesc::ADepthStencil::WriteInto(VkPipelineDepthStencilStateCreateInfo& OutState) const
+{
+    OutState.depthTestEnable = bDepthTest ? VK_TRUE : VK_FALSE;
+    OutState.depthWriteEnable = bDepthWrite ? VK_TRUE : VK_FALSE;
+    OutState.depthCompareOp = (VkCompareOp)DepthCompareOp;
+    OutState.depthBoundsTestEnable = bDepthBoundsTest ? VK_TRUE : VK_FALSE;
+    OutState.stencilTestEnable = bStencilTest ? VK_TRUE : VK_FALSE;
+    Front.WriteInto(OutState.front);
+    Back.WriteInto(OutState.back);
+    OutState.minDepthBounds = MinDepthBounds;
+    OutState.maxDepthBounds = MaxDepthBounds;
+}
+
+void AVulkanGraphicsPipelineDesc::ARenderPass::ReadFrom(const AVulkanRenderTargetLayout& RTLayout)
+{
+    const VkAttachmentDescription* Attachments = RTLayout.GetAttachmentDescriptions();
+
+    NumColorAttachments = RTLayout.NumColorAttachments;
+    if (const VkAttachmentReference* ColorReferences = RTLayout.GetColorAttachmentReferences(); ColorReferences)
+    {
+        for (uint32_t Index = 0; Index < NumColorAttachments; ++Index)
+        {
+            ColorFormats[Index] = Attachments[ColorReferences[Index].attachment].format;
+        }
+    }
+    if (const VkAttachmentReference* DepthStencilReference = RTLayout.GetDepthStencilAttachmentReference(); DepthStencilReference)
+    {
+        DepthStencilFormat = Attachments[DepthStencilReference->attachment].format;
+    }
+    NumSamples = std::max<uint8_t>(1, RTLayout.NumSamples);
+    SubpassHint = static_cast<uint8_t>(RTLayout.SubpassHint);
+    if (const VkAttachmentReference* ResolveReferences = RTLayout.GetResolveAttachmentReferences(); ResolveReferences)
+    {
+        for (uint32_t Index = 0; Index < NumColorAttachments; ++Index)
+        {
+            ResolveMask |= ResolveReferences[Index].attachment != VK_ATTACHMENT_UNUSED ? (1u << Index) : 0u;
+        }
+    }
+    bDepthStencilResolve = RTLayout.bHasDepthStencilResolve;
+}
+
+uint32_t AVulkanGraphicsPipelineDesc::ARenderPass::GetNumSubpassColorAttachments() const
+{
+    return AVulkanRenderTargetLayout::GetNumSubpassColorAttachments(static_cast<ESubpassHint>(SubpassHint), NumColorAttachments, SubpassIndex);
+}
+
+AGraphicsPipelineStateInitializer::AGraphicsPipelineStateInitializer()
+    : Topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST), PolygonMode(VK_POLYGON_MODE_FILL), CullMode(VK_CULL_MODE_BACK_BIT),
+      FrontFace(VK_FRONT_FACE_CLOCKWISE), bDepthTest(true), bDepthWrite(true), DepthCompareOp(VulkanDepthCompareOp), bDepthBoundsTest(false),
+      MinDepthBounds(0.0f), MaxDepthBounds(1.0f), bStencilTest(false), bAlphaToCoverage(false), SubpassIndex(0)
+{
+    // Stencil keeps everything when enabled without further setup.
+    AMemory::Memzero(FrontStencil);
+    FrontStencil.failOp = VK_STENCIL_OP_KEEP;
+    FrontStencil.passOp = VK_STENCIL_OP_KEEP;
+    FrontStencil.depthFailOp = VK_STENCIL_OP_KEEP;
+    FrontStencil.compareOp = VK_COMPARE_OP_ALWAYS;
+    FrontStencil.compareMask = 0xFF;
+    FrontStencil.writeMask = 0xFF;
+    BackStencil = FrontStencil;
+    AMemory::Memzero(BlendConstants);
+    AMemory::Memzero(ShaderHashes);
+
+    // Depth tested and written, so hidden fragments are rejected before they are shaded. Ignored without a depth attachment.
+    // Opaque, write all channels.
+    AMemory::Memzero(BlendStates);
+    for (VkPipelineColorBlendAttachmentState& BlendState : BlendStates)
+    {
+        BlendState.colorBlendOp = VK_BLEND_OP_ADD;
+        BlendState.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+        BlendState.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+        BlendState.alphaBlendOp = VK_BLEND_OP_ADD;
+        BlendState.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        BlendState.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        BlendState.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    }
+}
+
+AVulkanGraphicsPipelineState::AVulkanGraphicsPipelineState(
+    AVulkanDevice* InDevice, const AVulkanGraphicsPipelineDesc& InDesc, const AString (&InSpirvs)[ShaderStage::NumStages])
+    : Device(InDevice), Desc(InDesc), Pipeline(VK_NULL_HANDLE), OptimizedPipeline(VK_NULL_HANDLE), Layout(nullptr), Status(EStatus::Pending),
+      RenderPass(VK_NULL_HANDLE)
+{
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        Spirvs[Index] = InSpirvs[Index];
+        ShaderModules[Index] = VK_NULL_HANDLE;
+    }
+}
+
+AVulkanGraphicsPipelineState::~AVulkanGraphicsPipelineState()
+{
+    VulkanApi::vkDestroyPipeline(Device->GetHandle(), Pipeline, nullptr);
+    Pipeline = VK_NULL_HANDLE;
+
+    VulkanApi::vkDestroyPipeline(Device->GetHandle(), OptimizedPipeline, nullptr);
+    OptimizedPipeline = VK_NULL_HANDLE;
+}
+
+void AVulkanGraphicsPipelineState::FindOrCreateShaderModules()
+{
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        if (ShaderModules[Index] != VK_NULL_HANDLE)
+        {
+            continue;
+        }
+
+        if (!Spirvs[Index].empty())
+        {
+            AVulkanShaderManager* ShaderMgr = Device->GetShaderManager();
+            ShaderModules[Index] = ShaderMgr->GetOrCreateShader(Spirvs[Index].c_str());
+        }
+    }
+}
+
+void AVulkanGraphicsPipelineState::ReleaseShaderModules()
+{
+    AVulkanShaderManager* ShaderMgr = Device->GetShaderManager();
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        if (ShaderModules[Index] != VK_NULL_HANDLE)
+        {
+            ShaderMgr->ReleaseShader(ShaderModules[Index]);
+            ShaderModules[Index] = VK_NULL_HANDLE;
+        }
+    }
+}
+
+void AVulkanGraphicsPipelineState::Bind(AVulkanCommandBuffer* CmdBuffer)
+{
+    VulkanApi::vkCmdBindPipeline(CmdBuffer->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+}
+
+bool AVulkanPipelineManifest::Load(const AString& Filename)
+{
+    std::ifstream ManifestFile(Filename, std::ios::binary);
+    if (!ManifestFile.is_open())
+    {
+        return false;
+    }
+
+    AFileHeader Header;
+    ManifestFile.read(reinterpret_cast<AnsiChar*>(&Header), sizeof(Header));
+    if (!ManifestFile || Header.Magic != PipelineManifestFileMagic || Header.Version != PipelineManifestFileVersion ||
+        Header.DescSize != sizeof(AVulkanGraphicsPipelineDesc))
+    {
+        std::cout << "[INFO] PSO manifest: " << Filename << " was written by another build, ignored.\n";
+        return false;
+    }
+
+    while (true)
+    {
+        AEntry Entry;
+        ManifestFile.read(reinterpret_cast<AnsiChar*>(&Entry.Desc), sizeof(Entry.Desc));
+        for (int32_t Index = 0; Index < ShaderStage::NumStages && ManifestFile; ++Index)
+        {
+            uint32_t Length = 0;
+            ManifestFile.read(reinterpret_cast<AnsiChar*>(&Length), sizeof(Length));
+            Entry.Spirvs[Index].resize(Length);
+            ManifestFile.read(Entry.Spirvs[Index].data(), Length);
+        }
+        if (!ManifestFile)
+        {
+            // End of file, or an entry cut short by a crash while recording.
+            break;
+        }
+
+        if (!EntryIndices.Find(Entry.Desc))
+        {
+            EntryIndices.Add(Entry.Desc, Entries.Add(Entry) - 1);
+        }
+    }
+
+    return true;
+}
+
+bool AVulkanPipelineManifest::BeginRecording(const AString& Filename)
+{
+    const bool bAppend = Load(Filename);
+
+    std::error_code ErrorCode;
+    std::filesystem::create_directories(std::filesystem::path(Filename).parent_path(), ErrorCode);
+
+    Recording.open(Filename, std::ios::binary | (bAppend ? std::ios::app : std::ios::trunc));
+    if (!Recording.is_open())
+    {
+        std::cerr << "[WARNING] PSO manifest: failed to open " << Filename << " for writing.\n";
+        return false;
+    }
+
+    if (!bAppend)
+    {
+        AFileHeader Header;
+        AMemory::Memzero(Header);
+        Header.Magic = PipelineManifestFileMagic;
+        Header.Version = PipelineManifestFileVersion;
+        Header.DescSize = sizeof(AVulkanGraphicsPipelineDesc);
+        Recording.write(reinterpret_cast<const AnsiChar*>(&Header), sizeof(Header));
+        Recording.flush();
+    }
+
+    return true;
+}
+
+void AVulkanPipelineManifest::Record(const AVulkanGraphicsPipelineDesc& Desc, const AString (&Spirvs)[ShaderStage::NumStages])
+{
+    if (EntryIndices.Find(Desc))
+    {
+        return;
+    }
+
+    AEntry Entry;
+    Entry.Desc = Desc;
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        Entry.Spirvs[Index] = Spirvs[Index];
+    }
+    EntryIndices.Add(Desc, Entries.Add(Entry) - 1);
+
+    if (Recording.is_open())
+    {
+        Recording.write(reinterpret_cast<const AnsiChar*>(&Desc), sizeof(Desc));
+        for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+        {
+            const uint32_t Length = static_cast<uint32_t>(Spirvs[Index].size());
+            Recording.write(reinterpret_cast<const AnsiChar*>(&Length), sizeof(Length));
+            Recording.write(Spirvs[Index].data(), Length);
+        }
+        // Keep the file usable if the capture run does not shut down cleanly.
+        Recording.flush();
+    }
+}
+
+AVulkanPipelineStateManager::AVulkanPipelineStateManager(AVulkanDevice* InDevice)
+    : PrecompileBaseCacheHits(0), PrecompileBasePipelines(0), FrameNumber(0), NumPendingCompiles(0),
+      NumFinishedCompiles(0), CompileTimeUs(0), Device(InDevice)
+{
+    AMemory::Memzero(FrameStats);
+    AMemory::Memzero(LastFrameStats);
+}
+
+AVulkanPipelineStateManager::~AVulkanPipelineStateManager()
+{
+    WaitForPendingCompiles();
+
+    for (auto& [Desc, PSO] : GraphicsPSOMap)
+    {
+        // The worker may still be between publishing the status and its final suspend point.
+        PSO->CompileTask.Wait();
+        delete PSO;
+        PSO = nullptr;
+    }
+
+    for (auto& [Hash, RenderPass] : CompatibleRenderPasses)
+    {
+        VulkanApi::vkDestroyRenderPass(Device->GetHandle(), RenderPass, VK_CPU_ALLOCATOR);
+    }
+
+    for (auto& [Key, Library] : PipelineLibraries)
+    {
+        VulkanApi::vkDestroyPipeline(Device->GetHandle(), Library, VK_CPU_ALLOCATOR);
+    }
+    for (const TPair<uint64_t, VkPipeline>& Retired : RetiredPipelines)
+    {
+        VulkanApi::vkDestroyPipeline(Device->GetHandle(), Retired.second, VK_CPU_ALLOCATOR);
+    }
+}
+
+void AVulkanPipelineStateManager::BuildGraphicsPipelineDesc(
+    const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout, AVulkanGraphicsPipelineDesc& OutDesc)
+{
+    check(Initializer.VertexBindings.Num() <= MaxVertexElements && Initializer.VertexAttributes.Num() <= MaxVertexElements, "Too many vertex elements.");
+    check(!Initializer.bDepthBoundsTest || Device->GetPhysicalDeviceFeatures().depthBounds, "The device does not support depth bounds tests.");
+
+    OutDesc = AVulkanGraphicsPipelineDesc();
+
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        const AString& Spirv = Initializer.Spirvs[Index];
+        if (Spirv != Initializer.HashedSpirvs[Index] || (Initializer.ShaderHashes[Index] == 0 && !Spirv.empty()))
+        {
+            // Unreadable shaders hash to 0 and are looked up again, like GetContentHash() does.
+            Initializer.ShaderHashes[Index] = Spirv.empty() ? 0 : Device->GetShaderManager()->GetContentHash(Spirv);
+            Initializer.HashedSpirvs[Index] = Spirv;
+        }
+        OutDesc.ShaderHashes[Index] = Initializer.ShaderHashes[Index];
+    }
+
+    OutDesc.NumVertexBindings = static_cast<uint8_t>(Initializer.VertexBindings.Num());
+    for (int32_t Index = 0; Index < Initializer.VertexBindings.Num(); ++Index)
+    {
+        OutDesc.VertexBindings[Index].ReadFrom(Initializer.VertexBindings[Index]);
+    }
+    OutDesc.NumVertexAttributes = static_cast<uint8_t>(Initializer.VertexAttributes.Num());
+    for (int32_t Index = 0; Index < Initializer.VertexAttributes.Num(); ++Index)
+    {
+        OutDesc.VertexAttributes[Index].ReadFrom(Initializer.VertexAttributes[Index]);
+    }
+
+    OutDesc.RenderPass.ReadFrom(RTLayout);
+    check(Initializer.SubpassIndex < AVulkanRenderTargetLayout::GetNumSubpasses(RTLayout.SubpassHint), "The render pass has no such subpass.");
+    OutDesc.RenderPass.SubpassIndex = Initializer.SubpassIndex;
+
+    // Only attachments the subpass writes take part in the key.
+    for (uint32_t Index = 0; Index < OutDesc.RenderPass.GetNumSubpassColorAttachments(); ++Index)
+    {
+        OutDesc.BlendAttachments[Index].ReadFrom(Initializer.BlendStates[Index]);
+    }
+    if (OutDesc.RenderPass.GetNumSubpassColorAttachments() != 0)
+    {
+        AMemory::Memcpy(OutDesc.BlendConstants, Initializer.BlendConstants, sizeof(OutDesc.BlendConstants));
+    }
+
+    OutDesc.Rasterizer.PolygonMode = static_cast<uint8_t>(Initializer.PolygonMode);
+    OutDesc.Rasterizer.CullMode = static_cast<uint8_t>(Initializer.CullMode);
+    OutDesc.Rasterizer.FrontFace = static_cast<uint8_t>(Initializer.FrontFace);
+
+    if (OutDesc.RenderPass.DepthStencilFormat != VK_FORMAT_UNDEFINED)
+    {
+        OutDesc.DepthStencil.bDepthTest = Initializer.bDepthTest;
+        OutDesc.DepthStencil.bDepthWrite = Initializer.bDepthWrite;
+        OutDesc.DepthStencil.DepthCompareOp = static_cast<uint8_t>(Initializer.DepthCompareOp);
+        OutDesc.DepthStencil.bDepthBoundsTest = Initializer.bDepthBoundsTest;
+        OutDesc.DepthStencil.MinDepthBounds = Initializer.MinDepthBounds;
+        OutDesc.DepthStencil.MaxDepthBounds = Initializer.MaxDepthBounds;
+        OutDesc.DepthStencil.bStencilTest = Initializer.bStencilTest;
+        if (Initializer.bStencilTest)
+        {
+            OutDesc.DepthStencil.Front.ReadFrom(Initializer.FrontStencil);
+            OutDesc.DepthStencil.Back.ReadFrom(Initializer.BackStencil);
+        }
+    }
+
+    OutDesc.Topology = static_cast<uint8_t>(Initializer.Topology);
+    OutDesc.bAlphaToCoverage = Initializer.bAlphaToCoverage;
+    OutDesc.Permutation = Initializer.Permutation;
+}
+
+AVulkanGraphicsPipelineState* AVulkanPipelineStateManager::FindGraphicsPipelineState(const AVulkanGraphicsPipelineDesc& Desc) const
+{
+    AVulkanGraphicsPipelineState* const* FoundPSO = GraphicsPSOMap.Find(Desc);
+    return FoundPSO ? *FoundPSO : nullptr;
+}
+
+AVulkanGraphicsPipelineState* AVulkanPipelineStateManager::CreateGraphicsPipelineState(
+    const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass)
+{
+    AVulkanGraphicsPipelineState* PSO = RequestGraphicsPipelineState(Initializer, RTLayout, RenderPass);
+    while (PSO->IsPending())
+    {
+        AJobSystem::Get().PumpRenderThread();
+        std::this_thread::yield();
+    }
+
+    return PSO->IsReady() ? PSO : nullptr;
+}
+
+AVulkanGraphicsPipelineState* AVulkanPipelineStateManager::GetGraphicsPipelineState(const AGraphicsPipelineStateInitializer& Initializer,
+    const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass, AVulkanGraphicsPipelineState* Fallback)
+{
+    AVulkanGraphicsPipelineState* PSO = RequestGraphicsPipelineState(Initializer, RTLayout, RenderPass);
+    if (PSO->IsReady())
+    {
+        return PSO;
+    }
+
+    if (Fallback && Fallback->IsReady())
+    {
+        ++FrameStats.NumFallbackDraws;
+        return Fallback;
+    }
+
+    ++FrameStats.NumSkippedDraws;
+    return nullptr;
+}
+
+AVulkanGraphicsPipelineState* AVulkanPipelineStateManager::RequestGraphicsPipelineState(
+    const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass)
+{
+    AVulkanGraphicsPipelineDesc Desc;
+    BuildGraphicsPipelineDesc(Initializer, RTLayout, Desc);
+    if (AVulkanGraphicsPipelineState* FoundPSO = FindGraphicsPipelineState(Desc))
+    {
+        return FoundPSO;
+    }
+
+    return QueueGraphicsPipelineState(Desc, Initializer.Spirvs, RenderPass ? RenderPass->GetHandle() : VK_NULL_HANDLE);
+}
+
+AVulkanGraphicsPipelineState* AVulkanPipelineStateManager::QueueGraphicsPipelineState(
+    const AVulkanGraphicsPipelineDesc& Desc, const AString (&Spirvs)[ShaderStage::NumStages], VkRenderPass RenderPass)
+{
+    check(AJobSystem::Get().IsRenderThread(), "Pipeline states must be requested from the render thread.");
+
+    if (AVulkanGraphicsPipelineState* FoundPSO = FindGraphicsPipelineState(Desc))
+    {
+        return FoundPSO;
+    }
+
+    // Published right away as pending so that later requests for the same desc do not queue it again.
+    AVulkanGraphicsPipelineState* PSO = AllocateGraphicsPipelineState(Desc, Spirvs, RenderPass);
+    GraphicsPSOMap.Add(Desc, PSO);
+
+    if (Manifest.IsRecording())
+    {
+        Manifest.Record(Desc, Spirvs);
+    }
+
+    NumPendingCompiles.fetch_add(1, std::memory_order_acq_rel);
+    ++FrameStats.NumRequestedCompiles;
+
+    PSO->CompileTask = CompileGraphicsPipelineAsync(PSO);
+    PSO->CompileTask.Launch();
+
+    return PSO;
+}
+
+TTask<void> AVulkanPipelineStateManager::CompileGraphicsPipelineAsync(AVulkanGraphicsPipelineState* PSO)
+{
+    // Load all stages in parallel.
+    AVulkanShaderManager* ShaderMgr = Device->GetShaderManager();
+    TTask<VkShaderModule> ShaderTasks[ShaderStage::NumStages];
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        if (!PSO->Spirvs[Index].empty())
+        {
+            ShaderTasks[Index] = ShaderMgr->GetOrCreateShaderAsync(PSO->Spirvs[Index]);
+            ShaderTasks[Index].Launch();
+        }
+    }
+    bool bShadersLoaded = true;
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        if (ShaderTasks[Index].IsValid())
+        {
+            PSO->ShaderModules[Index] = co_await ShaderTasks[Index];
+            bShadersLoaded = bShadersLoaded && PSO->ShaderModules[Index] != VK_NULL_HANDLE;
+        }
+    }
+
+    co_await AJobSystem::Get().ResumeOnWorker();
+
+    using Clock = std::chrono::steady_clock;
+    auto CompileStart = Clock::now();
+    const bool bCreated = bShadersLoaded && CreateGraphicsPipeline(PSO);
+    auto CompileTime = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - CompileStart).count();
+
+    if (!bCreated)
+    {
+        // Each desc is compiled once, so this is logged once per pipeline key. Draws using it are skipped.
+        std::cerr << "[WARNING] Graphics pipeline " << std::hex << PSO->Desc.GetHash() << std::dec << " ("
+                  << (bShadersLoaded ? "compile failed" : "shader load failed") << ", vertex " << PSO->Spirvs[ShaderStage::Vertex] << ", pixel "
+                  << PSO->Spirvs[ShaderStage::Pixel] << ") is marked failed.\n";
+    }
+
+    CompileTimeUs.fetch_add(static_cast<uint64_t>(CompileTime), std::memory_order_relaxed);
+    NumFinishedCompiles.fetch_add(1, std::memory_order_relaxed);
+
+    using EStatus = AVulkanGraphicsPipelineState::EStatus;
+    PSO->Status.store(bCreated ? EStatus::Ready : EStatus::Failed, std::memory_order_release);
+    NumPendingCompiles.fetch_sub(1, std::memory_order_acq_rel);
+
+    const bool bFastLinked = Device->SupportsGraphicsPipelineLibrary() &&
+                             Device->GetGraphicsPipelineLibraryProperties().graphicsPipelineLibraryFastLinking == VK_TRUE;
+    if (bCreated && bFastLinked)
+    {
+        // Draws use the fast linked pipeline right away, the optimized one replaces it once built.
+        co_await AJobSystem::Get().ResumeOnWorker();
+
+        VkPipeline OptimizedPipeline = VK_NULL_HANDLE;
+        if (LinkGraphicsPipeline(PSO, true, OptimizedPipeline))
+        {
+            PSO->OptimizedPipeline = OptimizedPipeline;
+
+            std::lock_guard<std::mutex> Lock(OptimizedPSOsMutex);
+            OptimizedPSOs.Add(PSO);
+        }
+    }
+
+    // Both links are done, the pipeline (and its libraries) no longer need the modules.
+    PSO->ReleaseShaderModules();
+}
+
+void AVulkanPipelineStateManager::SwapOptimizedPipelines()
+{
+    TArray<AVulkanGraphicsPipelineState*> SwappedPSOs;
+    {
+        std::lock_guard<std::mutex> Lock(OptimizedPSOsMutex);
+        SwappedPSOs = std::move(OptimizedPSOs);
+        OptimizedPSOs.Clear();
+    }
+
+    for (AVulkanGraphicsPipelineState* PSO : SwappedPSOs)
+    {
+        RetiredPipelines.Add(TPair<uint64_t, VkPipeline>(FrameNumber, PSO->Pipeline));
+        PSO->Pipeline = PSO->OptimizedPipeline;
+        PSO->OptimizedPipeline = VK_NULL_HANDLE;
+    }
+
+    for (int32_t Index = RetiredPipelines.Num() - 1; Index >= 0; --Index)
+    {
+        if (RetiredPipelines[Index].first + NumFramesToRetirePipeline <= FrameNumber)
+        {
+            VulkanApi::vkDestroyPipeline(Device->GetHandle(), RetiredPipelines[Index].second, VK_CPU_ALLOCATOR);
+            RetiredPipelines.RemoveAt(Index);
+        }
+    }
+}
+
+void AVulkanPipelineStateManager::EndFrame()
+{
+    ++FrameNumber;
+    SwapOptimizedPipelines();
+
+    if (IsPrecompiling())
+    {
+        bool bPrecompileDone = true;
+        for (AVulkanGraphicsPipelineState* PSO : PrecompilingPSOs)
+        {
+            bPrecompileDone = bPrecompileDone && !PSO->IsPending();
+        }
+        if (bPrecompileDone)
+        {
+            ReportPrecompile();
+        }
+    }
+    else if (FrameNumber % NumFramesBetweenShaderCleanups == 0 && NumPendingCompiles.load(std::memory_order_acquire) == 0)
+    {
+        // Compiled pipelines released their modules, keeping them only saves reloading for pipelines not requested yet.
+        if (uint32_t NumReleased = Device->GetShaderManager()->ReleaseUnusedShaders())
+        {
+            std::cout << "[INFO] Released " << NumReleased << " unused shader modules.\n";
+        }
+    }
+
+    FrameStats.NumPendingCompiles = NumPendingCompiles.load(std::memory_order_acquire);
+    FrameStats.NumFinishedCompiles = NumFinishedCompiles.exchange(0, std::memory_order_relaxed);
+    FrameStats.CompileTimeMs = CompileTimeUs.exchange(0, std::memory_order_relaxed) / 1000.0;
+
+    LastFrameStats = FrameStats;
+    AMemory::Memzero(FrameStats);
+}
+
+void AVulkanPipelineStateManager::WaitForPendingCompiles()
+{
+    while (NumPendingCompiles.load(std::memory_order_acquire) != 0)
+    {
+        if (AJobSystem::Get().IsRenderThread())
+        {
+            AJobSystem::Get().PumpRenderThread();
+        }
+        std::this_thread::yield();
+    }
+}
+
+void AVulkanPipelineStateManager::BeginManifestCapture(const AString& Filename)
+{
+    if (!Manifest.BeginRecording(Filename))
+    {
+        return;
+    }
+
+    for (auto& [Desc, PSO] : GraphicsPSOMap)
+    {
+        Manifest.Record(Desc, PSO->Spirvs);
+    }
+    std::cout << "[INFO] PSO manifest: capturing to " << Filename << ", " << Manifest.GetEntries().Num() << " known pipelines.\n";
+}
+
+uint32_t AVulkanPipelineStateManager::PrecompileManifest(const AString& Filename, bool bWait)
+{
+    AVulkanPipelineManifest Replay;
+    if (!Replay.Load(Filename))
+    {
+        return 0;
+    }
+
+    PrecompileStart = std::chrono::steady_clock::now();
+    if (AVulkanPipelineCache* PipelineCache = Device->GetPipelineCache())
+    {
+        PrecompileBasePipelines = PipelineCache->GetNumPipelines();
+        PrecompileBaseCacheHits = PipelineCache->GetNumCacheHits();
+    }
+
+    for (const AVulkanPipelineManifest::AEntry& Entry : Replay.GetEntries())
+    {
+        if (Entry.Desc.RenderPass.SubpassIndex != 0 || Entry.Desc.RenderPass.SubpassHint != 0)
+        {
+            // Compatible render passes are built with a single subpass.
+            continue;
+        }
+        if (Entry.Desc.RenderPass.bDepthStencilResolve && !Device->SupportsDynamicRendering())
+        {
+            // And without depth resolves, which need render pass 2.
+            continue;
+        }
+
+        // Shaders edited since the capture are keyed by what frames will request now.
+        AVulkanGraphicsPipelineDesc Desc = Entry.Desc;
+        for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+        {
+            Desc.ShaderHashes[Index] = Entry.Spirvs[Index].empty() ? 0 : Device->GetShaderManager()->GetContentHash(Entry.Spirvs[Index]);
+        }
+
+        VkRenderPass RenderPass = Device->SupportsDynamicRendering() ? VK_NULL_HANDLE : GetOrCreateCompatibleRenderPass(Desc.RenderPass);
+        AVulkanGraphicsPipelineState* PSO = QueueGraphicsPipelineState(Desc, Entry.Spirvs, RenderPass);
+        if (PSO->IsPending())
+        {
+            PrecompilingPSOs.Add(PSO);
+        }
+    }
+
+    const uint32_t NumQueued = static_cast<uint32_t>(PrecompilingPSOs.Num());
+    std::cout << "[INFO] PSO manifest: precompiling " << NumQueued << " of " << Replay.GetEntries().Num() << " pipelines.\n";
+
+    if (bWait)
+    {
+        WaitForPendingCompiles();
+        ReportPrecompile();
+    }
+
+    return NumQueued;
+}
+
+void AVulkanPipelineStateManager::ReportPrecompile()
+{
+    uint32_t NumFailed = 0;
+    for (AVulkanGraphicsPipelineState* PSO : PrecompilingPSOs)
+    {
+        NumFailed += PSO->GetStatus() == AVulkanGraphicsPipelineState::EStatus::Failed ? 1 : 0;
+    }
+
+    const double PrecompileTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - PrecompileStart).count();
+    std::cout << "[INFO] PSO manifest: precompiled " << PrecompilingPSOs.Num() << " pipelines (" << NumFailed << " failed) in " << PrecompileTimeMs
+              << " ms";
+
+    // Includes pipelines requested by frames in the meantime.
+    if (AVulkanPipelineCache* PipelineCache = Device->GetPipelineCache())
+    {
+        const uint32_t NumPipelines = PipelineCache->GetNumPipelines() - PrecompileBasePipelines;
+        const uint32_t NumCacheHits = PipelineCache->GetNumCacheHits() - PrecompileBaseCacheHits;
+        std::cout << ", pipeline cache hit rate " << (NumPipelines ? 100.0 * NumCacheHits / NumPipelines : 0.0) << "%";
+    }
+    std::cout << ".\n";
+
+    PrecompilingPSOs.Clear();
+
+    // Modules only referenced by the precompiled pipelines are not needed anymore.
+    if (uint32_t NumReleased = Device->GetShaderManager()->ReleaseUnusedShaders())
+    {
+        std::cout << "[INFO] Released " << NumReleased << " unused shader modules.\n";
+    }
+}
+
+VkRenderPass AVulkanPipelineStateManager::GetOrCreateCompatibleRenderPass(const AVulkanGraphicsPipelineDesc::ARenderPass& Key)
+{
+    AVulkanGraphicsPipelineDesc::ARenderPass CompatibleKey = Key;
+    CompatibleKey.SubpassIndex = 0;
+    const uint64_t KeyHash = AHash::Memory(CompatibleKey);
+    if (VkRenderPass* FoundRenderPass = CompatibleRenderPasses.Find(KeyHash))
+    {
+        return *FoundRenderPass;
+    }
+
+    // Compatibility only depends on formats, sample counts and the subpass structure, load/store ops and layouts are free.
+    const VkSampleCountFlagBits Samples = (VkSampleCountFlagBits)std::max<uint8_t>(1, Key.NumSamples);
+    VkAttachmentDescription Attachments[MaxSimultaneousRenderTargets * 2 + 1];
+    VkAttachmentReference ColorReferences[MaxSimultaneousRenderTargets];
+    VkAttachmentReference ResolveReferences[MaxSimultaneousRenderTargets];
+    VkAttachmentReference DepthStencilReference;
+    AMemory::Memzero(Attachments);
+    uint32_t NumAttachments = 0;
+
+    for (uint32_t Index = 0; Index < Key.NumColorAttachments; ++Index, ++NumAttachments)
+    {
+        VkAttachmentDescription& Attachment = Attachments[NumAttachments];
+        Attachment.format = (VkFormat)Key.ColorFormats[Index];
+        Attachment.samples = Samples;
+        Attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        Attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        Attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        Attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        Attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+        ColorReferences[Index].attachment = NumAttachments;
+        ColorReferences[Index].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    }
+
+    VkSubpassDescription Subpass;
+    AMemory::Memzero(Subpass);
+    Subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    Subpass.colorAttachmentCount = Key.NumColorAttachments;
+    Subpass.pColorAttachments = ColorReferences;
+
+    if (Key.DepthStencilFormat != VK_FORMAT_UNDEFINED)
+    {
+        VkAttachmentDescription& Attachment = Attachments[NumAttachments];
+        Attachment.format = (VkFormat)Key.DepthStencilFormat;
+        Attachment.samples = Samples;
+        Attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        Attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        Attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        Attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        Attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        Attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        DepthStencilReference.attachment = NumAttachments++;
+        DepthStencilReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        Subpass.pDepthStencilAttachment = &DepthStencilReference;
+    }
+
+    if (Key.ResolveMask)
+    {
+        for (uint32_t Index = 0; Index < Key.NumColorAttachments; ++Index)
+        {
+            if (!(Key.ResolveMask & (1u << Index)))
+            {
+                ResolveReferences[Index].attachment = VK_ATTACHMENT_UNUSED;
+                ResolveReferences[Index].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                continue;
+            }
+
+            VkAttachmentDescription& Attachment = Attachments[NumAttachments];
+            Attachment = Attachments[ColorReferences[Index].attachment];
+            Attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+
+            ResolveReferences[Index].attachment = NumAttachments++;
+            ResolveReferences[Index].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+        Subpass.pResolveAttachments = ResolveReferences;
+    }
+
+    VkRenderPassCreateInfo RenderPassInfo;
+    ZeroVulkanStruct(RenderPassInfo, VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO);
+    RenderPassInfo.attachmentCount = NumAttachments;
+    RenderPassInfo.pAttachments = Attachments;
+    RenderPassInfo.subpassCount = 1;
+    RenderPassInfo.pSubpasses = &Subpass;
+
+    VkRenderPass RenderPass = VK_NULL_HANDLE;
+    VK_CHECK_RESULT(VulkanApi::vkCreateRenderPass(Device->GetHandle(), &RenderPassInfo, VK_CPU_ALLOCATOR, &RenderPass));
+    CompatibleRenderPasses.Add(KeyHash, RenderPass);
+
+    return RenderPass;
+}
+
+AVulkanGraphicsPipelineState* AVulkanPipelineStateManager::AllocateGraphicsPipelineState(
+    const AVulkanGraphicsPipelineDesc& Desc, const AString (&Spirvs)[ShaderStage::NumStages], VkRenderPass RenderPass)
+{
+    AVulkanGraphicsPipelineState* PSO = new AVulkanGraphicsPipelineState(Device, Desc, Spirvs);
+    PSO->RenderPass = RenderPass;
+    return PSO;
+}
+
+// Every state block of a graphics pipeline filled from its desc. Monolithic pipelines reference all of them,
+// pipeline library parts only the blocks of their subset.
+struct AVulkanGraphicsPipelineCreateState
+{
+    VkPipelineColorBlendAttachmentState BlendStates[MaxSimultaneousRenderTargets];
+    VkPipelineColorBlendStateCreateInfo ColorBlendingInfo;
+    VkPipelineViewportStateCreateInfo ViewportInfo;
+    VkPipelineMultisampleStateCreateInfo MultisamplingInfo;
+    VkSpecializationMapEntry SpecializationEntries[MaxSpecializationConstants];
+    VkSpecializationInfo SpecializationInfo;
+    VkPipelineShaderStageCreateInfo ShaderStagesInfo[ShaderStage::NumStages];
+    uint32_t ShaderStageCount;
+    VkVertexInputBindingDescription VBBindings[MaxVertexElements];
+    VkVertexInputAttributeDescription VBAttributes[MaxVertexElements];
+    VkPipelineVertexInputStateCreateInfo VertexInputInfo;
+    VkPipelineInputAssemblyStateCreateInfo InputAssemblyInfo;
+    VkPipelineRasterizationStateCreateInfo RasterizerInfo;
+    VkPipelineDepthStencilStateCreateInfo DepthStencilInfo;
+    VkDynamicState DynamicStates[2];
+    VkPipelineDynamicStateCreateInfo DynamicInfo;
+    // Replaces the render pass for pipelines used with dynamic rendering.
+    VkFormat ColorFormats[MaxSimultaneousRenderTargets];
+    VkPipelineRenderingCreateInfo RenderingInfo;
+
+    AVulkanGraphicsPipelineCreateState(const AVulkanGraphicsPipelineState* PSO)
+    {
+        const AVulkanGraphicsPipelineDesc& GraphicsDesc = PSO->GetDesc();
+
+        // Color blend
+        AMemory::Memzero(BlendStates);
+        const uint32_t NumBlendAttachments = GraphicsDesc.RenderPass.GetNumSubpassColorAttachments();
+        for (uint32_t Index = 0; Index < NumBlendAttachments; ++Index)
+        {
+            GraphicsDesc.BlendAttachments[Index].WriteInto(BlendStates[Index]);
+        }
+
+        ZeroVulkanStruct(ColorBlendingInfo, VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO);
+        ColorBlendingInfo.logicOpEnable = VK_FALSE;
+        ColorBlendingInfo.logicOp = VK_LOGIC_OP_COPY;
+        ColorBlendingInfo.attachmentCount = NumBlendAttachments;
+        ColorBlendingInfo.pAttachments = BlendStates;
+        AMemory::Memcpy(ColorBlendingInfo.blendConstants, GraphicsDesc.BlendConstants, sizeof(ColorBlendingInfo.blendConstants));
+
+        // Viewport
+        ZeroVulkanStruct(ViewportInfo, VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO);
+        ViewportInfo.viewportCount = 1;
+        ViewportInfo.scissorCount = 1;
+
+        // Multisample
+        ZeroVulkanStruct(MultisamplingInfo, VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO);
+        MultisamplingInfo.sampleShadingEnable = VK_FALSE;
+        MultisamplingInfo.rasterizationSamples = (VkSampleCountFlagBits)GraphicsDesc.RenderPass.NumSamples;
+        MultisamplingInfo.alphaToCoverageEnable = GraphicsDesc.bAlphaToCoverage ? VK_TRUE : VK_FALSE;
+
+        // Specialization constants, all 32 bit and read straight from the desc.
+        const AShaderPermutation& Permutation = GraphicsDesc.Permutation;
+        for (uint32_t Index = 0; Index < Permutation.NumConstants; ++Index)
+        {
+            SpecializationEntries[Index].constantID = Permutation.ConstantIds[Index];
+            SpecializationEntries[Index].offset = Index * sizeof(uint32_t);
+            SpecializationEntries[Index].size = sizeof(uint32_t);
+        }
+
+        AMemory::Memzero(SpecializationInfo);
+        SpecializationInfo.mapEntryCount = Permutation.NumConstants;
+        SpecializationInfo.pMapEntries = SpecializationEntries;
+        SpecializationInfo.dataSize = Permutation.NumConstants * sizeof(uint32_t);
+        SpecializationInfo.pData = Permutation.Values;
+
+        // Shader stages, indexed by ShaderStage::EStage.
+        ShaderStageCount = 0;
+        for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+        {
+            VkPipelineShaderStageCreateInfo& StageInfo = ShaderStagesInfo[Index];
+            ZeroVulkanStruct(StageInfo, VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO);
+            if (PSO->GetShaderModule((ShaderStage::EStage)Index) == VK_NULL_HANDLE)
+            {
+                continue;
+            }
+
+            StageInfo.stage = ShaderStage::ConvertToVKStageFlagBit((ShaderStage::EStage)Index);
+            StageInfo.module = PSO->GetShaderModule((ShaderStage::EStage)Index);
+            StageInfo.pName = "main";
+            StageInfo.pSpecializationInfo = Permutation.IsEmpty() ? nullptr : &SpecializationInfo;
+
+            ++ShaderStageCount;
+        }
+
+        // Vertex Input. The structure is mandatory even without vertex attributes.
+        for (uint32_t Index = 0; Index < GraphicsDesc.NumVertexBindings; ++Index)
+        {
+            GraphicsDesc.VertexBindings[Index].WriteInto(VBBindings[Index]);
+        }
+        for (uint32_t Index = 0; Index < GraphicsDesc.NumVertexAttributes; ++Index)
+        {
+            GraphicsDesc.VertexAttributes[Index].WriteInto(VBAttributes[Index]);
+        }
+
+        ZeroVulkanStruct(VertexInputInfo, VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO);
+        VertexInputInfo.vertexBindingDescriptionCount = GraphicsDesc.NumVertexBindings;
+        VertexInputInfo.pVertexBindingDescriptions = VBBindings;
+        VertexInputInfo.vertexAttributeDescriptionCount = GraphicsDesc.NumVertexAttributes;
+        VertexInputInfo.pVertexAttributeDescriptions = VBAttributes;
+
+        // Input assembly.
+        ZeroVulkanStruct(InputAssemblyInfo, VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO);
+        InputAssemblyInfo.topology = (VkPrimitiveTopology)GraphicsDesc.Topology;
+
+        // Rasterization state.
+        ZeroVulkanStruct(RasterizerInfo, VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO);
+        GraphicsDesc.Rasterizer.WriteInto(RasterizerInfo);
+
+        // Depth stencil state.
+        ZeroVulkanStruct(DepthStencilInfo, VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO);
+        GraphicsDesc.DepthStencil.WriteInto(DepthStencilInfo);
+
+        // Dynamic state.
+        ZeroVulkanStruct(DynamicInfo, VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO);
+        DynamicStates[0] = VK_DYNAMIC_STATE_VIEWPORT;
+        DynamicStates[1] = VK_DYNAMIC_STATE_SCISSOR;
+        DynamicInfo.dynamicStateCount = 2;
+        DynamicInfo.pDynamicStates = DynamicStates;
+
+        // Rendering formats.
+        const AVulkanGraphicsPipelineDesc::ARenderPass& RenderPassDesc = GraphicsDesc.RenderPass;
+        for (uint32_t Index = 0; Index < RenderPassDesc.NumColorAttachments; ++Index)
+        {
+            ColorFormats[Index] = (VkFormat)RenderPassDesc.ColorFormats[Index];
+        }
+
+        const VkFormat DepthStencilFormat = (VkFormat)RenderPassDesc.DepthStencilFormat;
+        ZeroVulkanStruct(RenderingInfo, VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO);
+        RenderingInfo.colorAttachmentCount = RenderPassDesc.NumColorAttachments;
+        RenderingInfo.pColorAttachmentFormats = ColorFormats;
+        RenderingInfo.depthAttachmentFormat = DepthStencilFormat != VK_FORMAT_S8_UINT ? DepthStencilFormat : VK_FORMAT_UNDEFINED;
+        RenderingInfo.stencilAttachmentFormat = IsStencilFormat(DepthStencilFormat) ? DepthStencilFormat : VK_FORMAT_UNDEFINED;
+    }
+
+    AVulkanGraphicsPipelineCreateState(const AVulkanGraphicsPipelineCreateState&) = delete;
+    AVulkanGraphicsPipelineCreateState& operator=(const AVulkanGraphicsPipelineCreateState&) = delete;
+
+    inline bool HasDepthStencil(const AVulkanGraphicsPipelineDesc& GraphicsDesc) const
+    {
+        return GraphicsDesc.RenderPass.DepthStencilFormat != VK_FORMAT_UNDEFINED;
+    }
+
+    static bool IsStencilFormat(VkFormat Format)
+    {
+        return Format == VK_FORMAT_S8_UINT || Format == VK_FORMAT_D16_UNORM_S8_UINT || Format == VK_FORMAT_D24_UNORM_S8_UINT ||
+               Format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+    }
+};
+
+bool AVulkanPipelineStateManager::CreateGraphicsPipelineTimed(VkGraphicsPipelineCreateInfo& PipelineInfo, VkPipeline& OutPipeline, const AnsiChar* Kind)
+{
+    // Creation feedback tells whether the driver found the pipeline in the cache.
+    VkPipelineCreationFeedback CreationFeedback;
+    AMemory::Memzero(CreationFeedback);
+    VkPipelineCreationFeedbackCreateInfo CreationFeedbackInfo;
+    ZeroVulkanStruct(CreationFeedbackInfo, VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO);
+    CreationFeedbackInfo.pPipelineCreationFeedback = &CreationFeedback;
+    CreationFeedbackInfo.pNext = PipelineInfo.pNext;
+    PipelineInfo.pNext = &CreationFeedbackInfo;
+
+    AVulkanPipelineCache* PipelineCache = Device->GetPipelineCache();
+
+    using Clock = std::chrono::steady_clock;
+    auto CompileStart = Clock::now();
+    VkResult Result = VulkanApi::vkCreateGraphicsPipelines(
+        Device->GetHandle(), PipelineCache ? PipelineCache->GetHandle() : VK_NULL_HANDLE, 1, &PipelineInfo, VK_CPU_ALLOCATOR, &OutPipeline);
+    auto CompileTimeMs = std::chrono::duration<double, std::milli>(Clock::now() - CompileStart).count();
+
+    PipelineInfo.pNext = CreationFeedbackInfo.pNext;
+
+    if (Result != VK_SUCCESS)
+    {
+        std::cerr << "Failed to create graphics pipeline (" << Kind << "), VkResult " << Result << ".\n";
+        OutPipeline = VK_NULL_HANDLE;
+        return false;
+    }
+
+    const bool bFeedbackValid = (CreationFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) != 0;
+    const bool bCacheHit = bFeedbackValid && (CreationFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT) != 0;
+    if (PipelineCache)
+    {
+        PipelineCache->AddPipelineStats(CompileTimeMs, bCacheHit);
+    }
+
+    std::cout << "[INFO] Graphics pipeline (" << Kind << ") created in " << CompileTimeMs << " ms";
+    if (bFeedbackValid)
+    {
+        std::cout << " (driver " << CreationFeedback.duration / 1.0e6 << " ms" << (bCacheHit ? ", cache hit" : "") << ")";
+    }
+    std::cout << ".\n";
+
+    return true;
+}
+
+bool AVulkanPipelineStateManager::CreateGraphicsPipeline(AVulkanGraphicsPipelineState* PSO)
+{
+    PSO->FindOrCreateShaderModules();
+
+    AVulkanShaderManager* ShaderMgr = Device->GetShaderManager();
+    PSO->Layout = ShaderMgr->GetOrCreatePipelineLayout(PSO->ShaderModules, ShaderStage::NumStages);
+
+    if (const AVulkanShaderReflection* VertexReflection = ShaderMgr->FindReflection(PSO->ShaderModules[ShaderStage::Vertex]))
+    {
+        const AVulkanGraphicsPipelineDesc& VertexDesc = PSO->Desc;
+        for (const AVulkanShaderReflection::AVertexInput& Input : VertexReflection->VertexInputs)
+        {
+            bool bFound = false;
+            for (uint32_t Index = 0; Index < VertexDesc.NumVertexAttributes && !bFound; ++Index)
+            {
+                bFound = VertexDesc.VertexAttributes[Index].Location == Input.Location;
+            }
+            if (!bFound)
+            {
+                std::cerr << "[WARNING] Vertex shader input at location " << Input.Location << " has no vertex attribute.\n";
+            }
+        }
+    }
+
+    // A constant no stage declares is ignored by the driver, most likely a typo in the permutation.
+    const AShaderPermutation& Permutation = PSO->Desc.Permutation;
+    for (uint32_t Index = 0; Index < Permutation.NumConstants; ++Index)
+    {
+        bool bDeclared = false;
+        for (int32_t Stage = 0; Stage < ShaderStage::NumStages && !bDeclared; ++Stage)
+        {
+            const AVulkanShaderReflection* Reflection = PSO->ShaderModules[Stage] ? ShaderMgr->FindReflection(PSO->ShaderModules[Stage]) : nullptr;
+            bDeclared = Reflection && Reflection->SpecializationConstants.Find(Permutation.ConstantIds[Index]);
+        }
+        if (!bDeclared)
+        {
+            std::cerr << "[WARNING] Specialization constant " << Permutation.ConstantIds[Index] << " is not declared by any shader stage.\n";
+        }
+    }
+
+    if (Device->SupportsGraphicsPipelineLibrary())
+    {
+        // Without fast linking an unoptimized link costs about as much as an optimized one, skip it.
+        const bool bFastLink = Device->GetGraphicsPipelineLibraryProperties().graphicsPipelineLibraryFastLinking == VK_TRUE;
+        return LinkGraphicsPipeline(PSO, !bFastLink, PSO->Pipeline);
+    }
+
+    const AVulkanGraphicsPipelineDesc& GraphicsDesc = PSO->Desc;
+    AVulkanGraphicsPipelineCreateState State(PSO);
+
+    // Compact the stages, unused ones are left out.
+    VkPipelineShaderStageCreateInfo ShaderStagesInfo[ShaderStage::NumStages];
+    uint32_t ShaderStageCount = 0;
+    for (int32_t Index = 0; Index < ShaderStage::NumStages; ++Index)
+    {
+        if (PSO->ShaderModules[Index] != VK_NULL_HANDLE)
+        {
+            ShaderStagesInfo[ShaderStageCount++] = State.ShaderStagesInfo[Index];
+        }
+    }
+    check(ShaderStageCount != 0);
+
+    // Pipeline
+    VkGraphicsPipelineCreateInfo PipelineInfo;
+    ZeroVulkanStruct(PipelineInfo, VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
+    PipelineInfo.stageCount = ShaderStageCount;
+    PipelineInfo.pStages = ShaderStagesInfo;
+    PipelineInfo.pVertexInputState = &State.VertexInputInfo;
+    PipelineInfo.pInputAssemblyState = &State.InputAssemblyInfo;
+    PipelineInfo.pViewportState = &State.ViewportInfo;
+    PipelineInfo.pRasterizationState = &State.RasterizerInfo;
+    PipelineInfo.pMultisampleState = &State.MultisamplingInfo;
+    PipelineInfo.pDepthStencilState = State.HasDepthStencil(GraphicsDesc) ? &State.DepthStencilInfo : nullptr;
+    PipelineInfo.pColorBlendState = &State.ColorBlendingInfo;
+    PipelineInfo.pDynamicState = &State.DynamicInfo;
+    PipelineInfo.layout = PSO->Layout->Handle;
+    PipelineInfo.renderPass = PSO->RenderPass;
+    PipelineInfo.subpass = GraphicsDesc.RenderPass.SubpassIndex;
+    PipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    if (PSO->RenderPass == VK_NULL_HANDLE)
+    {
+        PipelineInfo.pNext = &State.RenderingInfo;
+    }
+
+    return CreateGraphicsPipelineTimed(PipelineInfo, PSO->Pipeline, "monolithic");
+}
+
+uint64_t AVulkanPipelineStateManager::GetPipelineLibraryKey(VkGraphicsPipelineLibraryFlagsEXT Part, const AVulkanGraphicsPipelineState* PSO)
+{
+    const AVulkanGraphicsPipelineDesc& Desc = PSO->Desc;
+
+    // Only the desc members a part consumes, so that e.g. all pipelines sharing a vertex shader and
+    // rasterizer state share one pre-rasterization library.
+    uint64_t Hash = AHash::Combine(Part, reinterpret_cast<uint64_t>(PSO->Layout->Handle));
+    // Libraries built for dynamic rendering do not link with render pass ones.
+    Hash = AHash::Combine(Hash, PSO->RenderPass == VK_NULL_HANDLE);
+    switch (Part)
+    {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        Hash = AHash::Combine(Hash, AHash::XXH64(Desc.VertexBindings, sizeof(Desc.VertexBindings[0]) * Desc.NumVertexBindings));
+        Hash = AHash::Combine(Hash, AHash::XXH64(Desc.VertexAttributes, sizeof(Desc.VertexAttributes[0]) * Desc.NumVertexAttributes));
+        Hash = AHash::Combine(Hash, (uint64_t(Desc.NumVertexBindings) << 16) | (uint64_t(Desc.NumVertexAttributes) << 8) | Desc.Topology);
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        Hash = AHash::Combine(Hash, Desc.ShaderHashes[ShaderStage::Vertex]);
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.Permutation));
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.Rasterizer));
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.RenderPass));
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        Hash = AHash::Combine(Hash, Desc.ShaderHashes[ShaderStage::Pixel]);
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.Permutation));
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.DepthStencil));
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.RenderPass));
+        Hash = AHash::Combine(Hash, Desc.bAlphaToCoverage);
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.BlendAttachments));
+        Hash = AHash::Combine(Hash, AHash::Memory(Desc.RenderPass));
+        Hash = AHash::Combine(Hash, Desc.bAlphaToCoverage);
+        break;
+    default:
+        check(false, "Unknown pipeline library part.");
+    }
+    return Hash;
+}
+
+VkPipeline AVulkanPipelineStateManager::GetOrCreatePipelineLibrary(VkGraphicsPipelineLibraryFlagsEXT Part, const AVulkanGraphicsPipelineState* PSO)
+{
+    const uint64_t Key = GetPipelineLibraryKey(Part, PSO);
+    {
+        std::lock_guard<std::mutex> Lock(PipelineLibrariesMutex);
+        if (VkPipeline* FoundLibrary = PipelineLibraries.Find(Key))
+        {
+            return *FoundLibrary;
+        }
+    }
+
+    const AVulkanGraphicsPipelineDesc& GraphicsDesc = PSO->Desc;
+    AVulkanGraphicsPipelineCreateState State(PSO);
+
+    VkGraphicsPipelineLibraryCreateInfoEXT LibraryInfo;
+    ZeroVulkanStruct(LibraryInfo, VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT);
+    LibraryInfo.flags = Part;
+
+    VkGraphicsPipelineCreateInfo PipelineInfo;
+    ZeroVulkanStruct(PipelineInfo, VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
+    PipelineInfo.pNext = &LibraryInfo;
+    PipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+    const AnsiChar* Kind = nullptr;
+    switch (Part)
+    {
+    case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+        PipelineInfo.pVertexInputState = &State.VertexInputInfo;
+        PipelineInfo.pInputAssemblyState = &State.InputAssemblyInfo;
+        Kind = "vertex input library";
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+        PipelineInfo.stageCount = 1;
+        PipelineInfo.pStages = &State.ShaderStagesInfo[ShaderStage::Vertex];
+        PipelineInfo.pViewportState = &State.ViewportInfo;
+        PipelineInfo.pRasterizationState = &State.RasterizerInfo;
+        PipelineInfo.pDynamicState = &State.DynamicInfo;
+        Kind = "pre-rasterization library";
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+        PipelineInfo.stageCount = PSO->ShaderModules[ShaderStage::Pixel] != VK_NULL_HANDLE ? 1 : 0;
+        PipelineInfo.pStages = &State.ShaderStagesInfo[ShaderStage::Pixel];
+        PipelineInfo.pMultisampleState = &State.MultisamplingInfo;
+        PipelineInfo.pDepthStencilState = State.HasDepthStencil(GraphicsDesc) ? &State.DepthStencilInfo : nullptr;
+        Kind = "fragment shader library";
+        break;
+    case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+        PipelineInfo.pMultisampleState = &State.MultisamplingInfo;
+        PipelineInfo.pColorBlendState = &State.ColorBlendingInfo;
+        Kind = "fragment output library";
+        break;
+    default:
+        check(false, "Unknown pipeline library part.");
+    }
+
+    if (Part == VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT || Part == VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+    {
+        PipelineInfo.layout = PSO->Layout->Handle;
+    }
+    if (Part != VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)
+    {
+        PipelineInfo.renderPass = PSO->RenderPass;
+        PipelineInfo.subpass = GraphicsDesc.RenderPass.SubpassIndex;
+        if (PSO->RenderPass == VK_NULL_HANDLE)
+        {
+            LibraryInfo.pNext = &State.RenderingInfo;
+        }
+    }
+
+    VkPipeline Library = VK_NULL_HANDLE;
+    if (!CreateGraphicsPipelineTimed(PipelineInfo, Library, Kind))
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    std::lock_guard<std::mutex> Lock(PipelineLibrariesMutex);
+    if (VkPipeline* FoundLibrary = PipelineLibraries.Find(Key))
+    {
+        // Another worker built the same part in the meantime.
+        VulkanApi::vkDestroyPipeline(Device->GetHandle(), Library, VK_CPU_ALLOCATOR);
+        return *FoundLibrary;
+    }
+    PipelineLibraries.Add(Key, Library);
+    return Library;
+}
+
+bool AVulkanPipelineStateManager::LinkGraphicsPipeline(AVulkanGraphicsPipelineState* PSO, bool bOptimized, VkPipeline& OutPipeline)
+{
+    static const VkGraphicsPipelineLibraryFlagsEXT Parts[] = {
+        VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+        VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+        VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+        VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT,
+    };
+
+    VkPipeline Libraries[4];
+    for (int32_t Index = 0; Index < 4; ++Index)
+    {
+        Libraries[Index] = GetOrCreatePipelineLibrary(Parts[Index], PSO);
+        if (Libraries[Index] == VK_NULL_HANDLE)
+        {
+            return false;
+        }
+    }
+
+    VkPipelineLibraryCreateInfoKHR LinkInfo;
+    ZeroVulkanStruct(LinkInfo, VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR);
+    LinkInfo.libraryCount = 4;
+    LinkInfo.pLibraries = Libraries;
+
+    VkGraphicsPipelineCreateInfo PipelineInfo;
+    ZeroVulkanStruct(PipelineInfo, VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
+    PipelineInfo.pNext = &LinkInfo;
+    PipelineInfo.flags = bOptimized ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+    PipelineInfo.layout = PSO->Layout->Handle;
+
+    return CreateGraphicsPipelineTimed(PipelineInfo, OutPipeline, bOptimized ? "optimized link" : "fast link");
+}
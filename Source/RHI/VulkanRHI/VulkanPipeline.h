@@ -2,6 +2,16 @@
 
 #include "VulkanApi.h"
 #include "VulkanResources.h"
+#include "VulkanShaderReflection.h"
+
+#include "Core/Hash.h"
+#include "Core/Package.h"
+#include "Core/Task.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
 
 class AVulkanRHI;
 class AVulkanDevice;
@@ -34,67 +44,558 @@ namespace ShaderStage
     }
 } // namespace ShaderStage
 
+// Pipeline layout merged from the reflection of all stages of a pipeline. Created and shared by the shader
+// manager, pipelines with the same resource interface get the same object.
+struct AVulkanPipelineLayout
+{
+    // A lone uniform buffer at binding 0 of this set receives per-draw data through a dynamic offset when the
+    // shaders name the block or its instance DrawData, e.g. layout(set = 2, binding = 0) uniform DrawData { ... }.
+    // Other uniform buffers there are bound like any other set.
+    static constexpr uint32_t DrawDataSetIndex = 2;
+
+    struct ABinding
+    {
+        uint32_t Binding;
+        VkDescriptorType Type;
+        uint32_t Count;
+        VkShaderStageFlags StageFlags;
+    };
+
+    VkPipelineLayout Handle;
+
+    uint32_t NumSetLayouts;
+    VkDescriptorSetLayout SetLayouts[MaxDescriptorSets];
+    // Sorted by binding.
+    TArray<ABinding> SetBindings[MaxDescriptorSets];
+
+    // Size is 0 without push constants.
+    VkPushConstantRange PushConstantRange;
+
+    // The set at AVulkanBindlessHeap::BindlessSetIndex is the bindless heap.
+    bool bBindless;
+    bool bDynamicDrawData;
+};
+
+// Shader modules deduplicated by the XXH64 of their SPIR-V, so the same code behind different paths is
+// created once. Every Get adds a reference, unreferenced modules stay cached until ReleaseUnusedShaders().
+// Shaders below the root of a mounted package are created straight from the mapped package.
 class AVulkanShaderManager
 {
 public:
     AVulkanShaderManager(AVulkanDevice* Device);
     ~AVulkanShaderManager();
 
+    // Falls back to loose files if the package is missing.
+    bool MountPackage(const AString& Filename, const AString& Root);
+
     VkShaderModule GetOrCreateShader(const AnsiChar* Spirv);
+    // Hash of the SPIR-V words, read once per path and cached. Zero when the shader can't be read.
+    uint64_t GetContentHash(const AString& Spirv);
+    // Reads the file and creates the module on a worker thread, the caller is resumed on that worker.
+    TTask<VkShaderModule> GetOrCreateShaderAsync(AString Spirv);
+    void ReleaseShader(VkShaderModule ShaderModule);
+
+    // Destroys the modules without references, returns how many were destroyed.
+    uint32_t ReleaseUnusedShaders();
+    void LogStats();
+
+    // Valid while the module is referenced.
+    const AVulkanShaderReflection* FindReflection(VkShaderModule ShaderModule);
+    // Merges the interface of the given modules (null handles are skipped). The layout lives as long as the manager.
+    const AVulkanPipelineLayout* GetOrCreatePipelineLayout(const VkShaderModule* ShaderModules, uint32_t NumShaderModules);
 
 private:
-    static TArray<uint32_t> ReadSpirv(const AnsiChar* Spirv);
+    struct AShaderModule
+    {
+        VkShaderModule Handle;
+        int32_t RefCount;
+        uint32_t CodeSize;
+        AVulkanShaderReflection* Reflection;
+    };
+
+    struct ADescriptorSetLayout
+    {
+        TArray<AVulkanPipelineLayout::ABinding> Bindings;
+        VkDescriptorSetLayout Handle;
+    };
+
+    static bool ReadSpirv(const AnsiChar* Spirv, TArray<uint32_t>& OutCode);
+    const APackage::AEntry* FindPackageEntry(const AString& Spirv) const;
+
+    VkShaderModule FindShader(uint64_t PathHash);
+    VkShaderModule FindShaderByContent(uint64_t PathHash, uint64_t ContentHash);
+    VkShaderModule LoadShader(uint64_t PathHash, const AString& Spirv);
+    VkShaderModule CreateShader(uint64_t ContentHash, const uint32_t* SpirvCode, size_t CodeSize);
+
+    VkDescriptorSetLayout GetOrCreateDescriptorSetLayout(const TArray<AVulkanPipelineLayout::ABinding>& Bindings);
 
 private:
-    TMap<uint64_t, VkShaderModule> ShaderModules;
+    // Read-only once mounted.
+    APackage Package;
+    AString PackageRoot;
+
+    std::mutex ShaderModulesMutex;
+    // Path hash -> content hash, skips reading files that were loaded before.
+    TMap<uint64_t, uint64_t> ContentHashes;
+    TMap<uint64_t, AShaderModule> ShaderModules;
+    TMap<VkShaderModule, uint64_t> ModuleContentHashes;
+
+    uint32_t NumRequests;
+    uint32_t NumPathHits;
+    uint32_t NumContentHits;
+    uint32_t NumModulesCreated;
+    uint64_t NumBytesRead;
+
+    // Keyed by the hash of the bindings, and of the set layouts plus push constant range.
+    std::mutex LayoutsMutex;
+    TMap<uint64_t, TArray<ADescriptorSetLayout>> DescriptorSetLayouts;
+    TMap<uint64_t, TArray<AVulkanPipelineLayout*>> PipelineLayouts;
+
     AVulkanDevice* Device;
 };
 
+class AVulkanPipelineCache
+{
+public:
+    AVulkanPipelineCache(AVulkanDevice* Device);
+    ~AVulkanPipelineCache();
+
+    // Seeds the cache from the file if it was written by the same device and driver, starts empty otherwise.
+    bool Load(const AString& Filename);
+    bool Save(const AString& Filename) const;
+
+    // Thread safe, called for every created pipeline.
+    void AddPipelineStats(double CompileTimeMs, bool bCacheHit);
+    void LogStats() const;
+
+    inline uint32_t GetNumPipelines() const { return NumPipelines.load(std::memory_order_relaxed); }
+    inline uint32_t GetNumCacheHits() const { return NumCacheHits.load(std::memory_order_relaxed); }
+
+    inline VkPipelineCache GetHandle() const { return Handle; }
+
+private:
+    struct AFileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t VendorID;
+        uint32_t DeviceID;
+        uint32_t DriverVersion;
+        uint8_t DriverUUID[VK_UUID_SIZE];
+        uint8_t PipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t DataSize;
+        uint64_t DataHash;
+    };
+
+    void FillFileHeader(AFileHeader& OutHeader) const;
+    bool ValidateCacheData(const AFileHeader& Header, const TArray<uint8_t>& Data) const;
+
+private:
+    VkPipelineCache Handle;
+
+    std::atomic<uint32_t> NumPipelines;
+    std::atomic<uint32_t> NumCacheHits;
+    std::atomic<uint64_t> TotalCompileTimeUs;
+
+    AVulkanDevice* Device;
+};
+
+enum
+{
+    MaxVertexElements = 16,
+    MaxSpecializationConstants = 8,
+};
+
+// Feature variant of a pipeline's shaders. Variants are compiled from the same SPIR-V through specialization
+// constants, so the driver folds the branches away without one module per variant. Ids are the constant_id
+// of the shader declarations, e.g. layout(constant_id = 0) const bool bAlphaTest = false;
+// Plain old data kept sorted by id, equal permutations compare and hash equal.
+struct AShaderPermutation
+{
+    uint32_t ConstantIds[MaxSpecializationConstants];
+    uint32_t Values[MaxSpecializationConstants];
+    uint32_t NumConstants;
+    uint32_t Padding;
+
+    AShaderPermutation() { AMemory::Memzero(*this); }
+
+    AShaderPermutation& Set(uint32_t ConstantId, uint32_t Value);
+    inline AShaderPermutation& Set(uint32_t ConstantId, int32_t Value) { return Set(ConstantId, static_cast<uint32_t>(Value)); }
+    inline AShaderPermutation& Set(uint32_t ConstantId, bool bValue) { return Set(ConstantId, static_cast<uint32_t>(bValue ? VK_TRUE : VK_FALSE)); }
+    AShaderPermutation& Set(uint32_t ConstantId, float Value);
+
+    inline bool IsEmpty() const { return NumConstants == 0; }
+};
+
+// Complete key of a graphics pipeline. Plain old data without padding, built zeroed so that hashing
+// and comparison are plain memory operations and two descs are equal iff they create the same VkPipeline.
 struct AVulkanGraphicsPipelineDesc
 {
-    uint32_t Topology;
+    struct AVertexBinding
+    {
+        uint32_t Stride;
+        uint16_t Binding;
+        uint16_t InputRate;
+
+        void ReadFrom(const VkVertexInputBindingDescription& InState);
+        void WriteInto(VkVertexInputBindingDescription& OutState) const;
+    };
+
+    struct AVertexAttribute
+    {
+        uint32_t Location;
+        uint32_t Binding;
+        uint32_t Format;
+        uint32_t Offset;
+
+        void ReadFrom(const VkVertexInputAttributeDescription& InState);
+        void WriteInto(VkVertexInputAttributeDescription& OutState) const;
+    };
+
+    struct ABlendAttachment
+    {
+        uint8_t bBlend;
+        uint8_t ColorBlendOp;
+        uint8_t SrcColorBlendFactor;
+        uint8_t DstColorBlendFactor;
+        uint8_t AlphaBlendOp;
+        uint8_t SrcAlphaBlendFactor;
+        uint8_t DstAlphaBlendFactor;
+        uint8_t ColorWriteMask;
+
+        void ReadFrom(const VkPipelineColorBlendAttachmentState& InState);
+        void WriteInto(VkPipelineColorBlendAttachmentState& OutState) const;
+    };
+
+    struct ARasterizer
+    {
+        uint8_t PolygonMode;
+        uint8_t CullMode;
+        uint8_t FrontFace;
+        uint8_t bDepthClamp;
+        uint8_t bDepthBias;
+        uint8_t Padding[3];
+        float DepthBiasConstantFactor;
+        float DepthBiasSlopeFactor;
+
+        void WriteInto(VkPipelineRasterizationStateCreateInfo& OutState) const;
+    };
+
+    struct AStencilOp
+    {
+        uint8_t FailOp;
+        uint8_t PassOp;
+        uint8_t DepthFailOp;
+        uint8_t CompareOp;
+        uint32_t CompareMask;
+        uint32_t WriteMask;
+        uint32_t Reference;
+
+        void ReadFrom(const VkStencilOpState& InState);
+
+        void WriteInto(VkStencilOpState& OutState) const;
+    };
+
+    struct ADepthStencil
+    {
+        uint8_t bDepthTest;
+        uint8_t bDepthWrite;
+        uint8_t DepthCompareOp;
+        uint8_t bStencilTest;
+        AStencilOp Front;
+        AStencilOp Back;
+        uint8_t bDepthBoundsTest;
+        uint8_t Padding[3];
+        float MinDepthBounds;
+        float MaxDepthBounds;
+
+        void WriteInto(VkPipelineDepthStencilStateCreateInfo& OutState) const;
+    };
+
+    // Everything render pass compatibility depends on.
+    struct ARenderPass
+    {
+        uint32_t ColorFormats[MaxSimultaneousRenderTargets];
+        uint32_t DepthStencilFormat;
+        uint8_t NumColorAttachments;
+        uint8_t NumSamples;
+        uint8_t SubpassIndex;
+        // ESubpassHint, the subpass structure is part of compatibility.
+        uint8_t SubpassHint;
+        // Resolve attachments are part of compatibility too, one bit per color attachment.
+        uint8_t ResolveMask;
+        uint8_t bDepthStencilResolve;
+        uint8_t Padding[2];
+
+        void ReadFrom(const AVulkanRenderTargetLayout& RTLayout);
+        // Color attachments of the subpass the pipeline is drawn in.
+        uint32_t GetNumSubpassColorAttachments() const;
+    };
+
+    // Hashes of the SPIR-V code, see AVulkanShaderManager::GetContentHash().
+    uint64_t ShaderHashes[ShaderStage::NumStages];
+
+    AVertexBinding VertexBindings[MaxVertexElements];
+    AVertexAttribute VertexAttributes[MaxVertexElements];
+    ABlendAttachment BlendAttachments[MaxSimultaneousRenderTargets];
+    float BlendConstants[4];
+    ARasterizer Rasterizer;
+    ADepthStencil DepthStencil;
+    ARenderPass RenderPass;
+    // Applied to every stage, stages ignore ids they do not declare.
+    AShaderPermutation Permutation;
+
+    uint8_t NumVertexBindings;
+    uint8_t NumVertexAttributes;
+    uint8_t Topology;
+    uint8_t bAlphaToCoverage;
+    // Rounds the size up to the alignment of ShaderHashes, trailing padding would not survive a copy.
+    uint32_t Padding[2];
+
+    AVulkanGraphicsPipelineDesc() { AMemory::Memzero(*this); }
+
+    inline uint64_t GetHash() const { return AHash::Memory(*this); }
+    inline bool operator==(const AVulkanGraphicsPipelineDesc& Other) const { return AMemory::Memcmp(this, &Other, sizeof(*this)) == 0; }
+};
+
+template <>
+struct std::hash<AVulkanGraphicsPipelineDesc>
+{
+    size_t operator()(const AVulkanGraphicsPipelineDesc& Desc) const { return static_cast<size_t>(Desc.GetHash()); }
+};
+
+// What a caller describes, the manager turns it into an AVulkanGraphicsPipelineDesc.
+struct AGraphicsPipelineStateInitializer
+{
+    AString Spirvs[ShaderStage::NumStages];
+
+    TArray<VkVertexInputBindingDescription> VertexBindings;
+    TArray<VkVertexInputAttributeDescription> VertexAttributes;
+    VkPipelineColorBlendAttachmentState BlendStates[MaxSimultaneousRenderTargets];
+
+    VkPrimitiveTopology Topology;
+    VkPolygonMode PolygonMode;
+    VkCullModeFlags CullMode;
+    VkFrontFace FrontFace;
+
+    bool bDepthTest;
+    bool bDepthWrite;
+    VkCompareOp DepthCompareOp;
+    bool bDepthBoundsTest;
+    float MinDepthBounds;
+    float MaxDepthBounds;
+
+    // Masks and references are baked into the pipeline, none of them is dynamic state.
+    bool bStencilTest;
+    VkStencilOpState FrontStencil;
+    VkStencilOpState BackStencil;
+
+    float BlendConstants[4];
+    // Coverage of multisampled attachments from the alpha of the first color output.
+    bool bAlphaToCoverage;
+
     uint8_t SubpassIndex;
 
-    const AnsiChar* Spirvs[ShaderStage::NumStages];
+    AShaderPermutation Permutation;
+
+    // Content hashes of Spirvs, filled by the first desc built from the initializer so the draws after it don't
+    // go through the shader manager. A stage is hashed again once its path differs from HashedSpirvs.
+    mutable uint64_t ShaderHashes[ShaderStage::NumStages];
+    mutable AString HashedSpirvs[ShaderStage::NumStages];
+
+    AGraphicsPipelineStateInitializer();
 };
 
 class AVulkanGraphicsPipelineState
 {
 public:
-    AVulkanGraphicsPipelineState(AVulkanDevice* Device, const AVulkanGraphicsPipelineDesc& Desc);
+    AVulkanGraphicsPipelineState(AVulkanDevice* Device, const AVulkanGraphicsPipelineDesc& Desc, const AString (&Spirvs)[ShaderStage::NumStages]);
     ~AVulkanGraphicsPipelineState();
 
     void Bind(AVulkanCommandBuffer* CmdBuffer);
 
+    enum class EStatus : uint8_t
+    {
+        Pending,
+        Ready,
+        Failed,
+    };
+
+    // Written by the compiling worker, Pipeline is valid once the status reads Ready.
+    inline EStatus GetStatus() const { return Status.load(std::memory_order_acquire); }
+    inline bool IsReady() const { return GetStatus() == EStatus::Ready; }
+    inline bool IsPending() const { return GetStatus() == EStatus::Pending; }
+
+    inline const AVulkanGraphicsPipelineDesc& GetDesc() const { return Desc; }
+    inline VkShaderModule GetShaderModule(ShaderStage::EStage Stage) const { return ShaderModules[Stage]; }
+    // Set once the pipeline is ready.
+    inline const AVulkanPipelineLayout* GetLayout() const { return Layout; }
+
 private:
     void FindOrCreateShaderModules();
+    // Modules are only needed to build the pipeline.
+    void ReleaseShaderModules();
 
 private:
     AVulkanGraphicsPipelineDesc Desc;
+    AString Spirvs[ShaderStage::NumStages];
     VkShaderModule ShaderModules[ShaderStage::NumStages];
 
-    VkPipelineLayout Layout;
+    // Owned by the shader manager, set once the modules are loaded.
+    const AVulkanPipelineLayout* Layout;
     VkPipeline Pipeline;
+    // Link time optimized replacement built from pipeline libraries, swapped in by the manager.
+    VkPipeline OptimizedPipeline;
+
+    std::atomic<EStatus> Status;
+    TTask<void> CompileTask;
 
-    AVulkanRenderPass* RenderPass;
+    // Any render pass compatible with Desc.RenderPass.
+    VkRenderPass RenderPass;
     AVulkanDevice* Device;
 
     friend AVulkanPipelineStateManager;
 };
 
+// Every pipeline created during a capture run, replayed at startup to compile them ahead of use.
+class AVulkanPipelineManifest
+{
+public:
+    struct AEntry
+    {
+        AVulkanGraphicsPipelineDesc Desc;
+        AString Spirvs[ShaderStage::NumStages];
+    };
+
+    // Reads the entries of an existing manifest, files of another desc layout are ignored.
+    bool Load(const AString& Filename);
+    // Loads the file and appends every new desc passed to Record() to it.
+    bool BeginRecording(const AString& Filename);
+    void Record(const AVulkanGraphicsPipelineDesc& Desc, const AString (&Spirvs)[ShaderStage::NumStages]);
+
+    inline bool IsRecording() const { return Recording.is_open(); }
+    inline const TArray<AEntry>& GetEntries() const { return Entries; }
+
+private:
+    struct AFileHeader
+    {
+        uint32_t Magic;
+        uint32_t Version;
+        uint32_t DescSize;
+        uint32_t Padding;
+    };
+
+private:
+    TArray<AEntry> Entries;
+    TMap<AVulkanGraphicsPipelineDesc, int32_t> EntryIndices;
+    std::ofstream Recording;
+};
+
+struct AVulkanPipelineFrameStats
+{
+    uint32_t NumPendingCompiles;
+    uint32_t NumRequestedCompiles;
+    uint32_t NumFinishedCompiles;
+    double CompileTimeMs;
+
+    uint32_t NumFallbackDraws;
+    uint32_t NumSkippedDraws;
+};
+
 class AVulkanPipelineStateManager
 {
 public:
     AVulkanPipelineStateManager(AVulkanDevice* Device);
     ~AVulkanPipelineStateManager();
 
-    AVulkanGraphicsPipelineState* CreateGraphicsPipelineState(AVulkanRenderPass* RenderPass);
+    // RenderPass is nullptr for pipelines used with dynamic rendering, the formats then come from RTLayout alone.
+    // Blocks until the pipeline is compiled.
+    AVulkanGraphicsPipelineState* CreateGraphicsPipelineState(
+        const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass);
+
+    // Never blocks. Queues the compile on the first request and returns the PSO once it is ready, Fallback
+    // (which may be nullptr to skip the draw) until then or if compiling failed. Render thread only.
+    AVulkanGraphicsPipelineState* GetGraphicsPipelineState(const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout,
+        AVulkanRenderPass* RenderPass, AVulkanGraphicsPipelineState* Fallback = nullptr);
+
+    // Queues the compile if the pipeline is unknown, the returned PSO may still be pending.
+    AVulkanGraphicsPipelineState* RequestGraphicsPipelineState(
+        const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass);
+
+    // Single hash probe, nullptr if the pipeline was never requested.
+    AVulkanGraphicsPipelineState* FindGraphicsPipelineState(const AVulkanGraphicsPipelineDesc& Desc) const;
+
+    // Shaders are keyed by their contents, so the same code under two paths shares its pipelines.
+    void BuildGraphicsPipelineDesc(
+        const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout, AVulkanGraphicsPipelineDesc& OutDesc);
+
+    // Closes the frame counters, call once per frame on the render thread.
+    void EndFrame();
+    inline const AVulkanPipelineFrameStats& GetLastFrameStats() const { return LastFrameStats; }
+    inline uint32_t GetNumPendingCompiles() const { return NumPendingCompiles.load(std::memory_order_acquire); }
+
+    // Blocks until every queued compile finished.
+    void WaitForPendingCompiles();
+
+    // Appends every pipeline requested from now on to the manifest file.
+    void BeginManifestCapture(const AString& Filename);
+    // Queues every manifest entry on the workers, returns the number of queued pipelines. With bWait the
+    // call blocks until they are compiled, otherwise the result is logged from EndFrame() once done.
+    uint32_t PrecompileManifest(const AString& Filename, bool bWait);
+    inline bool IsPrecompiling() const { return !PrecompilingPSOs.IsEmpty(); }
 
 private:
+    AVulkanGraphicsPipelineState* QueueGraphicsPipelineState(
+        const AVulkanGraphicsPipelineDesc& Desc, const AString (&Spirvs)[ShaderStage::NumStages], VkRenderPass RenderPass);
+    AVulkanGraphicsPipelineState* AllocateGraphicsPipelineState(
+        const AVulkanGraphicsPipelineDesc& Desc, const AString (&Spirvs)[ShaderStage::NumStages], VkRenderPass RenderPass);
+    TTask<void> CompileGraphicsPipelineAsync(AVulkanGraphicsPipelineState* PSO);
     bool CreateGraphicsPipeline(AVulkanGraphicsPipelineState* PSO);
+    bool CreateGraphicsPipelineTimed(VkGraphicsPipelineCreateInfo& PipelineInfo, VkPipeline& OutPipeline, const AnsiChar* Kind);
+
+    // VK_EXT_graphics_pipeline_library: the four parts are compiled once per distinct subset of the desc
+    // and shared between pipelines, linking them is cheap.
+    static uint64_t GetPipelineLibraryKey(VkGraphicsPipelineLibraryFlagsEXT Part, const AVulkanGraphicsPipelineState* PSO);
+    VkPipeline GetOrCreatePipelineLibrary(VkGraphicsPipelineLibraryFlagsEXT Part, const AVulkanGraphicsPipelineState* PSO);
+    bool LinkGraphicsPipeline(AVulkanGraphicsPipelineState* PSO, bool bOptimized, VkPipeline& OutPipeline);
+    void SwapOptimizedPipelines();
+
+    // Render pass with the attachment formats of the key, only used to compile manifest entries without
+    // dynamic rendering.
+    VkRenderPass GetOrCreateCompatibleRenderPass(const AVulkanGraphicsPipelineDesc::ARenderPass& Key);
+    void ReportPrecompile();
 
 private:
-    TMap<int64_t, AVulkanGraphicsPipelineState*> GraphicsPSOMap;
+    TMap<AVulkanGraphicsPipelineDesc, AVulkanGraphicsPipelineState*> GraphicsPSOMap;
+    TMap<uint64_t, VkRenderPass> CompatibleRenderPasses;
+
+    AVulkanPipelineManifest Manifest;
+    TArray<AVulkanGraphicsPipelineState*> PrecompilingPSOs;
+    std::chrono::steady_clock::time_point PrecompileStart;
+    uint32_t PrecompileBaseCacheHits;
+    uint32_t PrecompileBasePipelines;
+
+
+    std::mutex PipelineLibrariesMutex;
+    TMap<uint64_t, VkPipeline> PipelineLibraries;
+
+    std::mutex OptimizedPSOsMutex;
+    TArray<AVulkanGraphicsPipelineState*> OptimizedPSOs;
+    // Replaced pipelines may still be referenced by frames in flight.
+    TArray<TPair<uint64_t, VkPipeline>> RetiredPipelines;
+    uint64_t FrameNumber;
+
+    enum
+    {
+        // Modules of compiled pipelines stay cached for a while, pipelines of the next frames often share them.
+        NumFramesBetweenShaderCleanups = 300
+    };
+
+    std::atomic<uint32_t> NumPendingCompiles;
+    std::atomic<uint32_t> NumFinishedCompiles;
+    std::atomic<uint64_t> CompileTimeUs;
+    AVulkanPipelineFrameStats FrameStats;
+    AVulkanPipelineFrameStats LastFrameStats;
 
     AVulkanDevice* Device;
 };
@@ -5,31 +5,80 @@
 #include "VulkanMemory.h"
 #include "VulkanSwapChain.h"
 
-AVulkanQueue::AVulkanQueue(AVulkanDevice* InDevice, uint32_t InFamilyIndex) : Device(InDevice), Queue(VK_NULL_HANDLE), FamilyIndex(InFamilyIndex), QueueIndex(0)
+AVulkanQueue::AVulkanQueue(AVulkanDevice* InDevice, uint32_t InFamilyIndex)
+    : Device(InDevice), Queue(VK_NULL_HANDLE), FamilyIndex(InFamilyIndex), QueueIndex(0), Timeline(nullptr), LastSubmittedValue(0)
 {
     VulkanApi::vkGetDeviceQueue(Device->GetHandle(), FamilyIndex, QueueIndex, &Queue);
+
+    Timeline = new AVulkanTimelineSemaphore(Device, LastSubmittedValue);
 }
 
 AVulkanQueue::~AVulkanQueue() 
 {
-    // TODO:
+    delete Timeline;
+    Timeline = nullptr;
 }
 
-void AVulkanQueue::Submit(AVulkanCommandBuffer* CmdBuffer, uint32_t NumWaitSemaphores, VkSemaphore* WaitSemaphores, VkPipelineStageFlags* WaitStageFlags,
-    uint32_t NumSignalSemaphores, VkSemaphore* SignalSemaphores, AVulkanFence* Fence) const
+uint64_t AVulkanQueue::Submit(AVulkanCommandBuffer* CmdBuffer, uint32_t NumWaitSemaphores, VkSemaphore* WaitSemaphores, VkPipelineStageFlags* WaitStageFlags,
+    uint32_t NumSignalSemaphores, VkSemaphore* SignalSemaphores, AVulkanFence* Fence)
 {
     const VkCommandBuffer CmdBuffers[] = { CmdBuffer->GetHandle() };
 
+    // Timeline waits follow the caller's binary semaphores, whose wait values are ignored.
+    TArray<VkSemaphore> AllWaitSemaphores(WaitSemaphores, NumWaitSemaphores);
+    TArray<VkPipelineStageFlags> AllWaitStageFlags(WaitStageFlags, NumWaitSemaphores);
+    TArray<uint64_t> WaitValues(static_cast<int32_t>(NumWaitSemaphores));
+    for (const ATimelineWait& Wait : PendingTimelineWaits)
+    {
+        AllWaitSemaphores.Add(Wait.Semaphore);
+        AllWaitStageFlags.Add(Wait.WaitStageFlags);
+        WaitValues.Add(Wait.Value);
+    }
+    PendingTimelineWaits.Clear();
+
+    // Every submission also signals the queue timeline, values for binary semaphores are ignored.
+    const uint64_t SignalValue = LastSubmittedValue + 1;
+    TArray<VkSemaphore> AllSignalSemaphores(SignalSemaphores, NumSignalSemaphores);
+    AllSignalSemaphores.Add(Timeline->GetHandle());
+    TArray<uint64_t> SignalValues(AllSignalSemaphores.Num());
+    SignalValues[AllSignalSemaphores.Num() - 1] = SignalValue;
+
+    VkTimelineSemaphoreSubmitInfo TimelineInfo;
+    ZeroVulkanStruct(TimelineInfo, VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO);
+    TimelineInfo.waitSemaphoreValueCount = WaitValues.Num();
+    TimelineInfo.pWaitSemaphoreValues = WaitValues.GetData();
+    TimelineInfo.signalSemaphoreValueCount = SignalValues.Num();
+    TimelineInfo.pSignalSemaphoreValues = SignalValues.GetData();
+
     VkSubmitInfo SubmitInfo;
     ZeroVulkanStruct(SubmitInfo, VK_STRUCTURE_TYPE_SUBMIT_INFO);
-    SubmitInfo.waitSemaphoreCount = NumWaitSemaphores; //
-    SubmitInfo.pWaitSemaphores = WaitSemaphores; //
-    SubmitInfo.pWaitDstStageMask = WaitStageFlags;     //
+    SubmitInfo.pNext = &TimelineInfo;
+    SubmitInfo.waitSemaphoreCount = AllWaitSemaphores.Num();
+    SubmitInfo.pWaitSemaphores = AllWaitSemaphores.GetData();
+    SubmitInfo.pWaitDstStageMask = AllWaitStageFlags.GetData();
     SubmitInfo.commandBufferCount = 1;
     SubmitInfo.pCommandBuffers = CmdBuffers;
-    SubmitInfo.signalSemaphoreCount = NumSignalSemaphores;
-    SubmitInfo.pSignalSemaphores = SignalSemaphores;
-    VK_CHECK_RESULT(VulkanApi::vkQueueSubmit(Queue, 1, &SubmitInfo, Fence->GetHandle()));
+    SubmitInfo.signalSemaphoreCount = AllSignalSemaphores.Num();
+    SubmitInfo.pSignalSemaphores = AllSignalSemaphores.GetData();
+    VK_CHECK_RESULT(VulkanApi::vkQueueSubmit(Queue, 1, &SubmitInfo, Fence ? Fence->GetHandle() : VK_NULL_HANDLE));
+
+    LastSubmittedValue = SignalValue;
+    return SignalValue;
+}
+
+void AVulkanQueue::AddTimelineWait(AVulkanTimelineSemaphore* WaitTimeline, uint64_t Value, VkPipelineStageFlags WaitStageFlags)
+{
+    check(WaitTimeline != Timeline, "A queue can't wait on its own timeline.");
+    for (ATimelineWait& Wait : PendingTimelineWaits)
+    {
+        if (Wait.Semaphore == WaitTimeline->GetHandle())
+        {
+            Wait.Value = std::max(Wait.Value, Value);
+            Wait.WaitStageFlags |= WaitStageFlags;
+            return;
+        }
+    }
+    PendingTimelineWaits.Add({ WaitTimeline->GetHandle(), Value, WaitStageFlags });
 }
 
 void AVulkanQueue::Present(uint32_t NumWaitSemaphores, VkSemaphore* WaitSemaphores, VkSwapchainKHR* SwapChains, uint32_t ImageIndex) const
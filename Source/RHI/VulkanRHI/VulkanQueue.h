@@ -5,6 +5,7 @@
 class AVulkanCommandBuffer;
 class AVulkanDevice;
 class AVulkanFence;
+class AVulkanTimelineSemaphore;
 
 class AVulkanQueue
 {
@@ -12,8 +13,12 @@ public:
     AVulkanQueue(AVulkanDevice* Device, uint32_t FamilyIndex);
     ~AVulkanQueue();
 
-    void Submit(AVulkanCommandBuffer* CmdBuffer, uint32_t NumWaitSemaphores, VkSemaphore* WaitSemaphores, VkPipelineStageFlags* WaitStageFlags,
-        uint32_t NumSignalSemaphores, VkSemaphore* SignalSemaphores, AVulkanFence* Fence) const;
+    // Returns the timeline value signaled once the GPU finished the command buffer.
+    uint64_t Submit(AVulkanCommandBuffer* CmdBuffer, uint32_t NumWaitSemaphores, VkSemaphore* WaitSemaphores, VkPipelineStageFlags* WaitStageFlags,
+        uint32_t NumSignalSemaphores, VkSemaphore* SignalSemaphores, AVulkanFence* Fence);
+    // Makes the next Submit() also wait until Timeline reached Value, such as work of another queue the
+    // command buffer depends on. Not thread safe, called by whoever submits to the queue.
+    void AddTimelineWait(AVulkanTimelineSemaphore* WaitTimeline, uint64_t Value, VkPipelineStageFlags WaitStageFlags);
     void Present(uint32_t NumWaitSemaphores, VkSemaphore* WaitSemaphores, VkSwapchainKHR* SwapChains, uint32_t ImageIndex) const;
 
     inline uint32_t GetFamilyIndex() const { return FamilyIndex; }
@@ -21,10 +26,24 @@ public:
 
     inline VkQueue GetHandle() const { return Queue; }
 
+    inline AVulkanTimelineSemaphore* GetTimeline() const { return Timeline; }
+    inline uint64_t GetLastSubmittedValue() const { return LastSubmittedValue; }
+
 private:
     VkQueue Queue;
     uint32_t FamilyIndex;
     uint32_t QueueIndex;
 
+    AVulkanTimelineSemaphore* Timeline;
+    uint64_t LastSubmittedValue;
+
+    struct ATimelineWait
+    {
+        VkSemaphore Semaphore;
+        uint64_t Value;
+        VkPipelineStageFlags WaitStageFlags;
+    };
+    TArray<ATimelineWait> PendingTimelineWaits;
+
     AVulkanDevice* Device;
 };
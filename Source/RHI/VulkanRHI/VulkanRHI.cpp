@@ -1,14 +1,24 @@
 #include "VulkanRHI.h"
 
 #include "VulkanCommandBuffer.h"
+#include "VulkanDescriptorSets.h"
 #include "VulkanDevice.h"
 #include "VulkanMemory.h"
 #include "VulkanPlatform.h"
 #include "VulkanPipeline.h"
 #include "VulkanQueue.h"
 #include "VulkanResources.h"
+#include "VulkanTextureStreaming.h"
+#include "VulkanTextureUpload.h"
 #include "VulkanViewport.h"
 
+#define PIPELINE_MANIFEST_PATH (AString(SAVED_DIR) + "PSOManifest.bin")
+
+// Draw data of the frames in flight.
+static constexpr VkDeviceSize UniformRingBufferSize = 4 * 1024 * 1024;
+// Streamed texture mips until SetBudget() says otherwise.
+static constexpr VkDeviceSize DefaultTextureStreamingBudget = 256 * 1024 * 1024;
+
 static const AnsiChar* DefaultInstanceExtensions[] = { nullptr };
 static int32_t ExplicitAdapterValue = 1;
 
@@ -120,7 +130,10 @@ static void GetInstanceLayersAndExtensions(TArray<const AnsiChar*>& OutInstanceE
 #endif
 }
 
-AVulkanRHI::AVulkanRHI() : Instance(VK_NULL_HANDLE), Device(nullptr), Viewport(nullptr), CmdBuffer(nullptr)
+AVulkanRHI::AVulkanRHI()
+    : Instance(VK_NULL_HANDLE), Device(nullptr), Viewport(nullptr), CmdBuffer(nullptr), RenderPassManager(nullptr), DescriptorAllocator(nullptr),
+      UniformRingBuffer(nullptr), RenderTargetPool(nullptr), TextureUploader(nullptr), TextureStreamer(nullptr), CurrentPSO(nullptr),
+      bDynamicRendering(false), AcquiredBackBuffer(nullptr)
 #if VK_VALIDATION_ENABLE
       , DebugMessenger(VK_NULL_HANDLE)
 #endif   
@@ -147,6 +160,15 @@ AVulkanRHI::AVulkanRHI() : Instance(VK_NULL_HANDLE), Device(nullptr), Viewport(n
 
     PipelineStateManager = new AVulkanPipelineStateManager(Device);
     RenderPassManager = new AVulkanRenderPassManager(Device);
+    DescriptorAllocator = new AVulkanDescriptorAllocator(Device);
+    UniformRingBuffer = new AVulkanRingBuffer(Device, UniformRingBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        Device->GetPhysicalDeviceProperties().limits.minUniformBufferOffsetAlignment);
+    RenderTargetPool = new AVulkanRenderTargetPool(Device);
+    TextureUploader = new AVulkanTextureUploader(Device);
+    TextureStreamer = new AVulkanTextureStreamer(Device, TextureUploader, DefaultTextureStreamingBudget);
+
+    bDynamicRendering = Device->SupportsDynamicRendering();
+    std::cout << "[INFO] " << (bDynamicRendering ? "Using dynamic rendering." : "Using render pass objects.") << "\n";
 }
 
 AVulkanRHI::~AVulkanRHI()
@@ -155,6 +177,16 @@ AVulkanRHI::~AVulkanRHI()
     PipelineStateManager = nullptr;
     delete RenderPassManager;
     RenderPassManager = nullptr;
+    delete DescriptorAllocator;
+    DescriptorAllocator = nullptr;
+    delete UniformRingBuffer;
+    UniformRingBuffer = nullptr;
+    delete RenderTargetPool;
+    RenderTargetPool = nullptr;
+    delete TextureStreamer;
+    TextureStreamer = nullptr;
+    delete TextureUploader;
+    TextureUploader = nullptr;
 
     delete CmdBufferPool;
     CmdBufferPool = nullptr;
@@ -265,10 +297,33 @@ AVulkanTexture* AVulkanRHI::GetViewportBackBuffer(int32_t Index) const
     return Viewport->GetBackBuffer(Index);
 }
 
-AVulkanGraphicsPipelineState* AVulkanRHI::CreateGraphicsPipelineState(const AVulkanRenderTargetLayout& RTLayout)
+AVulkanGraphicsPipelineState* AVulkanRHI::CreateGraphicsPipelineState(
+    const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout)
 {
-    AVulkanRenderPass* RenderPass = RenderPassManager->GetOrCreateRenderPass(RTLayout);
-    return PipelineStateManager->CreateGraphicsPipelineState(RenderPass);
+    AVulkanRenderPass* RenderPass = UseDynamicRendering(RTLayout.SubpassHint) ? nullptr : RenderPassManager->GetOrCreateRenderPass(RTLayout);
+    return PipelineStateManager->CreateGraphicsPipelineState(Initializer, RTLayout, RenderPass);
+}
+
+AVulkanGraphicsPipelineState* AVulkanRHI::GetGraphicsPipelineState(
+    const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout, AVulkanGraphicsPipelineState* Fallback)
+{
+    AVulkanRenderPass* RenderPass = UseDynamicRendering(RTLayout.SubpassHint) ? nullptr : RenderPassManager->GetOrCreateRenderPass(RTLayout);
+    return PipelineStateManager->GetGraphicsPipelineState(Initializer, RTLayout, RenderPass, Fallback);
+}
+
+const AVulkanPipelineFrameStats& AVulkanRHI::GetPipelineFrameStats() const
+{
+    return PipelineStateManager->GetLastFrameStats();
+}
+
+void AVulkanRHI::BeginPipelineManifestCapture()
+{
+    PipelineStateManager->BeginManifestCapture(PIPELINE_MANIFEST_PATH);
+}
+
+uint32_t AVulkanRHI::PrecompilePipelineManifest(bool bWait)
+{
+    return PipelineStateManager->PrecompileManifest(PIPELINE_MANIFEST_PATH, bWait);
 }
 
 void AVulkanRHI::SetViewport(float MinX, float MinY, float MinZ, float MaxZ)
@@ -290,27 +345,113 @@ void AVulkanRHI::SetGraphicsPipelineState(AVulkanGraphicsPipelineState* PSO)
 {
     PSO->Bind(CmdBuffer);
     CmdBuffer->bHasPipeline = true;
+    CurrentPSO = PSO;
+
+    const AVulkanPipelineLayout* Layout = PSO->GetLayout();
+    if (Layout->bBindless)
+    {
+        const VkDescriptorSet BindlessSet = Device->GetBindlessHeap()->GetSet();
+        VulkanApi::vkCmdBindDescriptorSets(CmdBuffer->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, Layout->Handle, AVulkanBindlessHeap::BindlessSetIndex, 1,
+            &BindlessSet, 0, nullptr);
+    }
+}
+
+void AVulkanRHI::SetDescriptorSet(uint32_t SetIndex, const AVulkanDescriptorSetBindings& Bindings, bool bPersistent)
+{
+    check(CurrentPSO, "Descriptor sets are bound for the current pipeline.");
+    const AVulkanPipelineLayout* Layout = CurrentPSO->GetLayout();
+    check(SetIndex < Layout->NumSetLayouts && !(Layout->bBindless && SetIndex == AVulkanBindlessHeap::BindlessSetIndex), "Invalid descriptor set index.");
+
+    const VkDescriptorSetLayout SetLayout = Layout->SetLayouts[SetIndex];
+    const VkDescriptorSet Set = bPersistent ? DescriptorAllocator->GetOrCreatePersistent(SetLayout, Bindings)
+                                            : DescriptorAllocator->AllocateTransient(SetLayout, Bindings);
+    VulkanApi::vkCmdBindDescriptorSets(CmdBuffer->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, Layout->Handle, SetIndex, 1, &Set, 0, nullptr);
+}
+
+void AVulkanRHI::SetDrawData(const void* Data, uint32_t Size)
+{
+    check(CurrentPSO, "Draw data is set for the current pipeline.");
+    const AVulkanPipelineLayout* Layout = CurrentPSO->GetLayout();
+
+    const VkPhysicalDeviceLimits& Limits = Device->GetPhysicalDeviceProperties().limits;
+    const VkPushConstantRange& PushConstantRange = Layout->PushConstantRange;
+    if (PushConstantRange.size != 0 && Size <= PushConstantRange.size && PushConstantRange.offset + Size <= Limits.maxPushConstantsSize)
+    {
+        VulkanApi::vkCmdPushConstants(CmdBuffer->GetHandle(), Layout->Handle, PushConstantRange.stageFlags, PushConstantRange.offset, Size, Data);
+        return;
+    }
+
+    // Draw data too large for the push constants goes through the ring when the shaders also declare the block.
+    check(Layout->bDynamicDrawData, "Draw data fits neither the pipeline's push constants nor a draw data uniform buffer.");
+    check(Size <= Limits.maxUniformBufferRange, "Draw data is larger than a uniform buffer.");
+
+    // The set only names the ring buffer and the range, so it is cached once per size and just re-bound.
+    AVulkanDescriptorSetBindings Bindings;
+    Bindings.SetBuffer(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, UniformRingBuffer->GetHandle(), 0, Size);
+    const VkDescriptorSet Set = DescriptorAllocator->GetOrCreatePersistent(Layout->SetLayouts[AVulkanPipelineLayout::DrawDataSetIndex], Bindings);
+
+    const uint32_t DynamicOffset = static_cast<uint32_t>(UniformRingBuffer->Allocate(Data, Size));
+    VulkanApi::vkCmdBindDescriptorSets(CmdBuffer->GetHandle(), VK_PIPELINE_BIND_POINT_GRAPHICS, Layout->Handle, AVulkanPipelineLayout::DrawDataSetIndex, 1,
+        &Set, 1, &DynamicOffset);
 }
 
 void AVulkanRHI::BeginDrawing()
 {
     CmdBuffer = CmdBufferPool->PrepareCommandBuffer();
     CmdBuffer->Begin();
+
+    TextureUploader->Flush(CmdBuffer);
+    TextureStreamer->Update(CmdBuffer);
 }
 
 void AVulkanRHI::EndDrawing()
 {
     check(CmdBuffer->IsOutsideRenderPass());
+    if (AcquiredBackBuffer)
+    {
+        // Nothing to record when the render graph already left it in the present layout.
+        const VkImageLayout PresentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        CmdBuffer->TransitionLayouts(&AcquiredBackBuffer, &PresentLayout, 1);
+    }
+    AcquiredBackBuffer = nullptr;
     CmdBuffer->End();
 
     Viewport->Present(CmdBuffer, Device->GetGraphicsQueue(), Device->GetPresentQueue(), Fence);
     
     CmdBuffer->Reset();
+
+    Device->ProcessTimelineWaiters();
+    PipelineStateManager->EndFrame();
+    RenderPassManager->EndFrame();
+    DescriptorAllocator->EndFrame();
+    UniformRingBuffer->EndFrame();
+    RenderTargetPool->EndFrame();
+    TextureUploader->EndFrame();
+    TextureStreamer->EndFrame();
+    if (AVulkanBindlessHeap* BindlessHeap = Device->GetBindlessHeap())
+    {
+        BindlessHeap->EndFrame();
+    }
+    CurrentPSO = nullptr;
+}
+
+AVulkanTexture* AVulkanRHI::AcquireNextBackBuffer()
+{
+    if (!AcquiredBackBuffer)
+    {
+        AcquiredBackBuffer = Viewport->AcquireNextBackBuffer();
+    }
+    return AcquiredBackBuffer;
+}
+
+void AVulkanRHI::PipelineBarrier(const VkImageMemoryBarrier2* Barriers, uint32_t NumBarriers)
+{
+    CmdBuffer->PipelineBarrier(Barriers, NumBarriers);
 }
 
 void AVulkanRHI::BeginRenderPass()
 {
-    AVulkanTexture* BackBuffer = Viewport->AcquireNextBackBuffer();
+    AVulkanTexture* BackBuffer = AcquireNextBackBuffer();
 
     AVulkanRenderTargetsInfo RTInfo;
     RTInfo.NumColorRenderTargets = 1;
@@ -320,6 +461,19 @@ void AVulkanRHI::BeginRenderPass()
     ColorRTView.LoadAction = VK_ATTACHMENT_LOAD_OP_CLEAR;
     ColorRTView.StoreAction = VK_ATTACHMENT_STORE_OP_STORE;
 
+    const VkClearValue ClearValues = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
+    CmdBuffer->TransitionRenderTargets(RTInfo);
+    BeginRenderPass(RTInfo, &ClearValues);
+}
+
+void AVulkanRHI::BeginRenderPass(const AVulkanRenderTargetsInfo& RTInfo, const VkClearValue* ClearValues)
+{
+    if (UseDynamicRendering(RTInfo.SubpassHint))
+    {
+        CmdBuffer->BeginRendering(RTInfo, ClearValues);
+        return;
+    }
+
     AVulkanRenderTargetLayout RTLayout(RTInfo);
     check(RTLayout.GetExtent2D().width != 0 && RTLayout.GetExtent2D().height != 0);
 
@@ -327,12 +481,35 @@ void AVulkanRHI::BeginRenderPass()
     AVulkanFramebuffer* Framebuffer = RenderPassManager->GetOrCreateFramebuffer(RTInfo, RTLayout, RenderPass);
     check(RenderPass != nullptr && Framebuffer != nullptr);
 
-    const VkClearValue ClearValues = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-    CmdBuffer->BeginRenderPass(RenderPass, Framebuffer, &ClearValues);
+    CmdBuffer->BeginRenderPass(RenderPass, Framebuffer, ClearValues);
+}
+
+void AVulkanRHI::NotifyDeletedImage(VkImage Image)
+{
+    // The viewport outlives the render pass manager on shutdown.
+    if (RenderPassManager)
+    {
+        RenderPassManager->NotifyDeletedImage(Image);
+    }
+}
+
+bool AVulkanRHI::UseDynamicRendering(ESubpassHint SubpassHint) const
+{
+    return bDynamicRendering && SubpassHint == ESubpassHint::None;
+}
+
+void AVulkanRHI::NextSubpass()
+{
+    CmdBuffer->NextSubpass();
 }
 
 void AVulkanRHI::EndRenderPass()
 {
+    if (!CmdBuffer->GetCurrentRenderPass())
+    {
+        CmdBuffer->EndRendering();
+        return;
+    }
     CmdBuffer->EndRenderPass();
 }
 
@@ -2,24 +2,37 @@
 
 #include "VulkanApi.h"
 
+#include "Core/Task.h"
+
 #if VK_VALIDATION_ENABLE
 #include "VulkanValidation.h"
 #endif // VULKAN_VALIDATION_ENABLE
 
 class AVulkanCommandBuffer;
 class AVulkanCommandBufferPool;
+class AVulkanDescriptorAllocator;
+class AVulkanDescriptorSetBindings;
 class AVulkanDevice;
 class AVulkanFence;
+struct AGraphicsPipelineStateInitializer;
 class AVulkanGraphicsPipelineState;
 class AVulkanPipeline;
 class AVulkanPipelineStateManager;
+struct AVulkanPipelineFrameStats;
 class AVulkanRenderPass;
 class AVulkanRenderPassManager;
 class AVulkanRenderTargetLayout;
+class AVulkanRenderTargetPool;
+class AVulkanRingBuffer;
+class AVulkanTextureStreamer;
+class AVulkanTextureUploader;
 class AVulkanViewport;
 
+struct AVulkanRenderTargetsInfo;
 struct AVulkanTexture;
 
+enum class ESubpassHint : uint8_t;
+
 class AVulkanRHI
 {
 public:
@@ -36,24 +49,60 @@ private:
 public:
     void CreateViewport(void* WindowHandle, uint32_t SizeX, uint32_t SizeY, bool bIsFullscreen);
     AVulkanTexture* GetViewportBackBuffer(int32_t Index) const;
-
-    AVulkanGraphicsPipelineState* CreateGraphicsPipelineState(const AVulkanRenderTargetLayout& RTLayout /* GraphicsPSO Struct */);
+    inline AVulkanRenderTargetPool* GetRenderTargetPool() const { return RenderTargetPool; }
+    // Uploads are recorded by BeginDrawing(), the textures can be sampled by everything drawn after it.
+    inline AVulkanTextureUploader* GetTextureUploader() const { return TextureUploader; }
+    // Streamed textures swap to their new mips in BeginDrawing(), fetch their texture after it.
+    inline AVulkanTextureStreamer* GetTextureStreamer() const { return TextureStreamer; }
+
+    AVulkanGraphicsPipelineState* CreateGraphicsPipelineState(const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout);
+    // Compiles in the background, returns Fallback (nullptr skips the draw) until the pipeline is ready.
+    AVulkanGraphicsPipelineState* GetGraphicsPipelineState(const AGraphicsPipelineStateInitializer& Initializer, const AVulkanRenderTargetLayout& RTLayout,
+        AVulkanGraphicsPipelineState* Fallback = nullptr);
+    const AVulkanPipelineFrameStats& GetPipelineFrameStats() const;
+
+    // Records every created pipeline to Saved/PSOManifest.bin.
+    void BeginPipelineManifestCapture();
+    // Compiles the recorded pipelines on the workers, blocking or progressively while frames render.
+    uint32_t PrecompilePipelineManifest(bool bWait);
 
     void SetViewport(float MinX, float MinY, float MinZ = 0.0f, float MaxZ = 1.0f);
     void SetViewport(float MinX, float MinY, float MinZ, float MaxX, float MaxY, float MaxZ);
     void SetScissorRect(int32_t MinX, int32_t MinY, int32_t MaxX, int32_t MaxY);
     void SetGraphicsPipelineState(AVulkanGraphicsPipelineState* PSO);
+    // Binds the resources of SetIndex for the current pipeline. Transient sets are rewritten every call,
+    // persistent ones are cached by their contents and suit bindings that rarely change.
+    void SetDescriptorSet(uint32_t SetIndex, const AVulkanDescriptorSetBindings& Bindings, bool bPersistent = false);
+    // Per-draw parameters such as transforms, for the current pipeline. Pushed as constants when its shaders
+    // declare a push constant block the data fits in, within maxPushConstantsSize. Otherwise copied to the
+    // uniform ring and bound through a dynamic offset at AVulkanPipelineLayout::DrawDataSetIndex, which needs
+    // the shaders to declare the DrawData block. Neither path writes a descriptor set per draw.
+    void SetDrawData(const void* Data, uint32_t Size);
 
     void BeginDrawing();
     void EndDrawing();
-    void BeginRenderPass(/* TODO: Render Pass Struct. */);
+    // Acquired once per frame, presented by EndDrawing().
+    AVulkanTexture* AcquireNextBackBuffer();
+    // Clears the acquired back buffer and renders to it.
+    void BeginRenderPass();
+    // The attachments must already be in their attachment layouts, ClearValues holds the colors first, then depth.
+    void BeginRenderPass(const AVulkanRenderTargetsInfo& RTInfo, const VkClearValue* ClearValues);
+    // Moves to the next subpass of a render pass begun with a SubpassHint.
+    void NextSubpass();
     void EndRenderPass();
+    void PipelineBarrier(const VkImageMemoryBarrier2* Barriers, uint32_t NumBarriers);
 
     void DrawPrimitive(uint32_t FirstVertexIndex, uint32_t NumPrimitives);
+    // Called by AVulkanDevice::NotifyDeletedImage().
+    void NotifyDeletedImage(VkImage Image);
     void WaitIdle();
 
     AVulkanViewport* Viewport;
 
+private:
+    // Subpasses need render pass objects, dynamic rendering has none.
+    bool UseDynamicRendering(ESubpassHint SubpassHint) const;
+
 private:
     VkInstance Instance;
     TArray<const AnsiChar*> InstanceExtensions;
@@ -74,4 +123,15 @@ private:
 
     AVulkanPipelineStateManager* PipelineStateManager;
     AVulkanRenderPassManager* RenderPassManager;
+    AVulkanDescriptorAllocator* DescriptorAllocator;
+    AVulkanRingBuffer* UniformRingBuffer;
+    AVulkanRenderTargetPool* RenderTargetPool;
+    AVulkanTextureUploader* TextureUploader;
+    AVulkanTextureStreamer* TextureStreamer;
+
+    AVulkanGraphicsPipelineState* CurrentPSO;
+
+    // Render passes and framebuffers are skipped when the device supports dynamic rendering.
+    bool bDynamicRendering;
+    AVulkanTexture* AcquiredBackBuffer;
 };
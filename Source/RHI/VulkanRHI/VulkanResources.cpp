@@ -3,6 +3,8 @@
 #include "VulkanDevice.h"
 #include "VulkanCommandBuffer.h"
 
+#include "Core/Hash.h"
+
 static constexpr const VkImageTiling VulkanViewTypeTilingMode[VK_IMAGE_VIEW_TYPE_RANGE_SIZE] = {
     VK_IMAGE_TILING_LINEAR,  // VK_IMAGE_VIEW_TYPE_1D
     VK_IMAGE_TILING_OPTIMAL, // VK_IMAGE_VIEW_TYPE_2D
@@ -203,9 +205,10 @@ static constexpr const VkImageTiling VulkanViewTypeTilingMode[VK_IMAGE_VIEW_TYPE
 //}
 
 AVulkanTexture::AVulkanTexture(AVulkanDevice* InDevice, VkImageViewType InViewType, VkFormat InFormat, uint32_t SizeX, uint32_t SizeY, uint32_t SizeZ,
-    uint32_t InArraySize, uint32_t InNumMips, uint32_t InNumSamples, VkImageAspectFlags InAspectFlags)
+    uint32_t InArraySize, uint32_t InNumMips, uint32_t InNumSamples, VkImageAspectFlags InAspectFlags, VkImageUsageFlags InUsage, bool bBindMemory)
     : Device(InDevice), ViewType(InViewType), PixelFormat(InFormat), Width(SizeX), Height(SizeY), Depth(SizeZ), ArraySize(InArraySize), NumMips(InNumMips),
-      NumSamples(InNumSamples), AspectMask(InAspectFlags), Image(VK_NULL_HANDLE), View(VK_NULL_HANDLE)
+      NumSamples(InNumSamples), AspectMask(InAspectFlags), Image(VK_NULL_HANDLE), View(VK_NULL_HANDLE), Memory(VK_NULL_HANDLE), bOwnsImage(true),
+      Layout(VK_IMAGE_LAYOUT_UNDEFINED)
     //, Surface(Device, ViewType, Format, SizeX, SizeY, SizeZ, ArraySize, NumMips, NumSamples, AspectFlags)
 {
     Tiling = VulkanViewTypeTilingMode[ViewType];
@@ -271,10 +274,13 @@ AVulkanTexture::AVulkanTexture(AVulkanDevice* InDevice, VkImageViewType InViewTy
     ImageInfo.pQueueFamilyIndices = nullptr;
     ImageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-    ImageInfo.usage = 0;
-    ImageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-    ImageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-    ImageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    ImageInfo.usage = InUsage;
+    if ((InUsage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) == 0)
+    {
+        ImageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        ImageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        ImageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+    }
 
     const VkFormatProperties* FormatProperties = Device->GetFormatProperties();
     const VkFormatFeatureFlags FormatFlags = FormatProperties[PixelFormat].optimalTilingFeatures;
@@ -323,6 +329,20 @@ AVulkanTexture::AVulkanTexture(AVulkanDevice* InDevice, VkImageViewType InViewTy
     //check(Surface.PixelFormat != VK_FORMAT_UNDEFINED, "Undefined pixel format.");
     check(PixelFormat != VK_FORMAT_UNDEFINED, "Undefined pixel format.");
 
+    if (!bBindMemory)
+    {
+        return;
+    }
+
+    const VkMemoryRequirements MemoryRequirements = GetMemoryRequirements();
+
+    VkMemoryAllocateInfo AllocateInfo;
+    ZeroVulkanStruct(AllocateInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
+    AllocateInfo.allocationSize = MemoryRequirements.size;
+    AllocateInfo.memoryTypeIndex = Device->FindMemoryTypeIndex(MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VK_CHECK_RESULT(VulkanApi::vkAllocateMemory(Device->GetHandle(), &AllocateInfo, VK_CPU_ALLOCATOR, &Memory));
+    VK_CHECK_RESULT(VulkanApi::vkBindImageMemory(Device->GetHandle(), Image, Memory, 0));
+
     CreateTextureView();
     //bool bIsArray = ViewType == VK_IMAGE_VIEW_TYPE_1D_ARRAY || ViewType == VK_IMAGE_VIEW_TYPE_2D_ARRAY || ViewType == VK_IMAGE_VIEW_TYPE_CUBE_ARRAY;
     //TextureView.Create(Device, Surface.Image, ViewType, Surface.AspectMask, Surface.PixelFormat, 0, std::max(NumMips, 1u), 0,
@@ -332,7 +352,8 @@ AVulkanTexture::AVulkanTexture(AVulkanDevice* InDevice, VkImageViewType InViewTy
 AVulkanTexture::AVulkanTexture(AVulkanDevice* InDevice, VkImageViewType InViewType, VkFormat InFormat, uint32_t SizeX, uint32_t SizeY, uint32_t SizeZ,
     uint32_t InArraySize, uint32_t InNumMips, uint32_t InNumSamples, VkImageAspectFlags InAspectFlags, VkImage InImage)
     : Device(InDevice), ViewType(InViewType), PixelFormat(InFormat), Width(SizeX), Height(SizeY), Depth(SizeZ), ArraySize(InArraySize), NumMips(InNumMips),
-      NumSamples(InNumSamples), AspectMask(InAspectFlags), Image(InImage), View(VK_NULL_HANDLE)
+      NumSamples(InNumSamples), AspectMask(InAspectFlags), Image(InImage), View(VK_NULL_HANDLE), Memory(VK_NULL_HANDLE), bOwnsImage(false),
+      Layout(VK_IMAGE_LAYOUT_UNDEFINED)
 {
     Tiling = VulkanViewTypeTilingMode[ViewType];
 
@@ -348,6 +369,20 @@ AVulkanTexture::AVulkanTexture(AVulkanDevice* InDevice, VkImageViewType InViewTy
     //}
 }
 
+VkMemoryRequirements AVulkanTexture::GetMemoryRequirements() const
+{
+    VkMemoryRequirements MemoryRequirements;
+    VulkanApi::vkGetImageMemoryRequirements(Device->GetHandle(), Image, &MemoryRequirements);
+    return MemoryRequirements;
+}
+
+void AVulkanTexture::BindMemory(VkDeviceMemory InMemory, VkDeviceSize Offset)
+{
+    check(bOwnsImage && Memory == VK_NULL_HANDLE && View == VK_NULL_HANDLE, "Texture memory is already bound.");
+    VK_CHECK_RESULT(VulkanApi::vkBindImageMemory(Device->GetHandle(), Image, InMemory, Offset));
+    CreateTextureView();
+}
+
 void AVulkanTexture::CreateTextureView()
 {
     VkImageViewCreateInfo ViewInfo;
@@ -398,12 +433,181 @@ AVulkanTexture::~AVulkanTexture()
     {
         VulkanApi::vkDestroyImageView(Device->GetHandle(), View, VK_CPU_ALLOCATOR);
         View = VK_NULL_HANDLE;
-        Image = VK_NULL_HANDLE;
     }
     if (Image != VK_NULL_HANDLE)
+    {
+        Device->NotifyDeletedImage(Image);
+    }
+    // Only images we created, the swapchain owns its own.
+    if (bOwnsImage && Image != VK_NULL_HANDLE)
     {
         VulkanApi::vkDestroyImage(Device->GetHandle(), Image, VK_CPU_ALLOCATOR);
     }
+    Image = VK_NULL_HANDLE;
+    if (Memory != VK_NULL_HANDLE)
+    {
+        VulkanApi::vkFreeMemory(Device->GetHandle(), Memory, VK_CPU_ALLOCATOR);
+        Memory = VK_NULL_HANDLE;
+    }
+}
+
+AVulkanBuffer::AVulkanBuffer(AVulkanDevice* InDevice, VkDeviceSize InSize, VkBufferUsageFlags InUsage, VkMemoryPropertyFlags InMemoryFlags)
+    : Buffer(VK_NULL_HANDLE), Memory(VK_NULL_HANDLE), Size(InSize), Usage(InUsage), MemoryFlags(InMemoryFlags), MappedData(nullptr), Device(InDevice)
+{
+    VkBufferCreateInfo BufferInfo;
+    ZeroVulkanStruct(BufferInfo, VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO);
+    BufferInfo.size = Size;
+    BufferInfo.usage = Usage;
+    BufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    VK_CHECK_RESULT(VulkanApi::vkCreateBuffer(Device->GetHandle(), &BufferInfo, VK_CPU_ALLOCATOR, &Buffer));
+
+    VkMemoryRequirements MemoryRequirements;
+    VulkanApi::vkGetBufferMemoryRequirements(Device->GetHandle(), Buffer, &MemoryRequirements);
+
+    VkMemoryAllocateInfo AllocateInfo;
+    ZeroVulkanStruct(AllocateInfo, VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO);
+    AllocateInfo.allocationSize = MemoryRequirements.size;
+    AllocateInfo.memoryTypeIndex = Device->FindMemoryTypeIndex(MemoryRequirements.memoryTypeBits, MemoryFlags);
+    VK_CHECK_RESULT(VulkanApi::vkAllocateMemory(Device->GetHandle(), &AllocateInfo, VK_CPU_ALLOCATOR, &Memory));
+    VK_CHECK_RESULT(VulkanApi::vkBindBufferMemory(Device->GetHandle(), Buffer, Memory, 0));
+
+    if (MemoryFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void* Data = nullptr;
+        VK_CHECK_RESULT(VulkanApi::vkMapMemory(Device->GetHandle(), Memory, 0, VK_WHOLE_SIZE, 0, &Data));
+        MappedData = static_cast<uint8_t*>(Data);
+    }
+}
+
+AVulkanBuffer::~AVulkanBuffer()
+{
+    if (MappedData)
+    {
+        VulkanApi::vkUnmapMemory(Device->GetHandle(), Memory);
+    }
+    VulkanApi::vkDestroyBuffer(Device->GetHandle(), Buffer, VK_CPU_ALLOCATOR);
+    VulkanApi::vkFreeMemory(Device->GetHandle(), Memory, VK_CPU_ALLOCATOR);
+}
+
+AVulkanRenderTargetPool::AVulkanRenderTargetPool(AVulkanDevice* InDevice, uint32_t InMaxUnusedFrames)
+    : MaxUnusedFrames(std::max<uint32_t>(InMaxUnusedFrames, NumFramesInFlight)), FrameNumber(0), Device(InDevice)
+{
+}
+
+AVulkanRenderTargetPool::~AVulkanRenderTargetPool()
+{
+    // The owner waits for the GPU before destroying the pool.
+    for (auto& [Hash, Bucket] : Elements)
+    {
+        for (AElement* Element : Bucket)
+        {
+            check(!Element->bInUse, "Render target was not released before the pool was destroyed.");
+            delete Element->Texture;
+            delete Element;
+        }
+    }
+    Elements.Clear();
+}
+
+uint64_t AVulkanRenderTargetPool::GetHash(const AVulkanRenderTargetDesc& Desc)
+{
+    static_assert(sizeof(AVulkanRenderTargetDesc) == 7 * sizeof(uint32_t), "AVulkanRenderTargetDesc must not contain padding.");
+    return AHash::Memory(Desc);
+}
+
+AVulkanTexture* AVulkanRenderTargetPool::Acquire(const AVulkanRenderTargetDesc& Desc)
+{
+    check(Desc.Format != VK_FORMAT_UNDEFINED && Desc.Width != 0 && Desc.Height != 0, "Invalid render target desc.");
+    ++Stats.NumRequests;
+
+    TArray<AElement*>& Bucket = Elements[GetHash(Desc)];
+    for (AElement* Element : Bucket)
+    {
+        if (!Element->bInUse && Element->Desc == Desc && FrameNumber >= Element->ReleaseFrame + NumFramesInFlight)
+        {
+            Element->bInUse = true;
+            ++Stats.NumHits;
+            return Element->Texture;
+        }
+    }
+
+    AElement* Element = new AElement();
+    Element->Desc = Desc;
+    Element->Texture = new AVulkanTexture(Device, VK_IMAGE_VIEW_TYPE_2D, Desc.Format, Desc.Width, Desc.Height, 1, 1, Desc.NumMips, Desc.NumSamples,
+        Desc.AspectMask, Desc.Usage);
+    Element->Size = Element->Texture->GetMemoryRequirements().size;
+    Element->bInUse = true;
+    Element->ReleaseFrame = 0;
+    Bucket.Add(Element);
+    return Element->Texture;
+}
+
+void AVulkanRenderTargetPool::Release(AVulkanTexture* Texture)
+{
+    // Releases are rare, the usage isn't kept on the texture to find its bucket directly.
+    for (auto& [Hash, Bucket] : Elements)
+    {
+        for (AElement* Element : Bucket)
+        {
+            if (Element->Texture == Texture)
+            {
+                check(Element->bInUse, "Render target released twice.");
+                Element->bInUse = false;
+                Element->ReleaseFrame = FrameNumber;
+                return;
+            }
+        }
+    }
+    check(false, "Render target doesn't belong to the pool.");
+}
+
+void AVulkanRenderTargetPool::EndFrame()
+{
+    TArray<uint64_t> EmptyBuckets;
+    for (auto& [Hash, Bucket] : Elements)
+    {
+        for (int32_t Index = Bucket.Num() - 1; Index >= 0; --Index)
+        {
+            AElement* Element = Bucket[Index];
+            if (!Element->bInUse && FrameNumber >= Element->ReleaseFrame + MaxUnusedFrames)
+            {
+                delete Element->Texture;
+                delete Element;
+                Bucket.RemoveAt(Index);
+                ++Stats.NumDestroyed;
+            }
+        }
+        if (Bucket.IsEmpty())
+        {
+            EmptyBuckets.Add(Hash);
+        }
+    }
+    // Descs of a past resolution would otherwise stay in the map for good.
+    for (uint64_t Hash : EmptyBuckets)
+    {
+        Elements.Remove(Hash);
+    }
+
+    UpdateStats(Stats);
+    LastStats = Stats;
+    Stats = AVulkanRenderTargetPoolStats();
+    ++FrameNumber;
+}
+
+void AVulkanRenderTargetPool::UpdateStats(AVulkanRenderTargetPoolStats& OutStats) const
+{
+    OutStats.NumTextures = 0;
+    OutStats.NumFreeTextures = 0;
+    OutStats.BytesHeld = 0;
+    for (const auto& [Hash, Bucket] : Elements)
+    {
+        for (const AElement* Element : Bucket)
+        {
+            ++OutStats.NumTextures;
+            OutStats.NumFreeTextures += Element->bInUse ? 0 : 1;
+            OutStats.BytesHeld += Element->Size;
+        }
+    }
 }
 
 //AVulkanTexture2D::AVulkanTexture2D(
@@ -419,19 +623,17 @@ AVulkanTexture::~AVulkanTexture()
 //}
 
 AVulkanRenderTargetLayout::AVulkanRenderTargetLayout(const AVulkanRenderTargetsInfo& RTInfo)
-    : NumAttachmentDescriptions(0), NumColorAttachments(0) /*, NumInputAttachments(0)*/, bHasDepthStencil(false) /*, bHasResolveAttachments(false) */,
-      NumSamples(0)
+    : NumAttachmentDescriptions(0), NumColorAttachments(0) /*, NumInputAttachments(0)*/, bHasDepthStencil(false), bHasResolveAttachments(false),
+      bHasDepthStencilResolve(false), NumSamples(0), SubpassHint(RTInfo.SubpassHint)
 {
     AMemory::Memzero(ColorReferences);
     AMemory::Memzero(DepthStencilReference);
-    // CMemory::Memzero(ResolveReferences);
+    AMemory::Memzero(ResolveReferences);
+    AMemory::Memzero(DepthStencilResolveReference);
     // CMemory::Memzero(InputAttachments);
     AMemory::Memzero(Desc);
     AMemory::Memzero(Extent);
 
-    AHashInfo HashInfo;
-    AMemory::Memzero(HashInfo);
-
     bool bSetExtent = false;
     bool bFoundClearOp = false;
 
@@ -460,23 +662,21 @@ AVulkanRenderTargetLayout::AVulkanRenderTargetLayout(const AVulkanRenderTargetsI
 
             VkAttachmentDescription& CurrDesc = Desc[NumAttachmentDescriptions];
             CurrDesc.format = Surface.PixelFormat;
-            CurrDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+            CurrDesc.samples = static_cast<VkSampleCountFlagBits>(Surface.NumSamples);
             CurrDesc.loadOp = RTView.LoadAction;
             CurrDesc.storeOp = RTView.StoreAction;
             CurrDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             CurrDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-            CurrDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            CurrDesc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            // Transitions are recorded as barriers from the layout tracked on the texture, see AVulkanCommandBuffer::TransitionLayouts().
+            CurrDesc.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            CurrDesc.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
             bFoundClearOp = bFoundClearOp || (CurrDesc.loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR);
 
             ColorReferences[NumColorAttachments].attachment = NumAttachmentDescriptions;
             ColorReferences[NumColorAttachments].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-            HashInfo.LoadOps[NumColorAttachments] = CurrDesc.loadOp;
-            HashInfo.StoreOps[NumColorAttachments] = CurrDesc.storeOp;
-
-            // TODO: Resolve attachment.
+            bHasResolveAttachments = bHasResolveAttachments || RTInfo.ResolveRenderTarget[Index].Texture != nullptr;
             ++NumAttachmentDescriptions;
             ++NumColorAttachments;
         }
@@ -508,12 +708,14 @@ AVulkanRenderTargetLayout::AVulkanRenderTargetLayout(const AVulkanRenderTargetsI
         }
 
         VkAttachmentDescription& CurrDesc = Desc[NumAttachmentDescriptions];
-        CurrDesc.format = VK_FORMAT_D32_SFLOAT_S8_UINT;
-        CurrDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+        const bool bHasStencil = (Surface.AspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+        CurrDesc.format = Surface.PixelFormat;
+        CurrDesc.samples = static_cast<VkSampleCountFlagBits>(Surface.NumSamples);
         CurrDesc.loadOp = RTView.DepthLoadAction;
         CurrDesc.storeOp = RTView.DepthStoreAction;
-        CurrDesc.stencilLoadOp = RTView.StencilLoadAction;
-        CurrDesc.stencilStoreOp = RTView.StencilStoreAction;
+        // Normalized so depth only layouts hash the same whatever the stencil actions of the view.
+        CurrDesc.stencilLoadOp = bHasStencil ? RTView.StencilLoadAction : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        CurrDesc.stencilStoreOp = bHasStencil ? RTView.StencilStoreAction : VK_ATTACHMENT_STORE_OP_DONT_CARE;
         CurrDesc.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
         CurrDesc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
@@ -522,20 +724,110 @@ AVulkanRenderTargetLayout::AVulkanRenderTargetLayout(const AVulkanRenderTargetsI
         DepthStencilReference.attachment = NumAttachmentDescriptions;
         DepthStencilReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
-        HashInfo.LoadOps[MaxSimultaneousRenderTargets] = CurrDesc.loadOp;
-        HashInfo.StoreOps[MaxSimultaneousRenderTargets] = CurrDesc.storeOp;
-        HashInfo.LoadOps[MaxSimultaneousRenderTargets + 1] = CurrDesc.stencilLoadOp;
-        HashInfo.StoreOps[MaxSimultaneousRenderTargets + 1] = CurrDesc.stencilStoreOp;
-
         ++NumAttachmentDescriptions;
         bHasDepthStencil = true;
     }
 
+    // Resolve targets are never loaded or cleared, so they come after the clear values.
     NumUsedClearValues = bFoundClearOp ? NumAttachmentDescriptions : 0;
 
-    uint8_t HashInfoByte[sizeof(AHashInfo)];
-    AMemory::Memcpy(HashInfoByte, &HashInfo, sizeof(AHashInfo));
-    Hash = static_cast<uint64_t>(std::hash<uint8_t*>()(HashInfoByte));
+    auto AddResolveAttachment = [this](const AVulkanTexture* Texture, VkImageLayout Layout, VkAttachmentReference& OutReference) {
+        check(NumSamples > 1, "Resolving needs multisampled attachments.");
+        check(Texture->NumSamples == 1, "Resolve targets are single sampled.");
+        check(Texture->Width >= Extent.width && Texture->Height >= Extent.height, "Resolve targets cover the render area.");
+
+        VkAttachmentDescription& CurrDesc = Desc[NumAttachmentDescriptions];
+        CurrDesc.format = Texture->PixelFormat;
+        CurrDesc.samples = VK_SAMPLE_COUNT_1_BIT;
+        // Every texel is written by the resolve.
+        CurrDesc.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        CurrDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        CurrDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        CurrDesc.stencilStoreOp = (Texture->AspectMask & VK_IMAGE_ASPECT_STENCIL_BIT) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        CurrDesc.initialLayout = Layout;
+        CurrDesc.finalLayout = Layout;
+
+        OutReference.attachment = NumAttachmentDescriptions++;
+        OutReference.layout = Layout;
+    };
+
+    if (bHasResolveAttachments)
+    {
+        check(SubpassHint == ESubpassHint::None, "Resolve attachments are only supported in render passes with a single subpass.");
+        uint32_t ColorIndex = 0;
+        for (int32_t Index = 0; Index < RTInfo.NumColorRenderTargets; ++Index)
+        {
+            if (!RTInfo.ColorRenderTarget[Index].Texture)
+            {
+                continue;
+            }
+            VkAttachmentReference& Reference = ResolveReferences[ColorIndex++];
+            if (const AVulkanTexture* Texture = RTInfo.ResolveRenderTarget[Index].Texture)
+            {
+                AddResolveAttachment(Texture, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, Reference);
+            }
+            else
+            {
+                Reference.attachment = VK_ATTACHMENT_UNUSED;
+                Reference.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            }
+        }
+    }
+
+    if (RTInfo.DepthStencilResolveTexture)
+    {
+        check(bHasDepthStencil && SubpassHint == ESubpassHint::None, "Depth is resolved from the depth attachment of a single subpass.");
+        AddResolveAttachment(RTInfo.DepthStencilResolveTexture, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, DepthStencilResolveReference);
+        bHasDepthStencilResolve = true;
+    }
+
+    ComputeHash();
+}
+
+void AVulkanRenderTargetLayout::ComputeHash()
+{
+    // The arrays are zeroed past the used entries, so hashing them whole is deterministic and needs no branches.
+    static_assert(sizeof(VkAttachmentDescription) == 9 * sizeof(uint32_t) && sizeof(VkAttachmentReference) == 2 * sizeof(uint32_t),
+        "Attachment structs are hashed as memory and must not contain padding.");
+
+    const uint64_t Counts = NumAttachmentDescriptions | (NumColorAttachments << 8) | (NumSamples << 16) | (bHasDepthStencil ? 1u << 24 : 0u) |
+                            (bHasResolveAttachments ? 1u << 25 : 0u) | (bHasDepthStencilResolve ? 1u << 26 : 0u) |
+                            (static_cast<uint64_t>(SubpassHint) << 32);
+    Hash = AHash::XXH64(Desc, sizeof(Desc), Counts);
+    Hash = AHash::XXH64(ColorReferences, sizeof(ColorReferences), Hash);
+    Hash = AHash::XXH64(&DepthStencilReference, sizeof(DepthStencilReference), Hash);
+    Hash = AHash::XXH64(ResolveReferences, sizeof(ResolveReferences), Hash);
+    Hash = AHash::XXH64(&DepthStencilResolveReference, sizeof(DepthStencilResolveReference), Hash);
+}
+
+uint32_t AVulkanRenderTargetLayout::GetNumSubpasses(ESubpassHint SubpassHint)
+{
+    switch (SubpassHint)
+    {
+    case ESubpassHint::DepthReadSubpass:
+        return 2;
+    case ESubpassHint::DeferredShadingSubpass:
+        return 3;
+    default:
+        return 1;
+    }
+}
+
+uint32_t AVulkanRenderTargetLayout::GetNumSubpassColorAttachments(ESubpassHint SubpassHint, uint32_t NumColorAttachments, uint32_t SubpassIndex)
+{
+    // The lighting subpass only writes SceneColor.
+    return (SubpassHint == ESubpassHint::DeferredShadingSubpass && SubpassIndex == 2) ? 1 : NumColorAttachments;
+}
+
+bool AVulkanRenderTargetLayout::Matches(const AVulkanRenderTargetLayout& Other) const
+{
+    return NumAttachmentDescriptions == Other.NumAttachmentDescriptions && NumColorAttachments == Other.NumColorAttachments &&
+           NumSamples == Other.NumSamples && bHasDepthStencil == Other.bHasDepthStencil && bHasResolveAttachments == Other.bHasResolveAttachments &&
+           bHasDepthStencilResolve == Other.bHasDepthStencilResolve && SubpassHint == Other.SubpassHint &&
+           AMemory::Memcmp(Desc, Other.Desc, sizeof(Desc)) == 0 && AMemory::Memcmp(ColorReferences, Other.ColorReferences, sizeof(ColorReferences)) == 0 &&
+           AMemory::Memcmp(&DepthStencilReference, &Other.DepthStencilReference, sizeof(DepthStencilReference)) == 0 &&
+           AMemory::Memcmp(ResolveReferences, Other.ResolveReferences, sizeof(ResolveReferences)) == 0 &&
+           AMemory::Memcmp(&DepthStencilResolveReference, &Other.DepthStencilResolveReference, sizeof(DepthStencilResolveReference)) == 0;
 }
 
 // CVulkanRenderTargetLayout::CVulkanRenderTargetLayout(const CVulkanRenderPassInfo& RPInfo)
@@ -644,9 +936,8 @@ AVulkanRenderTargetLayout::AVulkanRenderTargetLayout(const AVulkanRenderTargetsI
 // }
 
 AVulkanRenderPass::AVulkanRenderPass(AVulkanDevice* InDevice, const AVulkanRenderTargetLayout& RTLayout)
-    : Device(InDevice), RenderPass(VK_NULL_HANDLE), Layout(RTLayout), NumUsedClearValues(RTLayout.NumUsedClearValues)
+    : Device(InDevice), RenderPass(VK_NULL_HANDLE), Layout(RTLayout), NumUsedClearValues(RTLayout.NumUsedClearValues), NumSubpasses(0)
 {
-    uint32_t NumSubpasses = 0;
     uint32_t NumDependencies = 0;
 
     VkSubpassDescription SubpassDescriptions[4];
@@ -654,118 +945,135 @@ AVulkanRenderPass::AVulkanRenderPass(AVulkanDevice* InDevice, const AVulkanRende
     VkSubpassDependency SubpassDependencies[4];
     AMemory::Memzero(SubpassDependencies);
 
+    const VkAttachmentReference* ColorReferences = RTLayout.GetColorAttachmentReferences();
+    const VkAttachmentReference* DepthStencilReference = RTLayout.GetDepthStencilAttachmentReference();
+
+    // Referenced by the subpass descriptions until the render pass is created.
+    VkAttachmentReference DepthReadReference;
+    AMemory::Memzero(DepthReadReference);
+    VkAttachmentReference LightingInputReferences[5];
+    AMemory::Memzero(LightingInputReferences);
+
+    if (RTLayout.SubpassHint != ESubpassHint::None)
+    {
+        check(DepthStencilReference, "Subpasses read depth, the render pass needs a depth attachment.");
+        // Tested and read as an input attachment at the same time, which needs the read only layout.
+        DepthReadReference.attachment = DepthStencilReference->attachment;
+        DepthReadReference.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+    }
+
     // main sub-pass
     {
         VkSubpassDescription& SubpassDesc = SubpassDescriptions[NumSubpasses++];
         SubpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         SubpassDesc.colorAttachmentCount = RTLayout.NumColorAttachments;
-        SubpassDesc.pColorAttachments = RTLayout.GetColorAttachmentReferences();
-        SubpassDesc.pDepthStencilAttachment = RTLayout.GetDepthStencilAttachmentReference();
+        SubpassDesc.pColorAttachments = ColorReferences;
+        SubpassDesc.pResolveAttachments = RTLayout.GetResolveAttachmentReferences();
+        SubpassDesc.pDepthStencilAttachment = DepthStencilReference;
     }
 
     // Color write and depth read sub-pass
-    if (false /*bDepthReadSubpass*/)
+    if (RTLayout.SubpassHint == ESubpassHint::DepthReadSubpass)
     {
         VkSubpassDescription& SubpassDesc = SubpassDescriptions[NumSubpasses++];
 
         SubpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
         SubpassDesc.colorAttachmentCount = RTLayout.NumColorAttachments;
-        SubpassDesc.pColorAttachments = RTLayout.GetColorAttachmentReferences();
-        check(RTLayout.GetDepthStencilAttachmentReference());
+        SubpassDesc.pColorAttachments = ColorReferences;
 
         // depth as Input0
-        VkAttachmentReference InputAttachment;
-        AMemory::Memzero(InputAttachment);
-        InputAttachment.attachment = RTLayout.GetDepthStencilAttachmentReference()->attachment;
-        InputAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
         SubpassDesc.inputAttachmentCount = 1;
-        SubpassDesc.pInputAttachments = &InputAttachment;
-        SubpassDesc.pDepthStencilAttachment = &InputAttachment; // depth attachment is same as input attachment
+        SubpassDesc.pInputAttachments = &DepthReadReference;
+        SubpassDesc.pDepthStencilAttachment = &DepthReadReference; // depth attachment is same as input attachment
 
+        // Depth written by the main sub-pass, colors keep being written in order.
         VkSubpassDependency& SubpassDep = SubpassDependencies[NumDependencies++];
         SubpassDep.srcSubpass = 0;
         SubpassDep.dstSubpass = 1;
-        SubpassDep.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-        SubpassDep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        SubpassDep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        SubpassDep.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        SubpassDep.srcStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        SubpassDep.dstStageMask =
+            VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        SubpassDep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        SubpassDep.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                   VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
         SubpassDep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
     }
 
     // Two subpasses for deferred shading
-    if (false /*bDeferredShadingSubpass*/)
+    if (RTLayout.SubpassHint == ESubpassHint::DeferredShadingSubpass)
     {
-        // both sub-passes only test DepthStencil
-        VkAttachmentReference DepthStencilAttachment;
-        AMemory::Memzero(DepthStencilAttachment);
-        DepthStencilAttachment.attachment = RTLayout.GetDepthStencilAttachmentReference()->attachment;
-        DepthStencilAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
-        const VkAttachmentReference* ColorRef = RTLayout.GetColorAttachmentReferences();
         uint32_t NumColorAttachments = RTLayout.NumColorAttachments;
-        check(NumColorAttachments == 4); // current layout is SceneColor, GBufferA/B/C
+        check(NumColorAttachments == 4, "Deferred shading subpasses need SceneColor and GBufferA/B/C."); // current layout is SceneColor, GBufferA/B/C
 
         // 1. Write to SceneColor and GBuffer, input DepthStencil
         {
             VkSubpassDescription& SubpassDesc = SubpassDescriptions[NumSubpasses++];
-            AMemory::Memzero(&SubpassDesc, sizeof(VkSubpassDescription));
 
             SubpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
             SubpassDesc.colorAttachmentCount = 4;
-            SubpassDesc.pColorAttachments = ColorRef;
-            SubpassDesc.pDepthStencilAttachment = &DepthStencilAttachment;
+            SubpassDesc.pColorAttachments = ColorReferences;
+            SubpassDesc.pDepthStencilAttachment = &DepthReadReference;
 
             // depth as Input0
             SubpassDesc.inputAttachmentCount = 1;
-            SubpassDesc.pInputAttachments = &DepthStencilAttachment;
+            SubpassDesc.pInputAttachments = &DepthReadReference;
 
             VkSubpassDependency& SubpassDep = SubpassDependencies[NumDependencies++];
             SubpassDep.srcSubpass = 0;
             SubpassDep.dstSubpass = 1;
-            SubpassDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            SubpassDep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-            SubpassDep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            SubpassDep.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+            SubpassDep.srcStageMask =
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            SubpassDep.dstStageMask =
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+            SubpassDep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+            SubpassDep.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                                       VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
             SubpassDep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
         }
 
         // 2. Write to SceneColor, input GBuffer and DepthStencil
         {
             VkSubpassDescription& SubpassDesc = SubpassDescriptions[NumSubpasses++];
-            AMemory::Memzero(&SubpassDesc, sizeof(VkSubpassDescription));
 
             SubpassDesc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
             SubpassDesc.colorAttachmentCount = 1; // SceneColor only
-            SubpassDesc.pColorAttachments = ColorRef;
-            SubpassDesc.pDepthStencilAttachment = &DepthStencilAttachment;
+            SubpassDesc.pColorAttachments = ColorReferences;
+            SubpassDesc.pDepthStencilAttachment = &DepthReadReference;
 
             // GBuffer as Input2/3/4
-            VkAttachmentReference InputAttachments2[5];
-            AMemory::Memzero(InputAttachments2);
-            InputAttachments2[0].attachment = DepthStencilAttachment.attachment;
-            InputAttachments2[0].layout = DepthStencilAttachment.layout;
-            InputAttachments2[1].attachment = VK_ATTACHMENT_UNUSED;
-            InputAttachments2[1].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            LightingInputReferences[0] = DepthReadReference;
+            LightingInputReferences[1].attachment = VK_ATTACHMENT_UNUSED;
+            LightingInputReferences[1].layout = VK_IMAGE_LAYOUT_UNDEFINED;
             for (int32_t i = 2; i < 5; ++i)
             {
-                InputAttachments2[i].attachment = ColorRef[i - 1].attachment;
-                InputAttachments2[i].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                LightingInputReferences[i].attachment = ColorReferences[i - 1].attachment;
+                LightingInputReferences[i].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
             }
 
             SubpassDesc.inputAttachmentCount = 5;
-            SubpassDesc.pInputAttachments = InputAttachments2;
+            SubpassDesc.pInputAttachments = LightingInputReferences;
 
+            // The GBuffer is only read from here on, SceneColor keeps being written in order.
             VkSubpassDependency& SubpassDep = SubpassDependencies[NumDependencies++];
             SubpassDep.srcSubpass = 1;
             SubpassDep.dstSubpass = 2;
             SubpassDep.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            SubpassDep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+            SubpassDep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
             SubpassDep.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-            SubpassDep.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+            SubpassDep.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
             SubpassDep.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
         }
     }
+    check(NumSubpasses == AVulkanRenderTargetLayout::GetNumSubpasses(RTLayout.SubpassHint));
+
+    if (RTLayout.bHasDepthStencilResolve)
+    {
+        // Depth resolves only exist in render pass 2, the layout allows them in single subpass render passes only.
+        check(NumSubpasses == 1 && NumDependencies == 0);
+        CreateRenderPass2(SubpassDescriptions[0], RTLayout);
+        return;
+    }
 
     VkRenderPassCreateInfo CreateInfo;
     ZeroVulkanStruct(CreateInfo, VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO);
@@ -778,6 +1086,73 @@ AVulkanRenderPass::AVulkanRenderPass(AVulkanDevice* InDevice, const AVulkanRende
     VK_CHECK_RESULT(VulkanApi::vkCreateRenderPass(Device->GetHandle(), &CreateInfo, VK_CPU_ALLOCATOR, &RenderPass));
 }
 
+void AVulkanRenderPass::CreateRenderPass2(const VkSubpassDescription& SubpassDesc, const AVulkanRenderTargetLayout& RTLayout)
+{
+    VkAttachmentDescription2 Attachments[MaxSimultaneousRenderTargets * 2 + 2];
+    const VkAttachmentDescription* Descriptions = RTLayout.GetAttachmentDescriptions();
+    for (uint32_t Index = 0; Index < RTLayout.NumAttachmentDescriptions; ++Index)
+    {
+        const VkAttachmentDescription& Desc = Descriptions[Index];
+        VkAttachmentDescription2& Attachment = Attachments[Index];
+        ZeroVulkanStruct(Attachment, VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2);
+        Attachment.flags = Desc.flags;
+        Attachment.format = Desc.format;
+        Attachment.samples = Desc.samples;
+        Attachment.loadOp = Desc.loadOp;
+        Attachment.storeOp = Desc.storeOp;
+        Attachment.stencilLoadOp = Desc.stencilLoadOp;
+        Attachment.stencilStoreOp = Desc.stencilStoreOp;
+        Attachment.initialLayout = Desc.initialLayout;
+        Attachment.finalLayout = Desc.finalLayout;
+    }
+
+    // No input attachments, so the references need no aspect mask.
+    auto ConvertReferences = [](const VkAttachmentReference* References, uint32_t NumReferences, VkAttachmentReference2* OutReferences) {
+        for (uint32_t Index = 0; Index < NumReferences; ++Index)
+        {
+            ZeroVulkanStruct(OutReferences[Index], VK_STRUCTURE_TYPE_ATTACHMENT_REFERENCE_2);
+            OutReferences[Index].attachment = References[Index].attachment;
+            OutReferences[Index].layout = References[Index].layout;
+        }
+    };
+
+    VkAttachmentReference2 ColorReferences[MaxSimultaneousRenderTargets];
+    VkAttachmentReference2 ResolveReferences[MaxSimultaneousRenderTargets];
+    VkAttachmentReference2 DepthStencilReference;
+    VkAttachmentReference2 DepthStencilResolveReference;
+    ConvertReferences(SubpassDesc.pColorAttachments, SubpassDesc.colorAttachmentCount, ColorReferences);
+    if (SubpassDesc.pResolveAttachments)
+    {
+        ConvertReferences(SubpassDesc.pResolveAttachments, SubpassDesc.colorAttachmentCount, ResolveReferences);
+    }
+    ConvertReferences(SubpassDesc.pDepthStencilAttachment, 1, &DepthStencilReference);
+    ConvertReferences(RTLayout.GetDepthStencilResolveAttachmentReference(), 1, &DepthStencilResolveReference);
+
+    // Sample zero is supported by every device with depth stencil resolves, and is the only mode valid for integer stencil.
+    VkSubpassDescriptionDepthStencilResolve DepthStencilResolve;
+    ZeroVulkanStruct(DepthStencilResolve, VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_DEPTH_STENCIL_RESOLVE);
+    DepthStencilResolve.depthResolveMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+    DepthStencilResolve.stencilResolveMode = VK_RESOLVE_MODE_SAMPLE_ZERO_BIT;
+    DepthStencilResolve.pDepthStencilResolveAttachment = &DepthStencilResolveReference;
+
+    VkSubpassDescription2 Subpass;
+    ZeroVulkanStruct(Subpass, VK_STRUCTURE_TYPE_SUBPASS_DESCRIPTION_2);
+    Subpass.pNext = &DepthStencilResolve;
+    Subpass.pipelineBindPoint = SubpassDesc.pipelineBindPoint;
+    Subpass.colorAttachmentCount = SubpassDesc.colorAttachmentCount;
+    Subpass.pColorAttachments = SubpassDesc.colorAttachmentCount ? ColorReferences : nullptr;
+    Subpass.pResolveAttachments = SubpassDesc.pResolveAttachments ? ResolveReferences : nullptr;
+    Subpass.pDepthStencilAttachment = &DepthStencilReference;
+
+    VkRenderPassCreateInfo2 CreateInfo;
+    ZeroVulkanStruct(CreateInfo, VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO_2);
+    CreateInfo.attachmentCount = RTLayout.NumAttachmentDescriptions;
+    CreateInfo.pAttachments = Attachments;
+    CreateInfo.subpassCount = 1;
+    CreateInfo.pSubpasses = &Subpass;
+    VK_CHECK_RESULT(VulkanApi::vkCreateRenderPass2(Device->GetHandle(), &CreateInfo, VK_CPU_ALLOCATOR, &RenderPass));
+}
+
 AVulkanRenderPass::~AVulkanRenderPass()
 {
     VulkanApi::vkDestroyRenderPass(Device->GetHandle(), RenderPass, VK_CPU_ALLOCATOR);
@@ -787,9 +1162,10 @@ AVulkanRenderPass::~AVulkanRenderPass()
 AVulkanFramebuffer::AVulkanFramebuffer(
     AVulkanDevice* InDevice, AVulkanRenderPass* RenderPass, const AVulkanRenderTargetsInfo& RTInfo, const AVulkanRenderTargetLayout& RTLayout)
     : Device(InDevice), Framebuffer(VK_NULL_HANDLE), NumColorRenderTargets(RTInfo.NumColorRenderTargets), NumColorAttachments(0),
-      DepthStencilRenderTargetImage(VK_NULL_HANDLE)
+      DepthStencilRenderTargetImage(VK_NULL_HANDLE), DepthStencilResolveRenderTargetImage(VK_NULL_HANDLE)
 {
     AMemory::Memzero(ColorRenderTargetImages);
+    AMemory::Memzero(ResolveRenderTargetImages);
 
     const VkExtent2D& RTExtent = RTLayout.GetExtent2D();
     check(RTExtent.width != 0 && RTExtent.height != 0);
@@ -822,8 +1198,6 @@ AVulkanFramebuffer::AVulkanFramebuffer(
 
             AttachmentViews.Add(Surface.View);
             ++NumColorAttachments;
-
-            // TODO: Resolve.
         }
     }
 
@@ -849,6 +1223,26 @@ AVulkanFramebuffer::AVulkanFramebuffer(
         AttachmentViews.Add(Surface.View);
     }
 
+    // In the order of the attachment descriptions of the layout, after colors and depth.
+    if (RTLayout.bHasResolveAttachments)
+    {
+        for (int32_t Index = 0; Index < RTInfo.NumColorRenderTargets; ++Index)
+        {
+            const AVulkanTexture* Texture = RTInfo.ResolveRenderTarget[Index].Texture;
+            if (Texture && RTInfo.ColorRenderTarget[Index].Texture)
+            {
+                ResolveRenderTargetImages[Index] = Texture->Image;
+                AttachmentViews.Add(Texture->View);
+            }
+        }
+    }
+    if (RTLayout.bHasDepthStencilResolve)
+    {
+        DepthStencilResolveRenderTargetImage = RTInfo.DepthStencilResolveTexture->Image;
+        AttachmentViews.Add(RTInfo.DepthStencilResolveTexture->View);
+    }
+    check(AttachmentViews.Num() == RTLayout.NumAttachmentDescriptions);
+
     //for (AVulkanTextureView& TextureView : AttachmentTextureViews)
     //{
     //    AttachmentViews.Add(TextureView.View);
@@ -876,110 +1270,144 @@ AVulkanFramebuffer::~AVulkanFramebuffer()
     Framebuffer = VK_NULL_HANDLE;
 }
 
-bool AVulkanFramebuffer::Matches(const AVulkanRenderTargetsInfo& RTInfo) const
+bool AVulkanFramebuffer::ContainsImage(VkImage Image) const
 {
-    if (NumColorRenderTargets != RTInfo.NumColorRenderTargets)
+    for (uint32_t Index = 0; Index < NumColorRenderTargets; ++Index)
     {
-        return false;
+        if (ColorRenderTargetImages[Index] == Image || ResolveRenderTargetImages[Index] == Image)
+        {
+            return true;
+        }
     }
+    return DepthStencilRenderTargetImage == Image || DepthStencilResolveRenderTargetImage == Image;
+}
 
+AVulkanRenderPassManager::~AVulkanRenderPassManager()
+{
+    for (auto& [Hash, Entries] : RenderPasses)
     {
-        const ADepthRenderTargetView& B = RTInfo.DepthStencilRenderTarget;
-        if (B.Texture)
+        for (AVulkanRenderPass* RenderPass : Entries)
         {
-            VkImage AImage = DepthStencilRenderTargetImage;
-            VkImage BImage = B.Texture->Image;
-            if (AImage != BImage)
-            {
-                return false;
-            }
+            delete RenderPass;
         }
     }
 
-    int32_t AttachementIndex = 0;
-    for (int32_t Index = 0; Index < RTInfo.NumColorRenderTargets; ++Index)
+    for (AFramebufferEntry* Entry : LruFramebuffers)
+    {
+        delete Entry->Framebuffer;
+        delete Entry;
+    }
+    LruFramebuffers.clear();
+    Framebuffers.Clear();
+}
+
+AVulkanRenderPass* AVulkanRenderPassManager::GetOrCreateRenderPass(const AVulkanRenderTargetLayout& RTLayout)
+{
+    TArray<AVulkanRenderPass*>& Entries = RenderPasses[RTLayout.GetHash()];
+    for (AVulkanRenderPass* RenderPass : Entries)
     {
-        const AVulkanRenderTargetView& B = RTInfo.ColorRenderTarget[Index];
-        if (B.Texture)
+        if (RenderPass->GetLayout().Matches(RTLayout))
         {
-            VkImage AImage = ColorRenderTargetImages[AttachementIndex];
-            VkImage BImage = B.Texture->Image;
-            if (AImage != BImage)
-            {
-                return false;
-            }
-            ++AttachementIndex;
+            return RenderPass;
         }
     }
 
-    return true;
+    AVulkanRenderPass* RenderPass = new AVulkanRenderPass(Device, RTLayout);
+    Entries.Add(RenderPass);
+    return RenderPass;
 }
 
-AVulkanRenderPassManager::~AVulkanRenderPassManager()
+AVulkanFramebuffer* AVulkanRenderPassManager::GetOrCreateFramebuffer(
+    const AVulkanRenderTargetsInfo& RTInfo, const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass)
 {
-    for (auto& [Hash, RenderPass] : RenderPasses)
+    AFramebufferKey Key;
+    AMemory::Memzero(Key);
+    Key.RenderPass = RenderPass->GetHandle();
+    Key.Extent = RTLayout.GetExtent2D();
+    for (int32_t Index = 0; Index < RTInfo.NumColorRenderTargets; ++Index)
     {
-        delete RenderPass;
-        RenderPass = nullptr;
+        if (const AVulkanTexture* Texture = RTInfo.ColorRenderTarget[Index].Texture)
+        {
+            Key.Attachments[Key.NumAttachments++] = Texture->View;
+        }
     }
-
-    for (auto& [Hash, List] : Framebuffers)
+    if (RTLayout.bHasDepthStencil)
     {
-        if (List)
+        Key.Attachments[Key.NumAttachments++] = RTInfo.DepthStencilRenderTarget.Texture->View;
+    }
+    if (RTLayout.bHasResolveAttachments)
+    {
+        for (int32_t Index = 0; Index < RTInfo.NumColorRenderTargets; ++Index)
         {
-            for (AVulkanFramebuffer* Framebuffer : List->Framebuffer)
+            const AVulkanTexture* Texture = RTInfo.ResolveRenderTarget[Index].Texture;
+            if (Texture && RTInfo.ColorRenderTarget[Index].Texture)
             {
-                delete Framebuffer;
-                Framebuffer = nullptr;
+                Key.Attachments[Key.NumAttachments++] = Texture->View;
             }
-            delete List;
-            List = nullptr;
         }
     }
-}
-
-AVulkanRenderPass* AVulkanRenderPassManager::GetOrCreateRenderPass(const AVulkanRenderTargetLayout& RTLayout)
-{
-    uint64_t RTInfoHash = RTLayout.GetHash();
+    if (RTLayout.bHasDepthStencilResolve)
+    {
+        Key.Attachments[Key.NumAttachments++] = RTInfo.DepthStencilResolveTexture->View;
+    }
 
-    AVulkanRenderPass** FoundRenderPass = RenderPasses.Find(RTInfoHash);
-    if (FoundRenderPass)
+    const uint64_t Hash = AHash::Memory(Key);
+    TArray<AFramebufferEntry*>& Entries = Framebuffers[Hash];
+    for (AFramebufferEntry* Entry : Entries)
     {
-        return *FoundRenderPass;
+        if (Entry->Key == Key)
+        {
+            Entry->LastUsedFrame = FrameNumber;
+            LruFramebuffers.splice(LruFramebuffers.begin(), LruFramebuffers, Entry->LruIterator);
+            return Entry->Framebuffer;
+        }
     }
 
-    AVulkanRenderPass* RenderPass = new AVulkanRenderPass(Device, RTLayout);
-    RenderPasses.Add(RTInfoHash, RenderPass);
-    return RenderPass;
+    AFramebufferEntry* Entry = new AFramebufferEntry();
+    Entry->Key = Key;
+    Entry->Hash = Hash;
+    Entry->Framebuffer = new AVulkanFramebuffer(Device, RenderPass, RTInfo, RTLayout);
+    Entry->LastUsedFrame = FrameNumber;
+    Entry->LruIterator = LruFramebuffers.insert(LruFramebuffers.begin(), Entry);
+    Entries.Add(Entry);
+    return Entry->Framebuffer;
 }
 
-AVulkanFramebuffer* AVulkanRenderPassManager::GetOrCreateFramebuffer(
-    const AVulkanRenderTargetsInfo& RTInfo, const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass)
+void AVulkanRenderPassManager::NotifyDeletedImage(VkImage Image)
 {
-    uint64_t RTInfoHash = RTLayout.GetHash();
-
-    FFramebufferList** FoundFramebufferList = Framebuffers.Find(RTInfoHash);
-    FFramebufferList* FramebufferList = nullptr;
-    if (FoundFramebufferList)
+    // Bounded by MaxFramebuffers plus what the frames in flight use.
+    for (auto Iterator = LruFramebuffers.begin(); Iterator != LruFramebuffers.end();)
     {
-        FramebufferList = *FoundFramebufferList;
-        for (AVulkanFramebuffer* Framebuffer : FramebufferList->Framebuffer)
+        AFramebufferEntry* Entry = *Iterator++;
+        if (Entry->Framebuffer->ContainsImage(Image))
         {
-            if (Framebuffer->Matches(RTInfo))
-            {
-                return Framebuffer;
-            }
+            DestroyFramebuffer(Entry);
         }
     }
-    else
+}
+
+void AVulkanRenderPassManager::EndFrame()
+{
+    ++FrameNumber;
+    while (LruFramebuffers.size() > MaxFramebuffers && LruFramebuffers.back()->LastUsedFrame + NumFramesInFlight <= FrameNumber)
+    {
+        DestroyFramebuffer(LruFramebuffers.back());
+    }
+}
+
+void AVulkanRenderPassManager::DestroyFramebuffer(AFramebufferEntry* Entry)
+{
+    TArray<AFramebufferEntry*>* Entries = Framebuffers.Find(Entry->Hash);
+    check(Entries);
+    Entries->RemoveFirstOf(Entry);
+    if (Entries->IsEmpty())
     {
-        FramebufferList = new FFramebufferList;
-        Framebuffers.Add(RTInfoHash, FramebufferList);
+        Framebuffers.Remove(Entry->Hash);
     }
 
-    AVulkanFramebuffer* Framebuffer = new AVulkanFramebuffer(Device, RenderPass, RTInfo, RTLayout);
-    FramebufferList->Framebuffer.Add(Framebuffer);
-    return Framebuffer;
+    LruFramebuffers.erase(Entry->LruIterator);
+    delete Entry->Framebuffer;
+    delete Entry;
 }
 
 // void AVulkanRenderPassManager::EndRenderPass(CVulkanCmdBuffer* CmdBuffer)
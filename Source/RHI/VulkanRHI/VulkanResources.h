@@ -2,6 +2,8 @@
 
 #include "VulkanApi.h"
 
+#include <list>
+
 class AVulkanDevice;
 class AVulkanCommandBuffer;
 struct AVulkanTexture;
@@ -76,15 +78,26 @@ struct AVulkanTexture;
 
 struct AVulkanTexture
 {
+    // Usage is added to the transfer and sampled usage every texture gets, except for transient attachments which
+    // allow no other usage. The image is bound to its own device local memory unless bBindMemory is false, the view
+    // is then created by BindMemory().
     AVulkanTexture(AVulkanDevice* Device, VkImageViewType ViewType, VkFormat Format, uint32_t SizeX, uint32_t SizeY, uint32_t SizeZ, uint32_t ArraySize,
-        uint32_t NumMips, uint32_t NumSamples, VkImageAspectFlags AspectFlags);
+        uint32_t NumMips, uint32_t NumSamples, VkImageAspectFlags AspectFlags, VkImageUsageFlags Usage = 0, bool bBindMemory = true);
     AVulkanTexture(AVulkanDevice* Device, VkImageViewType ViewType, VkFormat Format, uint32_t SizeX, uint32_t SizeY, uint32_t SizeZ, uint32_t ArraySize,
         uint32_t NumMips, uint32_t NumSamples, VkImageAspectFlags AspectFlags, VkImage Image);
     ~AVulkanTexture();
 
+    VkMemoryRequirements GetMemoryRequirements() const;
+    // Places the image in memory owned by someone else, such as an AVulkanMemoryHeap.
+    void BindMemory(VkDeviceMemory InMemory, VkDeviceSize Offset);
+
     VkImage Image;
     VkImageView View;
     VkFormat PixelFormat;
+    // VK_NULL_HANDLE unless the texture allocated its own memory.
+    VkDeviceMemory Memory;
+    // False for images owned elsewhere, such as the swapchain.
+    bool bOwnsImage;
 
     uint32_t Width;
     uint32_t Height;
@@ -98,6 +111,9 @@ struct AVulkanTexture
     VkImageViewType ViewType;
     VkImageAspectFlags AspectMask;
 
+    // Layout of every subresource once the recorded commands executed, kept by AVulkanCommandBuffer::TransitionLayouts().
+    VkImageLayout Layout;
+
     //AVulkanSurface Surface;
     //AVulkanTextureView TextureView;
 
@@ -107,6 +123,109 @@ private:
     void CreateTextureView();
 };
 
+struct AVulkanBuffer
+{
+    // Host visible buffers stay mapped for their whole lifetime.
+    AVulkanBuffer(AVulkanDevice* Device, VkDeviceSize Size, VkBufferUsageFlags Usage, VkMemoryPropertyFlags MemoryFlags);
+    ~AVulkanBuffer();
+
+    VkBuffer Buffer;
+    VkDeviceMemory Memory;
+    VkDeviceSize Size;
+    VkBufferUsageFlags Usage;
+    VkMemoryPropertyFlags MemoryFlags;
+
+    // nullptr unless the memory is host visible.
+    uint8_t* MappedData;
+
+    AVulkanDevice* Device;
+};
+
+// Everything a pooled render target is matched on, textures are only handed out for an identical desc.
+struct AVulkanRenderTargetDesc
+{
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t NumMips = 1;
+    uint32_t NumSamples = 1;
+    VkImageAspectFlags AspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    VkImageUsageFlags Usage = 0;
+
+    inline bool operator==(const AVulkanRenderTargetDesc& Other) const
+    {
+        return Format == Other.Format && Width == Other.Width && Height == Other.Height && NumMips == Other.NumMips && NumSamples == Other.NumSamples &&
+               AspectMask == Other.AspectMask && Usage == Other.Usage;
+    }
+};
+
+struct AVulkanRenderTargetPoolStats
+{
+    // Of the last frame, a hit reused a pooled texture instead of creating one.
+    uint32_t NumRequests = 0;
+    uint32_t NumHits = 0;
+    uint32_t NumDestroyed = 0;
+
+    // Held by the pool at the end of the last frame, free or not.
+    uint32_t NumTextures = 0;
+    uint32_t NumFreeTextures = 0;
+    VkDeviceSize BytesHeld = 0;
+
+    inline float GetHitRate() const { return NumRequests ? static_cast<float>(NumHits) / NumRequests : 1.0f; }
+};
+
+// Render targets such as depth buffers and post process targets, kept across frames so resizes and dynamic
+// resolution switch between textures that already exist instead of allocating each time.
+//
+// A texture belongs to the caller from Acquire() until Release(), targets that live across frames are simply
+// held. Released textures are handed out again once the frames in flight can no longer use them, and
+// destroyed when nobody asked for them for MaxUnusedFrames frames.
+class AVulkanRenderTargetPool
+{
+public:
+    AVulkanRenderTargetPool(AVulkanDevice* Device, uint32_t MaxUnusedFrames = 60);
+    ~AVulkanRenderTargetPool();
+
+    // Contents and layout are whatever the previous owner left, Texture->Layout tells which.
+    AVulkanTexture* Acquire(const AVulkanRenderTargetDesc& Desc);
+    void Release(AVulkanTexture* Texture);
+
+    // Ages out unused textures and starts the stats of the next frame.
+    void EndFrame();
+
+    inline const AVulkanRenderTargetPoolStats& GetLastStats() const { return LastStats; }
+
+private:
+    struct AElement
+    {
+        AVulkanRenderTargetDesc Desc;
+        AVulkanTexture* Texture;
+        VkDeviceSize Size;
+        bool bInUse;
+        // Frame it was last released in.
+        uint64_t ReleaseFrame;
+    };
+
+    static uint64_t GetHash(const AVulkanRenderTargetDesc& Desc);
+    void UpdateStats(AVulkanRenderTargetPoolStats& OutStats) const;
+
+private:
+    enum
+    {
+        // Frames the GPU may still be using a released texture in.
+        NumFramesInFlight = 3
+    };
+
+    TMap<uint64_t, TArray<AElement*>> Elements;
+    uint32_t MaxUnusedFrames;
+    uint64_t FrameNumber;
+
+    AVulkanRenderTargetPoolStats Stats;
+    AVulkanRenderTargetPoolStats LastStats;
+
+    AVulkanDevice* Device;
+};
+
 //struct AVulkanTexture2D : public AVulkanTexture
 //{
 //    AVulkanTexture2D(
@@ -166,20 +285,42 @@ struct ADepthRenderTargetView
     }
 };
 
+// Subpasses of a render pass. Later subpasses read what earlier ones wrote as input attachments, per pixel,
+// so on tilers the data never leaves tile memory. Attachments read that way need INPUT_ATTACHMENT usage.
+enum class ESubpassHint : uint8_t
+{
+    None,
+    // 0 writes color and depth, 1 writes color with depth tested read only and readable as input attachment 0.
+    DepthReadSubpass,
+    // Colors are SceneColor and GBufferA/B/C. 0 writes depth and colors, 1 writes SceneColor and the GBuffer with
+    // depth tested read only, 2 is the lighting pass writing SceneColor and reading depth as input attachment 0
+    // and GBufferA/B/C as input attachments 2 to 4.
+    DeferredShadingSubpass,
+};
+
 struct AVulkanRenderTargetsInfo
 {
     AVulkanRenderTargetView ColorRenderTarget[MaxSimultaneousRenderTargets];
     int8_t NumColorRenderTargets;
     bool bClearColor;
 
-    // FVulkanRenderTargetView ResolveRenderTarget[MaxSimultaneousRenderTargets]; // Unused.
-    // bool bHasResolveAttachments;                                               // Unused.
+    // Single sampled targets the multisampled color target of the same index is resolved into at the end of the
+    // render pass, none where Texture is null. Only the texture of the view is used, resolves always store.
+    AVulkanRenderTargetView ResolveRenderTarget[MaxSimultaneousRenderTargets];
 
     ADepthRenderTargetView DepthStencilRenderTarget;
     bool bClearDepth;
     bool bClearStencil;
+    // Single sampled target the depth and stencil are resolved into, sample zero is kept.
+    AVulkanTexture* DepthStencilResolveTexture;
 
-    AVulkanRenderTargetsInfo() : NumColorRenderTargets(0), bClearColor(false), bClearDepth(false), bClearStencil(false) {}
+    ESubpassHint SubpassHint;
+
+    AVulkanRenderTargetsInfo()
+        : NumColorRenderTargets(0), bClearColor(false), bClearDepth(false), bClearStencil(false), DepthStencilResolveTexture(nullptr),
+          SubpassHint(ESubpassHint::None)
+    {
+    }
 };
 
 class AVulkanRenderTargetLayout
@@ -192,35 +333,51 @@ public:
 
     inline const VkAttachmentReference* GetColorAttachmentReferences() const { return NumColorAttachments > 0 ? ColorReferences : nullptr; }
     inline const VkAttachmentReference* GetDepthStencilAttachmentReference() const { return bHasDepthStencil ? &DepthStencilReference : nullptr; }
+    // One per color attachment, VK_ATTACHMENT_UNUSED for those without a resolve target.
+    inline const VkAttachmentReference* GetResolveAttachmentReferences() const { return bHasResolveAttachments ? ResolveReferences : nullptr; }
+    inline const VkAttachmentReference* GetDepthStencilResolveAttachmentReference() const
+    {
+        return bHasDepthStencilResolve ? &DepthStencilResolveReference : nullptr;
+    }
     inline const VkAttachmentDescription* GetAttachmentDescriptions() const { return Desc; }
 
+    // Covers everything the render pass is created from: attachment formats, samples, load and store ops,
+    // layouts and the attachment references of the subpasses. Not the extent, render passes don't depend on it.
     inline uint64_t GetHash() const { return Hash; }
+    // Full comparison of what the hash covers, guards caches keyed by it against collisions.
+    bool Matches(const AVulkanRenderTargetLayout& Other) const;
+
+    static uint32_t GetNumSubpasses(ESubpassHint SubpassHint);
+    // Color attachments written by the subpass, pipelines drawn in it blend that many.
+    static uint32_t GetNumSubpassColorAttachments(ESubpassHint SubpassHint, uint32_t NumColorAttachments, uint32_t SubpassIndex);
+
+private:
+    void ComputeHash();
 
 private:
-    struct AHashInfo
-    {
-        // +1 for Depth, +1 for Stencil
-        VkAttachmentLoadOp LoadOps[MaxSimultaneousRenderTargets + 2];
-        VkAttachmentStoreOp StoreOps[MaxSimultaneousRenderTargets + 2];
-    };
     uint64_t Hash;
 
 public:
     bool bHasDepthStencil;
-    // bool bHasResolveAttachments; // Unused.
+    bool bHasResolveAttachments;
+    // Needs VkSubpassDescriptionDepthStencilResolve, so the render pass is created with vkCreateRenderPass2.
+    bool bHasDepthStencilResolve;
     uint8_t NumAttachmentDescriptions;
     uint8_t NumColorAttachments;
     // uint8_t NumInputAttachments; // Unused.
     uint8_t NumSamples;
     uint8_t NumUsedClearValues;
+    ESubpassHint SubpassHint;
 
 private:
     VkAttachmentReference ColorReferences[MaxSimultaneousRenderTargets];
     VkAttachmentReference DepthStencilReference;
-    // VkAttachmentReference ResolveReferences[MaxSimultaneousRenderTargets];    // Unused.
+    VkAttachmentReference ResolveReferences[MaxSimultaneousRenderTargets];
+    VkAttachmentReference DepthStencilResolveReference;
     // VkAttachmentReference InputAttachments[MaxSimultaneousRenderTargets + 1]; // Unused.
 
-    VkAttachmentDescription Desc[MaxSimultaneousRenderTargets + 1]; // [MaxSimultaneousRenderTargets * 2 + 2];
+    // Colors, depth, then the resolve targets of the colors and of depth.
+    VkAttachmentDescription Desc[MaxSimultaneousRenderTargets * 2 + 2];
 
     VkExtent2D Extent;
 };
@@ -234,11 +391,17 @@ public:
     inline VkRenderPass GetHandle() const { return RenderPass; }
     inline const AVulkanRenderTargetLayout& GetLayout() const { return Layout; }
     inline uint32_t GetNumUsedClearValues() const { return NumUsedClearValues; }
+    inline uint32_t GetNumSubpasses() const { return NumSubpasses; }
+
+private:
+    // Creates the single subpass render pass with the depth stencil resolve of the layout.
+    void CreateRenderPass2(const VkSubpassDescription& SubpassDesc, const AVulkanRenderTargetLayout& RTLayout);
 
 private:
     VkRenderPass RenderPass;
     AVulkanRenderTargetLayout Layout;
     uint32_t NumUsedClearValues;
+    uint32_t NumSubpasses;
 
     AVulkanDevice* Device;
 };
@@ -249,7 +412,7 @@ public:
     AVulkanFramebuffer(AVulkanDevice* Device, AVulkanRenderPass* RenderPass, const AVulkanRenderTargetsInfo& RTInfo, const AVulkanRenderTargetLayout& RTLayout);
     ~AVulkanFramebuffer();
 
-    bool Matches(const AVulkanRenderTargetsInfo& RTInfo) const;
+    bool ContainsImage(VkImage Image) const;
 
     inline VkFramebuffer GetHandle() const { return Framebuffer; }
     inline uint32_t GetWidth() const { return Extents.width; }
@@ -267,14 +430,21 @@ private:
     uint32_t NumColorAttachments;
     VkImage ColorRenderTargetImages[MaxSimultaneousRenderTargets];
     VkImage DepthStencilRenderTargetImage;
+    VkImage ResolveRenderTargetImages[MaxSimultaneousRenderTargets];
+    VkImage DepthStencilResolveRenderTargetImage;
 
     AVulkanDevice* Device;
 };
 
+// Render passes by layout and framebuffers by the image views they bind.
+//
+// Framebuffers are looked up by a hash of the render pass, the attachment views and the extent. They are
+// destroyed with the first of their attachments, see NotifyDeletedImage(), and the least recently used ones
+// beyond MaxFramebuffers are evicted once no frame in flight can use them.
 class AVulkanRenderPassManager
 {
 public:
-    AVulkanRenderPassManager(AVulkanDevice* InDevice) : Device(InDevice) { }
+    AVulkanRenderPassManager(AVulkanDevice* InDevice) : FrameNumber(0), Device(InDevice) { }
     ~AVulkanRenderPassManager();
 
     AVulkanRenderPass* GetOrCreateRenderPass(const AVulkanRenderTargetLayout& RTLayout);
@@ -282,18 +452,59 @@ public:
     AVulkanFramebuffer* GetOrCreateFramebuffer(
         const AVulkanRenderTargetsInfo& RTInfo, const AVulkanRenderTargetLayout& RTLayout, AVulkanRenderPass* RenderPass);
 
+    // The image is about to be destroyed, so are the framebuffers using it. Textures are only destroyed once the
+    // GPU is done with them, and therefore with their framebuffers.
+    void NotifyDeletedImage(VkImage Image);
+    // Evicts least recently used framebuffers.
+    void EndFrame();
+
+    inline uint32_t GetNumFramebuffers() const { return static_cast<uint32_t>(LruFramebuffers.size()); }
+
     // void BeginRenderPass(AVulkanDevice* Device, AVulkanCommandBuffer* CmdBuffer, const AVulkanRenderTargetLayout& RTLayout,
     //     AVulkanRenderPass* RenderPass, AVulkanFramebuffer* Framebuffer);
     // void EndRenderPass(AVulkanCommandBuffer* CmdBuffer);
 
 private:
-    TMap<uint64_t, AVulkanRenderPass*> RenderPasses;
+    // Hashed as memory, zeroed before it is filled.
+    struct AFramebufferKey
+    {
+        VkRenderPass RenderPass;
+        VkExtent2D Extent;
+        uint32_t NumAttachments;
+        uint32_t Padding;
+        VkImageView Attachments[MaxSimultaneousRenderTargets * 2 + 2];
 
-    struct FFramebufferList
+        inline bool operator==(const AFramebufferKey& Other) const { return AMemory::Memcmp(this, &Other, sizeof(AFramebufferKey)) == 0; }
+    };
+
+    struct AFramebufferEntry
+    {
+        AFramebufferKey Key;
+        uint64_t Hash;
+        AVulkanFramebuffer* Framebuffer;
+        uint64_t LastUsedFrame;
+        // Position in LruFramebuffers.
+        std::list<AFramebufferEntry*>::iterator LruIterator;
+    };
+
+    void DestroyFramebuffer(AFramebufferEntry* Entry);
+
+private:
+    enum
     {
-        TArray<AVulkanFramebuffer*> Framebuffer;
+        // Frames the GPU may still be using a framebuffer in.
+        NumFramesInFlight = 3,
+        MaxFramebuffers = 64
     };
-    TMap<uint64_t, FFramebufferList*> Framebuffers;
+
+    // Entries with the same layout hash, almost always one.
+    TMap<uint64_t, TArray<AVulkanRenderPass*>> RenderPasses;
+
+    // Entries with the same hash, almost always one.
+    TMap<uint64_t, TArray<AFramebufferEntry*>> Framebuffers;
+    // Most recently used first.
+    std::list<AFramebufferEntry*> LruFramebuffers;
+    uint64_t FrameNumber;
 
     AVulkanDevice* Device;
 };
@@ -0,0 +1,469 @@
+#include "VulkanShaderReflection.h"
+
+// Only the subset of the SPIR-V specification (https://registry.khronos.org/SPIR-V/specs/unified1/SPIRV.html)
+// needed to find the resource interface.
+namespace Spirv
+{
+    static constexpr uint32_t Magic = 0x07230203;
+    static constexpr uint32_t HeaderWords = 5;
+
+    enum EOp : uint32_t
+    {
+        OpName = 5,
+        OpEntryPoint = 15,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpSpecConstantTrue = 48,
+        OpSpecConstantFalse = 49,
+        OpSpecConstant = 50,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+        OpTypeAccelerationStructureKHR = 5341,
+    };
+
+    enum EDecoration : uint32_t
+    {
+        SpecId = 1,
+        BufferBlock = 3,
+        ArrayStride = 6,
+        MatrixStride = 7,
+        BuiltIn = 11,
+        Location = 30,
+        Binding = 33,
+        DescriptorSet = 34,
+        Offset = 35,
+    };
+
+    enum EStorageClass : uint32_t
+    {
+        UniformConstant = 0,
+        Input = 1,
+        Uniform = 2,
+        PushConstant = 9,
+        StorageBuffer = 12,
+    };
+
+    enum EDim : uint32_t
+    {
+        DimBuffer = 5,
+        DimSubpassData = 6,
+    };
+} // namespace Spirv
+
+namespace
+{
+    static constexpr uint32_t InvalidValue = ~0u;
+
+    struct AIdInfo
+    {
+        uint32_t Op = 0;
+        // Word index of the defining instruction.
+        uint32_t Instruction = 0;
+
+        uint32_t Set = InvalidValue;
+        uint32_t Binding = InvalidValue;
+        uint32_t Location = InvalidValue;
+        uint32_t ArrayStride = 0;
+        uint32_t SpecId = InvalidValue;
+        bool bBuiltIn = false;
+        bool bBufferBlock = false;
+        // Debug name is DrawData.
+        bool bDrawDataName = false;
+
+        // Struct types only.
+        TArray<uint32_t> MemberOffsets;
+        TArray<uint32_t> MemberMatrixStrides;
+    };
+
+    class ASpirvParser
+    {
+    public:
+        ASpirvParser(const uint32_t* InCode, size_t InNumWords) : Code(InCode), NumWords(InNumWords) { }
+
+        bool Parse(AVulkanShaderReflection& OutReflection);
+
+    private:
+        inline uint32_t Operand(uint32_t Id, uint32_t Index) const { return Code[Ids[Id].Instruction + Index]; }
+        inline uint32_t WordCount(uint32_t Id) const { return Code[Ids[Id].Instruction] >> 16; }
+
+        bool IsValidId(uint32_t Id) const { return Id < static_cast<uint32_t>(Ids.Num()) && Ids[Id].Op != 0; }
+
+        uint32_t GetTypeSize(uint32_t TypeId, uint32_t MatrixStride) const;
+        VkDescriptorType GetDescriptorType(uint32_t TypeId, uint32_t StorageClass) const;
+        VkFormat GetVertexFormat(uint32_t TypeId) const;
+
+        static void SetMember(TArray<uint32_t>& Members, uint32_t Member, uint32_t Value);
+
+    private:
+        const uint32_t* Code;
+        size_t NumWords;
+        TArray<AIdInfo> Ids;
+    };
+
+    void ASpirvParser::SetMember(TArray<uint32_t>& Members, uint32_t Member, uint32_t Value)
+    {
+        if (Member >= static_cast<uint32_t>(Members.Num()))
+        {
+            Members.Resize(static_cast<int32_t>(Member + 1), 0);
+        }
+        Members[Member] = Value;
+    }
+
+    uint32_t ASpirvParser::GetTypeSize(uint32_t TypeId, uint32_t MatrixStride) const
+    {
+        if (!IsValidId(TypeId))
+        {
+            return 0;
+        }
+
+        switch (Ids[TypeId].Op)
+        {
+        case Spirv::OpTypeInt:
+        case Spirv::OpTypeFloat:
+            return Operand(TypeId, 2) / 8;
+        case Spirv::OpTypeVector:
+            return Operand(TypeId, 3) * GetTypeSize(Operand(TypeId, 2), 0);
+        case Spirv::OpTypeMatrix:
+            return Operand(TypeId, 3) * (MatrixStride ? MatrixStride : GetTypeSize(Operand(TypeId, 2), 0));
+        case Spirv::OpTypeArray:
+        {
+            const uint32_t LengthId = Operand(TypeId, 3);
+            const uint32_t Length = IsValidId(LengthId) && Ids[LengthId].Op == Spirv::OpConstant ? Operand(LengthId, 3) : 0;
+            const uint32_t Stride = Ids[TypeId].ArrayStride ? Ids[TypeId].ArrayStride : GetTypeSize(Operand(TypeId, 2), MatrixStride);
+            return Length * Stride;
+        }
+        case Spirv::OpTypeStruct:
+        {
+            const AIdInfo& Struct = Ids[TypeId];
+            uint32_t Size = 0;
+            for (uint32_t Member = 0; Member + 2 < WordCount(TypeId); ++Member)
+            {
+                const uint32_t Offset = Member < static_cast<uint32_t>(Struct.MemberOffsets.Num()) ? Struct.MemberOffsets[Member] : 0;
+                const uint32_t Stride = Member < static_cast<uint32_t>(Struct.MemberMatrixStrides.Num()) ? Struct.MemberMatrixStrides[Member] : 0;
+                Size = std::max(Size, Offset + GetTypeSize(Operand(TypeId, 2 + Member), Stride));
+            }
+            return Size;
+        }
+        default:
+            return 0;
+        }
+    }
+
+    VkDescriptorType ASpirvParser::GetDescriptorType(uint32_t TypeId, uint32_t StorageClass) const
+    {
+        if (StorageClass == Spirv::StorageBuffer)
+        {
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        }
+        if (StorageClass == Spirv::Uniform)
+        {
+            // Older compilers mark storage buffers as BufferBlock in the Uniform storage class.
+            return Ids[TypeId].bBufferBlock ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        }
+
+        switch (Ids[TypeId].Op)
+        {
+        case Spirv::OpTypeSampler:
+            return VK_DESCRIPTOR_TYPE_SAMPLER;
+        case Spirv::OpTypeSampledImage:
+            return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        case Spirv::OpTypeImage:
+        {
+            // Operands: result, sampled type, dim, depth, arrayed, multisampled, sampled.
+            const uint32_t Dim = Operand(TypeId, 3);
+            const bool bStorage = Operand(TypeId, 7) == 2;
+            if (Dim == Spirv::DimBuffer)
+            {
+                return bStorage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+            }
+            if (Dim == Spirv::DimSubpassData)
+            {
+                return VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            }
+            return bStorage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        }
+        case Spirv::OpTypeAccelerationStructureKHR:
+            return VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+        default:
+            return VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        }
+    }
+
+    VkFormat ASpirvParser::GetVertexFormat(uint32_t TypeId) const
+    {
+        uint32_t NumComponents = 1;
+        if (Ids[TypeId].Op == Spirv::OpTypeVector)
+        {
+            NumComponents = Operand(TypeId, 3);
+            TypeId = Operand(TypeId, 2);
+        }
+        if (!IsValidId(TypeId) || Operand(TypeId, 2) != 32 || NumComponents < 1 || NumComponents > 4)
+        {
+            return VK_FORMAT_UNDEFINED;
+        }
+
+        static constexpr VkFormat FloatFormats[] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+        static constexpr VkFormat SintFormats[] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+        static constexpr VkFormat UintFormats[] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+        if (Ids[TypeId].Op == Spirv::OpTypeFloat)
+        {
+            return FloatFormats[NumComponents - 1];
+        }
+        if (Ids[TypeId].Op == Spirv::OpTypeInt)
+        {
+            return Operand(TypeId, 3) ? SintFormats[NumComponents - 1] : UintFormats[NumComponents - 1];
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    bool ASpirvParser::Parse(AVulkanShaderReflection& OutReflection)
+    {
+        if (NumWords < Spirv::HeaderWords || Code[0] != Spirv::Magic)
+        {
+            return false;
+        }
+
+        // The header holds an upper bound of all ids.
+        Ids.Resize(static_cast<int32_t>(Code[3]));
+
+        TArray<uint32_t> Variables;
+        bool bFoundEntryPoint = false;
+        uint32_t ExecutionModel = 0;
+
+        for (size_t Word = Spirv::HeaderWords; Word < NumWords;)
+        {
+            const uint32_t NumInstructionWords = Code[Word] >> 16;
+            const uint32_t Op = Code[Word] & 0xFFFF;
+            if (NumInstructionWords == 0 || Word + NumInstructionWords > NumWords)
+            {
+                return false;
+            }
+            const uint32_t* Instruction = Code + Word;
+
+            auto DefineId = [this, Op, Word](uint32_t Id)
+            {
+                if (Id < static_cast<uint32_t>(Ids.Num()))
+                {
+                    Ids[Id].Op = Op;
+                    Ids[Id].Instruction = static_cast<uint32_t>(Word);
+                }
+            };
+
+            switch (Op)
+            {
+            case Spirv::OpName:
+                // Names precede every definition, only the draw data convention needs them.
+                if (NumInstructionWords > 2 && Instruction[1] < static_cast<uint32_t>(Ids.Num()))
+                {
+                    const AnsiChar* Name = reinterpret_cast<const AnsiChar*>(Instruction + 2);
+                    Ids[Instruction[1]].bDrawDataName = strncmp(Name, "DrawData", (NumInstructionWords - 2) * sizeof(uint32_t)) == 0;
+                }
+                break;
+            case Spirv::OpEntryPoint:
+                if (!bFoundEntryPoint && NumInstructionWords > 3)
+                {
+                    bFoundEntryPoint = true;
+                    ExecutionModel = Instruction[1];
+
+                    const AnsiChar* Name = reinterpret_cast<const AnsiChar*>(Instruction + 3);
+                    OutReflection.EntryPoint.assign(Name, strnlen(Name, (NumInstructionWords - 3) * sizeof(uint32_t)));
+                }
+                break;
+            case Spirv::OpTypeInt:
+            case Spirv::OpTypeFloat:
+            case Spirv::OpTypeVector:
+            case Spirv::OpTypeMatrix:
+            case Spirv::OpTypeImage:
+            case Spirv::OpTypeSampler:
+            case Spirv::OpTypeSampledImage:
+            case Spirv::OpTypeArray:
+            case Spirv::OpTypeRuntimeArray:
+            case Spirv::OpTypeStruct:
+            case Spirv::OpTypePointer:
+            case Spirv::OpTypeAccelerationStructureKHR:
+                DefineId(Instruction[1]);
+                break;
+            case Spirv::OpConstant:
+                DefineId(Instruction[2]);
+                break;
+            case Spirv::OpSpecConstantTrue:
+            case Spirv::OpSpecConstantFalse:
+            case Spirv::OpSpecConstant:
+                // Decorations precede all types and constants, the SpecId is known by now.
+                if (Instruction[2] < static_cast<uint32_t>(Ids.Num()) && Ids[Instruction[2]].SpecId != InvalidValue)
+                {
+                    OutReflection.SpecializationConstants.Add(Ids[Instruction[2]].SpecId);
+                }
+                DefineId(Instruction[2]);
+                break;
+            case Spirv::OpVariable:
+                DefineId(Instruction[2]);
+                Variables.Add(Instruction[2]);
+                break;
+            case Spirv::OpDecorate:
+                if (NumInstructionWords >= 3 && Instruction[1] < static_cast<uint32_t>(Ids.Num()))
+                {
+                    AIdInfo& Target = Ids[Instruction[1]];
+                    const uint32_t Value = NumInstructionWords > 3 ? Instruction[3] : 0;
+                    switch (Instruction[2])
+                    {
+                    case Spirv::SpecId: Target.SpecId = Value; break;
+                    case Spirv::BufferBlock: Target.bBufferBlock = true; break;
+                    case Spirv::ArrayStride: Target.ArrayStride = Value; break;
+                    case Spirv::BuiltIn: Target.bBuiltIn = true; break;
+                    case Spirv::Location: Target.Location = Value; break;
+                    case Spirv::Binding: Target.Binding = Value; break;
+                    case Spirv::DescriptorSet: Target.Set = Value; break;
+                    default: break;
+                    }
+                }
+                break;
+            case Spirv::OpMemberDecorate:
+                if (NumInstructionWords >= 5 && Instruction[1] < static_cast<uint32_t>(Ids.Num()))
+                {
+                    AIdInfo& Target = Ids[Instruction[1]];
+                    if (Instruction[3] == Spirv::Offset)
+                    {
+                        SetMember(Target.MemberOffsets, Instruction[2], Instruction[4]);
+                    }
+                    else if (Instruction[3] == Spirv::MatrixStride)
+                    {
+                        SetMember(Target.MemberMatrixStrides, Instruction[2], Instruction[4]);
+                    }
+                }
+                break;
+            default:
+                break;
+            }
+
+            Word += NumInstructionWords;
+        }
+
+        if (!bFoundEntryPoint)
+        {
+            return false;
+        }
+
+        static constexpr VkShaderStageFlagBits ExecutionModelStages[] = {
+            VK_SHADER_STAGE_VERTEX_BIT,
+            VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT,
+            VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT,
+            VK_SHADER_STAGE_GEOMETRY_BIT,
+            VK_SHADER_STAGE_FRAGMENT_BIT,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+        };
+        if (ExecutionModel >= sizeof(ExecutionModelStages) / sizeof(ExecutionModelStages[0]))
+        {
+            return false;
+        }
+        OutReflection.Stage = ExecutionModelStages[ExecutionModel];
+
+        for (uint32_t VariableId : Variables)
+        {
+            const AIdInfo& Variable = Ids[VariableId];
+            const uint32_t PointerId = Code[Variable.Instruction + 1];
+            const uint32_t StorageClass = Code[Variable.Instruction + 3];
+            if (!IsValidId(PointerId) || Ids[PointerId].Op != Spirv::OpTypePointer)
+            {
+                continue;
+            }
+            uint32_t TypeId = Operand(PointerId, 3);
+            if (!IsValidId(TypeId))
+            {
+                continue;
+            }
+
+            switch (StorageClass)
+            {
+            case Spirv::UniformConstant:
+            case Spirv::Uniform:
+            case Spirv::StorageBuffer:
+            {
+                if (Variable.Set == InvalidValue || Variable.Binding == InvalidValue)
+                {
+                    break;
+                }
+
+                AVulkanShaderReflection::ABinding Binding;
+                Binding.Set = Variable.Set;
+                Binding.Binding = Variable.Binding;
+                Binding.Count = 1;
+                Binding.bDrawData = false;
+                while (IsValidId(TypeId) && (Ids[TypeId].Op == Spirv::OpTypeArray || Ids[TypeId].Op == Spirv::OpTypeRuntimeArray))
+                {
+                    if (Ids[TypeId].Op == Spirv::OpTypeRuntimeArray)
+                    {
+                        Binding.Count = 0;
+                    }
+                    else
+                    {
+                        const uint32_t LengthId = Operand(TypeId, 3);
+                        Binding.Count *= IsValidId(LengthId) && Ids[LengthId].Op == Spirv::OpConstant ? Operand(LengthId, 3) : 1;
+                    }
+                    TypeId = Operand(TypeId, 2);
+                }
+
+                Binding.Type = IsValidId(TypeId) ? GetDescriptorType(TypeId, StorageClass) : VK_DESCRIPTOR_TYPE_MAX_ENUM;
+                Binding.bDrawData = Binding.Type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER && (Variable.bDrawDataName || Ids[TypeId].bDrawDataName);
+                if (Binding.Type != VK_DESCRIPTOR_TYPE_MAX_ENUM)
+                {
+                    OutReflection.Bindings.Add(Binding);
+                }
+                break;
+            }
+            case Spirv::PushConstant:
+                if (Ids[TypeId].Op == Spirv::OpTypeStruct)
+                {
+                    const TArray<uint32_t>& Offsets = Ids[TypeId].MemberOffsets;
+                    const uint32_t Offset = Offsets.IsEmpty() ? 0 : *std::min_element(Offsets.begin(), Offsets.end());
+                    OutReflection.PushConstantOffset = Offset;
+                    OutReflection.PushConstantSize = GetTypeSize(TypeId, 0) - Offset;
+                }
+                break;
+            case Spirv::Input:
+                if (OutReflection.Stage == VK_SHADER_STAGE_VERTEX_BIT && !Variable.bBuiltIn && Variable.Location != InvalidValue)
+                {
+                    OutReflection.VertexInputs.Add(AVulkanShaderReflection::AVertexInput{ Variable.Location, GetVertexFormat(TypeId) });
+                }
+                break;
+            default:
+                break;
+            }
+        }
+
+        std::sort(OutReflection.Bindings.begin(), OutReflection.Bindings.end(),
+            [](const AVulkanShaderReflection::ABinding& A, const AVulkanShaderReflection::ABinding& B)
+            { return A.Set != B.Set ? A.Set < B.Set : A.Binding < B.Binding; });
+        OutReflection.SpecializationConstants.Sort();
+        std::sort(OutReflection.VertexInputs.begin(), OutReflection.VertexInputs.end(),
+            [](const AVulkanShaderReflection::AVertexInput& A, const AVulkanShaderReflection::AVertexInput& B) { return A.Location < B.Location; });
+
+        return true;
+    }
+} // namespace
+
+bool AVulkanShaderReflection::Parse(const uint32_t* Code, size_t CodeSize, AVulkanShaderReflection& OutReflection)
+{
+    OutReflection.Stage = VK_SHADER_STAGE_ALL;
+    OutReflection.EntryPoint.clear();
+    OutReflection.Bindings.Clear();
+    OutReflection.VertexInputs.Clear();
+    OutReflection.SpecializationConstants.Clear();
+    OutReflection.PushConstantOffset = 0;
+    OutReflection.PushConstantSize = 0;
+
+    ASpirvParser Parser(Code, CodeSize / sizeof(uint32_t));
+    return Parser.Parse(OutReflection);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "VulkanApi.h"
+
+enum
+{
+    MaxDescriptorSets = 4
+};
+
+// Resource interface of the first entry point of a SPIR-V module, parsed from the module words.
+struct AVulkanShaderReflection
+{
+    struct ABinding
+    {
+        uint32_t Set;
+        uint32_t Binding;
+        VkDescriptorType Type;
+        // 0 for runtime sized arrays.
+        uint32_t Count;
+        // Uniform block or its type named DrawData, see AVulkanPipelineLayout::DrawDataSetIndex.
+        bool bDrawData;
+    };
+
+    struct AVertexInput
+    {
+        uint32_t Location;
+        VkFormat Format;
+    };
+
+    VkShaderStageFlagBits Stage;
+    AString EntryPoint;
+
+    // Sorted by set and binding.
+    TArray<ABinding> Bindings;
+    // Sorted by location, vertex shaders only.
+    TArray<AVertexInput> VertexInputs;
+    // Sorted constant_id of the specialization constants.
+    TArray<uint32_t> SpecializationConstants;
+
+    // Size is 0 without push constants.
+    uint32_t PushConstantOffset;
+    uint32_t PushConstantSize;
+
+    static bool Parse(const uint32_t* Code, size_t CodeSize, AVulkanShaderReflection& OutReflection);
+};
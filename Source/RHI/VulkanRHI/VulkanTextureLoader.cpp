@@ -0,0 +1,228 @@
+#include "VulkanTextureLoader.h"
+
+#include "Core/Compression.h"
+#include "Core/MappedFile.h"
+#include "Core/TextureDecoder.h"
+#include "VulkanDevice.h"
+#include "VulkanTextureUpload.h"
+
+// CPU decoder of a format and the uncompressed format its texels are uploaded in.
+static bool GetDecodeFallback(VkFormat Format, ETextureBlockFormat& OutBlockFormat, VkFormat& OutDecodedFormat)
+{
+    switch (Format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC1;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC1;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC1A;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC1A;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC2;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC2;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC3;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC3;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC4;
+        OutDecodedFormat = VK_FORMAT_R8_UNORM;
+        return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::BC5;
+        OutDecodedFormat = VK_FORMAT_R8G8_UNORM;
+        return true;
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::ETC2_RGB8;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::ETC2_RGB8;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::ETC2_RGB8A1;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::ETC2_RGB8A1;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::ETC2_RGBA8;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        return true;
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::ETC2_RGBA8;
+        OutDecodedFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        return true;
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::EAC_R11;
+        OutDecodedFormat = VK_FORMAT_R16_UNORM;
+        return true;
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+        OutBlockFormat = ETextureBlockFormat::EAC_RG11;
+        OutDecodedFormat = VK_FORMAT_R16G16_UNORM;
+        return true;
+    default:
+        return false;
+    }
+}
+
+AVulkanTexture* AVulkanTextureLoader::LoadKTX2(AVulkanTextureUploader* Uploader, const AnsiChar* Filename)
+{
+    AMappedFile File;
+    if (!File.Open(Filename))
+    {
+        std::cerr << "[WARNING] Failed to open texture " << Filename << ".\n";
+        return nullptr;
+    }
+
+    AVulkanTexture* Texture = LoadKTX2(Uploader, File.GetData(), File.GetSize());
+    if (!Texture)
+    {
+        std::cerr << "[WARNING] Failed to load texture " << Filename << ".\n";
+    }
+    return Texture;
+}
+
+AVulkanTexture* AVulkanTextureLoader::LoadKTX2(AVulkanTextureUploader* Uploader, const void* Data, size_t Size)
+{
+    const uint8_t* Bytes = static_cast<const uint8_t*>(Data);
+    AKTX2Format::AHeader Header;
+    if (Size < sizeof(Header))
+    {
+        std::cerr << "[WARNING] KTX2: file too small.\n";
+        return nullptr;
+    }
+    AMemory::Memcpy(&Header, Bytes, sizeof(Header));
+    if (AMemory::Memcmp(Header.Identifier, AKTX2Format::Identifier, sizeof(Header.Identifier)) != 0)
+    {
+        std::cerr << "[WARNING] KTX2: not a KTX2 file.\n";
+        return nullptr;
+    }
+
+    const VkFormat Format = static_cast<VkFormat>(Header.Format);
+    if (Format == VK_FORMAT_UNDEFINED || Header.Supercompression == AKTX2Format::ESupercompression::BasisLZ)
+    {
+        std::cerr << "[WARNING] KTX2: Basis Universal textures need a transcoder.\n";
+        return nullptr;
+    }
+    if (Header.Format >= VK_FORMAT_RANGE_SIZE || GetFormatBlock(Format).BlockBytes == 0)
+    {
+        std::cerr << "[WARNING] KTX2: unsupported format " << Header.Format << ".\n";
+        return nullptr;
+    }
+    if (Header.PixelWidth == 0 || Header.PixelHeight == 0 || Header.PixelDepth > 1 || Header.LayerCount > 1 || Header.FaceCount != 1)
+    {
+        std::cerr << "[WARNING] KTX2: only 2D textures are supported.\n";
+        return nullptr;
+    }
+    if (Header.Supercompression != AKTX2Format::ESupercompression::None && Header.Supercompression != AKTX2Format::ESupercompression::Zlib)
+    {
+        std::cerr << "[WARNING] KTX2: unsupported supercompression scheme " << static_cast<uint32_t>(Header.Supercompression) << ".\n";
+        return nullptr;
+    }
+
+    const uint32_t NumLevels = std::max(Header.LevelCount, 1u);
+    if (NumLevels > GetNumFullMips(Header.PixelWidth, Header.PixelHeight) || Size < sizeof(Header) + NumLevels * sizeof(AKTX2Format::ALevel))
+    {
+        std::cerr << "[WARNING] KTX2: invalid level index.\n";
+        return nullptr;
+    }
+
+    // Inflated levels, the others are read straight from Data.
+    TArray<TArray<uint8_t>> Inflated(static_cast<int32_t>(NumLevels));
+    TArray<const void*> LevelData;
+    for (uint32_t LevelIndex = 0; LevelIndex < NumLevels; ++LevelIndex)
+    {
+        AKTX2Format::ALevel Level;
+        AMemory::Memcpy(&Level, Bytes + sizeof(Header) + LevelIndex * sizeof(Level), sizeof(Level));
+
+        const VkDeviceSize MipSize = GetMipSize(Format, std::max(Header.PixelWidth >> LevelIndex, 1u), std::max(Header.PixelHeight >> LevelIndex, 1u));
+        if (Level.ByteOffset > Size || Level.ByteLength > Size - Level.ByteOffset)
+        {
+            std::cerr << "[WARNING] KTX2: level " << LevelIndex << " is out of bounds.\n";
+            return nullptr;
+        }
+
+        if (Header.Supercompression == AKTX2Format::ESupercompression::Zlib)
+        {
+            TArray<uint8_t>& InflatedLevel = Inflated[LevelIndex];
+            InflatedLevel.Resize(static_cast<int32_t>(MipSize));
+            if (Level.UncompressedByteLength != MipSize ||
+                !ACompression::DecompressZlib(
+                    Bytes + Level.ByteOffset, static_cast<size_t>(Level.ByteLength), InflatedLevel.GetData(), static_cast<size_t>(MipSize)))
+            {
+                std::cerr << "[WARNING] KTX2: failed to inflate level " << LevelIndex << ".\n";
+                return nullptr;
+            }
+            LevelData.Add(InflatedLevel.GetData());
+        }
+        else
+        {
+            if (Level.ByteLength < MipSize)
+            {
+                std::cerr << "[WARNING] KTX2: level " << LevelIndex << " is truncated.\n";
+                return nullptr;
+            }
+            LevelData.Add(Bytes + Level.ByteOffset);
+        }
+    }
+
+    AVulkanTextureUploadDesc Desc;
+    Desc.Format = Format;
+    Desc.Width = Header.PixelWidth;
+    Desc.Height = Header.PixelHeight;
+    Desc.NumMips = Header.LevelCount;
+    Desc.NumDataMips = NumLevels;
+
+    const VkFormatFeatureFlags Features = Uploader->GetDevice()->GetFormatProperties()[Format].optimalTilingFeatures;
+    if (Features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)
+    {
+        return Uploader->CreateTexture(Desc, LevelData.GetData());
+    }
+
+    ETextureBlockFormat BlockFormat;
+    VkFormat DecodedFormat;
+    if (!GetDecodeFallback(Format, BlockFormat, DecodedFormat))
+    {
+        std::cerr << "[WARNING] KTX2: format " << Header.Format << " can't be sampled on this device and has no CPU decoder.\n";
+        return nullptr;
+    }
+
+    std::cerr << "[WARNING] KTX2: format " << Header.Format << " can't be sampled on this device, decoding " << Desc.Width << "x" << Desc.Height
+              << " on the CPU.\n";
+
+    TArray<TArray<uint8_t>> Decoded(static_cast<int32_t>(NumLevels));
+    for (uint32_t LevelIndex = 0; LevelIndex < NumLevels; ++LevelIndex)
+    {
+        const uint32_t LevelWidth = std::max(Desc.Width >> LevelIndex, 1u);
+        const uint32_t LevelHeight = std::max(Desc.Height >> LevelIndex, 1u);
+        Decoded[LevelIndex].Resize(static_cast<int32_t>(GetMipSize(DecodedFormat, LevelWidth, LevelHeight)));
+        ATextureDecoder::Decode(BlockFormat, LevelData[LevelIndex], LevelWidth, LevelHeight, Decoded[LevelIndex].GetData());
+        LevelData[LevelIndex] = Decoded[LevelIndex].GetData();
+    }
+
+    Desc.Format = DecodedFormat;
+    return Uploader->CreateTexture(Desc, LevelData.GetData());
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "VulkanApi.h"
+
+class AVulkanTextureUploader;
+struct AVulkanTexture;
+
+// KTX2 container (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html).
+//
+// Layout: AHeader | ALevel[max(LevelCount, 1)] | data format descriptor | key/value data | supercompression
+// global data | mip levels. The level index starts with the largest mip, the file stores the smallest first.
+struct AKTX2Format
+{
+    static constexpr uint8_t Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    enum class ESupercompression : uint32_t
+    {
+        None,
+        BasisLZ,
+        Zstandard,
+        Zlib,
+    };
+
+    struct AHeader
+    {
+        uint8_t Identifier[12];
+        // VK_FORMAT_UNDEFINED for Basis Universal data, which needs transcoding.
+        uint32_t Format;
+        uint32_t TypeSize;
+        uint32_t PixelWidth;
+        uint32_t PixelHeight;
+        uint32_t PixelDepth;
+        uint32_t LayerCount;
+        uint32_t FaceCount;
+        // Zero asks the loader to generate the mips from the single level in the file.
+        uint32_t LevelCount;
+        ESupercompression Supercompression;
+
+        uint32_t DfdByteOffset;
+        uint32_t DfdByteLength;
+        uint32_t KvdByteOffset;
+        uint32_t KvdByteLength;
+        uint64_t SgdByteOffset;
+        uint64_t SgdByteLength;
+    };
+
+    struct ALevel
+    {
+        uint64_t ByteOffset;
+        uint64_t ByteLength;
+        uint64_t UncompressedByteLength;
+    };
+};
+
+static_assert(sizeof(AKTX2Format::AHeader) == 80, "KTX2 header layout mismatch.");
+
+// Creates textures from KTX2 files through the uploader, so they can be sampled after the next BeginDrawing().
+//
+// Block compressed levels are uploaded as they are and stay compressed in memory. Zlib supercompressed levels
+// are inflated first. When the device can't sample the format, BC1-5 and ETC2/EAC are decoded on the CPU and
+// uploaded uncompressed instead, other formats fail to load.
+struct AVulkanTextureLoader
+{
+    // 2D textures only, returns nullptr on failure.
+    static AVulkanTexture* LoadKTX2(AVulkanTextureUploader* Uploader, const AnsiChar* Filename);
+    static AVulkanTexture* LoadKTX2(AVulkanTextureUploader* Uploader, const void* Data, size_t Size);
+};
@@ -0,0 +1,496 @@
+#include "VulkanTextureStreaming.h"
+
+#include "VulkanCommandBuffer.h"
+#include "VulkanDescriptorSets.h"
+#include "VulkanDevice.h"
+#include "VulkanMemory.h"
+#include "VulkanQueue.h"
+#include "VulkanResources.h"
+#include "VulkanTextureUpload.h"
+
+AVulkanTextureStreamer::AVulkanTextureStreamer(AVulkanDevice* InDevice, AVulkanTextureUploader* InUploader, VkDeviceSize InBudgetBytes)
+    : TransferCmdBufferPool(nullptr), TransferCmdBuffer(nullptr), FrameNumber(0), BudgetBytes(InBudgetBytes), Uploader(InUploader), Device(InDevice)
+{
+    TransferCmdBufferPool = new AVulkanCommandBufferPool(Device, Device->GetTransferQueue()->GetFamilyIndex());
+}
+
+AVulkanTextureStreamer::~AVulkanTextureStreamer()
+{
+    AVulkanQueue* TransferQueue = Device->GetTransferQueue();
+    TransferQueue->GetTimeline()->WaitFor(TransferQueue->GetLastSubmittedValue(), UINT64_MAX);
+
+    for (AStreamingRequest& Request : PendingRequests)
+    {
+        delete Request.Texture;
+        delete Request.StagingBuffer;
+    }
+    PendingRequests.Clear();
+
+    AVulkanBindlessHeap* BindlessHeap = Device->GetBindlessHeap();
+    for (AVulkanStreamedTexture* StreamedTexture : StreamedTextures)
+    {
+        if (BindlessHeap && StreamedTexture->GetBindlessHandle() != AVulkanBindlessHeap::InvalidHandle)
+        {
+            BindlessHeap->Remove(AVulkanBindlessHeap::SampledImages, StreamedTexture->GetBindlessHandle());
+        }
+        delete StreamedTexture->GetTexture();
+        delete StreamedTexture;
+    }
+    StreamedTextures.Clear();
+
+    for (TPair<uint64_t, AVulkanTexture*>& Retired : RetiredTextures)
+    {
+        delete Retired.second;
+    }
+    RetiredTextures.Clear();
+
+    delete TransferCmdBufferPool;
+    TransferCmdBufferPool = nullptr;
+}
+
+AVulkanStreamedTexture* AVulkanTextureStreamer::RegisterTexture(const AVulkanStreamedTextureDesc& Desc)
+{
+    check(Desc.Width != 0 && Desc.Height != 0 && Desc.MipData != nullptr, "Invalid streamed texture desc.");
+    const uint32_t NumMips = std::min(std::max(Desc.NumMips, 1u), GetNumFullMips(Desc.Width, Desc.Height));
+
+    uint32_t TailMip = 0;
+    while (TailMip + 1 < NumMips && std::max(Desc.Width >> TailMip, Desc.Height >> TailMip) > MinResidentSize)
+    {
+        ++TailMip;
+    }
+
+    // Only the tail starts resident, the larger mips follow once the texture is drawn.
+    AVulkanTextureUploadDesc UploadDesc;
+    UploadDesc.Format = Desc.Format;
+    UploadDesc.Width = std::max(Desc.Width >> TailMip, 1u);
+    UploadDesc.Height = std::max(Desc.Height >> TailMip, 1u);
+    UploadDesc.NumMips = NumMips - TailMip;
+    UploadDesc.NumDataMips = NumMips - TailMip;
+    AVulkanTexture* Texture = Uploader->CreateTexture(UploadDesc, Desc.MipData + TailMip);
+    if (!Texture)
+    {
+        return nullptr;
+    }
+
+    AVulkanStreamedTexture* StreamedTexture = new AVulkanStreamedTexture();
+    StreamedTexture->Texture.store(Texture, std::memory_order_relaxed);
+    AVulkanBindlessHeap* BindlessHeap = Device->GetBindlessHeap();
+    StreamedTexture->BindlessHandle.store(BindlessHeap ? BindlessHeap->AddSampledImage(Texture->View) : AVulkanBindlessHeap::InvalidHandle,
+        std::memory_order_relaxed);
+    StreamedTexture->ResidentMip.store(TailMip, std::memory_order_relaxed);
+    StreamedTexture->RequestedScreenSize.store(0, std::memory_order_relaxed);
+    StreamedTexture->Format = Desc.Format;
+    StreamedTexture->Width = Desc.Width;
+    StreamedTexture->Height = Desc.Height;
+    StreamedTexture->MipData = TArray<const void*>(const_cast<const void**>(Desc.MipData), static_cast<int32_t>(NumMips));
+    StreamedTexture->TailMip = TailMip;
+    StreamedTexture->DesiredMip = TailMip;
+    StreamedTexture->TargetMip = TailMip;
+    StreamedTexture->LastScreenSize = 0;
+    StreamedTexture->LastRequestFrame = FrameNumber;
+    StreamedTexture->bRequestPending = false;
+    StreamedTextures.Add(StreamedTexture);
+    return StreamedTexture;
+}
+
+void AVulkanTextureStreamer::UnregisterTexture(AVulkanStreamedTexture* StreamedTexture)
+{
+    if (StreamedTexture->bRequestPending)
+    {
+        for (int32_t Index = 0; Index < PendingRequests.Num(); ++Index)
+        {
+            AStreamingRequest& Request = PendingRequests[Index];
+            if (Request.StreamedTexture == StreamedTexture)
+            {
+                // Never sampled, only the transfer queue has to be done with it.
+                Device->GetTransferQueue()->GetTimeline()->WaitFor(Request.TimelineValue, UINT64_MAX);
+                delete Request.Texture;
+                delete Request.StagingBuffer;
+                PendingRequests.RemoveAt(Index);
+                break;
+            }
+        }
+    }
+
+    Retire(StreamedTexture->GetTexture(), StreamedTexture->GetBindlessHandle());
+    StreamedTextures.RemoveFirstOf(StreamedTexture);
+    delete StreamedTexture;
+}
+
+void AVulkanTextureStreamer::RequestScreenSize(AVulkanStreamedTexture* StreamedTexture, uint32_t ScreenSize)
+{
+    uint32_t Current = StreamedTexture->RequestedScreenSize.load(std::memory_order_relaxed);
+    while (Current < ScreenSize && !StreamedTexture->RequestedScreenSize.compare_exchange_weak(Current, ScreenSize, std::memory_order_relaxed))
+    {
+    }
+}
+
+VkDeviceSize AVulkanTextureStreamer::GetChainSize(const AVulkanStreamedTexture* StreamedTexture, uint32_t FirstMip)
+{
+    VkDeviceSize Size = 0;
+    for (uint32_t Mip = FirstMip; Mip < StreamedTexture->GetNumMips(); ++Mip)
+    {
+        Size += GetMipSize(StreamedTexture->Format, std::max(StreamedTexture->Width >> Mip, 1u), std::max(StreamedTexture->Height >> Mip, 1u));
+    }
+    return Size;
+}
+
+float AVulkanTextureStreamer::GetMipPriority(const AVulkanStreamedTexture* StreamedTexture, uint32_t Mip)
+{
+    const uint32_t MipSize = std::max(std::max(StreamedTexture->Width >> Mip, StreamedTexture->Height >> Mip), 1u);
+    return static_cast<float>(StreamedTexture->LastScreenSize) / MipSize;
+}
+
+void AVulkanTextureStreamer::Update(AVulkanCommandBuffer* CmdBuffer)
+{
+    check(CmdBuffer->IsOutsideRenderPass(), "Streamed texture swaps can't be recorded inside a render pass.");
+
+    FinishRequests(CmdBuffer);
+    UpdateTargetMips();
+
+    // Old and new images both hold memory until a swap, so requests in flight count twice.
+    VkDeviceSize ResidentBytes = 0;
+    for (const AVulkanStreamedTexture* StreamedTexture : StreamedTextures)
+    {
+        ResidentBytes += GetChainSize(StreamedTexture, StreamedTexture->GetResidentMip());
+    }
+    for (const AStreamingRequest& Request : PendingRequests)
+    {
+        ResidentBytes += GetChainSize(Request.StreamedTexture, Request.FirstMip);
+    }
+
+    // Stream outs first, they make room for the stream ins.
+    TArray<AVulkanStreamedTexture*> StreamIns;
+    for (AVulkanStreamedTexture* StreamedTexture : StreamedTextures)
+    {
+        if (StreamedTexture->bRequestPending || StreamedTexture->TargetMip == StreamedTexture->GetResidentMip())
+        {
+            continue;
+        }
+        if (StreamedTexture->TargetMip > StreamedTexture->GetResidentMip())
+        {
+            StartRequest(StreamedTexture, StreamedTexture->TargetMip);
+            ResidentBytes += GetChainSize(StreamedTexture, StreamedTexture->TargetMip);
+        }
+        else
+        {
+            StreamIns.Add(StreamedTexture);
+        }
+    }
+
+    // The textures drawn largest compared to their resident mip go first.
+    std::sort(StreamIns.begin(), StreamIns.end(), [](const AVulkanStreamedTexture* A, const AVulkanStreamedTexture* B) {
+        return GetMipPriority(A, A->GetResidentMip()) > GetMipPriority(B, B->GetResidentMip());
+    });
+    for (AVulkanStreamedTexture* StreamedTexture : StreamIns)
+    {
+        const VkDeviceSize ChainSize = GetChainSize(StreamedTexture, StreamedTexture->TargetMip);
+        // A single chain larger than the frame limit still goes through on its own.
+        if (CurrentStats.UploadedBytes != 0 && CurrentStats.UploadedBytes + ChainSize > MaxUploadBytesPerFrame)
+        {
+            break;
+        }
+        if (ResidentBytes + ChainSize > BudgetBytes)
+        {
+            continue;
+        }
+        StartRequest(StreamedTexture, StreamedTexture->TargetMip);
+        ResidentBytes += ChainSize;
+    }
+
+    if (TransferCmdBuffer)
+    {
+        TransferCmdBuffer->End();
+        const uint64_t TimelineValue = Device->GetTransferQueue()->Submit(TransferCmdBuffer, 0, nullptr, nullptr, 0, nullptr, nullptr);
+        TransferCmdBuffer->State = AVulkanCommandBuffer::EState::Submitted;
+        SubmittedCmdBuffers.Add(TPair<uint64_t, AVulkanCommandBuffer*>(TimelineValue, TransferCmdBuffer));
+        TransferCmdBuffer = nullptr;
+
+        for (AStreamingRequest& Request : PendingRequests)
+        {
+            if (Request.TimelineValue == 0)
+            {
+                Request.TimelineValue = TimelineValue;
+            }
+        }
+    }
+
+    CurrentStats.NumTextures = static_cast<uint32_t>(StreamedTextures.Num());
+    CurrentStats.NumPendingRequests = static_cast<uint32_t>(PendingRequests.Num());
+    CurrentStats.BudgetBytes = BudgetBytes;
+    for (const AVulkanStreamedTexture* StreamedTexture : StreamedTextures)
+    {
+        CurrentStats.NumResidentMips += StreamedTexture->GetNumMips() - StreamedTexture->GetResidentMip();
+        CurrentStats.NumRequestedMips += StreamedTexture->GetNumMips() - StreamedTexture->DesiredMip;
+        CurrentStats.ResidentBytes += GetChainSize(StreamedTexture, StreamedTexture->GetResidentMip());
+        CurrentStats.RequestedBytes += GetChainSize(StreamedTexture, StreamedTexture->DesiredMip);
+    }
+}
+
+void AVulkanTextureStreamer::FinishRequests(AVulkanCommandBuffer* CmdBuffer)
+{
+    AVulkanQueue* GraphicsQueue = Device->GetGraphicsQueue();
+    AVulkanQueue* TransferQueue = Device->GetTransferQueue();
+    AVulkanTimelineSemaphore* TransferTimeline = TransferQueue->GetTimeline();
+
+    for (int32_t Index = SubmittedCmdBuffers.Num() - 1; Index >= 0; --Index)
+    {
+        if (TransferTimeline->IsCompleted(SubmittedCmdBuffers[Index].first))
+        {
+            SubmittedCmdBuffers[Index].second->Reset();
+            SubmittedCmdBuffers.RemoveAt(Index);
+        }
+    }
+
+    // Ownership moves to the graphics queue when the transfer queue is of another family, the transfer side
+    // released it with the same barrier.
+    const bool bOwnershipTransfer = GraphicsQueue->GetFamilyIndex() != TransferQueue->GetFamilyIndex();
+    TArray<VkImageMemoryBarrier2> AcquireBarriers;
+    uint64_t WaitValue = 0;
+
+    AVulkanBindlessHeap* BindlessHeap = Device->GetBindlessHeap();
+    for (int32_t Index = PendingRequests.Num() - 1; Index >= 0; --Index)
+    {
+        AStreamingRequest& Request = PendingRequests[Index];
+        if (!TransferTimeline->IsCompleted(Request.TimelineValue))
+        {
+            continue;
+        }
+
+        if (bOwnershipTransfer)
+        {
+            VkImageMemoryBarrier2 Barrier;
+            ZeroVulkanStruct(Barrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2);
+            // The stages the timeline wait below blocks, so the acquire and its layout transition run after the wait.
+            Barrier.srcStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+            Barrier.dstStageMask = Barrier.srcStageMask;
+            Barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+            Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            Barrier.srcQueueFamilyIndex = TransferQueue->GetFamilyIndex();
+            Barrier.dstQueueFamilyIndex = GraphicsQueue->GetFamilyIndex();
+            Barrier.image = Request.Texture->Image;
+            Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            Barrier.subresourceRange.levelCount = Request.Texture->NumMips;
+            Barrier.subresourceRange.layerCount = 1;
+            AcquireBarriers.Add(Barrier);
+        }
+        Request.Texture->Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        WaitValue = std::max(WaitValue, Request.TimelineValue);
+
+        AVulkanStreamedTexture* StreamedTexture = Request.StreamedTexture;
+        if (Request.FirstMip < StreamedTexture->GetResidentMip())
+        {
+            ++CurrentStats.NumStreamedIn;
+        }
+        else
+        {
+            ++CurrentStats.NumStreamedOut;
+        }
+
+        // A full heap leaves the texture without a handle rather than pointing at the old image.
+        const uint32_t BindlessHandle = BindlessHeap ? BindlessHeap->AddSampledImage(Request.Texture->View) : AVulkanBindlessHeap::InvalidHandle;
+        AVulkanTexture* OldTexture = StreamedTexture->Texture.exchange(Request.Texture, std::memory_order_acq_rel);
+        const uint32_t OldBindlessHandle = StreamedTexture->BindlessHandle.exchange(BindlessHandle, std::memory_order_acq_rel);
+        StreamedTexture->ResidentMip.store(Request.FirstMip, std::memory_order_relaxed);
+        StreamedTexture->bRequestPending = false;
+        Retire(OldTexture, OldBindlessHandle);
+
+        delete Request.StagingBuffer;
+        PendingRequests.RemoveAt(Index);
+    }
+
+    if (WaitValue != 0)
+    {
+        // Already reached, the wait makes the copies visible to this frame and orders the acquire after the release.
+        GraphicsQueue->AddTimelineWait(TransferTimeline, WaitValue,
+            VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    if (!AcquireBarriers.IsEmpty())
+    {
+        CmdBuffer->PipelineBarrier(AcquireBarriers.GetData(), AcquireBarriers.Num());
+    }
+}
+
+void AVulkanTextureStreamer::UpdateTargetMips()
+{
+    VkDeviceSize TargetBytes = 0;
+    VkDeviceSize StreamInHeadroom = 0;
+    for (AVulkanStreamedTexture* StreamedTexture : StreamedTextures)
+    {
+        const uint32_t ScreenSize = StreamedTexture->RequestedScreenSize.exchange(0, std::memory_order_relaxed);
+        if (ScreenSize != 0)
+        {
+            // The smallest mip still at least as large as the texture on screen.
+            uint32_t DesiredMip = 0;
+            while (DesiredMip < StreamedTexture->TailMip &&
+                   std::max(StreamedTexture->Width >> (DesiredMip + 1), StreamedTexture->Height >> (DesiredMip + 1)) >= ScreenSize)
+            {
+                ++DesiredMip;
+            }
+            StreamedTexture->DesiredMip = DesiredMip;
+            StreamedTexture->LastScreenSize = ScreenSize;
+            StreamedTexture->LastRequestFrame = FrameNumber;
+        }
+        else if (FrameNumber - StreamedTexture->LastRequestFrame > NumUnusedFramesBeforeStreamOut)
+        {
+            StreamedTexture->DesiredMip = StreamedTexture->TailMip;
+            StreamedTexture->LastScreenSize = 0;
+        }
+
+        StreamedTexture->TargetMip = StreamedTexture->DesiredMip;
+        TargetBytes += GetChainSize(StreamedTexture, StreamedTexture->TargetMip);
+        if (StreamedTexture->DesiredMip < StreamedTexture->GetResidentMip())
+        {
+            StreamInHeadroom = std::max(StreamInHeadroom, GetChainSize(StreamedTexture, StreamedTexture->GetResidentMip()));
+        }
+    }
+
+    // A stream in keeps its old chain until the swap, Update() only starts it when both fit the budget. Planning
+    // with room for the largest old chain lets every planned stream in start once the requests before it finished.
+    const VkDeviceSize PlannedBytes = BudgetBytes > StreamInHeadroom ? BudgetBytes - StreamInHeadroom : 0;
+
+    // Over budget, the top mip needed least goes until everything fits or only tails are left.
+    TArray<TPair<float, AVulkanStreamedTexture*>> Heap;
+    for (AVulkanStreamedTexture* StreamedTexture : StreamedTextures)
+    {
+        if (StreamedTexture->TargetMip < StreamedTexture->TailMip)
+        {
+            Heap.Add(TPair<float, AVulkanStreamedTexture*>(GetMipPriority(StreamedTexture, StreamedTexture->TargetMip), StreamedTexture));
+        }
+    }
+    const auto LeastNeededFirst = [](const TPair<float, AVulkanStreamedTexture*>& A, const TPair<float, AVulkanStreamedTexture*>& B) {
+        return A.first > B.first;
+    };
+    std::make_heap(Heap.begin(), Heap.end(), LeastNeededFirst);
+    while (TargetBytes > PlannedBytes && !Heap.IsEmpty())
+    {
+        std::pop_heap(Heap.begin(), Heap.end(), LeastNeededFirst);
+        AVulkanStreamedTexture* StreamedTexture = Heap[Heap.Num() - 1].second;
+        Heap.RemoveAt(Heap.Num() - 1);
+
+        TargetBytes -= GetChainSize(StreamedTexture, StreamedTexture->TargetMip) - GetChainSize(StreamedTexture, StreamedTexture->TargetMip + 1);
+        ++StreamedTexture->TargetMip;
+        if (StreamedTexture->TargetMip < StreamedTexture->TailMip)
+        {
+            Heap.Add(TPair<float, AVulkanStreamedTexture*>(GetMipPriority(StreamedTexture, StreamedTexture->TargetMip), StreamedTexture));
+            std::push_heap(Heap.begin(), Heap.end(), LeastNeededFirst);
+        }
+    }
+}
+
+void AVulkanTextureStreamer::StartRequest(AVulkanStreamedTexture* StreamedTexture, uint32_t FirstMip)
+{
+    const uint32_t NumMips = StreamedTexture->GetNumMips() - FirstMip;
+
+    // The whole new chain comes from the CPU data, the old image is never read on the transfer queue.
+    TArray<VkBufferImageCopy> Regions;
+    VkDeviceSize StagingSize = 0;
+    for (uint32_t MipIndex = 0; MipIndex < NumMips; ++MipIndex)
+    {
+        const uint32_t MipWidth = std::max(StreamedTexture->Width >> (FirstMip + MipIndex), 1u);
+        const uint32_t MipHeight = std::max(StreamedTexture->Height >> (FirstMip + MipIndex), 1u);
+
+        VkBufferImageCopy Region = {};
+        Region.bufferOffset = StagingSize;
+        Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Region.imageSubresource.mipLevel = MipIndex;
+        Region.imageSubresource.layerCount = 1;
+        Region.imageExtent = { MipWidth, MipHeight, 1 };
+        Regions.Add(Region);
+
+        const VkDeviceSize MipSize = GetMipSize(StreamedTexture->Format, MipWidth, MipHeight);
+        StagingSize = (StagingSize + MipSize + StagingAlignment - 1) & ~(StagingAlignment - 1);
+    }
+
+    AVulkanBuffer* StagingBuffer = new AVulkanBuffer(Device, StagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    for (uint32_t MipIndex = 0; MipIndex < NumMips; ++MipIndex)
+    {
+        const VkExtent3D& Extent = Regions[MipIndex].imageExtent;
+        const VkDeviceSize MipSize = GetMipSize(StreamedTexture->Format, Extent.width, Extent.height);
+        AMemory::Memcpy(
+            StagingBuffer->MappedData + Regions[MipIndex].bufferOffset, StreamedTexture->MipData[FirstMip + MipIndex], static_cast<size_t>(MipSize));
+    }
+
+    AVulkanTexture* Texture = new AVulkanTexture(Device, VK_IMAGE_VIEW_TYPE_2D, StreamedTexture->Format, Regions[0].imageExtent.width,
+        Regions[0].imageExtent.height, 1, 1, NumMips, 1, VK_IMAGE_ASPECT_COLOR_BIT);
+
+    if (!TransferCmdBuffer)
+    {
+        TransferCmdBuffer = TransferCmdBufferPool->PrepareCommandBuffer();
+        TransferCmdBuffer->Begin();
+    }
+
+    VkImageMemoryBarrier2 Barrier;
+    ZeroVulkanStruct(Barrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2);
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Texture->Image;
+    Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    Barrier.subresourceRange.levelCount = NumMips;
+    Barrier.subresourceRange.layerCount = 1;
+    Barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    TransferCmdBuffer->PipelineBarrier(&Barrier, 1);
+
+    VulkanApi::vkCmdCopyBufferToImage(TransferCmdBuffer->GetHandle(), StagingBuffer->Buffer, Texture->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        NumMips, Regions.GetData());
+
+    // The graphics queue waits on the transfer timeline before sampling, so nothing follows the copy here. With
+    // another queue family this releases the image, FinishRequests() records the matching acquire.
+    const uint32_t GraphicsFamilyIndex = Device->GetGraphicsQueue()->GetFamilyIndex();
+    const uint32_t TransferFamilyIndex = Device->GetTransferQueue()->GetFamilyIndex();
+    Barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    Barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    Barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    Barrier.dstAccessMask = VK_ACCESS_2_NONE;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    if (GraphicsFamilyIndex != TransferFamilyIndex)
+    {
+        Barrier.srcQueueFamilyIndex = TransferFamilyIndex;
+        Barrier.dstQueueFamilyIndex = GraphicsFamilyIndex;
+    }
+    TransferCmdBuffer->PipelineBarrier(&Barrier, 1);
+
+    AStreamingRequest Request;
+    Request.StreamedTexture = StreamedTexture;
+    Request.Texture = Texture;
+    Request.StagingBuffer = StagingBuffer;
+    Request.FirstMip = FirstMip;
+    Request.TimelineValue = 0;
+    PendingRequests.Add(Request);
+
+    StreamedTexture->bRequestPending = true;
+    CurrentStats.UploadedBytes += StagingSize;
+}
+
+void AVulkanTextureStreamer::Retire(AVulkanTexture* Texture, uint32_t BindlessHandle)
+{
+    AVulkanBindlessHeap* BindlessHeap = Device->GetBindlessHeap();
+    if (BindlessHeap && BindlessHandle != AVulkanBindlessHeap::InvalidHandle)
+    {
+        // The heap holds on to the handle for the frames in flight itself.
+        BindlessHeap->Remove(AVulkanBindlessHeap::SampledImages, BindlessHandle);
+    }
+    RetiredTextures.Add(TPair<uint64_t, AVulkanTexture*>(FrameNumber, Texture));
+}
+
+void AVulkanTextureStreamer::EndFrame()
+{
+    ++FrameNumber;
+    for (int32_t Index = RetiredTextures.Num() - 1; Index >= 0; --Index)
+    {
+        if (RetiredTextures[Index].first + NumFramesInFlight <= FrameNumber)
+        {
+            delete RetiredTextures[Index].second;
+            RetiredTextures.RemoveAt(Index);
+        }
+    }
+
+    LastStats = CurrentStats;
+    CurrentStats = AVulkanTextureStreamingStats();
+}
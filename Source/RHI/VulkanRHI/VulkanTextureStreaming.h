@@ -0,0 +1,168 @@
+#pragma once
+
+#include "VulkanApi.h"
+
+#include <atomic>
+
+class AVulkanCommandBuffer;
+class AVulkanCommandBufferPool;
+class AVulkanDevice;
+class AVulkanTextureUploader;
+struct AVulkanBuffer;
+struct AVulkanTexture;
+
+struct AVulkanStreamedTextureDesc
+{
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t NumMips = 1;
+    // Each of the NumMips mips, largest first. Mips are streamed from here, so the data must stay valid until
+    // the texture is unregistered.
+    const void* const* MipData = nullptr;
+};
+
+// A texture whose largest mips are only resident while they are needed. The texture and its bindless handle
+// change between frames as mips stream in and out, fetch them again every frame instead of keeping them.
+class AVulkanStreamedTexture
+{
+public:
+    // Safe from any thread, the previous texture stays valid for the frames in flight after a swap.
+    inline AVulkanTexture* GetTexture() const { return Texture.load(std::memory_order_acquire); }
+    // AVulkanBindlessHeap::InvalidHandle without a bindless heap.
+    inline uint32_t GetBindlessHandle() const { return BindlessHandle.load(std::memory_order_acquire); }
+
+    // Mip of the source data the resident texture starts with.
+    inline uint32_t GetResidentMip() const { return ResidentMip.load(std::memory_order_relaxed); }
+    inline uint32_t GetNumMips() const { return static_cast<uint32_t>(MipData.Num()); }
+
+private:
+    AVulkanStreamedTexture() = default;
+
+    std::atomic<AVulkanTexture*> Texture;
+    std::atomic<uint32_t> BindlessHandle;
+    std::atomic<uint32_t> ResidentMip;
+    // Largest screen size the texture was drawn at this frame, in pixels along its longest side.
+    std::atomic<uint32_t> RequestedScreenSize;
+
+    VkFormat Format;
+    uint32_t Width;
+    uint32_t Height;
+    TArray<const void*> MipData;
+
+    // Smallest mip that is never streamed out.
+    uint32_t TailMip;
+    // Mip wanted from the screen size, then the one the budget allows.
+    uint32_t DesiredMip;
+    uint32_t TargetMip;
+    uint32_t LastScreenSize;
+    uint64_t LastRequestFrame;
+
+    // An upload to a new image is in flight, at most one at a time.
+    bool bRequestPending;
+
+    friend class AVulkanTextureStreamer;
+};
+
+struct AVulkanTextureStreamingStats
+{
+    uint32_t NumTextures = 0;
+    // Summed over every texture, resident counts what can be sampled now and requested what the screen sizes
+    // asked for before the budget.
+    uint32_t NumResidentMips = 0;
+    uint32_t NumRequestedMips = 0;
+    VkDeviceSize ResidentBytes = 0;
+    VkDeviceSize RequestedBytes = 0;
+    VkDeviceSize BudgetBytes = 0;
+
+    // Of the last frame.
+    uint32_t NumStreamedIn = 0;
+    uint32_t NumStreamedOut = 0;
+    uint32_t NumPendingRequests = 0;
+    VkDeviceSize UploadedBytes = 0;
+};
+
+// Keeps the mips of registered textures resident according to how large they are drawn on screen.
+//
+// Each frame Update() picks the first mip of every texture from the screen sizes reported with
+// RequestScreenSize(), then drops the top mip of the textures that need it least until the chains fit the
+// budget, minus room for the old chain of the largest stream in. Changes are uploaded from the CPU data into
+// a new image on the transfer queue, the streamed texture switches to it at the start of the first frame
+// after the copies finished and the old image is destroyed once no frame in flight uses it. Mips at most
+// MinResidentSize texels wide are always resident.
+class AVulkanTextureStreamer
+{
+public:
+    AVulkanTextureStreamer(AVulkanDevice* Device, AVulkanTextureUploader* Uploader, VkDeviceSize BudgetBytes);
+    ~AVulkanTextureStreamer();
+
+    // Render thread only. The tail mips are created through the uploader and ready after the next BeginDrawing(),
+    // returns nullptr when the texture can't be uploaded.
+    AVulkanStreamedTexture* RegisterTexture(const AVulkanStreamedTextureDesc& Desc);
+    // Render thread only, waits for the texture's pending upload.
+    void UnregisterTexture(AVulkanStreamedTexture* StreamedTexture);
+
+    // Thread safe, called for every draw sampling the texture with its size on screen in pixels.
+    void RequestScreenSize(AVulkanStreamedTexture* StreamedTexture, uint32_t ScreenSize);
+
+    // Swaps in the finished uploads and starts new ones, outside of any render pass at the start of the frame.
+    void Update(AVulkanCommandBuffer* CmdBuffer);
+    void EndFrame();
+
+    void SetBudget(VkDeviceSize InBudgetBytes) { BudgetBytes = InBudgetBytes; }
+    inline const AVulkanTextureStreamingStats& GetLastStats() const { return LastStats; }
+
+private:
+    struct AStreamingRequest
+    {
+        AVulkanStreamedTexture* StreamedTexture;
+        AVulkanTexture* Texture;
+        AVulkanBuffer* StagingBuffer;
+        uint32_t FirstMip;
+        // Transfer queue timeline value signaled once the copies finished.
+        uint64_t TimelineValue;
+    };
+
+    // Bytes of the mips from FirstMip down.
+    static VkDeviceSize GetChainSize(const AVulkanStreamedTexture* StreamedTexture, uint32_t FirstMip);
+    // How much the last screen size needs Mip, two when the texture is drawn twice as large as the mip.
+    static float GetMipPriority(const AVulkanStreamedTexture* StreamedTexture, uint32_t Mip);
+
+    void FinishRequests(AVulkanCommandBuffer* CmdBuffer);
+    void UpdateTargetMips();
+    void StartRequest(AVulkanStreamedTexture* StreamedTexture, uint32_t FirstMip);
+    void Retire(AVulkanTexture* Texture, uint32_t BindlessHandle);
+
+private:
+    enum
+    {
+        // Frames a swapped out texture may still be sampled in.
+        NumFramesInFlight = 3,
+        // Frames a texture keeps its mips after it was last drawn.
+        NumUnusedFramesBeforeStreamOut = 30,
+        MinResidentSize = 64
+    };
+
+    // Limits how much a single frame copies, the rest waits for the next frames.
+    static constexpr VkDeviceSize MaxUploadBytesPerFrame = 16 * 1024 * 1024;
+    static constexpr VkDeviceSize StagingAlignment = 16;
+
+    TArray<AVulkanStreamedTexture*> StreamedTextures;
+    TArray<AStreamingRequest> PendingRequests;
+
+    AVulkanCommandBufferPool* TransferCmdBufferPool;
+    // Transfer command buffers and the timeline value of their submission.
+    TArray<TPair<uint64_t, AVulkanCommandBuffer*>> SubmittedCmdBuffers;
+    AVulkanCommandBuffer* TransferCmdBuffer;
+
+    // Textures replaced by a swap and the frame they were replaced in.
+    TArray<TPair<uint64_t, AVulkanTexture*>> RetiredTextures;
+    uint64_t FrameNumber;
+
+    VkDeviceSize BudgetBytes;
+    AVulkanTextureStreamingStats CurrentStats;
+    AVulkanTextureStreamingStats LastStats;
+
+    AVulkanTextureUploader* Uploader;
+    AVulkanDevice* Device;
+};
@@ -0,0 +1,408 @@
+#include "VulkanTextureUpload.h"
+
+#include "VulkanCommandBuffer.h"
+#include "VulkanDevice.h"
+#include "VulkanResources.h"
+
+AVulkanFormatBlock GetFormatBlock(VkFormat Format)
+{
+    switch (Format)
+    {
+    case VK_FORMAT_R8_UNORM:
+        return { 1, 1, 1 };
+    case VK_FORMAT_R8G8_UNORM:
+    case VK_FORMAT_R16_UNORM:
+    case VK_FORMAT_R16_SFLOAT:
+        return { 2, 1, 1 };
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+    case VK_FORMAT_R16G16_UNORM:
+    case VK_FORMAT_R32_SFLOAT:
+        return { 4, 1, 1 };
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+        return { 8, 1, 1 };
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return { 16, 1, 1 };
+
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    case VK_FORMAT_BC4_UNORM_BLOCK:
+    case VK_FORMAT_BC4_SNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11_SNORM_BLOCK:
+        return { 8, 4, 4 };
+    case VK_FORMAT_BC2_UNORM_BLOCK:
+    case VK_FORMAT_BC2_SRGB_BLOCK:
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC5_SNORM_BLOCK:
+    case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+    case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+    case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+    case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+    case VK_FORMAT_EAC_R11G11_SNORM_BLOCK:
+        return { 16, 4, 4 };
+
+    // Every ASTC block is 16 bytes, only the texels it covers differ.
+    case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+        return { 16, 4, 4 };
+    case VK_FORMAT_ASTC_5x4_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_5x4_SRGB_BLOCK:
+        return { 16, 5, 4 };
+    case VK_FORMAT_ASTC_5x5_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_5x5_SRGB_BLOCK:
+        return { 16, 5, 5 };
+    case VK_FORMAT_ASTC_6x5_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_6x5_SRGB_BLOCK:
+        return { 16, 6, 5 };
+    case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+        return { 16, 6, 6 };
+    case VK_FORMAT_ASTC_8x5_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x5_SRGB_BLOCK:
+        return { 16, 8, 5 };
+    case VK_FORMAT_ASTC_8x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x6_SRGB_BLOCK:
+        return { 16, 8, 6 };
+    case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+        return { 16, 8, 8 };
+    case VK_FORMAT_ASTC_10x5_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_10x5_SRGB_BLOCK:
+        return { 16, 10, 5 };
+    case VK_FORMAT_ASTC_10x6_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_10x6_SRGB_BLOCK:
+        return { 16, 10, 6 };
+    case VK_FORMAT_ASTC_10x8_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_10x8_SRGB_BLOCK:
+        return { 16, 10, 8 };
+    case VK_FORMAT_ASTC_10x10_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_10x10_SRGB_BLOCK:
+        return { 16, 10, 10 };
+    case VK_FORMAT_ASTC_12x10_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_12x10_SRGB_BLOCK:
+        return { 16, 12, 10 };
+    case VK_FORMAT_ASTC_12x12_UNORM_BLOCK:
+    case VK_FORMAT_ASTC_12x12_SRGB_BLOCK:
+        return { 16, 12, 12 };
+
+    default:
+        return { 0, 1, 1 };
+    }
+}
+
+EVulkanFormatNumericType GetFormatNumericType(VkFormat Format)
+{
+    using EType = EVulkanFormatNumericType;
+
+    // The uncompressed core formats come in runs of the same components, each run in the same order of types.
+    static constexpr EType ByteTypes[] = { EType::UNorm, EType::SNorm, EType::UScaled, EType::SScaled, EType::UInt, EType::SInt, EType::SRGB };
+    static constexpr EType Packed10Types[] = { EType::UNorm, EType::SNorm, EType::UScaled, EType::SScaled, EType::UInt, EType::SInt };
+    static constexpr EType HalfTypes[] = { EType::UNorm, EType::SNorm, EType::UScaled, EType::SScaled, EType::UInt, EType::SInt, EType::SFloat };
+    static constexpr EType WordTypes[] = { EType::UInt, EType::SInt, EType::SFloat };
+
+    if (Format >= VK_FORMAT_R4G4_UNORM_PACK8 && Format <= VK_FORMAT_A1R5G5B5_UNORM_PACK16)
+    {
+        return EType::UNorm;
+    }
+    if (Format >= VK_FORMAT_R8_UNORM && Format <= VK_FORMAT_A8B8G8R8_SRGB_PACK32)
+    {
+        return ByteTypes[(Format - VK_FORMAT_R8_UNORM) % 7];
+    }
+    if (Format >= VK_FORMAT_A2R10G10B10_UNORM_PACK32 && Format <= VK_FORMAT_A2B10G10R10_SINT_PACK32)
+    {
+        return Packed10Types[(Format - VK_FORMAT_A2R10G10B10_UNORM_PACK32) % 6];
+    }
+    if (Format >= VK_FORMAT_R16_UNORM && Format <= VK_FORMAT_R16G16B16A16_SFLOAT)
+    {
+        return HalfTypes[(Format - VK_FORMAT_R16_UNORM) % 7];
+    }
+    if (Format >= VK_FORMAT_R32_UINT && Format <= VK_FORMAT_R64G64B64A64_SFLOAT)
+    {
+        return WordTypes[(Format - VK_FORMAT_R32_UINT) % 3];
+    }
+
+    switch (Format)
+    {
+    case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+    case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+        return EType::UFloat;
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+        return EType::UNorm;
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return EType::SFloat;
+    case VK_FORMAT_S8_UINT:
+        return EType::UInt;
+    default:
+        return EType::Other;
+    }
+}
+
+VkDeviceSize GetMipSize(VkFormat Format, uint32_t Width, uint32_t Height)
+{
+    const AVulkanFormatBlock Block = GetFormatBlock(Format);
+    const VkDeviceSize NumBlocksX = (Width + Block.BlockWidth - 1) / Block.BlockWidth;
+    const VkDeviceSize NumBlocksY = (Height + Block.BlockHeight - 1) / Block.BlockHeight;
+    return NumBlocksX * NumBlocksY * Block.BlockBytes;
+}
+
+uint32_t GetNumFullMips(uint32_t Width, uint32_t Height)
+{
+    uint32_t NumMips = 1;
+    for (uint32_t Size = std::max(Width, Height); Size > 1; Size >>= 1)
+    {
+        ++NumMips;
+    }
+    return NumMips;
+}
+
+AVulkanTextureUploader::AVulkanTextureUploader(AVulkanDevice* InDevice)
+    : FrameNumber(0), Device(InDevice)
+{
+}
+
+AVulkanTextureUploader::~AVulkanTextureUploader()
+{
+    for (APendingUpload& Upload : PendingUploads)
+    {
+        delete Upload.StagingBuffer;
+    }
+    PendingUploads.Clear();
+
+    for (TPair<uint64_t, AVulkanBuffer*>& Retired : RetiredBuffers)
+    {
+        delete Retired.second;
+    }
+    RetiredBuffers.Clear();
+}
+
+AVulkanTexture* AVulkanTextureUploader::CreateTexture(const AVulkanTextureUploadDesc& Desc, const void* Data, size_t Size)
+{
+    const uint32_t NumDataMips = std::min(Desc.NumDataMips, GetNumFullMips(Desc.Width, Desc.Height));
+    TArray<const void*> MipData;
+    VkDeviceSize DataSize = 0;
+    for (uint32_t MipIndex = 0; MipIndex < NumDataMips; ++MipIndex)
+    {
+        MipData.Add(static_cast<const uint8_t*>(Data) + DataSize);
+        DataSize += GetMipSize(Desc.Format, std::max(Desc.Width >> MipIndex, 1u), std::max(Desc.Height >> MipIndex, 1u));
+    }
+
+    if (Size < DataSize)
+    {
+        std::cerr << "[WARNING] Texture upload: " << Size << " bytes given, " << DataSize << " needed for " << NumDataMips << " mips.\n";
+        return nullptr;
+    }
+    return CreateTexture(Desc, MipData.GetData());
+}
+
+AVulkanTexture* AVulkanTextureUploader::CreateTexture(const AVulkanTextureUploadDesc& Desc, const void* const* MipData)
+{
+    check(Desc.Width != 0 && Desc.Height != 0 && Desc.NumDataMips != 0, "Invalid texture upload desc.");
+
+    if (GetFormatBlock(Desc.Format).BlockBytes == 0)
+    {
+        std::cerr << "[WARNING] Texture upload: unsupported format " << Desc.Format << ".\n";
+        return nullptr;
+    }
+
+    const VkFormatFeatureFlags Features = Device->GetFormatProperties()[Desc.Format].optimalTilingFeatures;
+    if (!(Features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+    {
+        std::cerr << "[WARNING] Texture upload: format " << Desc.Format << " can't be sampled on this device.\n";
+        return nullptr;
+    }
+
+    const uint32_t NumFullMips = GetNumFullMips(Desc.Width, Desc.Height);
+    uint32_t NumMips = Desc.NumMips == 0 ? NumFullMips : std::min(Desc.NumMips, NumFullMips);
+    const uint32_t NumDataMips = std::min(Desc.NumDataMips, NumMips);
+
+    const VkFormatFeatureFlags BlitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if (NumMips > NumDataMips && (Features & BlitFeatures) != BlitFeatures)
+    {
+        std::cerr << "[WARNING] Texture upload: format " << Desc.Format << " can't be blitted, keeping the " << NumDataMips << " uploaded mips.\n";
+        NumMips = NumDataMips;
+    }
+
+    // Mip offsets in the staging buffer, copies need aligned offsets.
+    TArray<VkBufferImageCopy> Regions;
+    VkDeviceSize StagingSize = 0;
+    for (uint32_t MipIndex = 0; MipIndex < NumDataMips; ++MipIndex)
+    {
+        const uint32_t MipWidth = std::max(Desc.Width >> MipIndex, 1u);
+        const uint32_t MipHeight = std::max(Desc.Height >> MipIndex, 1u);
+
+        VkBufferImageCopy Region = {};
+        Region.bufferOffset = StagingSize;
+        Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Region.imageSubresource.mipLevel = MipIndex;
+        Region.imageSubresource.layerCount = 1;
+        Region.imageExtent = { MipWidth, MipHeight, 1 };
+        Regions.Add(Region);
+
+        const VkDeviceSize MipSize = GetMipSize(Desc.Format, MipWidth, MipHeight);
+        StagingSize = (StagingSize + MipSize + StagingAlignment - 1) & ~(StagingAlignment - 1);
+    }
+
+    AVulkanBuffer* StagingBuffer = new AVulkanBuffer(Device, StagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    for (uint32_t MipIndex = 0; MipIndex < NumDataMips; ++MipIndex)
+    {
+        const VkExtent3D& Extent = Regions[MipIndex].imageExtent;
+        const VkDeviceSize MipSize = GetMipSize(Desc.Format, Extent.width, Extent.height);
+        AMemory::Memcpy(StagingBuffer->MappedData + Regions[MipIndex].bufferOffset, MipData[MipIndex], static_cast<size_t>(MipSize));
+    }
+
+    AVulkanTexture* Texture = new AVulkanTexture(Device, VK_IMAGE_VIEW_TYPE_2D, Desc.Format, Desc.Width, Desc.Height, 1, 1, NumMips, 1,
+        VK_IMAGE_ASPECT_COLOR_BIT);
+
+    APendingUpload Upload;
+    Upload.Texture = Texture;
+    Upload.StagingBuffer = StagingBuffer;
+    Upload.Regions = std::move(Regions);
+    // Minification filter of the mips, nearest when the format can't be filtered.
+    Upload.MipFilter = (Features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    PendingUploads.Add(std::move(Upload));
+    return Texture;
+}
+
+void AVulkanTextureUploader::Flush(AVulkanCommandBuffer* CmdBuffer)
+{
+    check(CmdBuffer->IsOutsideRenderPass(), "Texture uploads can't be recorded inside a render pass.");
+
+    std::lock_guard<std::mutex> Lock(Mutex);
+    for (APendingUpload& Upload : PendingUploads)
+    {
+        RecordUpload(CmdBuffer, Upload);
+        RetiredBuffers.Add(TPair<uint64_t, AVulkanBuffer*>(FrameNumber, Upload.StagingBuffer));
+    }
+    PendingUploads.Clear();
+}
+
+void AVulkanTextureUploader::RecordUpload(AVulkanCommandBuffer* CmdBuffer, const APendingUpload& Upload)
+{
+    AVulkanTexture* Texture = Upload.Texture;
+    const uint32_t NumDataMips = static_cast<uint32_t>(Upload.Regions.Num());
+
+    VkImageMemoryBarrier2 Barrier;
+    ZeroVulkanStruct(Barrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2);
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.image = Texture->Image;
+    Barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    Barrier.subresourceRange.layerCount = 1;
+
+    // Every mip is written, by a copy or a blit, so the undefined contents are dropped.
+    Barrier.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.subresourceRange.levelCount = Texture->NumMips;
+    CmdBuffer->PipelineBarrier(&Barrier, 1);
+
+    VulkanApi::vkCmdCopyBufferToImage(CmdBuffer->GetHandle(), Upload.StagingBuffer->Buffer, Texture->Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        NumDataMips, Upload.Regions.GetData());
+
+    // Each generated mip is blitted from the one above it, which is moved to the source layout once written.
+    Barrier.subresourceRange.levelCount = 1;
+    Barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    Barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    Barrier.dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+    Barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    for (uint32_t MipIndex = NumDataMips; MipIndex < Texture->NumMips; ++MipIndex)
+    {
+        // The mip above was written by the copy or by the previous blit.
+        Barrier.srcStageMask = MipIndex == NumDataMips ? VK_PIPELINE_STAGE_2_COPY_BIT : VK_PIPELINE_STAGE_2_BLIT_BIT;
+        Barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        Barrier.subresourceRange.baseMipLevel = MipIndex - 1;
+        CmdBuffer->PipelineBarrier(&Barrier, 1);
+
+        const int32_t SrcWidth = static_cast<int32_t>(std::max(Texture->Width >> (MipIndex - 1), 1u));
+        const int32_t SrcHeight = static_cast<int32_t>(std::max(Texture->Height >> (MipIndex - 1), 1u));
+
+        VkImageBlit Blit = {};
+        Blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        Blit.srcSubresource.mipLevel = MipIndex - 1;
+        Blit.srcSubresource.layerCount = 1;
+        Blit.srcOffsets[1] = { SrcWidth, SrcHeight, 1 };
+        Blit.dstSubresource = Blit.srcSubresource;
+        Blit.dstSubresource.mipLevel = MipIndex;
+        Blit.dstOffsets[1] = { std::max(SrcWidth >> 1, 1), std::max(SrcHeight >> 1, 1), 1 };
+        VulkanApi::vkCmdBlitImage(CmdBuffer->GetHandle(), Texture->Image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Texture->Image,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &Blit, Upload.MipFilter);
+    }
+
+    // Everything moves to the shader read layout. The blit sources are in the source layout, the uploaded mips
+    // above them and the last mip still in the destination layout.
+    const uint32_t NumBlitSources = Texture->NumMips - NumDataMips;
+    struct AMipRange
+    {
+        uint32_t BaseMip;
+        uint32_t NumMips;
+        VkImageLayout Layout;
+    };
+    const AMipRange Ranges[] = {
+        { 0, NumBlitSources != 0 ? NumDataMips - 1 : NumDataMips, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL },
+        { NumDataMips - 1, NumBlitSources, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL },
+        { Texture->NumMips - 1, NumBlitSources != 0 ? 1u : 0u, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL },
+    };
+
+    VkImageMemoryBarrier2 FinalBarriers[3];
+    uint32_t NumFinalBarriers = 0;
+    for (const AMipRange& Range : Ranges)
+    {
+        if (Range.NumMips == 0)
+        {
+            continue;
+        }
+
+        VkImageMemoryBarrier2& FinalBarrier = FinalBarriers[NumFinalBarriers++];
+        FinalBarrier = Barrier;
+        const bool bWritten = Range.Layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        FinalBarrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+        FinalBarrier.srcAccessMask = bWritten ? VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_NONE;
+        FinalBarrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        FinalBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+        FinalBarrier.oldLayout = Range.Layout;
+        FinalBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        FinalBarrier.subresourceRange.baseMipLevel = Range.BaseMip;
+        FinalBarrier.subresourceRange.levelCount = Range.NumMips;
+    }
+    CmdBuffer->PipelineBarrier(FinalBarriers, NumFinalBarriers);
+
+    Texture->Layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+void AVulkanTextureUploader::EndFrame()
+{
+    std::lock_guard<std::mutex> Lock(Mutex);
+    ++FrameNumber;
+    for (int32_t Index = RetiredBuffers.Num() - 1; Index >= 0; --Index)
+    {
+        if (RetiredBuffers[Index].first + NumFramesInFlight <= FrameNumber)
+        {
+            delete RetiredBuffers[Index].second;
+            RetiredBuffers.RemoveAt(Index);
+        }
+    }
+}
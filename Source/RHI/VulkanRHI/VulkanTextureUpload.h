@@ -0,0 +1,108 @@
+#pragma once
+
+#include "VulkanApi.h"
+
+#include <mutex>
+
+class AVulkanCommandBuffer;
+class AVulkanDevice;
+struct AVulkanBuffer;
+struct AVulkanTexture;
+
+// Size of the smallest addressable block of a format, a single texel for uncompressed formats.
+struct AVulkanFormatBlock
+{
+    // Zero for formats textures can't be uploaded in.
+    uint32_t BlockBytes;
+    uint32_t BlockWidth;
+    uint32_t BlockHeight;
+};
+
+AVulkanFormatBlock GetFormatBlock(VkFormat Format);
+
+// How the texels of a format are read, as in the suffix of its name.
+enum class EVulkanFormatNumericType : uint8_t
+{
+    // Compressed, multi-planar and extension formats.
+    Other,
+    UNorm,
+    SNorm,
+    UScaled,
+    SScaled,
+    UInt,
+    SInt,
+    UFloat,
+    SFloat,
+    SRGB,
+};
+
+// Depth stencil formats report the type of their depth.
+EVulkanFormatNumericType GetFormatNumericType(VkFormat Format);
+// Bytes of a Width x Height mip in Format, rows and blocks tightly packed.
+VkDeviceSize GetMipSize(VkFormat Format, uint32_t Width, uint32_t Height);
+// Mips of a full chain down to 1x1.
+uint32_t GetNumFullMips(uint32_t Width, uint32_t Height);
+
+struct AVulkanTextureUploadDesc
+{
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    // Zero for a full chain.
+    uint32_t NumMips = 0;
+    // Mips present in the data, largest first and tightly packed. The rest are generated on the GPU.
+    uint32_t NumDataMips = 1;
+};
+
+// Creates sampled 2D textures from pixel data.
+//
+// The data is copied to a staging buffer right away, the copies into the image and the mip generation are
+// recorded at the start of the next frame by Flush(), each mip blitted from the one above it. Textures are
+// in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL for every command recorded after that flush and must not be
+// destroyed before it. Staging buffers are freed once the frames in flight can no longer read them.
+class AVulkanTextureUploader
+{
+public:
+    AVulkanTextureUploader(AVulkanDevice* Device);
+    ~AVulkanTextureUploader();
+
+    // Thread safe, returns nullptr when the format can't be uploaded or Size is too small for the data mips.
+    AVulkanTexture* CreateTexture(const AVulkanTextureUploadDesc& Desc, const void* Data, size_t Size);
+    // MipData points to each of the Desc.NumDataMips mips, for data that is not packed in one allocation.
+    AVulkanTexture* CreateTexture(const AVulkanTextureUploadDesc& Desc, const void* const* MipData);
+
+    // Records the pending uploads, outside of any render pass.
+    void Flush(AVulkanCommandBuffer* CmdBuffer);
+    void EndFrame();
+
+    inline AVulkanDevice* GetDevice() const { return Device; }
+
+private:
+    struct APendingUpload
+    {
+        AVulkanTexture* Texture;
+        AVulkanBuffer* StagingBuffer;
+        TArray<VkBufferImageCopy> Regions;
+        VkFilter MipFilter;
+    };
+
+    void RecordUpload(AVulkanCommandBuffer* CmdBuffer, const APendingUpload& Upload);
+
+private:
+    enum
+    {
+        // Frames the GPU may still be copying from a staging buffer in.
+        NumFramesInFlight = 3
+    };
+
+    // Copies within a buffer have to start at a multiple of the texel block size, this covers every format.
+    static constexpr VkDeviceSize StagingAlignment = 16;
+
+    std::mutex Mutex;
+    TArray<APendingUpload> PendingUploads;
+    // Staging buffers of flushed uploads and the frame they were flushed in.
+    TArray<TPair<uint64_t, AVulkanBuffer*>> RetiredBuffers;
+    uint64_t FrameNumber;
+
+    AVulkanDevice* Device;
+};
@@ -232,7 +232,8 @@ void AVulkanViewport::Present(AVulkanCommandBuffer* CmdBuffer, AVulkanQueue* Que
 {
     check(CmdBuffer->HasEnded());
 
-    VkPipelineStageFlags SubmitWaitStageFlags[] = { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT };
+    // The back buffer is first touched by the color attachment writes, work before them needn't wait for the acquire.
+    VkPipelineStageFlags SubmitWaitStageFlags[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     VkSemaphore SubmitWaitSemaphores[] = { ImageAcquiredSemaphores[AcquiredIndex]->GetHandle() };
     VkSemaphore SubmitSignalSemaphores[] = { RenderingDoneSemaphores[AcquiredIndex]->GetHandle() };
     Queue->Submit(CmdBuffer, 1, SubmitWaitSemaphores, SubmitWaitStageFlags, 1, SubmitSignalSemaphores, Fence);
@@ -0,0 +1,813 @@
+#include "RenderGraph.h"
+
+#include "RHI/VulkanRHI/VulkanCommandBuffer.h"
+#include "RHI/VulkanRHI/VulkanDevice.h"
+#include "RHI/VulkanRHI/VulkanMemory.h"
+#include "RHI/VulkanRHI/VulkanResources.h"
+#include "RHI/VulkanRHI/VulkanRHI.h"
+
+struct ARenderGraphAccessInfo
+{
+    VkImageLayout Layout;
+    VkPipelineStageFlags2 Stages;
+    VkAccessFlags2 Access;
+    VkImageUsageFlags Usage;
+    bool bWrite;
+};
+
+static ARenderGraphAccessInfo GetAccessInfo(ERenderGraphAccess Access)
+{
+    switch (Access)
+    {
+    case ERenderGraphAccess::ColorAttachment:
+        return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true };
+    case ERenderGraphAccess::DepthStencilAttachment:
+        return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true };
+    case ERenderGraphAccess::DepthStencilRead:
+        return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+    case ERenderGraphAccess::DepthStencilResolve:
+        return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true };
+    case ERenderGraphAccess::ShaderRead:
+        return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_USAGE_SAMPLED_BIT, false };
+    case ERenderGraphAccess::StorageReadWrite:
+        return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_USAGE_STORAGE_BIT, true };
+    case ERenderGraphAccess::TransferSrc:
+        return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false };
+    case ERenderGraphAccess::TransferDst:
+        return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT, true };
+    default:
+        check(false, "Unknown render graph access.");
+        return { VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT, 0, true };
+    }
+}
+
+ARenderGraphPass::ARenderGraphPass(const AnsiChar* InName, ARenderGraphPassFunction&& InFunction)
+    : Name(InName), Function(std::move(InFunction)), NumColorTargets(0), DepthStencilTarget(nullptr), DepthLoadAction(VK_ATTACHMENT_LOAD_OP_LOAD),
+      NumResolveTargets(0), DepthStencilResolveTarget(nullptr), bNeverCull(false), bCulled(false), bMergedWithPrevious(false),
+      DepthStoreAction(VK_ATTACHMENT_STORE_OP_STORE)
+{
+    AMemory::Memzero(ColorTargets);
+    AMemory::Memzero(ResolveTargets);
+    AMemory::Memzero(ClearValues);
+    for (uint32_t Index = 0; Index < MaxSimultaneousRenderTargets; ++Index)
+    {
+        ColorLoadActions[Index] = VK_ATTACHMENT_LOAD_OP_LOAD;
+        ColorStoreActions[Index] = VK_ATTACHMENT_STORE_OP_STORE;
+    }
+}
+
+void ARenderGraphPass::AddUse(const AUse& Use)
+{
+    for (const AUse& Other : Uses)
+    {
+        check(Other.Texture != Use.Texture, "A pass uses a texture once, in a single layout.");
+    }
+    Uses.Add(Use);
+}
+
+void ARenderGraphPass::SetColorTarget(uint32_t Index, ARenderGraphTexture* Texture, VkAttachmentLoadOp LoadAction, const VkClearColorValue& ClearColor)
+{
+    check(Index < MaxSimultaneousRenderTargets && ColorTargets[Index] == nullptr, "Color target is already set.");
+    ColorTargets[Index] = Texture;
+    ColorLoadActions[Index] = LoadAction;
+    ClearValues[Index].color = ClearColor;
+    NumColorTargets = std::max(NumColorTargets, Index + 1);
+
+    AddUse({ Texture, ERenderGraphAccess::ColorAttachment, true, LoadAction != VK_ATTACHMENT_LOAD_OP_LOAD, true });
+}
+
+void ARenderGraphPass::SetDepthStencilTarget(ARenderGraphTexture* Texture, VkAttachmentLoadOp LoadAction, float ClearDepth, uint32_t ClearStencil)
+{
+    check(DepthStencilTarget == nullptr, "Depth stencil target is already set.");
+    DepthStencilTarget = Texture;
+    DepthLoadAction = LoadAction;
+    // Written after the colors once their count is known, see ARenderGraph::Record().
+    ClearValues[MaxSimultaneousRenderTargets].depthStencil = { ClearDepth, ClearStencil };
+
+    AddUse({ Texture, ERenderGraphAccess::DepthStencilAttachment, true, LoadAction != VK_ATTACHMENT_LOAD_OP_LOAD, true });
+}
+
+void ARenderGraphPass::SetResolveTarget(uint32_t Index, ARenderGraphTexture* Texture)
+{
+    check(Index < MaxSimultaneousRenderTargets && ResolveTargets[Index] == nullptr, "Resolve target is already set.");
+    check(Texture->GetDesc().NumSamples == 1, "Resolve targets are single sampled.");
+    ResolveTargets[Index] = Texture;
+    ++NumResolveTargets;
+
+    // Every texel is written by the resolve.
+    AddUse({ Texture, ERenderGraphAccess::ColorAttachment, true, true, true });
+}
+
+void ARenderGraphPass::SetDepthStencilResolveTarget(ARenderGraphTexture* Texture)
+{
+    check(DepthStencilResolveTarget == nullptr, "Depth stencil resolve target is already set.");
+    check(Texture->GetDesc().NumSamples == 1, "Resolve targets are single sampled.");
+    DepthStencilResolveTarget = Texture;
+
+    AddUse({ Texture, ERenderGraphAccess::DepthStencilResolve, true, true, true });
+}
+
+void ARenderGraphPass::Read(ARenderGraphTexture* Texture, ERenderGraphAccess Access)
+{
+    check(!GetAccessInfo(Access).bWrite, "Written textures are declared with Write().");
+    AddUse({ Texture, Access, false, false, false });
+}
+
+void ARenderGraphPass::Write(ARenderGraphTexture* Texture, ERenderGraphAccess Access, bool bOverwrite)
+{
+    check(GetAccessInfo(Access).bWrite, "Read only accesses are declared with Read().");
+    check(Access != ERenderGraphAccess::ColorAttachment && Access != ERenderGraphAccess::DepthStencilAttachment &&
+              Access != ERenderGraphAccess::DepthStencilResolve,
+        "Attachments are set with Set*Target().");
+    AddUse({ Texture, Access, true, bOverwrite, false });
+}
+
+ARenderGraph::ARenderGraph(AVulkanRHI* InRHI) : FrameNumber(0), RHI(InRHI)
+{
+}
+
+ARenderGraph::~ARenderGraph()
+{
+    Reset();
+    // The owner waits for the GPU before destroying the graph.
+    for (uint32_t Slot = 0; Slot < NumFramesInFlight; ++Slot)
+    {
+        for (AVulkanTexture* Texture : CreatedTextures[Slot])
+        {
+            delete Texture;
+        }
+        for (AVulkanMemoryHeap* Heap : Heaps[Slot])
+        {
+            delete Heap;
+        }
+        CreatedTextures[Slot].Clear();
+        Heaps[Slot].Clear();
+    }
+}
+
+ARenderGraphTexture* ARenderGraph::CreateTexture(const AnsiChar* Name, const ARenderGraphTextureDesc& Desc)
+{
+    check(Desc.Format != VK_FORMAT_UNDEFINED && Desc.Width != 0 && Desc.Height != 0, "Invalid render graph texture.");
+
+    ARenderGraphTexture* Texture = new ARenderGraphTexture();
+    AMemory::Memzero(*Texture);
+    Texture->Name = Name;
+    Texture->Desc = Desc;
+    Texture->Texture = nullptr;
+    Texture->Usage = 0;
+    Texture->bExternal = false;
+    Texture->FinalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    AMemory::Memzero(Texture->State);
+    Texture->State.Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    Textures.Add(Texture);
+    return Texture;
+}
+
+ARenderGraphTexture* ARenderGraph::ImportTexture(const AnsiChar* Name, AVulkanTexture* InTexture, VkImageLayout FinalLayout)
+{
+    ARenderGraphTexture* Texture = new ARenderGraphTexture();
+    AMemory::Memzero(*Texture);
+    Texture->Name = Name;
+    Texture->Desc.Format = InTexture->PixelFormat;
+    Texture->Desc.Width = InTexture->Width;
+    Texture->Desc.Height = InTexture->Height;
+    Texture->Desc.NumMips = InTexture->NumMips;
+    Texture->Desc.NumSamples = InTexture->NumSamples;
+    Texture->Desc.AspectMask = InTexture->AspectMask;
+    Texture->Texture = InTexture;
+    Texture->Usage = 0;
+    Texture->bExternal = true;
+    Texture->FinalLayout = FinalLayout;
+
+    // Whatever used the texture before the graph is treated as a write in its current layout. That also chains
+    // the first barrier of a back buffer to the acquire semaphore, see AVulkanCommandBuffer::GetTextureSync().
+    ARenderGraphTexture::ASyncState& State = Texture->State;
+    AMemory::Memzero(State);
+    State.Layout = InTexture->Layout;
+    AVulkanCommandBuffer::GetTextureSync(InTexture, State.WriteStages, State.WriteAccess);
+    State.WriteAccess &= VulkanWriteAccessMask;
+    if (State.WriteAccess == 0 && State.Layout != VK_IMAGE_LAYOUT_UNDEFINED)
+    {
+        // Read only contents, reading them again needs no barrier.
+        State.SyncedStages = ~VkPipelineStageFlags2(0);
+        State.VisibleAccess = ~VkAccessFlags2(0);
+    }
+
+    Textures.Add(Texture);
+    return Texture;
+}
+
+const AVulkanRenderTargetLayout& ARenderGraph::GetRenderTargetLayout() const
+{
+    check(RenderTargetLayout.has_value(), "Only raster passes record into a render pass.");
+    return *RenderTargetLayout;
+}
+
+ARenderGraphPass* ARenderGraph::AddPass(const AnsiChar* Name, ARenderGraphPassFunction&& Function)
+{
+    ARenderGraphPass* Pass = new ARenderGraphPass(Name, std::move(Function));
+    Passes.Add(Pass);
+    return Pass;
+}
+
+void ARenderGraph::Execute()
+{
+    Stats = ARenderGraphStats();
+    Stats.NumPasses = Passes.Num();
+
+    CullPasses();
+    ComputeLifetimes();
+    BuildBarriers();
+    ComputeStoreActions();
+    CreateTextures();
+    Record();
+    Reset();
+}
+
+void ARenderGraph::CullPasses()
+{
+    // Walks the passes backwards keeping a pass only when a later live pass or the outside of the graph needs
+    // what it writes. A pass that discards a texture makes the writes before it dead.
+    for (ARenderGraphTexture* Texture : Textures)
+    {
+        Texture->bNeeded = Texture->bExternal;
+    }
+
+    for (int32_t PassIndex = Passes.Num() - 1; PassIndex >= 0; --PassIndex)
+    {
+        ARenderGraphPass* Pass = Passes[PassIndex];
+
+        bool bLive = Pass->bNeverCull;
+        for (const ARenderGraphPass::AUse& Use : Pass->Uses)
+        {
+            bLive = bLive || (Use.bWrite && Use.Texture->bNeeded);
+        }
+        Pass->bCulled = !bLive;
+        if (Pass->bCulled)
+        {
+            ++Stats.NumCulledPasses;
+            continue;
+        }
+
+        for (const ARenderGraphPass::AUse& Use : Pass->Uses)
+        {
+            if (Use.bWrite && Use.bDiscard)
+            {
+                Use.Texture->bNeeded = false;
+            }
+        }
+        for (const ARenderGraphPass::AUse& Use : Pass->Uses)
+        {
+            // Reads, and writes that keep part of the contents, need the earlier writes.
+            if (!Use.bWrite || !Use.bDiscard)
+            {
+                Use.Texture->bNeeded = true;
+            }
+        }
+    }
+
+    for (ARenderGraphPass* Pass : Passes)
+    {
+        if (!Pass->bCulled)
+        {
+            LivePasses.Add(Pass);
+        }
+    }
+}
+
+void ARenderGraph::ComputeLifetimes()
+{
+    for (ARenderGraphTexture* Texture : Textures)
+    {
+        Texture->FirstPass = -1;
+        Texture->LastPass = -1;
+        Texture->bAttachmentOnly = true;
+    }
+
+    for (int32_t PassIndex = 0; PassIndex < LivePasses.Num(); ++PassIndex)
+    {
+        for (const ARenderGraphPass::AUse& Use : LivePasses[PassIndex]->Uses)
+        {
+            ARenderGraphTexture* Texture = Use.Texture;
+            if (Texture->FirstPass < 0)
+            {
+                Texture->FirstPass = PassIndex;
+                Texture->bFirstUseDiscards = Use.bDiscard;
+            }
+            Texture->LastPass = PassIndex;
+            Texture->bAttachmentOnly = Texture->bAttachmentOnly && Use.bAttachment;
+            Texture->Usage |= GetAccessInfo(Use.Access).Usage;
+        }
+    }
+}
+
+void ARenderGraph::Transition(ARenderGraphTexture* Texture, VkImageLayout Layout, VkPipelineStageFlags2 Stages, VkAccessFlags2 Access, bool bWrite,
+    bool bDiscard, TArray<VkImageMemoryBarrier2>& OutBarriers, TArray<ARenderGraphTexture*>& OutTextures)
+{
+    ARenderGraphTexture::ASyncState& State = Texture->State;
+
+    const bool bLayoutChange = State.Layout != Layout;
+    if (!bLayoutChange)
+    {
+        // Writes wait for every earlier use, reads only for the last write.
+        const bool bNeedsBarrier = bWrite ? (State.WriteStages | State.ReadStages) != 0
+                                          : (Stages & ~State.SyncedStages) != 0 || (Access & ~State.VisibleAccess) != 0;
+        if (!bNeedsBarrier)
+        {
+            State.ReadStages |= bWrite ? 0 : Stages;
+            return;
+        }
+    }
+
+    VkImageMemoryBarrier2 Barrier;
+    ZeroVulkanStruct(Barrier, VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2);
+    Barrier.srcStageMask = (bLayoutChange || bWrite) ? (State.WriteStages | State.ReadStages) : State.WriteStages;
+    Barrier.srcAccessMask = State.WriteAccess;
+    Barrier.dstStageMask = Stages;
+    Barrier.dstAccessMask = Access;
+    // Discarded contents need not be preserved by the transition.
+    Barrier.oldLayout = bDiscard ? VK_IMAGE_LAYOUT_UNDEFINED : State.Layout;
+    Barrier.newLayout = Layout;
+    Barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    Barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    // The image is filled in by Record(), created textures don't exist yet.
+    Barrier.subresourceRange.aspectMask = Texture->Desc.AspectMask;
+    Barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+    Barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+    OutBarriers.Add(Barrier);
+    OutTextures.Add(Texture);
+
+    if (bWrite || bLayoutChange)
+    {
+        // A layout transition writes the image as well, later uses order themselves after it.
+        State.WriteStages = Stages;
+        State.WriteAccess = bWrite ? (Access & VulkanWriteAccessMask) : 0;
+        State.ReadStages = bWrite ? 0 : Stages;
+        State.SyncedStages = Stages;
+        State.VisibleAccess = Access;
+    }
+    else
+    {
+        State.ReadStages |= Stages;
+        State.SyncedStages |= Stages;
+        State.VisibleAccess |= Access;
+    }
+    State.Layout = Layout;
+}
+
+bool ARenderGraph::CanMerge(const ARenderGraphPass* Previous, const ARenderGraphPass* Pass) const
+{
+    if (!Previous->IsRaster() || !Pass->IsRaster())
+    {
+        return false;
+    }
+
+    if (Previous->NumColorTargets != Pass->NumColorTargets || Previous->DepthStencilTarget != Pass->DepthStencilTarget)
+    {
+        return false;
+    }
+    // Resolves run when the render pass ends, draws recorded after them would end up in the resolved targets too,
+    // and the render pass is begun with the resolve targets of its first pass.
+    if (Previous->HasResolveTargets() || Pass->HasResolveTargets())
+    {
+        return false;
+    }
+    if (Pass->DepthStencilTarget && Pass->DepthLoadAction != VK_ATTACHMENT_LOAD_OP_LOAD)
+    {
+        return false;
+    }
+    for (uint32_t Index = 0; Index < Pass->NumColorTargets; ++Index)
+    {
+        // Clears can't happen in the middle of a render pass.
+        if (Previous->ColorTargets[Index] != Pass->ColorTargets[Index] || Pass->ColorLoadActions[Index] != VK_ATTACHMENT_LOAD_OP_LOAD)
+        {
+            return false;
+        }
+    }
+
+    // Barriers can't be recorded inside a render pass. Draws to the same attachments are ordered by the render pass
+    // itself, any other barrier needs a pass of its own.
+    for (int32_t Index = 0; Index < Pass->Barriers.Num(); ++Index)
+    {
+        const VkImageMemoryBarrier2& Barrier = Pass->Barriers[Index];
+        bool bAttachment = false;
+        for (const ARenderGraphPass::AUse& Use : Pass->Uses)
+        {
+            bAttachment = bAttachment || (Use.bAttachment && Use.Texture == Pass->BarrierTextures[Index]);
+        }
+        if (!bAttachment || Barrier.oldLayout != Barrier.newLayout)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ARenderGraph::BuildBarriers()
+{
+    ARenderGraphPass* Previous = nullptr;
+    for (ARenderGraphPass* Pass : LivePasses)
+    {
+        for (const ARenderGraphPass::AUse& Use : Pass->Uses)
+        {
+            const ARenderGraphAccessInfo Info = GetAccessInfo(Use.Access);
+            Transition(Use.Texture, Info.Layout, Info.Stages, Info.Access, Use.bWrite, Use.bDiscard, Pass->Barriers, Pass->BarrierTextures);
+        }
+
+        Pass->bMergedWithPrevious = Previous && CanMerge(Previous, Pass);
+        if (Pass->bMergedWithPrevious)
+        {
+            // The texture states already match what the render pass leaves behind.
+            Pass->Barriers.Clear();
+            Pass->BarrierTextures.Clear();
+            ++Stats.NumMergedPasses;
+        }
+        Previous = Pass;
+
+        for (int32_t Index = 0; Index < Pass->BarrierTextures.Num(); ++Index)
+        {
+            ARenderGraphTexture* Texture = Pass->BarrierTextures[Index];
+            if (!Texture->FirstBarrierPass)
+            {
+                Texture->FirstBarrierPass = Pass;
+                Texture->FirstBarrierIndex = Index;
+            }
+        }
+    }
+
+    for (ARenderGraphTexture* Texture : Textures)
+    {
+        if (!Texture->bExternal || Texture->State.Layout == Texture->FinalLayout || Texture->FinalLayout == VK_IMAGE_LAYOUT_UNDEFINED)
+        {
+            continue;
+        }
+
+        VkPipelineStageFlags2 Stages;
+        VkAccessFlags2 Access;
+        AVulkanCommandBuffer::GetImageLayoutSync(Texture->FinalLayout, Stages, Access);
+        if (Texture->FinalLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
+        {
+            // Presentation is ordered by the semaphore signaled at the end of the submit.
+            Stages = VK_PIPELINE_STAGE_2_NONE;
+            Access = VK_ACCESS_2_NONE;
+        }
+        Transition(Texture, Texture->FinalLayout, Stages, Access, false, false, FinalBarriers, FinalBarrierTextures);
+    }
+}
+
+void ARenderGraph::ComputeStoreActions()
+{
+    // Attachments nobody reads after the render pass are not written back to memory.
+    for (int32_t PassIndex = 0; PassIndex < LivePasses.Num(); ++PassIndex)
+    {
+        ARenderGraphPass* Pass = LivePasses[PassIndex];
+        if (!Pass->IsRaster() || Pass->bMergedWithPrevious)
+        {
+            continue;
+        }
+
+        int32_t LastPassIndex = PassIndex;
+        while (LastPassIndex + 1 < LivePasses.Num() && LivePasses[LastPassIndex + 1]->bMergedWithPrevious)
+        {
+            ++LastPassIndex;
+        }
+
+        auto GetStoreAction = [LastPassIndex](const ARenderGraphTexture* Texture) {
+            return (Texture->bExternal || Texture->LastPass > LastPassIndex) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        };
+        for (uint32_t Index = 0; Index < Pass->NumColorTargets; ++Index)
+        {
+            Pass->ColorStoreActions[Index] = GetStoreAction(Pass->ColorTargets[Index]);
+        }
+        if (Pass->DepthStencilTarget)
+        {
+            Pass->DepthStoreAction = GetStoreAction(Pass->DepthStencilTarget);
+        }
+    }
+}
+
+void ARenderGraph::CreateTextures()
+{
+    const uint32_t Slot = FrameNumber % NumFramesInFlight;
+
+    // Textures of this slot were created NumFramesInFlight frames ago, the GPU is done with them and their heaps.
+    for (AVulkanTexture* Texture : CreatedTextures[Slot])
+    {
+        delete Texture;
+    }
+    CreatedTextures[Slot].Clear();
+
+    // Render pass of each live pass, attachments that stay within one of them never leave tile memory.
+    TArray<int32_t> RenderPassIndices(LivePasses.Num());
+    for (int32_t PassIndex = 0; PassIndex < LivePasses.Num(); ++PassIndex)
+    {
+        RenderPassIndices[PassIndex] = LivePasses[PassIndex]->bMergedWithPrevious ? RenderPassIndices[PassIndex - 1] : PassIndex;
+    }
+
+    // A texture can only share memory with one whose lifetime is disjoint from its own and that picked the same
+    // memory type, so the heap's type is in the memoryTypeBits of both. Without Candidates only lifetimes are
+    // checked, before any memory type is known.
+    auto CanAlias = [this](const ARenderGraphTexture* Texture, const TArray<ARenderGraphTexture*>* Candidates) {
+        for (const ARenderGraphTexture* Other : Candidates ? *Candidates : Textures)
+        {
+            const bool bDisjoint = Other->LastPass < Texture->FirstPass || Texture->LastPass < Other->FirstPass;
+            if (Other == Texture || Other->bExternal || Other->LastPass < 0 || !bDisjoint)
+            {
+                continue;
+            }
+            if (!Candidates || Other->MemoryTypeIndex == Texture->MemoryTypeIndex)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // The first barrier transitions from undefined, so whatever a pooled texture held before doesn't matter.
+    auto AcquirePooled = [this](ARenderGraphTexture* Texture) {
+        const ARenderGraphTextureDesc& Desc = Texture->Desc;
+        AVulkanRenderTargetDesc PoolDesc;
+        PoolDesc.Format = Desc.Format;
+        PoolDesc.Width = Desc.Width;
+        PoolDesc.Height = Desc.Height;
+        PoolDesc.NumMips = Desc.NumMips;
+        PoolDesc.NumSamples = Desc.NumSamples;
+        PoolDesc.AspectMask = Desc.AspectMask;
+        PoolDesc.Usage = Texture->Usage;
+        Texture->Texture = RHI->GetRenderTargetPool()->Acquire(PoolDesc);
+        Texture->bPooled = true;
+
+        const VkDeviceSize Size = Texture->Texture->GetMemoryRequirements().size;
+        ++Stats.NumCreatedTextures;
+        ++Stats.NumPooledTextures;
+        Stats.TransientBytesRequested += Size;
+        Stats.TransientBytesAliased += Size;
+    };
+
+    // Images of the textures that may share memory, bound once their heaps are placed.
+    AVulkanDevice* Device = RHI->GetDevice();
+    TArray<ARenderGraphTexture*> HeapCandidates;
+    for (ARenderGraphTexture* Texture : Textures)
+    {
+        if (Texture->bExternal || Texture->LastPass < 0)
+        {
+            continue;
+        }
+
+        const bool bTransient = Texture->bAttachmentOnly && Texture->bFirstUseDiscards &&
+                                RenderPassIndices[Texture->FirstPass] == RenderPassIndices[Texture->LastPass];
+        Texture->Usage |= bTransient ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : 0;
+
+        // Transient attachments stay in the heaps for the lazily allocated memory.
+        if (!bTransient && !CanAlias(Texture, nullptr))
+        {
+            AcquirePooled(Texture);
+            continue;
+        }
+
+        const ARenderGraphTextureDesc& Desc = Texture->Desc;
+        Texture->Texture = new AVulkanTexture(Device, VK_IMAGE_VIEW_TYPE_2D, Desc.Format, Desc.Width, Desc.Height, 1, 1, Desc.NumMips, Desc.NumSamples,
+            Desc.AspectMask, Texture->Usage, false);
+
+        const VkMemoryRequirements MemoryRequirements = Texture->Texture->GetMemoryRequirements();
+        Texture->MemorySize = MemoryRequirements.size;
+        Texture->MemoryAlignment = MemoryRequirements.alignment;
+        Texture->bLazy = bTransient && Device->TryFindMemoryTypeIndex(MemoryRequirements.memoryTypeBits,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, Texture->MemoryTypeIndex);
+        if (!Texture->bLazy)
+        {
+            Texture->MemoryTypeIndex = Device->FindMemoryTypeIndex(MemoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+        HeapCandidates.Add(Texture);
+    }
+
+    // Heaps are per memory type, a texture whose type no disjoint texture shares ends up alone in its heap.
+    TArray<ARenderGraphTexture*> TexturesByType[VK_MAX_MEMORY_TYPES];
+    for (ARenderGraphTexture* Texture : HeapCandidates)
+    {
+        if ((Texture->Usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) == 0 && !CanAlias(Texture, &HeapCandidates))
+        {
+            delete Texture->Texture;
+            AcquirePooled(Texture);
+            continue;
+        }
+
+        CreatedTextures[Slot].Add(Texture->Texture);
+        TexturesByType[Texture->MemoryTypeIndex].Add(Texture);
+
+        ++Stats.NumCreatedTextures;
+        Stats.NumLazyTextures += Texture->bLazy ? 1 : 0;
+        Stats.TransientBytesRequested += Texture->MemorySize;
+    }
+
+    for (uint32_t MemoryTypeIndex = 0; MemoryTypeIndex < VK_MAX_MEMORY_TYPES; ++MemoryTypeIndex)
+    {
+        TArray<ARenderGraphTexture*>& HeapTextures = TexturesByType[MemoryTypeIndex];
+        if (HeapTextures.IsEmpty())
+        {
+            continue;
+        }
+
+        const VkDeviceSize HeapSize = PlaceTextures(HeapTextures);
+        AVulkanMemoryHeap* Heap = GetOrCreateHeap(MemoryTypeIndex, HeapSize);
+        for (ARenderGraphTexture* Texture : HeapTextures)
+        {
+            Texture->Texture->BindMemory(Heap->GetHandle(), Texture->MemoryOffset);
+        }
+
+        Stats.TransientBytesAliased += HeapSize;
+        Stats.TransientBytesLazy += HeapTextures[0]->bLazy ? HeapSize : 0;
+
+        // A texture placed over memory an earlier one used waits for that one's last use before its first.
+        for (ARenderGraphTexture* Texture : HeapTextures)
+        {
+            check(Texture->FirstBarrierPass, "The first use of a created texture always transitions it from undefined.");
+            VkImageMemoryBarrier2& FirstBarrier = Texture->FirstBarrierPass->Barriers[Texture->FirstBarrierIndex];
+            for (const ARenderGraphTexture* Other : HeapTextures)
+            {
+                const bool bOverlaps = Other->MemoryOffset < Texture->MemoryOffset + Texture->MemorySize &&
+                                       Texture->MemoryOffset < Other->MemoryOffset + Other->MemorySize;
+                if (Other != Texture && bOverlaps && Other->LastPass < Texture->FirstPass)
+                {
+                    FirstBarrier.srcStageMask |= Other->State.WriteStages | Other->State.ReadStages;
+                    FirstBarrier.srcAccessMask |= Other->State.WriteAccess;
+                }
+            }
+        }
+    }
+}
+
+VkDeviceSize ARenderGraph::PlaceTextures(TArray<ARenderGraphTexture*>& HeapTextures)
+{
+    // Largest first, each at the lowest offset that doesn't overlap a texture placed before that is alive at the
+    // same time. The candidates are the start of the heap and the ends of those textures.
+    std::stable_sort(HeapTextures.begin(), HeapTextures.end(),
+        [](const ARenderGraphTexture* A, const ARenderGraphTexture* B) { return A->MemorySize > B->MemorySize; });
+
+    VkDeviceSize HeapSize = 0;
+    for (int32_t Index = 0; Index < HeapTextures.Num(); ++Index)
+    {
+        ARenderGraphTexture* Texture = HeapTextures[Index];
+        auto IsAliveWith = [Texture](const ARenderGraphTexture* Other) {
+            return Other->FirstPass <= Texture->LastPass && Texture->FirstPass <= Other->LastPass;
+        };
+        auto Fits = [&](VkDeviceSize Offset) {
+            for (int32_t OtherIndex = 0; OtherIndex < Index; ++OtherIndex)
+            {
+                const ARenderGraphTexture* Other = HeapTextures[OtherIndex];
+                if (IsAliveWith(Other) && Other->MemoryOffset < Offset + Texture->MemorySize && Offset < Other->MemoryOffset + Other->MemorySize)
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+        auto Align = [Texture](VkDeviceSize Offset) { return (Offset + Texture->MemoryAlignment - 1) / Texture->MemoryAlignment * Texture->MemoryAlignment; };
+
+        VkDeviceSize BestOffset = Fits(0) ? 0 : ~VkDeviceSize(0);
+        for (int32_t OtherIndex = 0; OtherIndex < Index; ++OtherIndex)
+        {
+            const ARenderGraphTexture* Other = HeapTextures[OtherIndex];
+            const VkDeviceSize Offset = Align(Other->MemoryOffset + Other->MemorySize);
+            if (IsAliveWith(Other) && Offset < BestOffset && Fits(Offset))
+            {
+                BestOffset = Offset;
+            }
+        }
+        check(BestOffset != ~VkDeviceSize(0), "The end of the last placed texture always fits.");
+
+        Texture->MemoryOffset = BestOffset;
+        HeapSize = std::max(HeapSize, BestOffset + Texture->MemorySize);
+    }
+    return HeapSize;
+}
+
+AVulkanMemoryHeap* ARenderGraph::GetOrCreateHeap(uint32_t MemoryTypeIndex, VkDeviceSize Size)
+{
+    TArray<AVulkanMemoryHeap*>& FrameHeaps = Heaps[FrameNumber % NumFramesInFlight];
+    for (int32_t Index = 0; Index < FrameHeaps.Num(); ++Index)
+    {
+        AVulkanMemoryHeap* Heap = FrameHeaps[Index];
+        if (Heap->GetMemoryTypeIndex() != MemoryTypeIndex)
+        {
+            continue;
+        }
+        if (Heap->GetSize() >= Size)
+        {
+            return Heap;
+        }
+
+        // Too small, nothing of this frame slot is in flight anymore.
+        delete Heap;
+        FrameHeaps.RemoveAt(Index);
+        break;
+    }
+
+    const VkDeviceSize HeapSize = (Size + HeapGranularity - 1) / HeapGranularity * HeapGranularity;
+    AVulkanMemoryHeap* Heap = new AVulkanMemoryHeap(RHI->GetDevice(), HeapSize, MemoryTypeIndex);
+    FrameHeaps.Add(Heap);
+    return Heap;
+}
+
+void ARenderGraph::Record()
+{
+    auto RecordBarriers = [this](TArray<VkImageMemoryBarrier2>& Barriers, const TArray<ARenderGraphTexture*>& BarrierTextures) {
+        if (Barriers.IsEmpty())
+        {
+            return;
+        }
+        for (int32_t Index = 0; Index < Barriers.Num(); ++Index)
+        {
+            Barriers[Index].image = BarrierTextures[Index]->Texture->Image;
+        }
+        RHI->PipelineBarrier(Barriers.GetData(), Barriers.Num());
+        for (int32_t Index = 0; Index < Barriers.Num(); ++Index)
+        {
+            BarrierTextures[Index]->Texture->Layout = Barriers[Index].newLayout;
+        }
+        Stats.NumBarriers += Barriers.Num();
+        ++Stats.NumBarrierBatches;
+    };
+
+    for (int32_t PassIndex = 0; PassIndex < LivePasses.Num(); ++PassIndex)
+    {
+        ARenderGraphPass* Pass = LivePasses[PassIndex];
+        RecordBarriers(Pass->Barriers, Pass->BarrierTextures);
+
+        if (Pass->IsRaster() && !Pass->bMergedWithPrevious)
+        {
+            AVulkanRenderTargetsInfo RTInfo;
+            VkClearValue ClearValues[MaxSimultaneousRenderTargets + 1];
+            RTInfo.NumColorRenderTargets = static_cast<int8_t>(Pass->NumColorTargets);
+            for (uint32_t Index = 0; Index < Pass->NumColorTargets; ++Index)
+            {
+                check(Pass->ColorTargets[Index], "Color targets are set without gaps.");
+                AVulkanRenderTargetView& View = RTInfo.ColorRenderTarget[Index];
+                View.Texture = Pass->ColorTargets[Index]->Texture;
+                View.LoadAction = Pass->ColorLoadActions[Index];
+                View.StoreAction = Pass->ColorStoreActions[Index];
+                ClearValues[Index] = Pass->ClearValues[Index];
+                RTInfo.bClearColor = RTInfo.bClearColor || View.LoadAction == VK_ATTACHMENT_LOAD_OP_CLEAR;
+            }
+            if (Pass->DepthStencilTarget)
+            {
+                RTInfo.DepthStencilRenderTarget = ADepthRenderTargetView(
+                    Pass->DepthStencilTarget->Texture, Pass->DepthLoadAction, Pass->DepthStoreAction);
+                RTInfo.bClearDepth = Pass->DepthLoadAction == VK_ATTACHMENT_LOAD_OP_CLEAR;
+                RTInfo.bClearStencil = RTInfo.bClearDepth;
+                ClearValues[Pass->NumColorTargets] = Pass->ClearValues[MaxSimultaneousRenderTargets];
+            }
+            for (uint32_t Index = 0; Index < Pass->NumColorTargets; ++Index)
+            {
+                RTInfo.ResolveRenderTarget[Index].Texture = Pass->ResolveTargets[Index] ? Pass->ResolveTargets[Index]->Texture : nullptr;
+            }
+            RTInfo.DepthStencilResolveTexture = Pass->DepthStencilResolveTarget ? Pass->DepthStencilResolveTarget->Texture : nullptr;
+            RHI->BeginRenderPass(RTInfo, ClearValues);
+            RenderTargetLayout.emplace(RTInfo);
+        }
+
+        Pass->Function(RHI);
+
+        const bool bEndsRenderPass = PassIndex + 1 == LivePasses.Num() || !LivePasses[PassIndex + 1]->bMergedWithPrevious;
+        if (Pass->IsRaster() && bEndsRenderPass)
+        {
+            RHI->EndRenderPass();
+            RenderTargetLayout.reset();
+        }
+    }
+
+    RecordBarriers(FinalBarriers, FinalBarrierTextures);
+}
+
+void ARenderGraph::Reset()
+{
+    for (ARenderGraphPass* Pass : Passes)
+    {
+        delete Pass;
+    }
+    for (ARenderGraphTexture* Texture : Textures)
+    {
+        if (Texture->bPooled)
+        {
+            // The pool hands it out again once the frames in flight are done with it.
+            RHI->GetRenderTargetPool()->Release(Texture->Texture);
+        }
+        delete Texture;
+    }
+    Passes.Clear();
+    Textures.Clear();
+    LivePasses.Clear();
+    FinalBarriers.Clear();
+    FinalBarrierTextures.Clear();
+    ++FrameNumber;
+}
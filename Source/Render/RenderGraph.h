@@ -0,0 +1,259 @@
+#pragma once
+
+#include "RHI/VulkanRHI/VulkanAPI.h"
+#include "RHI/VulkanRHI/VulkanResources.h"
+
+class AVulkanMemoryHeap;
+class AVulkanRHI;
+class ARenderGraphPass;
+
+// How a pass uses a texture, decides the layout, the pipeline stages and the accesses its barriers wait for.
+enum class ERenderGraphAccess : uint8_t
+{
+    ColorAttachment,
+    DepthStencilAttachment,
+    // Depth tested without writes and sampled in the same pass.
+    DepthStencilRead,
+    // Written by the depth stencil resolve at the end of a render pass, which runs in the color output stage.
+    DepthStencilResolve,
+    ShaderRead,
+    StorageReadWrite,
+    TransferSrc,
+    TransferDst,
+};
+
+struct ARenderGraphTextureDesc
+{
+    VkFormat Format = VK_FORMAT_UNDEFINED;
+    uint32_t Width = 0;
+    uint32_t Height = 0;
+    uint32_t NumMips = 1;
+    uint32_t NumSamples = 1;
+    VkImageAspectFlags AspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+};
+
+struct ARenderGraphStats
+{
+    uint32_t NumPasses = 0;
+    uint32_t NumCulledPasses = 0;
+    // Passes recorded in the render pass of the previous one instead of beginning their own.
+    uint32_t NumMergedPasses = 0;
+    uint32_t NumBarriers = 0;
+    uint32_t NumBarrierBatches = 0;
+
+    uint32_t NumCreatedTextures = 0;
+    // Created textures that live in tile memory only, backed by lazily allocated memory when the device has it.
+    uint32_t NumLazyTextures = 0;
+    // Created textures taken from the render target pool, alive alongside every other one so none could alias them.
+    uint32_t NumPooledTextures = 0;
+    // Memory the created textures would take on their own, and what they take once those with disjoint
+    // lifetimes share it. The difference is what aliasing saved this frame.
+    VkDeviceSize TransientBytesRequested = 0;
+    VkDeviceSize TransientBytesAliased = 0;
+    // Part of TransientBytesAliased in lazily allocated memory, only committed if the tiles spill.
+    VkDeviceSize TransientBytesLazy = 0;
+};
+
+class ARenderGraphTexture
+{
+public:
+    inline const AnsiChar* GetName() const { return Name; }
+    inline const ARenderGraphTextureDesc& GetDesc() const { return Desc; }
+    // Valid while the passes execute.
+    inline AVulkanTexture* GetTexture() const { return Texture; }
+
+private:
+    friend class ARenderGraph;
+
+    // Last synchronized use, recorded while the barriers are built.
+    struct ASyncState
+    {
+        VkImageLayout Layout;
+        VkPipelineStageFlags2 WriteStages;
+        VkAccessFlags2 WriteAccess;
+        // Reads since the last write, a following write has to wait for them.
+        VkPipelineStageFlags2 ReadStages;
+        // Stages and accesses already ordered after the last write or layout transition.
+        VkPipelineStageFlags2 SyncedStages;
+        VkAccessFlags2 VisibleAccess;
+    };
+
+    const AnsiChar* Name;
+    ARenderGraphTextureDesc Desc;
+    AVulkanTexture* Texture;
+    VkImageUsageFlags Usage;
+
+    // Imported textures keep their contents after the graph executed and are left in FinalLayout.
+    bool bExternal;
+    VkImageLayout FinalLayout;
+
+    // Whether a later live pass or the outside of the graph reads the current contents, while culling.
+    bool bNeeded;
+    // Indices of the first and last live pass using it.
+    int32_t FirstPass;
+    int32_t LastPass;
+    bool bAttachmentOnly;
+    bool bFirstUseDiscards;
+
+    ASyncState State;
+    // Its first barrier, which also waits for the textures that used its memory earlier in the frame.
+    ARenderGraphPass* FirstBarrierPass;
+    int32_t FirstBarrierIndex;
+
+    // Placement of created textures.
+    VkDeviceSize MemorySize;
+    VkDeviceSize MemoryAlignment;
+    VkDeviceSize MemoryOffset;
+    uint32_t MemoryTypeIndex;
+    bool bLazy;
+    // Acquired from the RHI's render target pool instead of placed in a heap, released when the graph resets.
+    bool bPooled;
+};
+
+using ARenderGraphPassFunction = TFunction<void(AVulkanRHI* RHI)>;
+
+class ARenderGraphPass
+{
+public:
+    // Passes with attachments are raster passes, the graph begins and ends rendering around them.
+    void SetColorTarget(uint32_t Index, ARenderGraphTexture* Texture, VkAttachmentLoadOp LoadAction, const VkClearColorValue& ClearColor = {});
+    void SetDepthStencilTarget(ARenderGraphTexture* Texture, VkAttachmentLoadOp LoadAction, float ClearDepth = VulkanFarDepth, uint32_t ClearStencil = 0);
+    // Single sampled textures the multisampled targets are resolved into when the render pass ends. A pass that
+    // resolves is the last one of its render pass, later passes drawing to the same targets begin a new one.
+    void SetResolveTarget(uint32_t Index, ARenderGraphTexture* Texture);
+    void SetDepthStencilResolveTarget(ARenderGraphTexture* Texture);
+
+    void Read(ARenderGraphTexture* Texture, ERenderGraphAccess Access = ERenderGraphAccess::ShaderRead);
+    // bOverwrite tells the pass replaces every texel, so earlier writes are not needed for it.
+    void Write(ARenderGraphTexture* Texture, ERenderGraphAccess Access, bool bOverwrite = false);
+
+    // Kept even when nothing reads what it writes, for passes with effects outside of the graph.
+    inline void NeverCull() { bNeverCull = true; }
+
+    inline const AnsiChar* GetName() const { return Name; }
+    inline bool IsRaster() const { return NumColorTargets != 0 || DepthStencilTarget != nullptr; }
+    inline bool HasResolveTargets() const { return NumResolveTargets != 0 || DepthStencilResolveTarget != nullptr; }
+
+private:
+    friend class ARenderGraph;
+
+    struct AUse
+    {
+        ARenderGraphTexture* Texture;
+        ERenderGraphAccess Access;
+        bool bWrite;
+        // The contents before the pass are not needed, an attachment that is cleared or a full overwrite.
+        bool bDiscard;
+        bool bAttachment;
+    };
+
+    ARenderGraphPass(const AnsiChar* Name, ARenderGraphPassFunction&& Function);
+    void AddUse(const AUse& Use);
+
+    const AnsiChar* Name;
+    ARenderGraphPassFunction Function;
+    TArray<AUse> Uses;
+
+    ARenderGraphTexture* ColorTargets[MaxSimultaneousRenderTargets];
+    VkAttachmentLoadOp ColorLoadActions[MaxSimultaneousRenderTargets];
+    uint32_t NumColorTargets;
+    ARenderGraphTexture* DepthStencilTarget;
+    VkAttachmentLoadOp DepthLoadAction;
+    // Indexed by the color target they resolve.
+    ARenderGraphTexture* ResolveTargets[MaxSimultaneousRenderTargets];
+    uint32_t NumResolveTargets;
+    ARenderGraphTexture* DepthStencilResolveTarget;
+    // Indexed by color target, depth at MaxSimultaneousRenderTargets.
+    VkClearValue ClearValues[MaxSimultaneousRenderTargets + 1];
+
+    bool bNeverCull;
+    bool bCulled;
+    // Recorded inside the render pass begun by the previous live pass.
+    bool bMergedWithPrevious;
+    // Store actions of the render pass this pass begins, decided once every pass of it is known.
+    VkAttachmentStoreOp ColorStoreActions[MaxSimultaneousRenderTargets];
+    VkAttachmentStoreOp DepthStoreAction;
+
+    // Recorded as one vkCmdPipelineBarrier2 before the pass.
+    TArray<VkImageMemoryBarrier2> Barriers;
+    TArray<ARenderGraphTexture*> BarrierTextures;
+};
+
+// Frame render graph.
+//
+// Passes declare the textures they read and write, Execute() then culls the passes whose results nobody
+// reads, batches the barriers each pass needs into a single vkCmdPipelineBarrier2 derived from the last use
+// of every texture, and records raster passes with the same attachments into one render pass. Passes run
+// in the order they were added. Everything is rebuilt every frame.
+//
+// Created textures are placed in per-frame memory heaps, one per memory type, and those whose lifetimes don't
+// overlap share memory. Textures with nothing to share with, alive alongside every other texture of their
+// memory type, come from the render target pool instead and keep their image across frames. Attachments that
+// are cleared and dropped within a single render pass are created as transient attachments in lazily
+// allocated memory when the device has it, so on tilers they never get backing memory at all.
+class ARenderGraph
+{
+public:
+    ARenderGraph(AVulkanRHI* RHI);
+    ~ARenderGraph();
+
+    // Allocated by Execute() when a live pass uses it, usage and placement follow from the passes.
+    ARenderGraphTexture* CreateTexture(const AnsiChar* Name, const ARenderGraphTextureDesc& Desc);
+    ARenderGraphTexture* ImportTexture(const AnsiChar* Name, AVulkanTexture* Texture, VkImageLayout FinalLayout);
+    ARenderGraphPass* AddPass(const AnsiChar* Name, ARenderGraphPassFunction&& Function);
+
+    // Records every live pass into the current command buffer and resets the graph for the next frame.
+    void Execute();
+
+    inline const ARenderGraphStats& GetLastStats() const { return Stats; }
+    // Layout of the render pass the running raster pass records into, only valid inside its function. Pipelines
+    // drawn in the pass are looked up with it, so they follow the load, store and resolve choices of the graph.
+    const AVulkanRenderTargetLayout& GetRenderTargetLayout() const;
+
+private:
+    void CullPasses();
+    void ComputeLifetimes();
+    void BuildBarriers();
+    void ComputeStoreActions();
+    void CreateTextures();
+    void Record();
+    void Reset();
+
+    // Barrier moving Texture to the use, nothing when the use is already ordered after the previous ones.
+    void Transition(ARenderGraphTexture* Texture, VkImageLayout Layout, VkPipelineStageFlags2 Stages, VkAccessFlags2 Access, bool bWrite, bool bDiscard,
+        TArray<VkImageMemoryBarrier2>& OutBarriers, TArray<ARenderGraphTexture*>& OutTextures);
+    // Lowest offsets at which no two textures alive at the same time overlap, returns the memory they need.
+    static VkDeviceSize PlaceTextures(TArray<ARenderGraphTexture*>& HeapTextures);
+    AVulkanMemoryHeap* GetOrCreateHeap(uint32_t MemoryTypeIndex, VkDeviceSize Size);
+    bool CanMerge(const ARenderGraphPass* Previous, const ARenderGraphPass* Pass) const;
+
+private:
+    enum
+    {
+        // Frames the GPU may still be reading textures created by the graph in.
+        NumFramesInFlight = 3
+    };
+
+    // Heaps grow in steps of this, so small changes of the render targets don't reallocate every frame.
+    static constexpr VkDeviceSize HeapGranularity = 4 * 1024 * 1024;
+
+    TArray<ARenderGraphTexture*> Textures;
+    TArray<ARenderGraphPass*> Passes;
+    TArray<ARenderGraphPass*> LivePasses;
+
+    // Leaves the external textures in their final layout.
+    TArray<VkImageMemoryBarrier2> FinalBarriers;
+    TArray<ARenderGraphTexture*> FinalBarrierTextures;
+
+    // Per frame slot, reused once the frame that used them can no longer be in flight.
+    TArray<AVulkanTexture*> CreatedTextures[NumFramesInFlight];
+    TArray<AVulkanMemoryHeap*> Heaps[NumFramesInFlight];
+    uint64_t FrameNumber;
+
+    // Set by Record() while a render pass is open.
+    TOptional<AVulkanRenderTargetLayout> RenderTargetLayout;
+
+    ARenderGraphStats Stats;
+
+    AVulkanRHI* RHI;
+};
@@ -1,7 +1,11 @@
 #include "Renderer.h"
 
+#include "Core/JobSystem.h"
+#include "Render/RenderGraph.h"
+#include "RHI/VulkanRHI/VulkanDevice.h"
 #include "RHI/VulkanRHI/VulkanRHI.h"
 #include "RHI/VulkanRHI/VulkanResources.h"
+#include "RHI/VulkanRHI/VulkanTextureStreaming.h"
 #include "RHI/VulkanRHI/VulkanPipeline.h"
 
 #define GLFW_INCLUDE_VULKAN
@@ -14,12 +18,55 @@
 #include <chrono>
 #include <thread>
 
-ARenderer::ARenderer(int32_t InWidth, int32_t InHeight) : WindowWidth(InWidth), WindowHeight(InHeight), RHI(nullptr)
+void ARendererOptions::ParseCommandLine(int32_t Argc, char** Argv)
+{
+    for (int32_t Index = 1; Index < Argc; ++Index)
+    {
+        const std::string_view Arg = Argv[Index];
+        if (Arg == "-psocapture")
+        {
+            bCapturePSOs = true;
+        }
+        else if (Arg == "-nopsoprecompile")
+        {
+            bPrecompilePSOs = false;
+        }
+        else if (Arg == "-psoprecompileasync")
+        {
+            bPrecompilePSOsAsync = true;
+        }
+        else if (Arg == "-msaa" && Index + 1 < Argc)
+        {
+            NumMSAASamples = static_cast<uint32_t>(std::strtoul(Argv[++Index], nullptr, 10));
+        }
+        else if (Arg == "-texturebudget" && Index + 1 < Argc)
+        {
+            TextureStreamingBudgetMB = static_cast<uint32_t>(std::strtoul(Argv[++Index], nullptr, 10));
+        }
+    }
+}
+
+ARenderer::ARenderer(int32_t InWidth, int32_t InHeight, const ARendererOptions& InOptions)
+    : WindowWidth(InWidth), WindowHeight(InHeight), RHI(nullptr), RenderGraph(nullptr), Options(InOptions), NumMSAASamples(1)
 {
     InitializeWindow();
 
+    AJobSystem::Get().Initialize();
+
     RHI = new AVulkanRHI();
     RHI->CreateViewport(GetNativeWindowHandle(), WindowWidth, WindowHeight, false);
+    RenderGraph = new ARenderGraph(RHI);
+    SetMSAASampleCount(Options.NumMSAASamples);
+    RHI->GetTextureStreamer()->SetBudget(static_cast<VkDeviceSize>(Options.TextureStreamingBudgetMB) * 1024 * 1024);
+
+    if (Options.bPrecompilePSOs)
+    {
+        RHI->PrecompilePipelineManifest(!Options.bPrecompilePSOsAsync);
+    }
+    if (Options.bCapturePSOs)
+    {
+        RHI->BeginPipelineManifestCapture();
+    }
     // AViewportInfo ViewportInfo;
     // AMemory::Memzero(ViewportInfo);
     // ViewportInfo.WindowHandle = GetNativeWindowHandle();
@@ -35,9 +82,15 @@ ARenderer::~ARenderer()
 {
     // RHI->ClearContext();
 
+    delete RenderGraph;
+    RenderGraph = nullptr;
+
+    // Waits for the pipeline compiles, before the job system drops what is still queued.
     delete RHI;
     RHI = nullptr;
 
+    AJobSystem::Get().Shutdown();
+
     glfwDestroyWindow((GLFWwindow*)Window);
     glfwTerminate();
 }
@@ -62,38 +115,98 @@ void* ARenderer::GetNativeWindowHandle() const
     return (void*)glfwGetWin32Window((GLFWwindow*)Window);
 }
 
+void ARenderer::SetMSAASampleCount(uint32_t NumSamples)
+{
+    // Scene depth is multisampled as well.
+    NumMSAASamples = RHI->GetDevice()->GetSupportedSampleCount(std::max(1u, NumSamples), true);
+    if (NumMSAASamples != NumSamples)
+    {
+        std::cout << "[INFO] MSAA: " << NumSamples << " samples are not supported, using " << NumMSAASamples << ".\n";
+    }
+    else
+    {
+        std::cout << "[INFO] MSAA: " << NumMSAASamples << " samples.\n";
+    }
+}
+
 void ARenderer::MainTick()
 {
     // AVulkanTexture* BackBuffer = RHI->AcquireViewportNextBackBuffer();
 
-    AVulkanRenderTargetsInfo RTInfo;
-    RTInfo.NumColorRenderTargets = 1;
-
-    AVulkanRenderTargetView& ColorRTView = RTInfo.ColorRenderTarget[0];
-    ColorRTView.Texture = RHI->GetViewportBackBuffer(0);
-    ColorRTView.LoadAction = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    ColorRTView.StoreAction = VK_ATTACHMENT_STORE_OP_STORE;
-
-    AVulkanRenderTargetLayout RTLayout(RTInfo);
+    AGraphicsPipelineStateInitializer PSOInitializer;
+    PSOInitializer.Spirvs[ShaderStage::Vertex] = AString(SHADER_DIR) + "VertShaderBase_vert.spv";
+    PSOInitializer.Spirvs[ShaderStage::Pixel] = AString(SHADER_DIR) + "FragShaderBase_frag.spv";
+    PSOInitializer.Topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 
-    AVulkanGraphicsPipelineState* PSO = RHI->CreateGraphicsPipelineState(RTLayout);
+    // Nothing uses stencil yet.
+    const VkFormat SceneDepthFormat = RHI->GetDevice()->GetDepthStencilFormat(false);
 
+    bool bMSAAKeyWasDown = false;
+    // The transient textures only change with the graph's shape, log them when they do.
+    ARenderGraphStats LoggedGraphStats;
     while (!ShouldCloseWindow())
     {
         using Clock = std::chrono::steady_clock;
         auto FrameStart = Clock::now();
 
         glfwPollEvents();
+        AJobSystem::Get().PumpRenderThread();
+
+        const bool bMSAAKeyDown = glfwGetKey((GLFWwindow*)Window, GLFW_KEY_M) == GLFW_PRESS;
+        if (bMSAAKeyDown && !bMSAAKeyWasDown)
+        {
+            // Steps through the supported counts and back to 1 past the highest one.
+            const uint32_t NextNumSamples = RHI->GetDevice()->GetSupportedSampleCount(NumMSAASamples * 2, true);
+            SetMSAASampleCount(NextNumSamples > NumMSAASamples ? NextNumSamples : 1);
+        }
+        bMSAAKeyWasDown = bMSAAKeyDown;
 
         RHI->BeginDrawing();
 
-        RHI->BeginRenderPass();
-        RHI->SetViewport(0.0f, 0.0f, 0.0f, (float)WindowWidth, (float)WindowHeight, 1.0f);
+        AVulkanTexture* BackBufferTexture = RHI->AcquireNextBackBuffer();
+        ARenderGraphTexture* BackBuffer = RenderGraph->ImportTexture("BackBuffer", BackBufferTexture, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
-        // RHI->SetViewport
-        RHI->SetGraphicsPipelineState(PSO);
-        RHI->DrawPrimitive(0, 1);
-        RHI->EndRenderPass();
+        // Multisampled scene color is cleared, drawn and resolved within the render pass, so the graph keeps it in
+        // lazily allocated memory where the device has it and the samples never leave tile memory.
+        ARenderGraphTexture* SceneColor = BackBuffer;
+        if (NumMSAASamples > 1)
+        {
+            ARenderGraphTextureDesc SceneColorDesc;
+            SceneColorDesc.Format = BackBufferTexture->PixelFormat;
+            SceneColorDesc.Width = BackBufferTexture->Width;
+            SceneColorDesc.Height = BackBufferTexture->Height;
+            SceneColorDesc.NumSamples = NumMSAASamples;
+            SceneColor = RenderGraph->CreateTexture("SceneColorMS", SceneColorDesc);
+        }
+
+        // Same for depth, only tested within the pass.
+        ARenderGraphTextureDesc SceneDepthDesc;
+        SceneDepthDesc.Format = SceneDepthFormat;
+        SceneDepthDesc.Width = BackBufferTexture->Width;
+        SceneDepthDesc.Height = BackBufferTexture->Height;
+        SceneDepthDesc.NumSamples = NumMSAASamples;
+        SceneDepthDesc.AspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+        ARenderGraphTexture* SceneDepth = RenderGraph->CreateTexture("SceneDepth", SceneDepthDesc);
+
+        ARenderGraphPass* BasePass = RenderGraph->AddPass("BasePass", [this, &PSOInitializer](AVulkanRHI* InRHI) {
+            // Compiled in the background, frames only clear the back buffer until the PSO is ready.
+            AVulkanGraphicsPipelineState* PSO = InRHI->GetGraphicsPipelineState(PSOInitializer, RenderGraph->GetRenderTargetLayout());
+
+            InRHI->SetViewport(0.0f, 0.0f, 0.0f, (float)WindowWidth, (float)WindowHeight, 1.0f);
+            if (PSO)
+            {
+                InRHI->SetGraphicsPipelineState(PSO);
+                InRHI->DrawPrimitive(0, 1);
+            }
+        });
+        BasePass->SetColorTarget(0, SceneColor, VK_ATTACHMENT_LOAD_OP_CLEAR, { { 0.0f, 0.0f, 0.0f, 1.0f } });
+        if (SceneColor != BackBuffer)
+        {
+            BasePass->SetResolveTarget(0, BackBuffer);
+        }
+        BasePass->SetDepthStencilTarget(SceneDepth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+
+        RenderGraph->Execute();
 
         // RHI->BeginRenderPass();
         // RHI->SetGraphicsPipelineState(PSO);
@@ -102,6 +215,45 @@ void ARenderer::MainTick()
 
         RHI->EndDrawing();
 
+        const AVulkanPipelineFrameStats& PSOStats = RHI->GetPipelineFrameStats();
+        if (PSOStats.NumRequestedCompiles != 0 || PSOStats.NumFinishedCompiles != 0)
+        {
+            std::cout << "[INFO] PSO: " << PSOStats.NumRequestedCompiles << " requested, " << PSOStats.NumFinishedCompiles << " compiled in "
+                      << PSOStats.CompileTimeMs << " ms, " << PSOStats.NumPendingCompiles << " pending, " << PSOStats.NumSkippedDraws
+                      << " draws skipped, " << PSOStats.NumFallbackDraws << " fallback draws.\n";
+        }
+
+        const ARenderGraphStats& GraphStats = RenderGraph->GetLastStats();
+        if (GraphStats.NumCreatedTextures != LoggedGraphStats.NumCreatedTextures ||
+            GraphStats.TransientBytesRequested != LoggedGraphStats.TransientBytesRequested ||
+            GraphStats.TransientBytesAliased != LoggedGraphStats.TransientBytesAliased || GraphStats.TransientBytesLazy != LoggedGraphStats.TransientBytesLazy)
+        {
+            std::cout << "[INFO] Render graph: " << GraphStats.NumPasses - GraphStats.NumCulledPasses << "/" << GraphStats.NumPasses << " passes ("
+                      << GraphStats.NumMergedPasses << " merged), " << GraphStats.NumBarriers << " barriers in " << GraphStats.NumBarrierBatches
+                      << " batches, " << GraphStats.NumCreatedTextures << " transient textures (" << GraphStats.NumLazyTextures << " lazy, "
+                      << GraphStats.NumPooledTextures << " pooled), "
+                      << GraphStats.TransientBytesRequested / 1024 << " KB requested, " << GraphStats.TransientBytesAliased / 1024 << " KB aliased, "
+                      << GraphStats.TransientBytesLazy / 1024 << " KB lazy.\n";
+            LoggedGraphStats = GraphStats;
+        }
+
+        const AVulkanRenderTargetPoolStats& PoolStats = RHI->GetRenderTargetPool()->GetLastStats();
+        if (PoolStats.NumHits != PoolStats.NumRequests || PoolStats.NumDestroyed != 0)
+        {
+            std::cout << "[INFO] Render targets: " << PoolStats.NumHits << "/" << PoolStats.NumRequests << " reused, " << PoolStats.NumDestroyed
+                      << " destroyed, " << PoolStats.NumTextures << " pooled (" << PoolStats.NumFreeTextures << " free), "
+                      << PoolStats.BytesHeld / (1024 * 1024) << " MB held.\n";
+        }
+
+        const AVulkanTextureStreamingStats& StreamingStats = RHI->GetTextureStreamer()->GetLastStats();
+        if (StreamingStats.NumStreamedIn != 0 || StreamingStats.NumStreamedOut != 0)
+        {
+            std::cout << "[INFO] Texture streaming: " << StreamingStats.NumResidentMips << "/" << StreamingStats.NumRequestedMips << " mips resident, "
+                      << StreamingStats.ResidentBytes / (1024 * 1024) << "/" << StreamingStats.RequestedBytes / (1024 * 1024) << " MB of "
+                      << StreamingStats.BudgetBytes / (1024 * 1024) << " MB budget, " << StreamingStats.NumStreamedIn << " in, "
+                      << StreamingStats.NumStreamedOut << " out, " << StreamingStats.NumPendingRequests << " pending.\n";
+        }
+
         auto FrameEnd = Clock::now();
         auto FrameTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(FrameEnd - FrameStart).count();
         constexpr int64_t TargetFrameMs = 15;
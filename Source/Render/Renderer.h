@@ -2,16 +2,37 @@
 
 #include "Core/BasicTypes.h"
 
+class ARenderGraph;
 class AVulkanRHI;
 
+struct ARendererOptions
+{
+    // -psocapture: records every created pipeline to the PSO manifest.
+    bool bCapturePSOs = false;
+    // -nopsoprecompile: skips compiling the manifest at startup.
+    bool bPrecompilePSOs = true;
+    // -psoprecompileasync: compiles the manifest while frames render instead of before the first one.
+    bool bPrecompilePSOsAsync = false;
+    // -msaa <N>: samples per pixel of the scene color, resolved into the back buffer. Clamped to what the device
+    // supports and changed at runtime with SetMSAASampleCount(), the M key cycles through 1, 2, 4 and 8.
+    uint32_t NumMSAASamples = 1;
+    // -texturebudget <MB>: memory streamed texture mips may use.
+    uint32_t TextureStreamingBudgetMB = 256;
+
+    void ParseCommandLine(int32_t Argc, char** Argv);
+};
+
 class ARenderer
 {
 public:
-    ARenderer(int32_t InWidth = 1280, int32_t InHeight = 720);
+    ARenderer(int32_t InWidth = 1280, int32_t InHeight = 720, const ARendererOptions& InOptions = ARendererOptions());
     ~ARenderer();
 
     void MainTick();
 
+    void SetMSAASampleCount(uint32_t NumSamples);
+    inline uint32_t GetMSAASampleCount() const { return NumMSAASamples; }
+
 private:
     void InitializeWindow();
     bool ShouldCloseWindow() const;
@@ -22,6 +43,9 @@ private:
     void* Window;
 
     AVulkanRHI* RHI;
+    ARenderGraph* RenderGraph;
+    ARendererOptions Options;
+    uint32_t NumMSAASamples;
 
     int32_t WindowWidth;
     int32_t WindowHeight;
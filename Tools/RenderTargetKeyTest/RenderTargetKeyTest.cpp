@@ -0,0 +1,246 @@
+// Builds an AVulkanRenderTargetLayout for every permutation of attachment formats, load and store actions,
+// sample counts, resolve targets and subpass hints, and fails when two different layouts share a key.
+//
+// Usage: RenderTargetKeyTest
+//
+// The render pass cache guards against collisions with Matches(), a collision still costs a render pass
+// creation every time the two layouts alternate. Every permutation differs in something the render pass is
+// created from, so every key must be unique. Returns 1 otherwise.
+//
+// Afterwards every permutation is built NumTimingPasses more times and the average time to build and hash a
+// layout is printed. It is informational only, the render pass cache builds a layout for every render pass begun.
+
+#include "Core/BasicCore.h"
+#include "RHI/VulkanRHI/VulkanResources.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <unordered_map>
+
+namespace
+{
+    struct AColorTarget
+    {
+        VkFormat Format;
+        VkAttachmentLoadOp LoadAction;
+        VkAttachmentStoreOp StoreAction;
+        bool bResolve;
+    };
+
+    struct ADepthTarget
+    {
+        VkFormat Format;
+        VkImageAspectFlags AspectMask;
+        VkAttachmentLoadOp DepthLoadAction;
+        VkAttachmentStoreOp DepthStoreAction;
+        VkAttachmentLoadOp StencilLoadAction;
+        VkAttachmentStoreOp StencilStoreAction;
+        bool bResolve;
+    };
+
+    constexpr VkFormat ColorFormats[] = { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT };
+    constexpr VkAttachmentLoadOp LoadActions[] = { VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_LOAD_OP_DONT_CARE };
+    constexpr VkAttachmentStoreOp StoreActions[] = { VK_ATTACHMENT_STORE_OP_STORE, VK_ATTACHMENT_STORE_OP_DONT_CARE };
+    constexpr uint32_t SampleCounts[] = { 1, 4 };
+    constexpr ESubpassHint SubpassHints[] = { ESubpassHint::None, ESubpassHint::DepthReadSubpass, ESubpassHint::DeferredShadingSubpass };
+    constexpr int32_t MaxColorTargets = 2;
+    constexpr uint32_t NumTimingPasses = 20;
+
+    // The layout only reads the format, the size, the sample count and the aspect of its textures, so they are
+    // filled in without an image or a device behind them.
+    class ATextureFactory
+    {
+    public:
+        ~ATextureFactory()
+        {
+            for (AVulkanTexture* Texture : Textures)
+            {
+                std::free(Texture);
+            }
+        }
+
+        AVulkanTexture* Get(VkFormat Format, uint32_t NumSamples, VkImageAspectFlags AspectMask)
+        {
+            for (AVulkanTexture* Texture : Textures)
+            {
+                if (Texture->PixelFormat == Format && Texture->NumSamples == NumSamples && Texture->AspectMask == AspectMask)
+                {
+                    return Texture;
+                }
+            }
+
+            AVulkanTexture* Texture = static_cast<AVulkanTexture*>(std::malloc(sizeof(AVulkanTexture)));
+            AMemory::Memzero(Texture, sizeof(AVulkanTexture));
+            Texture->PixelFormat = Format;
+            Texture->Width = 1920;
+            Texture->Height = 1080;
+            Texture->NumSamples = NumSamples;
+            Texture->AspectMask = AspectMask;
+            Textures.Add(Texture);
+            return Texture;
+        }
+
+    private:
+        TArray<AVulkanTexture*> Textures;
+    };
+
+    void AddColorTargets(TArray<TArray<AColorTarget>>& OutCombinations, TArray<AColorTarget>& Targets, bool bMultisampled)
+    {
+        OutCombinations.Add(Targets);
+        if (Targets.Num() == MaxColorTargets)
+        {
+            return;
+        }
+
+        for (VkFormat Format : ColorFormats)
+        {
+            for (VkAttachmentLoadOp LoadAction : LoadActions)
+            {
+                for (VkAttachmentStoreOp StoreAction : StoreActions)
+                {
+                    for (uint32_t Resolve = 0; Resolve < (bMultisampled ? 2u : 1u); ++Resolve)
+                    {
+                        Targets.Add(AColorTarget{ Format, LoadAction, StoreAction, Resolve != 0 });
+                        AddColorTargets(OutCombinations, Targets, bMultisampled);
+                        Targets.RemoveAt(Targets.Num() - 1);
+                    }
+                }
+            }
+        }
+    }
+
+    void AddDepthTargets(TArray<ADepthTarget>& OutTargets, bool bMultisampled)
+    {
+        OutTargets.Add(ADepthTarget{ VK_FORMAT_UNDEFINED });
+        for (uint32_t Resolve = 0; Resolve < (bMultisampled ? 2u : 1u); ++Resolve)
+        {
+            for (VkAttachmentLoadOp DepthLoadAction : LoadActions)
+            {
+                for (VkAttachmentStoreOp DepthStoreAction : StoreActions)
+                {
+                    // Stencil actions of depth only targets are ignored, a single permutation covers them.
+                    OutTargets.Add(ADepthTarget{ VK_FORMAT_D32_SFLOAT, VK_IMAGE_ASPECT_DEPTH_BIT, DepthLoadAction, DepthStoreAction,
+                        VK_ATTACHMENT_LOAD_OP_DONT_CARE, VK_ATTACHMENT_STORE_OP_DONT_CARE, Resolve != 0 });
+
+                    for (VkAttachmentLoadOp StencilLoadAction : LoadActions)
+                    {
+                        for (VkAttachmentStoreOp StencilStoreAction : StoreActions)
+                        {
+                            OutTargets.Add(ADepthTarget{ VK_FORMAT_D24_UNORM_S8_UINT, VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+                                DepthLoadAction, DepthStoreAction, StencilLoadAction, StencilStoreAction, Resolve != 0 });
+                        }
+                    }
+                }
+            }
+        }
+    }
+} // namespace
+
+int main()
+{
+    ATextureFactory TextureFactory;
+    // Key to the number of the permutation that produced it.
+    std::unordered_map<uint64_t, uint32_t> Keys;
+    uint32_t NumPermutations = 0;
+    uint32_t NumCollisions = 0;
+    TArray<AVulkanRenderTargetsInfo> Permutations;
+
+    for (uint32_t NumSamples : SampleCounts)
+    {
+        const bool bMultisampled = NumSamples > 1;
+
+        TArray<TArray<AColorTarget>> ColorCombinations;
+        TArray<AColorTarget> Targets;
+        AddColorTargets(ColorCombinations, Targets, bMultisampled);
+
+        TArray<ADepthTarget> DepthTargets;
+        AddDepthTargets(DepthTargets, bMultisampled);
+
+        for (const TArray<AColorTarget>& ColorTargets : ColorCombinations)
+        {
+            bool bResolvesColor = false;
+            for (const AColorTarget& Color : ColorTargets)
+            {
+                bResolvesColor = bResolvesColor || Color.bResolve;
+            }
+
+            for (const ADepthTarget& Depth : DepthTargets)
+            {
+                if (ColorTargets.IsEmpty() && Depth.Format == VK_FORMAT_UNDEFINED)
+                {
+                    continue;
+                }
+
+                for (ESubpassHint SubpassHint : SubpassHints)
+                {
+                    // Resolves are only supported in render passes with a single subpass.
+                    if ((bResolvesColor || Depth.bResolve) && SubpassHint != ESubpassHint::None)
+                    {
+                        continue;
+                    }
+
+                    AVulkanRenderTargetsInfo RTInfo;
+                    RTInfo.SubpassHint = SubpassHint;
+                    RTInfo.NumColorRenderTargets = static_cast<int8_t>(ColorTargets.Num());
+                    for (int32_t Index = 0; Index < ColorTargets.Num(); ++Index)
+                    {
+                        const AColorTarget& Color = ColorTargets[Index];
+                        AVulkanTexture* Texture = TextureFactory.Get(Color.Format, NumSamples, VK_IMAGE_ASPECT_COLOR_BIT);
+                        RTInfo.ColorRenderTarget[Index] = AVulkanRenderTargetView(Texture, Color.LoadAction);
+                        RTInfo.ColorRenderTarget[Index].StoreAction = Color.StoreAction;
+                        if (Color.bResolve)
+                        {
+                            RTInfo.ResolveRenderTarget[Index].Texture = TextureFactory.Get(Color.Format, 1, VK_IMAGE_ASPECT_COLOR_BIT);
+                        }
+                    }
+                    if (Depth.Format != VK_FORMAT_UNDEFINED)
+                    {
+                        RTInfo.DepthStencilRenderTarget = ADepthRenderTargetView(TextureFactory.Get(Depth.Format, NumSamples, Depth.AspectMask),
+                            Depth.DepthLoadAction, Depth.DepthStoreAction, Depth.StencilLoadAction, Depth.StencilStoreAction);
+                        if (Depth.bResolve)
+                        {
+                            RTInfo.DepthStencilResolveTexture = TextureFactory.Get(Depth.Format, 1, Depth.AspectMask);
+                        }
+                    }
+
+                    const AVulkanRenderTargetLayout Layout(RTInfo);
+                    Permutations.Add(RTInfo);
+                    ++NumPermutations;
+
+                    auto [Found, bInserted] = Keys.emplace(Layout.GetHash(), NumPermutations);
+                    if (!bInserted)
+                    {
+                        std::cerr << "[ERROR] Permutations " << Found->second << " and " << NumPermutations << " share the key " << std::hex
+                                  << Layout.GetHash() << std::dec << ".\n";
+                        ++NumCollisions;
+                    }
+                }
+            }
+        }
+    }
+
+    if (NumCollisions != 0)
+    {
+        std::cerr << "[ERROR] " << NumCollisions << " of " << NumPermutations << " render target layouts share a key.\n";
+        return 1;
+    }
+
+    std::cout << "[INFO] " << NumPermutations << " render target layouts, every key is unique.\n";
+
+    using Clock = std::chrono::steady_clock;
+    // Keeps the layouts from being optimized away.
+    uint64_t KeySum = 0;
+    auto TimingStart = Clock::now();
+    for (uint32_t Pass = 0; Pass < NumTimingPasses; ++Pass)
+    {
+        for (const AVulkanRenderTargetsInfo& RTInfo : Permutations)
+        {
+            const AVulkanRenderTargetLayout Layout(RTInfo);
+            KeySum += Layout.GetHash();
+        }
+    }
+    auto TimingNs = std::chrono::duration<double, std::nano>(Clock::now() - TimingStart).count();
+    std::cout << "[INFO] Built and hashed a layout in " << TimingNs / (static_cast<double>(NumPermutations) * NumTimingPasses) << " ns on average"
+              << " (key sum " << std::hex << KeySum << std::dec << ").\n";
+    return 0;
+}
@@ -0,0 +1,141 @@
+// Packs every compiled .spv under a directory into one shader package.
+//
+// Usage: ShaderPacker <InputDir> <OutputFile> [-compress] [-report <UnoptimizedDir>]
+//
+// -report prints the content hash and the instruction count of every shader, compared with the module
+// of the same name in UnoptimizedDir.
+
+#include "Core/BasicCore.h"
+#include "Core/Hash.h"
+#include "Core/Package.h"
+
+#include <filesystem>
+#include <iomanip>
+
+static constexpr uint32_t SpirvMagic = 0x07230203;
+
+static bool ReadFile(const std::filesystem::path& Path, TArray<uint8_t>& OutData)
+{
+    std::ifstream File(Path, std::ios::ate | std::ios::binary);
+    if (!File.is_open())
+    {
+        return false;
+    }
+
+    OutData.Resize(static_cast<int32_t>(File.tellg()));
+    File.seekg(0);
+    File.read(reinterpret_cast<AnsiChar*>(OutData.GetData()), OutData.Num());
+    return static_cast<bool>(File);
+}
+
+static uint32_t CountInstructions(const TArray<uint8_t>& Code)
+{
+    const size_t NumWords = Code.Num() / sizeof(uint32_t);
+    uint32_t NumInstructions = 0;
+    for (size_t Word = 5; Word < NumWords; ++NumInstructions)
+    {
+        uint32_t Instruction;
+        AMemory::Memcpy(&Instruction, Code.GetData() + Word * sizeof(uint32_t), sizeof(Instruction));
+        if ((Instruction >> 16) == 0)
+        {
+            break;
+        }
+        Word += Instruction >> 16;
+    }
+    return NumInstructions;
+}
+
+int main(int Argc, char** Argv)
+{
+    if (Argc < 3)
+    {
+        std::cerr << "Usage: ShaderPacker <InputDir> <OutputFile> [-compress] [-report <UnoptimizedDir>]\n";
+        return 1;
+    }
+
+    const std::filesystem::path InputDir = Argv[1];
+    const AString OutputFile = Argv[2];
+    bool bCompress = false;
+    std::filesystem::path ReportDir;
+    for (int Index = 3; Index < Argc; ++Index)
+    {
+        if (std::strcmp(Argv[Index], "-compress") == 0)
+        {
+            bCompress = true;
+        }
+        else if (std::strcmp(Argv[Index], "-report") == 0 && Index + 1 < Argc)
+        {
+            ReportDir = Argv[++Index];
+        }
+        else
+        {
+            std::cerr << "[ERROR] Unknown argument " << Argv[Index] << ".\n";
+            return 1;
+        }
+    }
+
+    // Sorted so the package is byte identical between runs.
+    TArray<std::filesystem::path> Files;
+    for (const std::filesystem::directory_entry& Entry : std::filesystem::recursive_directory_iterator(InputDir))
+    {
+        if (Entry.is_regular_file() && Entry.path().extension() == ".spv")
+        {
+            Files.Add(Entry.path());
+        }
+    }
+    std::sort(Files.begin(), Files.end());
+
+    APackageWriter Writer;
+    size_t NumBytes = 0;
+    for (const std::filesystem::path& Path : Files)
+    {
+        TArray<uint8_t> Code;
+        if (!ReadFile(Path, Code))
+        {
+            std::cerr << "[ERROR] Failed to read " << Path.string() << ".\n";
+            return 1;
+        }
+
+        uint32_t Magic = 0;
+        if (Code.Num() >= static_cast<int32_t>(sizeof(Magic)))
+        {
+            AMemory::Memcpy(&Magic, Code.GetData(), sizeof(Magic));
+        }
+        if (Code.Num() % sizeof(uint32_t) != 0 || Magic != SpirvMagic)
+        {
+            std::cerr << "[ERROR] " << Path.string() << " is not a SPIR-V module.\n";
+            return 1;
+        }
+
+        // Looked up by the path relative to the shader directory.
+        const AString Name = std::filesystem::relative(Path, InputDir).generic_string();
+        Writer.Add(Name, Code.GetData(), Code.Num(), bCompress);
+        NumBytes += Code.Num();
+
+        if (!ReportDir.empty())
+        {
+            TArray<uint8_t> UnoptimizedCode;
+            if (!ReadFile(ReportDir / Name, UnoptimizedCode))
+            {
+                std::cerr << "[WARNING] No unoptimized module for " << Name << " in " << ReportDir.string() << ", skipping its comparison.\n";
+                continue;
+            }
+            const uint32_t NumInstructions = CountInstructions(Code);
+            const uint32_t NumUnoptimizedInstructions = CountInstructions(UnoptimizedCode);
+
+            std::cout << "[INFO] " << std::left << std::setw(32) << Name << std::right << " " << std::hex << std::setw(16) << std::setfill('0')
+                      << AHash::XXH64(Code.GetData(), Code.Num()) << std::dec << std::setfill(' ') << "  instructions " << std::setw(6)
+                      << NumUnoptimizedInstructions << " -> " << std::setw(6) << NumInstructions << "  bytes " << std::setw(7)
+                      << UnoptimizedCode.Num() << " -> " << std::setw(7) << Code.Num() << "\n";
+        }
+    }
+
+    if (!Writer.Save(OutputFile))
+    {
+        std::cerr << "[ERROR] Failed to write " << OutputFile << ".\n";
+        return 1;
+    }
+
+    std::cout << "[INFO] Packed " << Writer.GetNumEntries() << " shaders (" << NumBytes << " bytes) into " << OutputFile << ".\n";
+    return 0;
+}